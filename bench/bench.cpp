@@ -0,0 +1,37 @@
+#include "bench.h"
+#include <chrono>
+#include <ctime>
+
+double Bench_NowMs() {
+    using namespace std::chrono;
+    return duration<double, std::milli>(
+               steady_clock::now().time_since_epoch())
+        .count();
+}
+
+double Bench_ThreadCpuMs() {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1e6;
+}
+
+Renderer Bench_CreateRenderer(int w, int h, int sampleCount) {
+    Renderer r = Renderer_Create(w, h, 1, sampleCount);
+    r.camera =
+        Camera_Create(Vec3{0.0f, 0.0f, 2.0f}, Vec3{0.0f, 1.0f, 0.0f}, YAW, PITCH);
+
+    return r;
+}
+
+void Bench_DrawDemoScene(Renderer *r, float t) {
+    Vec3 rotation = Vec3{0.0f, t * 40.f, t * 20.0f};
+
+    Renderer_DrawCube(r, Vec3{0.0f, 0.0f, 0.0f}, rotation,
+                      Vec3{1.0f, 1.0f, 1.0f}, ColorRGBA{1.0f, 0.3f, 0.1f, 1.0f});
+    Renderer_DrawCube(r, Vec3{-1.0f, 0.0f, 0.0f}, rotation,
+                      Vec3{0.5f, 0.5f, 0.5f}, ColorRGBA{1.0f, 0.0f, 0.0f, 1.0f});
+    Renderer_DrawCube(r, Vec3{1.0f, 0.0f, 0.0f}, rotation,
+                      Vec3{0.5f, 0.5f, 0.5f}, ColorRGBA{0.0f, 1.0f, 0.0f, 1.0f});
+    Renderer_DrawCube(r, Vec3{0.0f, 1.0f, 0.0f}, rotation,
+                      Vec3{0.5f, 0.5f, 0.5f}, ColorRGBA{0.0f, 0.0f, 1.0f, 1.0f});
+}
@@ -0,0 +1,48 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "renderer.h"
+
+// Headless benchmarks. Each scenario renders offscreen with the portable
+// renderer sources and prints its timings to stdout.
+
+struct BenchScenario {
+    const char *name;
+    void (*run)();
+};
+
+double Bench_NowMs();
+// CPU time of the calling thread, without the time other threads took its
+// core
+double Bench_ThreadCpuMs();
+Renderer Bench_CreateRenderer(int w, int h, int sampleCount = 1);
+// Draws the four spinning cubes of the macOS demo at time t
+void Bench_DrawDemoScene(Renderer *r, float t);
+
+void Bench_MSAA();
+void Bench_DynamicResolution();
+void Bench_Pipeline();
+void Bench_Texture();
+void Bench_Instancing();
+void Bench_Scene();
+void Bench_Occlusion();
+void Bench_Lod();
+void Bench_Overlay();
+void Bench_MicroTriangles();
+void Bench_Shader();
+void Bench_Interpolation();
+void Bench_Transparency();
+void Bench_Depth();
+void Bench_Arena();
+void Bench_VertexFormats();
+void Bench_Incremental();
+void Bench_Export();
+void Bench_MultiView();
+void Bench_Distributed();
+void Bench_Affinity();
+void Bench_Isa();
+void Bench_Streaming();
+void Bench_Skinning();
+void Bench_PostProcess();
+
+#endif
@@ -0,0 +1,74 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+static const int FRAMES = 30;
+
+struct AffinityCase {
+    const char *name;
+    int width, height;
+    int sampleCount;
+};
+
+// Many small cubes over the whole frame, so every tile has work
+static void DrawScene(Renderer *r, float t) {
+    Renderer_ClearBackground(r, 0x101010);
+    Bench_DrawDemoScene(r, t);
+    for (int i = 0; i < 600; i++) {
+        Vec3 position = {(i % 30) * 0.25f - 3.6f, (i / 30) * 0.2f - 2.0f,
+                         -3.0f};
+        Renderer_DrawCube(r, position, Vec3{t * 30.0f, t * 50.0f, 0.0f},
+                          Vec3{0.08f, 0.08f, 0.08f},
+                          ColorRGBA{0.2f, 0.6f, 0.9f, 1.0f});
+    }
+}
+
+static void Run(const AffinityCase &c, bool affinity) {
+    Renderer r = Bench_CreateRenderer(c.width, c.height, c.sampleCount);
+    int nodes = affinity ? Renderer_EnableThreadAffinity(&r) : 0;
+
+    double bestRasterMs = 1e9, rasterMs = 0.0;
+    int stolen = 0, tiles = 0;
+    double start = Bench_NowMs();
+    for (int f = 0; f < FRAMES; f++) {
+        Renderer_BeginFrame(&r);
+        DrawScene(&r, f * 0.016f);
+        Renderer_EndFrame(&r);
+
+        const RenderTarget *target = r.presentTarget;
+        bestRasterMs = std::min(bestRasterMs, (double)target->rasterMs);
+        rasterMs += target->rasterMs;
+        stolen += target->stolenTiles;
+        tiles += target->numTiles;
+    }
+    double ms = (Bench_NowMs() - start) / FRAMES;
+
+    printf("  %-10s %-8s frame %7.2f ms  raster avg %7.2f ms best %7.2f ms",
+           c.name, affinity ? "affine" : "floating", ms, rasterMs / FRAMES,
+           bestRasterMs);
+    if (affinity) {
+        printf("  %d NUMA node%s, %.1f%% tiles off their owner", nodes,
+               nodes == 1 ? "" : "s", 100.0 * stolen / std::max(tiles, 1));
+    }
+    printf("\n");
+
+    Renderer_Destroy(&r);
+}
+
+void Bench_Affinity() {
+    AffinityCase cases[] = {
+        {"1080p", 1920, 1080, 1},
+        {"1080p MSAA", 1920, 1080, 4},
+    };
+
+    // Cross-socket traffic itself needs hardware counters, e.g.
+    // perf stat -e node-load-misses,node-store-misses ./bin/Bench affinity;
+    // tiles off their owner bound the pixels touched from another node
+    printf("%d threads, %d frames\n",
+           std::max(1u, std::thread::hardware_concurrency()), FRAMES);
+    for (const AffinityCase &c : cases) {
+        Run(c, false);
+        Run(c, true);
+    }
+}
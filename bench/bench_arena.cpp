@@ -0,0 +1,111 @@
+#include "bench.h"
+#include "overlay.h"
+#include "shader.h"
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+static const int W = 800, H = 600, WARMUP_FRAMES = 4, FRAMES = 20;
+
+// Every heap allocation of the bench binary goes through here
+static std::atomic<uint64_t> heapAllocations(0);
+
+void *operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+// A frame touching every transient list: built-in, instanced, translucent,
+// shaded and shadowed geometry, plus an overlay
+static void DrawFrame(Renderer *r, Overlay *ov, const Mesh *sphere,
+                      const std::vector<Mat4> &transforms, int f) {
+    Renderer_BeginFrame(r);
+    Renderer_ClearBackground(r, 0x101010);
+
+    Bench_DrawDemoScene(r, f * 0.02f);
+    Renderer_DrawInstanced(r, sphere, transforms.data(), nullptr,
+                           (int)transforms.size());
+    Renderer_DrawQuad(r, Vec3{0.2f, 0.1f, 0.5f}, Vec3{0.0f, f * 2.0f, 0.0f},
+                      Vec3{1.0f, 1.0f, 1.0f}, ColorRGBA{0.0f, 0.0f, 1.0f, 0.5f});
+
+    Mat4 model = Renderer_ModelMatrix(Vec3{0.0f, 1.0f, -1.0f},
+                                      Vec3{0.0f, f * 3.0f, 0.0f},
+                                      Vec3{0.5f, 0.5f, 0.5f});
+    Mat4 modelViewProj =
+        Mat4_Mult(Mat4_Transpose(model), Renderer_ViewProjection(r));
+    Renderer_DrawShaded(r, sphere, PhongVertexShader{modelViewProj},
+                        PhongFragmentShader{ColorRGBA{1.0f, 0.5f, 0.2f, 1.0f},
+                                            r->camera.position});
+
+    Renderer_EndFrame(r);
+
+    Overlay_Begin(ov, W, H);
+    Overlay_DrawText(ov, Vec2{4, 4}, "ARENA", 0xFFFFFFFF, 2);
+    Overlay_Render(ov, r->pixels);
+}
+
+static void Run(const Mesh *sphere, bool pipelined) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    if (pipelined) {
+        Renderer_EnablePipelining(&r, 2);
+    }
+    Renderer_EnableShadows(&r, Vec3{0.4f, -0.3f, -1.0f},
+                           Vec3{0.0f, 0.0f, -1.0f}, 3.0f, 512);
+
+    std::vector<Mat4> transforms;
+    for (int i = 0; i < 64; i++) {
+        transforms.push_back(Renderer_ModelMatrix(
+            Vec3{(i % 8 - 3.5f) * 0.4f, (i / 8 - 3.5f) * 0.3f, -2.0f},
+            Vec3{0.0f, 0.0f, 0.0f}, Vec3{0.15f, 0.15f, 0.15f}));
+    }
+    Overlay ov = {};
+
+    for (int f = 0; f < WARMUP_FRAMES; f++) {
+        DrawFrame(&r, &ov, sphere, transforms, f);
+    }
+    Renderer_Finish(&r);
+
+    uint64_t before = heapAllocations.load();
+    double maxMs = 0, minMs = 1e9;
+    for (int f = WARMUP_FRAMES; f < WARMUP_FRAMES + FRAMES; f++) {
+        double start = Bench_NowMs();
+        DrawFrame(&r, &ov, sphere, transforms, f);
+        double ms = Bench_NowMs() - start;
+        minMs = std::min(minMs, ms);
+        maxMs = std::max(maxMs, ms);
+    }
+    Renderer_Finish(&r);
+    uint64_t allocations = heapAllocations.load() - before;
+
+    size_t arenaBytes = 0;
+    for (const RenderFrame &frame : r.frames) {
+        arenaBytes += frame.arena.size;
+    }
+    printf("  %-10s  %llu heap allocations in %d frames  arenas %6.2f MB  "
+           "frame %6.2f - %6.2f ms\n",
+           pipelined ? "pipelined" : "immediate",
+           (unsigned long long)allocations, FRAMES,
+           arenaBytes / (1024.0 * 1024.0), minMs, maxMs);
+    assert(allocations == 0 && "frames allocate after warm-up");
+
+    Renderer_Destroy(&r);
+}
+
+void Bench_Arena() {
+    Mesh sphere = Mesh_CreateSphere(24, 12);
+    printf("%d warm-up frames, then %d frames of the same workload\n",
+           WARMUP_FRAMES, FRAMES);
+
+    Run(&sphere, false);
+    Run(&sphere, true);
+}
@@ -0,0 +1,92 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static const int W = 800, H = 600, FRAMES = 10;
+
+enum DepthPath {
+    PATH_COLOR,
+    PATH_PREPASS,
+    PATH_DEPTH_ONLY,
+    PATH_SHADOWS,
+    PATH_SHADOWS_PREPASS,
+};
+
+// Layers of spheres drawn back to front, so without a prepass every layer
+// is shaded where it overlaps the ones behind it
+static void DrawLayers(Renderer *r, const Mesh *sphere, int f) {
+    for (int layer = 0; layer < 4; layer++) {
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 5; x++) {
+                Vec3 position = {(x - 2.0f) * 0.8f + layer * 0.2f,
+                                 (y - 1.5f) * 0.8f + layer * 0.1f,
+                                 -3.0f + layer * 0.5f};
+                Vec3 rotation = {f * 5.0f, f * 3.0f, 0.0f};
+                Vec3 scale = {1.6f, 1.6f, 1.6f};
+                ColorRGBA color = {x / 5.0f, y / 4.0f, layer / 4.0f, 1.0f};
+
+                Renderer_DrawTriangles(r, (float *)sphere->vertices.data(),
+                                       sphere->numVertices, sphere->vertexSize,
+                                       position, rotation, scale, color);
+            }
+        }
+    }
+}
+
+// Returns the last frame's pixels
+static std::vector<uint32_t> Run(const Mesh *sphere, DepthPath path) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    r.zPrepass = path == PATH_PREPASS || path == PATH_SHADOWS_PREPASS;
+    r.depthOnly = path == PATH_DEPTH_ONLY;
+    if (path == PATH_SHADOWS || path == PATH_SHADOWS_PREPASS) {
+        Renderer_EnableShadows(&r, Vec3{0.4f, -0.3f, -1.0f},
+                               Vec3{0.0f, 0.0f, -2.0f}, 3.0f);
+    }
+
+    // Best of FRAMES
+    double frameMs = 1e9, rasterMs = 1e9, shadowMs = 1e9;
+    for (int f = 0; f < FRAMES; f++) {
+        double start = Bench_NowMs();
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+        DrawLayers(&r, sphere, f);
+        Renderer_EndFrame(&r);
+        frameMs = std::min(frameMs, Bench_NowMs() - start);
+        rasterMs = std::min(rasterMs, (double)r.presentTarget->rasterMs);
+        shadowMs = std::min(shadowMs, (double)r.presentTarget->shadowMs);
+    }
+
+    const char *names[] = {"color", "Z-prepass", "depth only", "shadows",
+                           "shadows + Z-prepass"};
+    printf("  %-19s  frame %7.2f ms  raster %7.2f ms  %6.1f Mpixel/s",
+           names[path], frameMs, rasterMs, W * H / (rasterMs * 1000.0));
+    if (r.shadow.enabled) {
+        printf("  shadow map %5.2f ms", shadowMs);
+    }
+    printf("\n");
+
+    std::vector<uint32_t> pixels(r.pixels, r.pixels + W * H);
+    Renderer_Destroy(&r);
+    return pixels;
+}
+
+void Bench_Depth() {
+    Mesh sphere = Mesh_CreateSphere(48, 24);
+    printf("4 layers of 20 spheres of %u triangles, %dx%d shadow map\n",
+           sphere.numVertices / 3, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+
+    std::vector<uint32_t> pixels[PATH_SHADOWS_PREPASS + 1];
+    for (DepthPath path : {PATH_COLOR, PATH_PREPASS, PATH_DEPTH_ONLY,
+                           PATH_SHADOWS, PATH_SHADOWS_PREPASS}) {
+        pixels[path] = Run(&sphere, path);
+    }
+
+    // A prepass shades the same triangle per pixel as the color pass
+    int differing = 0;
+    for (int i = 0; i < W * H; i++) {
+        differing += pixels[PATH_COLOR][i] != pixels[PATH_PREPASS][i];
+        differing += pixels[PATH_SHADOWS][i] != pixels[PATH_SHADOWS_PREPASS][i];
+    }
+    printf("  %d pixels differ with the Z-prepass\n", differing);
+}
@@ -0,0 +1,159 @@
+#include "bench.h"
+#include "distributed.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+static const int MAX_WORKERS = 4;
+
+struct DistributedCase {
+    const char *name;
+    DistributedJob job;
+};
+
+// Frames received, compared with the same job rendered by one renderer
+struct FrameCheck {
+    const std::vector<std::vector<uint32_t>> *reference;
+    int frames;
+    uint64_t differing;
+    // Worker to kill once this many frames arrived, -1 for none
+    int killAfter;
+    pid_t victim;
+};
+
+static void PrepareFrame(Renderer *r, int frame, void *user) {
+    r->camera = Camera_Create(Vec3{0.0f, 0.0f, 2.0f}, Vec3{0.0f, 1.0f, 0.0f},
+                              YAW, PITCH);
+}
+
+static void DrawFrame(Renderer *r, int frame, void *user) {
+    Renderer_ClearBackground(r, 0x101010);
+    Bench_DrawDemoScene(r, frame / 60.0f);
+}
+
+static void ReceiveFrame(int frame, const uint32_t *pixels, int width,
+                         int height, void *user) {
+    FrameCheck *check = (FrameCheck *)user;
+    const std::vector<uint32_t> &expected = (*check->reference)[check->frames];
+    for (int i = 0; i < width * height; i++) {
+        check->differing += pixels[i] != expected[i];
+    }
+
+    if (++check->frames == check->killAfter) {
+        kill(check->victim, SIGKILL);
+    }
+}
+
+// The job rendered whole in this process
+static std::vector<std::vector<uint32_t>>
+RenderLocal(const DistributedJob *job) {
+    std::vector<std::vector<uint32_t>> frames;
+    Renderer r = Renderer_Create(job->width, job->height, 1, job->sampleCount);
+    for (int f = job->firstFrame; f < job->firstFrame + job->numFrames; f++) {
+        PrepareFrame(&r, f, nullptr);
+        RenderView view = {r.camera, 0, 0, job->width, job->height};
+        Renderer_SetViews(&r, &view, 1);
+        Renderer_BeginFrame(&r);
+        DrawFrame(&r, f, nullptr);
+        Renderer_EndFrame(&r);
+        Renderer_Finish(&r);
+        frames.emplace_back(r.pixels, r.pixels + job->width * job->height);
+    }
+    Renderer_Destroy(&r);
+    return frames;
+}
+
+// Renders job with numWorkers local worker processes; killAfter >= 0 kills
+// the first worker once that many frames are done
+static double Run(Coordinator *coordinator, const DistributedJob *job,
+                  int numWorkers, int killAfter, FrameCheck *check,
+                  DistributedStats *stats) {
+    DistributedScene scene = {PrepareFrame, DrawFrame, nullptr};
+    pid_t workers[MAX_WORKERS];
+    fflush(stdout);
+    for (int i = 0; i < numWorkers; i++) {
+        workers[i] = fork();
+        if (workers[i] == 0) {
+            close(coordinator->listenFd);
+            _exit(Worker_Run("127.0.0.1", coordinator->port, &scene) ? 0 : 1);
+        }
+    }
+
+    check->frames = 0;
+    check->differing = 0;
+    check->killAfter = killAfter;
+    check->victim = workers[0];
+    double start = Bench_NowMs();
+    bool ok = Coordinator_Run(coordinator, job, ReceiveFrame, check, stats);
+    double ms = Bench_NowMs() - start;
+
+    for (int i = 0; i < numWorkers; i++) {
+        waitpid(workers[i], nullptr, 0);
+    }
+    return ok ? ms : -1.0;
+}
+
+void Bench_Distributed() {
+    Coordinator coordinator;
+    if (!Coordinator_Listen(&coordinator, 0)) {
+        printf("  could not listen\n");
+        return;
+    }
+
+    DistributedCase cases[] = {
+        {"frames", {.width = 640, .height = 360, .numFrames = 48,
+                    .sampleCount = 1, .timeoutMs = 2000}},
+        {"regions", {.width = 2048, .height = 2048, .numFrames = 4,
+                     .regionSize = 256, .sampleCount = 1, .timeoutMs = 2000}},
+    };
+
+    // Regions match the whole frame pixel for pixel but for rare depth ties
+    // where surfaces meet: the depth planes are evaluated at other
+    // coordinates and round differently
+    printf("local worker processes over loopback on port %u, %ld cores; "
+           "efficiency is T1 / (N * TN), differing pixels are against one "
+           "local renderer\n",
+           coordinator.port, sysconf(_SC_NPROCESSORS_ONLN));
+    for (const DistributedCase &c : cases) {
+        printf("  %-8s %dx%d, %d frames%s\n", c.name, c.job.width,
+               c.job.height, c.job.numFrames,
+               c.job.regionSize > 0 ? ", 256x256 regions" : "");
+
+        std::vector<std::vector<uint32_t>> reference = RenderLocal(&c.job);
+        double pixels = (double)c.job.width * c.job.height * c.job.numFrames;
+        FrameCheck check = {&reference};
+        double singleMs = 0.0;
+        for (int n = 1; n <= MAX_WORKERS; n++) {
+            DistributedStats stats;
+            double ms = Run(&coordinator, &c.job, n, -1, &check, &stats);
+            if (ms < 0.0) {
+                printf("    %d workers failed\n", n);
+                continue;
+            }
+            if (n == 1) {
+                singleMs = ms;
+            }
+            printf("    %d workers %8.1f ms  %6.1f fps  efficiency %5.1f%%  "
+                   "%d tasks, compressed to %.1f%%  %.4f%% pixels differ\n",
+                   n, ms, c.job.numFrames * 1000.0 / ms,
+                   100.0 * singleMs / (n * ms), stats.tasks,
+                   100.0 * stats.compressedBytes / stats.rawBytes,
+                   100.0 * check.differing / pixels);
+        }
+
+        // A worker killed halfway: its unanswered tasks go to the others
+        DistributedStats stats;
+        double ms = Run(&coordinator, &c.job, 2, c.job.numFrames / 2, &check,
+                        &stats);
+        printf("    2 workers, one killed %8.1f ms  lost %d, reassigned %d "
+               "tasks, %d frames  %.4f%% pixels differ\n",
+               ms, stats.workersLost, stats.reassigned, check.frames,
+               100.0 * check.differing / pixels);
+    }
+
+    Coordinator_Close(&coordinator);
+}
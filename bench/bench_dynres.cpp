@@ -0,0 +1,52 @@
+#include "bench.h"
+#include <cstdio>
+
+static const int W = 800, H = 600, FRAMES = 160;
+
+// Renders a scene whose cost steps up mid-run and logs how the render size
+// follows the frame-time budget
+void Bench_DynamicResolution() {
+    Renderer r = Bench_CreateRenderer(W, H);
+    const float targetMs = 30.0f;
+    Renderer_EnableDynamicResolution(&r, targetMs, 0.25f, 1.0f);
+
+    double upscaleMs = 0;
+
+    for (int f = 0; f < FRAMES; f++) {
+        double start = Bench_NowMs();
+
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+        Bench_DrawDemoScene(&r, f * 0.016f);
+
+        // Heavy phase: a wall of cubes right in front of the camera
+        if (f >= FRAMES / 4 && f < FRAMES * 3 / 4) {
+            for (int i = 0; i < 16; i++) {
+                Vec3 position = {(i % 4) * 0.5f - 0.75f, (i / 4) * 0.5f - 0.75f,
+                                 0.8f};
+                Renderer_DrawCube(&r, position, Vec3{0.0f, f * 2.0f, 0.0f},
+                                  Vec3{0.45f, 0.45f, 0.45f},
+                                  ColorRGBA{0.8f, 0.8f, 0.8f, 1.0f});
+            }
+        }
+
+        Renderer_EndFrame(&r);
+        double frameMs = Bench_NowMs() - start;
+
+        Renderer_UpdateDynamicResolution(&r, frameMs);
+
+        double upscaleStart = Bench_NowMs();
+        Renderer_Upscale(&r);
+        upscaleMs += Bench_NowMs() - upscaleStart;
+
+        if (f % 10 == 0) {
+            printf("  frame %3d  %7.2f ms  render %4dx%-4d (scale %.2f)\n", f,
+                   frameMs, r.width, r.height, r.dynres.scale);
+        }
+    }
+
+    printf("target %.1f ms, upscale to %dx%d: %.3f ms/frame\n", targetMs, W, H,
+           upscaleMs / FRAMES);
+
+    Renderer_Destroy(&r);
+}
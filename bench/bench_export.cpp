@@ -0,0 +1,114 @@
+#include "bench.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+static const int W = 800, H = 600, FRAMES = 300;
+static const char *RING_NAME = "/rasterizer";
+
+struct ConsumerStats {
+    int frames;
+    uint64_t lastFrame;
+    int skipped;
+    int torn;
+    double latencyMs;
+    double maxLatencyMs;
+    uint32_t checksum;
+};
+
+// Stands in for an encoder in another process: reads every pixel of each
+// frame in place, then checks the slot wasn't reused meanwhile
+static void Consume(std::atomic<bool> *stop, ConsumerStats *stats) {
+    FrameRingReader reader;
+    if (!FrameRingReader_Open(&reader, RING_NAME)) {
+        return;
+    }
+
+    FrameView view;
+    while (!stop->load()) {
+        if (!FrameRingReader_Wait(&reader, 10, &view)) {
+            continue;
+        }
+
+        uint32_t checksum = 0;
+        for (uint32_t y = 0; y < view.height; y++) {
+            const uint32_t *row = view.pixels + y * view.stride;
+            for (uint32_t x = 0; x < view.width; x++) {
+                checksum += row[x];
+            }
+        }
+        if (!FrameRingReader_Valid(&reader, &view)) {
+            stats->torn++;
+            continue;
+        }
+
+        double latencyMs = (FrameRing_NowNs() - view.submitNs) / 1e6;
+        stats->skipped += (int)(view.frameNumber - stats->lastFrame) - 1;
+        stats->lastFrame = view.frameNumber;
+        stats->frames++;
+        stats->latencyMs += latencyMs;
+        stats->maxLatencyMs = std::max(stats->maxLatencyMs, latencyMs);
+        stats->checksum += checksum;
+    }
+
+    FrameRingReader_Close(&reader);
+}
+
+static void Run(int framesInFlight, bool exported) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    if (framesInFlight > 1) {
+        Renderer_EnablePipelining(&r, framesInFlight);
+    }
+    if (exported && !Renderer_EnableFrameExport(&r, RING_NAME)) {
+        printf("  could not create %s\n", RING_NAME);
+        Renderer_Destroy(&r);
+        return;
+    }
+
+    std::atomic<bool> stop(false);
+    ConsumerStats stats = {};
+    std::thread consumer;
+    if (exported) {
+        consumer = std::thread(Consume, &stop, &stats);
+    }
+
+    double start = Bench_NowMs();
+    for (int f = 0; f < FRAMES; f++) {
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+        Bench_DrawDemoScene(&r, f / 60.0f);
+        Renderer_EndFrame(&r);
+    }
+    Renderer_Finish(&r);
+    double ms = Bench_NowMs() - start;
+
+    if (exported) {
+        stop = true;
+        consumer.join();
+    }
+
+    printf("  %d in flight %-9s %6.1f fps", framesInFlight,
+           exported ? "exported" : "local", FRAMES * 1000.0 / ms);
+    if (exported) {
+        printf("  consumed %3d, skipped %3d, torn %d  latency avg %5.2f ms "
+               "max %5.2f ms",
+               stats.frames, stats.skipped, stats.torn,
+               stats.latencyMs / std::max(stats.frames, 1),
+               stats.maxLatencyMs);
+    }
+    printf("\n");
+
+    Renderer_Destroy(&r);
+}
+
+void Bench_Export() {
+    printf("%dx%d demo scene, %d frames, consumer thread reading every "
+           "pixel\n",
+           W, H, FRAMES);
+
+    for (int framesInFlight : {1, 2}) {
+        Run(framesInFlight, false);
+        Run(framesInFlight, true);
+    }
+}
@@ -0,0 +1,75 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static const int W = 800, H = 600, FRAMES = 30;
+
+enum IncrementalScene {
+    SCENE_ONE_CUBE,    // static scene, one small cube rotating
+    SCENE_CAMERA_MOVE, // every frame moves the camera
+};
+
+// A static field of spheres, like a model in a viewer, and a small rotating
+// cube in one corner
+static void DrawScene(Renderer *r, const Mesh *sphere,
+                      const std::vector<Mat4> &transforms, int f) {
+    Renderer_BeginFrame(r);
+    Renderer_ClearBackground(r, 0x101010);
+    Renderer_DrawInstanced(r, sphere, transforms.data(), nullptr,
+                           (int)transforms.size());
+    Renderer_DrawCube(r, Vec3{0.9f, 0.6f, -1.5f},
+                      Vec3{f * 4.0f, f * 3.0f, 0.0f},
+                      Vec3{0.15f, 0.15f, 0.15f},
+                      ColorRGBA{1.0f, 0.3f, 0.1f, 1.0f});
+    Renderer_EndFrame(r);
+}
+
+static void Run(const Mesh *sphere, const std::vector<Mat4> &transforms,
+                IncrementalScene scene, bool incremental) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    r.incremental = incremental;
+
+    double rasterMs = 0;
+    int dirtyTiles = 0, numTiles = 0;
+    for (int f = 0; f < FRAMES; f++) {
+        if (scene == SCENE_CAMERA_MOVE) {
+            r.camera.position.x = f * 0.01f;
+        }
+        DrawScene(&r, sphere, transforms, f);
+
+        // The first frame draws everything either way
+        if (f > 0) {
+            rasterMs += r.presentTarget->rasterMs;
+            dirtyTiles += r.presentTarget->dirtyTiles;
+            numTiles += r.presentTarget->numTiles;
+        }
+    }
+    rasterMs /= FRAMES - 1;
+
+    printf("  %-12s %-11s raster %7.2f ms  dirty tiles %5.1f%%\n",
+           scene == SCENE_ONE_CUBE ? "one cube" : "camera move",
+           incremental ? "incremental" : "full", rasterMs,
+           100.0 * dirtyTiles / numTiles);
+
+    Renderer_Destroy(&r);
+}
+
+void Bench_Incremental() {
+    Mesh sphere = Mesh_CreateSphere(32, 16);
+    std::vector<Mat4> transforms;
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 12; x++) {
+            transforms.push_back(Renderer_ModelMatrix(
+                Vec3{(x - 5.5f) * 0.3f, (y - 3.5f) * 0.3f, -2.5f},
+                Vec3{0.0f, 0.0f, 0.0f}, Vec3{0.28f, 0.28f, 0.28f}));
+        }
+    }
+    printf("%dx%d, %zu static spheres, average of %d frames\n", W, H,
+           transforms.size(), FRAMES - 1);
+
+    for (IncrementalScene scene : {SCENE_ONE_CUBE, SCENE_CAMERA_MOVE}) {
+        Run(&sphere, transforms, scene, false);
+        Run(&sphere, transforms, scene, true);
+    }
+}
@@ -0,0 +1,84 @@
+#include "bench.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const int W = 800, H = 600, FRAMES = 3;
+
+// Cubes on a jittered grid in front of the camera, spread wider than the
+// view so part of them is culled
+static void BuildInstances(int count, std::vector<Vec3> *positions,
+                           std::vector<Mat4> *transforms,
+                           std::vector<ColorRGBA> *colors) {
+    int side = (int)ceilf(cbrtf((float)count));
+
+    for (int i = 0; i < count; i++) {
+        int x = i % side;
+        int y = (i / side) % side;
+        int z = i / (side * side);
+        Vec3 position = {(x - side / 2) * 0.25f, (y - side / 2) * 0.25f,
+                         -2.0f - z * 0.25f};
+
+        positions->push_back(position);
+        transforms->push_back(Renderer_ModelMatrix(
+            position, Vec3{i * 7.0f, i * 13.0f, 0.0f},
+            Vec3{0.08f, 0.08f, 0.08f}));
+        colors->push_back(ColorRGBA{(x % 4) / 4.0f + 0.25f,
+                                    (y % 4) / 4.0f + 0.25f, 0.6f, 1.0f});
+    }
+}
+
+static void RunInstances(int count) {
+    std::vector<Vec3> positions;
+    std::vector<Mat4> transforms;
+    std::vector<ColorRGBA> colors;
+    BuildInstances(count, &positions, &transforms, &colors);
+
+    Mesh cube = Mesh_CreateCube();
+
+    for (int instanced = 0; instanced <= 1; instanced++) {
+        Renderer r = Bench_CreateRenderer(W, H);
+        double geometryMs = 0, frameMs = 0;
+
+        for (int f = 0; f < FRAMES; f++) {
+            double start = Bench_NowMs();
+
+            Renderer_BeginFrame(&r);
+            Renderer_ClearBackground(&r, 0x101010);
+            if (instanced) {
+                Renderer_DrawInstanced(&r, &cube, transforms.data(),
+                                       colors.data(), count);
+            } else {
+                for (int i = 0; i < count; i++) {
+                    Renderer_DrawCube(&r, positions[i],
+                                      Vec3{i * 7.0f, i * 13.0f, 0.0f},
+                                      Vec3{0.08f, 0.08f, 0.08f}, colors[i]);
+                }
+            }
+            double recorded = Bench_NowMs();
+            Renderer_EndFrame(&r);
+
+            geometryMs += recorded - start;
+            frameMs += Bench_NowMs() - start;
+        }
+
+        geometryMs /= FRAMES;
+        frameMs /= FRAMES;
+
+        printf("  %6d cubes %-10s geometry %8.2f ms (%6.2f M instances/s)  "
+               "frame %8.2f ms (%6.2f M instances/s)\n",
+               count, instanced ? "instanced" : "DrawCube", geometryMs,
+               count / (geometryMs * 1000.0), frameMs,
+               count / (frameMs * 1000.0));
+
+        Renderer_Destroy(&r);
+    }
+}
+
+void Bench_Instancing() {
+    printf("%dx%d, %d frames\n", W, H, FRAMES);
+
+    for (int count : {1000, 10000, 100000}) {
+        RunInstances(count);
+    }
+}
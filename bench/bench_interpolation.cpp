@@ -0,0 +1,60 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+
+static const int W = 800, H = 600, FRAMES = 10;
+
+// Raster cost per covered pixel of a grid of lit spheres, optionally
+// textured. Triangles are large enough that attribute interpolation and
+// shading dominate over setup
+static void Run(const Mesh *sphere, const Texture *texture, int sampleCount) {
+    Renderer r = Bench_CreateRenderer(W, H, sampleCount);
+    // Attribute cost only, the micro path has its own scenario
+    r.microTriangleSize = 0;
+
+    double rasterMs = 1e9;
+    for (int f = 0; f < FRAMES; f++) {
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+
+        for (int y = 0; y < 3; y++) {
+            for (int x = 0; x < 4; x++) {
+                Vec3 position = {(x - 1.5f) * 0.9f, (y - 1.0f) * 0.9f, -1.0f};
+                Vec3 rotation = {f * 5.0f, f * 3.0f, 0.0f};
+                Renderer_DrawTriangles(&r, (float *)sphere->vertices.data(),
+                                       sphere->numVertices, sphere->vertexSize,
+                                       position, rotation,
+                                       Vec3{0.85f, 0.85f, 0.85f},
+                                       ColorRGBA{0.9f, 0.6f, 0.3f, 1.0f},
+                                       texture);
+            }
+        }
+
+        Renderer_EndFrame(&r);
+        rasterMs = std::min(rasterMs, (double)r.presentTarget->rasterMs);
+    }
+
+    int covered = 0;
+    for (int i = 0; i < W * H; i++) {
+        covered += r.pixels[i] != 0x101010;
+    }
+
+    printf("  %-10s %s  raster %7.2f ms  %6.1f ns/pixel (%d pixels)\n",
+           texture != nullptr ? "textured" : "untextured",
+           sampleCount > 1 ? "4x MSAA" : "no AA  ", rasterMs,
+           rasterMs * 1e6 / covered, covered);
+
+    Renderer_Destroy(&r);
+}
+
+void Bench_Interpolation() {
+    Mesh sphere = Mesh_CreateSphere(32, 16);
+    Texture texture = Texture_CreateChecker(256, 16, 0xFFFFFFFF, 0xFF3050A0);
+
+    Run(&sphere, nullptr, 1);
+    Run(&sphere, &texture, 1);
+    Run(&sphere, nullptr, MSAA_SAMPLES);
+    Run(&sphere, &texture, MSAA_SAMPLES);
+
+    Texture_Destroy(&texture);
+}
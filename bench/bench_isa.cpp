@@ -0,0 +1,104 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static const int W = 1280, H = 720, FRAMES = 10;
+
+struct IsaTiming {
+    double geometryMs;
+    double rasterMs;
+};
+
+// Instanced spheres for the vertex stage, MSAA and shadows for the tiles.
+// With a texture, large textured spheres instead, for the sampler
+static IsaTiming Run(RendererIsa isa, const Mesh *sphere,
+                     const std::vector<Mat4> &transforms,
+                     const Texture *texture, std::vector<uint32_t> *pixels) {
+    Renderer r = Bench_CreateRenderer(W, H, 4);
+    Renderer_EnableShadows(&r, Vec3{-0.3f, -1.0f, -0.4f}, Vec3{0, 0, -2.5f},
+                           3.0f);
+    Renderer_SetIsa(&r, isa);
+
+    IsaTiming best = {1e9, 1e9};
+    for (int f = 0; f < FRAMES; f++) {
+        double start = Bench_NowMs();
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+        if (texture != nullptr) {
+            for (int i = 0; i < 12; i++) {
+                Renderer_DrawTriangles(
+                    &r, (float *)sphere->vertices.data(), sphere->numVertices,
+                    sphere->vertexSize,
+                    Vec3{(i % 4 - 1.5f) * 0.9f, (i / 4 - 1.0f) * 0.9f, -2.0f},
+                    Vec3{30.0f, i * 20.0f, 0.0f}, Vec3{0.45f, 0.45f, 0.45f},
+                    ColorRGBA{0.9f, 0.6f, 0.3f, 1.0f}, texture);
+            }
+        } else {
+            Renderer_DrawInstanced(&r, sphere, transforms.data(), nullptr,
+                                   (int)transforms.size());
+            Bench_DrawDemoScene(&r, 0.5f);
+        }
+        double geometry = Bench_NowMs();
+        Renderer_EndFrame(&r);
+
+        best.geometryMs = std::min(best.geometryMs, geometry - start);
+        best.rasterMs =
+            std::min(best.rasterMs, (double)r.presentTarget->rasterMs);
+    }
+
+    pixels->assign(r.pixels, r.pixels + W * H);
+    Renderer_Destroy(&r);
+    return best;
+}
+
+void Bench_Isa() {
+    Mesh sphere = Mesh_CreateSphere(32, 16);
+    std::vector<Mat4> transforms;
+    for (int y = 0; y < 12; y++) {
+        for (int x = 0; x < 20; x++) {
+            transforms.push_back(Renderer_ModelMatrix(
+                Vec3{(x - 9.5f) * 0.22f, (y - 5.5f) * 0.22f, -2.5f},
+                Vec3{0.0f, 0.0f, 0.0f}, Vec3{0.2f, 0.2f, 0.2f}));
+        }
+    }
+
+    Texture texture = Texture_CreateChecker(256, 16, 0xFFFFFFFF, 0xFF3050A0);
+
+    Renderer probe = Renderer_Create(1, 1);
+    printf("%dx%d MSAA, shadows, %zu instanced spheres, and 12 large textured "
+           "ones, best of %d frames; %s detected\n",
+           W, H, transforms.size(), FRAMES, RendererIsa_Name(probe.isa));
+    Renderer_Destroy(&probe);
+
+    std::vector<uint32_t> generic[2], pixels[2];
+    IsaTiming base = {}, texturedBase = {};
+    for (int i = 0; i < RENDERER_ISA_COUNT; i++) {
+        RendererIsa isa = (RendererIsa)i;
+        if (!RendererIsa_Supported(isa)) {
+            printf("  %-8s not supported\n", RendererIsa_Name(isa));
+            continue;
+        }
+
+        bool isGeneric = isa == RENDERER_ISA_GENERIC;
+        IsaTiming t = Run(isa, &sphere, transforms, nullptr,
+                          isGeneric ? &generic[0] : &pixels[0]);
+        IsaTiming textured = Run(isa, &sphere, transforms, &texture,
+                                 isGeneric ? &generic[1] : &pixels[1]);
+        if (isGeneric) {
+            base = t;
+            texturedBase = textured;
+        }
+        printf("  %-8s geometry %6.2f ms (%.2fx)  raster %7.2f ms (%.2fx)  "
+               "textured %7.2f ms (%.2fx)%s\n",
+               RendererIsa_Name(isa), t.geometryMs,
+               base.geometryMs / t.geometryMs, t.rasterMs,
+               base.rasterMs / t.rasterMs, textured.rasterMs,
+               texturedBase.rasterMs / textured.rasterMs,
+               isGeneric || (pixels[0] == generic[0] && pixels[1] == generic[1])
+                   ? ""
+                   : "  pixels differ from generic");
+    }
+
+    Texture_Destroy(&texture);
+}
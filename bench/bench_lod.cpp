@@ -0,0 +1,96 @@
+#include "bench.h"
+#include "scene.h"
+#include <cmath>
+#include <cstdio>
+
+static const int W = 800, H = 600, FRAMES = 3;
+
+// Dense spheres spread out far from the camera
+static void AddSpheres(Scene *scene, const Mesh *mesh, const MeshLods *lods) {
+    for (int z = 0; z < 12; z++) {
+        for (int y = 0; y < 10; y++) {
+            for (int x = 0; x < 16; x++) {
+                Vec3 position = {(x - 7.5f) * (1.0f + z * 0.4f),
+                                 (y - 4.5f) * (1.0f + z * 0.4f),
+                                 -8.0f - z * 4.0f};
+                Mat4 transform = Renderer_ModelMatrix(
+                    position, Vec3{0.0f, 0.0f, 0.0f}, Vec3{0.8f, 0.8f, 0.8f});
+                ColorRGBA color = {x / 16.0f, y / 10.0f, 0.8f, 1.0f};
+
+                if (lods != nullptr) {
+                    Scene_AddLodObject(scene, lods, transform, color);
+                } else {
+                    Scene_AddObject(scene, mesh, transform, color);
+                }
+            }
+        }
+    }
+}
+
+// Sweeps an object back and forth by 1% around a switch distance and counts
+// level changes
+static int CountSwitches(Renderer *r, const MeshLods *lods, bool hysteresis) {
+    // Level 1 -> 2 switch point of a unit sphere
+    float pixels = MESH_LOD_DETAIL_PIXELS / 2.0f;
+    float distance = lods->levels[0].radius * r->height /
+                     (pixels * tanf(DegToRadians(r->camera.zoom) * 0.5f));
+
+    int level = -1, switches = 0;
+    for (int f = 0; f < 100; f++) {
+        float d = distance * (1.0f + 0.01f * sinf(f * 0.7f));
+        Mat4 model = Renderer_ModelMatrix(
+            Vec3_Add(r->camera.position, Vec3{0.0f, 0.0f, -d}),
+            Vec3{0.0f, 0.0f, 0.0f}, Vec3{1.0f, 1.0f, 1.0f});
+        int next = Renderer_SelectLod(r, lods, model, hysteresis ? level : -1);
+        switches += level >= 0 && next != level;
+        level = next;
+    }
+
+    return switches;
+}
+
+void Bench_Lod() {
+    Mesh sphere = Mesh_CreateSphere(64, 32);
+
+    double start = Bench_NowMs();
+    MeshLods lods = MeshLods_Create(&sphere, MESH_MAX_LODS);
+    printf("simplified %u triangles into %d levels in %.2f ms:",
+           sphere.numVertices / 3, lods.numLevels, Bench_NowMs() - start);
+    for (int i = 0; i < lods.numLevels; i++) {
+        printf(" %u", lods.levels[i].numVertices / 3);
+    }
+    printf("\n");
+
+    for (int useLod = 0; useLod <= 1; useLod++) {
+        Renderer r = Bench_CreateRenderer(W, H);
+        Scene scene = Scene_Create();
+        AddSpheres(&scene, &sphere, useLod ? &lods : nullptr);
+
+        double frameMs = 0;
+        size_t triangles = 0;
+        for (int f = 0; f < FRAMES; f++) {
+            start = Bench_NowMs();
+            Renderer_BeginFrame(&r);
+            Renderer_ClearBackground(&r, 0x101010);
+            Scene_Draw(&r, &scene);
+            triangles = r.frame->triangles.size();
+            Renderer_EndFrame(&r);
+            frameMs += Bench_NowMs() - start;
+        }
+        frameMs /= FRAMES;
+
+        printf("  LOD %-3s %zu objects  %8zu triangles  frame %8.2f ms  "
+               "(%.2f M triangles/s)\n",
+               useLod ? "on" : "off", scene.objects.size(), triangles,
+               frameMs, triangles / (frameMs * 1000.0));
+
+        if (useLod) {
+            printf("  level switches over 100 frames at a switch distance: "
+                   "%d without hysteresis, %d with\n",
+                   CountSwitches(&r, &lods, false),
+                   CountSwitches(&r, &lods, true));
+        }
+
+        Renderer_Destroy(&r);
+    }
+}
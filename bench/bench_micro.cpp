@@ -0,0 +1,65 @@
+#include "bench.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const int W = 800, H = 600, FRAMES = 10;
+
+// Tessellated spheres sized so their visible triangles average the given
+// number of pixels: half of the triangles cover pi * d^2 / 4 pixels
+static void RunSphere(int segments, int rings, float pixelsPerTriangle) {
+    Mesh sphere = Mesh_CreateSphere(segments, rings);
+    int triangles = sphere.numVertices / 3;
+    float diameter = sqrtf(pixelsPerTriangle * triangles * 2.0f / PI);
+
+    std::vector<uint32_t> reference(W * H);
+
+    for (int micro = 0; micro <= 1; micro++) {
+        Renderer r = Bench_CreateRenderer(W, H);
+        r.microTriangleSize = micro ? MICRO_TRIANGLE_SIZE : 0;
+
+        // Camera at z = 2: a unit sphere spans diameter pixels at distance d
+        float distance = H / (diameter * tanf(DegToRadians(ZOOM) * 0.5f));
+        Mat4 model =
+            Renderer_ModelMatrix(Vec3{0.0f, 0.0f, 2.0f - distance},
+                                 Vec3{10.0f, 20.0f, 0.0f}, Vec3{1, 1, 1});
+        ColorRGBA color = {0.9f, 0.5f, 0.2f, 1.0f};
+
+        // Best of FRAMES, the raster stage alone
+        double rasterMs = 1e9;
+        for (int f = 0; f < FRAMES; f++) {
+            Renderer_BeginFrame(&r);
+            Renderer_ClearBackground(&r, 0x101010);
+            Renderer_DrawInstanced(&r, &sphere, &model, &color, 1);
+            Renderer_EndFrame(&r);
+            rasterMs = std::min(rasterMs, (double)r.presentTarget->rasterMs);
+        }
+
+        int differing = 0;
+        for (int i = 0; i < W * H; i++) {
+            if (micro) {
+                differing += r.pixels[i] != reference[i];
+            } else {
+                reference[i] = r.pixels[i];
+            }
+        }
+
+        printf("  %6d triangles ~%.0f px each (%3.0f px sphere)  micro %-3s  "
+               "raster %7.2f ms",
+               triangles, pixelsPerTriangle, diameter, micro ? "on" : "off",
+               rasterMs);
+        if (micro) {
+            printf("  (%d pixels differ)", differing);
+        }
+        printf("\n");
+
+        Renderer_Destroy(&r);
+    }
+}
+
+void Bench_MicroTriangles() {
+    for (float pixels : {1.0f, 2.0f, 4.0f}) {
+        RunSphere(256, 128, pixels);
+    }
+}
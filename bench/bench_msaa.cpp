@@ -0,0 +1,70 @@
+#include "bench.h"
+#include <cstdio>
+
+static const int W = 800, H = 600, FRAMES = 60;
+
+// Box-filters a 2x2 supersampled frame down to the output resolution
+static void DownsampleSSAA(const Renderer *src, uint32_t *dst) {
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            const uint32_t *row0 = &src->pixels[(y * 2) * src->width + x * 2];
+            const uint32_t *row1 = row0 + src->width;
+            uint32_t p[4] = {row0[0], row0[1], row1[0], row1[1]};
+
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int s = 0; s < 4; s++) {
+                for (int c = 0; c < 4; c++) {
+                    sum[c] += (p[s] >> (c * 8)) & 0xFF;
+                }
+            }
+            dst[y * W + x] = ((sum[3] / 4) << 24) | ((sum[2] / 4) << 16) |
+                             ((sum[1] / 4) << 8) | (sum[0] / 4);
+        }
+    }
+}
+
+static double RenderFrames(Renderer *r, uint32_t *downsampled) {
+    double start = Bench_NowMs();
+
+    for (int f = 0; f < FRAMES; f++) {
+        Renderer_BeginFrame(r);
+        Renderer_ClearBackground(r, 0x101010);
+        Bench_DrawDemoScene(r, f * 0.016f);
+        Renderer_EndFrame(r);
+
+        if (downsampled != nullptr) {
+            DownsampleSSAA(r, downsampled);
+        }
+    }
+
+    return (Bench_NowMs() - start) / FRAMES;
+}
+
+void Bench_MSAA() {
+    Renderer noAA = Bench_CreateRenderer(W, H, 1);
+    Renderer msaa = Bench_CreateRenderer(W, H, MSAA_SAMPLES);
+    Renderer ssaa = Bench_CreateRenderer(W * 2, H * 2, 1);
+    uint32_t *downsampled = new uint32_t[W * H];
+
+    double noAAMs = RenderFrames(&noAA, nullptr);
+    double msaaMs = RenderFrames(&msaa, nullptr);
+    double ssaaMs = RenderFrames(&ssaa, downsampled);
+
+    int compressed = 0;
+    for (int i = 0; i < W * H; i++) {
+        compressed += msaa.sampleFlags[i] & MSAA_PIXEL_COMPRESSED;
+    }
+
+    printf("%dx%d, %d frames\n", W, H, FRAMES);
+    printf("  no AA      %8.3f ms/frame\n", noAAMs);
+    printf("  4x MSAA    %8.3f ms/frame (%.2fx no AA)\n", msaaMs,
+           msaaMs / noAAMs);
+    printf("  2x2 SSAA   %8.3f ms/frame (%.2fx no AA)\n", ssaaMs,
+           ssaaMs / noAAMs);
+    printf("  MSAA compressed pixels: %.1f%%\n", 100.0 * compressed / (W * H));
+
+    delete[] downsampled;
+    Renderer_Destroy(&noAA);
+    Renderer_Destroy(&msaa);
+    Renderer_Destroy(&ssaa);
+}
@@ -0,0 +1,196 @@
+#include "bench.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const int FRAMES = 5;
+
+struct MultiViewCase {
+    const char *name;
+    int width, height;
+    std::vector<RenderView> views;
+};
+
+struct MultiViewTiming {
+    double geometryMs;
+    double frameMs;
+};
+
+// Spheres on a shell around the origin, so every direction sees some
+static void DrawScene(Renderer *r, const Mesh *sphere,
+                      const std::vector<Mat4> &transforms) {
+    Renderer_ClearBackground(r, 0x101010);
+    Renderer_DrawInstanced(r, sphere, transforms.data(), nullptr,
+                           (int)transforms.size());
+    for (int i = 0; i < 8; i++) {
+        float angle = i * 2.0f * PI / 8;
+        Renderer_DrawCube(r, Vec3{2.0f * cosf(angle), -0.8f, 2.0f * sinf(angle)},
+                          Vec3{0.0f, i * 20.0f, 0.0f}, Vec3{0.4f, 0.4f, 0.4f},
+                          ColorRGBA{1.0f, 0.3f, 0.1f, 1.0f});
+    }
+}
+
+static RenderView View(Vec3 position, Vec3 up, float yaw, float pitch,
+                       float zoom, int x, int y, int width, int height) {
+    Camera camera = Camera_Create(position, up, yaw, pitch);
+    camera.zoom = zoom;
+    return {camera, x, y, width, height};
+}
+
+// Best-of FRAMES time of one multi-view frame
+static MultiViewTiming RenderMultiView(const MultiViewCase &c,
+                                       const Mesh *sphere,
+                                       const std::vector<Mat4> &transforms,
+                                       std::vector<uint32_t> *pixels) {
+    Renderer r = Bench_CreateRenderer(c.width, c.height);
+    Renderer_EnableShadows(&r, Vec3{-0.3f, -1.0f, -0.2f}, Vec3{0, 0, 0}, 5.0f);
+    Renderer_SetViews(&r, c.views.data(), (int)c.views.size());
+
+    MultiViewTiming best = {1e9, 1e9};
+    for (int f = 0; f < FRAMES; f++) {
+        double start = Bench_NowMs();
+        Renderer_BeginFrame(&r);
+        DrawScene(&r, sphere, transforms);
+        double geometry = Bench_NowMs();
+        Renderer_EndFrame(&r);
+        double end = Bench_NowMs();
+
+        best.geometryMs = std::min(best.geometryMs, geometry - start);
+        best.frameMs = std::min(best.frameMs, end - start);
+    }
+
+    pixels->assign(r.pixels, r.pixels + c.width * c.height);
+    Renderer_Destroy(&r);
+    return best;
+}
+
+// The same views as separate frames of one view-sized renderer, one after
+// the other; pixels receives them at their place in the multi-view frame.
+// Each is set as the renderer's only view, so draws are culled the same way
+// (Renderer.camera alone doesn't cull Renderer_DrawCube)
+static MultiViewTiming RenderSequential(const MultiViewCase &c,
+                                        const Mesh *sphere,
+                                        const std::vector<Mat4> &transforms,
+                                        std::vector<uint32_t> *pixels) {
+    const RenderView &first = c.views[0];
+    Renderer r = Bench_CreateRenderer(first.width, first.height);
+    Renderer_EnableShadows(&r, Vec3{-0.3f, -1.0f, -0.2f}, Vec3{0, 0, 0}, 5.0f);
+    pixels->assign(c.width * c.height, 0);
+
+    MultiViewTiming best = {1e9, 1e9};
+    for (int f = 0; f < FRAMES; f++) {
+        MultiViewTiming total = {};
+        for (const RenderView &view : c.views) {
+            RenderView single = {view.camera, 0, 0, view.width, view.height};
+            Renderer_SetViews(&r, &single, 1);
+
+            double start = Bench_NowMs();
+            Renderer_BeginFrame(&r);
+            DrawScene(&r, sphere, transforms);
+            double geometry = Bench_NowMs();
+            Renderer_EndFrame(&r);
+            double end = Bench_NowMs();
+
+            total.geometryMs += geometry - start;
+            total.frameMs += end - start;
+
+            for (int y = 0; y < view.height; y++) {
+                std::copy(r.pixels + y * view.width,
+                          r.pixels + (y + 1) * view.width,
+                          pixels->data() + (view.y + y) * c.width + view.x);
+            }
+        }
+        best.geometryMs = std::min(best.geometryMs, total.geometryMs);
+        best.frameMs = std::min(best.frameMs, total.frameMs);
+    }
+
+    Renderer_Destroy(&r);
+    return best;
+}
+
+// Share of pixels with a channel more than 2 levels apart. Shadows can
+// differ: a view rendered alone lacks the casters only other views see
+static double DifferingPixels(const std::vector<uint32_t> &a,
+                              const std::vector<uint32_t> &b) {
+    int differing = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        for (int shift = 0; shift < 24; shift += 8) {
+            int ca = (a[i] >> shift) & 0xFF;
+            int cb = (b[i] >> shift) & 0xFF;
+            if (abs(ca - cb) > 2) {
+                differing++;
+                break;
+            }
+        }
+    }
+    return 100.0 * differing / a.size();
+}
+
+void Bench_MultiView() {
+    Mesh sphere = Mesh_CreateSphere(24, 12);
+    std::vector<Mat4> transforms;
+    for (int i = 0; i < 400; i++) {
+        // Fibonacci sphere of radius 4
+        float y = 1.0f - 2.0f * (i + 0.5f) / 400;
+        float ring = sqrtf(1.0f - y * y);
+        float angle = i * 2.39996323f;
+        transforms.push_back(Renderer_ModelMatrix(
+            Vec3{4.0f * ring * cosf(angle), 4.0f * y, 4.0f * ring * sinf(angle)},
+            Vec3{0.0f, 0.0f, 0.0f}, Vec3{0.5f, 0.5f, 0.5f}));
+    }
+
+    Vec3 origin = {0.0f, 0.0f, 0.0f};
+    Vec3 up = {0.0f, 1.0f, 0.0f};
+    MultiViewCase cases[3];
+
+    cases[0] = {"stereo", 800, 400, {}};
+    cases[0].views = {
+        View(Vec3{-0.03f, 0.0f, 0.0f}, up, -90.0f, 0.0f, 60.0f, 0, 0, 400, 400),
+        View(Vec3{0.03f, 0.0f, 0.0f}, up, -90.0f, 0.0f, 60.0f, 400, 0, 400,
+             400),
+    };
+
+    cases[1] = {"split-screen 4", 800, 600, {}};
+    for (int i = 0; i < 4; i++) {
+        cases[1].views.push_back(View(origin, up, -90.0f + i * 90.0f, 0.0f,
+                                      ZOOM, (i % 2) * 400, (i / 2) * 300, 400,
+                                      300));
+    }
+
+    // +X, -X, +Y, -Y, +Z, -Z in a 3x2 atlas
+    cases[2] = {"cubemap", 768, 512, {}};
+    struct Face {
+        Vec3 up;
+        float yaw, pitch;
+    } faces[6] = {
+        {up, 0.0f, 0.0f},           {up, 180.0f, 0.0f},
+        {{0, 0, 1}, -90.0f, 90.0f}, {{0, 0, -1}, -90.0f, -90.0f},
+        {up, 90.0f, 0.0f},          {up, -90.0f, 0.0f},
+    };
+    for (int i = 0; i < 6; i++) {
+        cases[2].views.push_back(View(origin, faces[i].up, faces[i].yaw,
+                                      faces[i].pitch, 90.0f, (i % 3) * 256,
+                                      (i / 3) * 256, 256, 256));
+    }
+
+    printf("%zu instanced spheres and 8 cubes around the cameras, best of %d "
+           "frames\n",
+           transforms.size(), FRAMES);
+    for (const MultiViewCase &c : cases) {
+        std::vector<uint32_t> multiPixels, sequentialPixels;
+        MultiViewTiming multi =
+            RenderMultiView(c, &sphere, transforms, &multiPixels);
+        MultiViewTiming sequential =
+            RenderSequential(c, &sphere, transforms, &sequentialPixels);
+
+        printf("  %-15s %zu views  sequential geometry %6.2f ms frame "
+               "%7.2f ms  multi-view geometry %6.2f ms frame %7.2f ms  "
+               "(%.2fx)  %.2f%% pixels differ\n",
+               c.name, c.views.size(), sequential.geometryMs,
+               sequential.frameMs, multi.geometryMs, multi.frameMs,
+               sequential.frameMs / multi.frameMs,
+               DifferingPixels(multiPixels, sequentialPixels));
+    }
+}
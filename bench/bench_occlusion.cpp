@@ -0,0 +1,102 @@
+#include "bench.h"
+#include <cstdio>
+#include <vector>
+
+static const int W = 800, H = 600, FRAMES = 5;
+
+// Two walls close to the camera hiding most of a block of small cubes
+static void DrawScene(Renderer *r, const Mesh *cube, const Mat4 *walls,
+                      const std::vector<Mat4> &transforms,
+                      const std::vector<ColorRGBA> &colors) {
+    for (int i = 0; i < 2; i++) {
+        Renderer_DrawInstanced(r, cube, &walls[i], nullptr, 1);
+    }
+    Renderer_DrawInstanced(r, cube, transforms.data(), colors.data(),
+                           transforms.size());
+}
+
+void Bench_Occlusion() {
+    Mesh cube = Mesh_CreateCube();
+
+    Mat4 walls[2] = {
+        Renderer_ModelMatrix(Vec3{-0.9f, 0.0f, -1.0f}, Vec3{0.0f, 20.0f, 0.0f},
+                             Vec3{2.0f, 2.2f, 0.2f}),
+        Renderer_ModelMatrix(Vec3{1.2f, -0.2f, -1.5f}, Vec3{0.0f, -15.0f, 0.0f},
+                             Vec3{1.8f, 2.2f, 0.2f}),
+    };
+
+    std::vector<Mat4> transforms;
+    std::vector<ColorRGBA> colors;
+    for (int z = 0; z < 10; z++) {
+        for (int y = 0; y < 12; y++) {
+            for (int x = 0; x < 16; x++) {
+                Vec3 position = {(x - 7.5f) * 0.5f, (y - 5.5f) * 0.5f,
+                                 -3.0f - z * 0.8f};
+                transforms.push_back(Renderer_ModelMatrix(
+                    position, Vec3{x * 10.0f, y * 10.0f, 0.0f},
+                    Vec3{0.3f, 0.3f, 0.3f}));
+                colors.push_back(
+                    ColorRGBA{x / 16.0f, y / 12.0f, 1.0f - z / 10.0f, 1.0f});
+            }
+        }
+    }
+
+    std::vector<uint32_t> reference(W * H);
+
+    for (int occlude = 0; occlude <= 1; occlude++) {
+        Renderer r = Bench_CreateRenderer(W, H);
+        OcclusionBuffer ob = OcclusionBuffer_Create(W, H);
+        double frameMs = 0, testMs = 0;
+
+        for (int f = 0; f < FRAMES; f++) {
+            double start = Bench_NowMs();
+
+            Renderer_BeginFrame(&r);
+            Renderer_ClearBackground(&r, 0x101010);
+            if (occlude) {
+                Occlusion_Begin(&ob, Renderer_ViewProjection(&r));
+                for (const Mat4 &wall : walls) {
+                    Occlusion_AddOccluder(&ob, &cube, wall);
+                }
+                Occlusion_Finish(&ob);
+                r.occlusion = &ob;
+
+                // The bare tests, outside of the frame timing below
+                double testStart = Bench_NowMs();
+                for (const Mat4 &t : transforms) {
+                    Vec3 min, max;
+                    Mat4_TransformAABB(t, cube.min, cube.max, &min, &max);
+                    Occlusion_TestAABB(&ob, min, max);
+                }
+                testMs += Bench_NowMs() - testStart;
+                start += Bench_NowMs() - testStart;
+            }
+            DrawScene(&r, &cube, walls, transforms, colors);
+            Renderer_EndFrame(&r);
+
+            frameMs += Bench_NowMs() - start;
+        }
+
+        int differing = 0;
+        for (int i = 0; i < W * H; i++) {
+            if (occlude) {
+                differing += r.pixels[i] != reference[i];
+            } else {
+                reference[i] = r.pixels[i];
+            }
+        }
+
+        frameMs /= FRAMES;
+        if (occlude) {
+            printf("  occlusion on   frame %8.2f ms  build %.3f ms  "
+                   "tests %.3f ms  culled %u / %u submitted  "
+                   "%d pixels differ\n",
+                   frameMs, ob.stats.buildMs, testMs / FRAMES, ob.stats.culled,
+                   ob.stats.tested, differing);
+        } else {
+            printf("  occlusion off  frame %8.2f ms\n", frameMs);
+        }
+
+        Renderer_Destroy(&r);
+    }
+}
@@ -0,0 +1,119 @@
+#include "bench.h"
+#include "overlay.h"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const int W = 800, H = 600, FRAMES = 5;
+static const int LINES = 10000, TRIANGLES = 1000, CUBES = 500;
+
+static Vec2 RandomPoint() {
+    // Partly off screen so clipping is exercised
+    return Vec2{(float)(rand() % (W + 200) - 100),
+                (float)(rand() % (H + 200) - 100)};
+}
+
+void Bench_Overlay() {
+    srand(7);
+
+    std::vector<Vec2> lines(LINES * 2), triangles(TRIANGLES * 3);
+    for (Vec2 &p : lines) {
+        p = RandomPoint();
+    }
+    for (int i = 0; i < TRIANGLES; i++) {
+        Vec2 center = RandomPoint();
+        for (int k = 0; k < 3; k++) {
+            triangles[i * 3 + k] = {center.x + rand() % 60 - 30,
+                                    center.y + rand() % 60 - 30};
+        }
+    }
+
+    Renderer r = Bench_CreateRenderer(W, H);
+    Renderer_BeginFrame(&r);
+    Renderer_ClearBackground(&r, 0x000000);
+    Renderer_EndFrame(&r);
+
+    // Per-pixel Renderer_DrawLine/FillTriangle with a heap point list, as
+    // Renderer_DrawTriangle used to do
+    double start = Bench_NowMs();
+    for (int f = 0; f < FRAMES; f++) {
+        for (int i = 0; i < LINES; i++) {
+            std::vector<Vec2> points;
+            Renderer_DrawLine(&r, &points, lines[i * 2], lines[i * 2 + 1],
+                              0xffffffff);
+        }
+    }
+    double legacyLinesMs = (Bench_NowMs() - start) / FRAMES;
+
+    start = Bench_NowMs();
+    for (int f = 0; f < FRAMES; f++) {
+        for (int i = 0; i < TRIANGLES; i++) {
+            Vec2 *t = &triangles[i * 3];
+            std::vector<Vec2> points;
+            Renderer_DrawLine(&r, &points, t[0], t[1], 0xff00ff00);
+            Renderer_DrawLine(&r, &points, t[1], t[2], 0xff00ff00);
+            Renderer_DrawLine(&r, &points, t[0], t[2], 0xff00ff00);
+            Renderer_FillTriangle(&r, &points, 0xff00ff00);
+        }
+    }
+    double legacyTrianglesMs = (Bench_NowMs() - start) / FRAMES;
+
+    Overlay ov = {};
+    Mesh cube = Mesh_CreateCube();
+    Mat4 viewProj = Renderer_ViewProjection(&r);
+    double linesMs = 0, trianglesMs = 0, hudMs = 0, wireframeMs = 0;
+
+    for (int f = 0; f < FRAMES; f++) {
+        start = Bench_NowMs();
+        Overlay_Begin(&ov, W, H);
+        for (int i = 0; i < LINES; i++) {
+            Overlay_DrawLine(&ov, lines[i * 2], lines[i * 2 + 1], 0xffffffff);
+        }
+        Overlay_Render(&ov, r.pixels);
+        linesMs += Bench_NowMs() - start;
+
+        start = Bench_NowMs();
+        Overlay_Begin(&ov, W, H);
+        for (int i = 0; i < TRIANGLES; i++) {
+            Vec2 *t = &triangles[i * 3];
+            Overlay_FillTriangle(&ov, t[0], t[1], t[2], 0xff00ff00);
+        }
+        Overlay_Render(&ov, r.pixels);
+        trianglesMs += Bench_NowMs() - start;
+
+        start = Bench_NowMs();
+        Overlay_Begin(&ov, W, H);
+        Overlay_FillRect(&ov, Vec2{4, 4}, Vec2{220, 92}, 0xff202020);
+        for (int line = 0; line < 10; line++) {
+            char text[64];
+            snprintf(text, sizeof(text), "FRAME %d: %.2f MS %dx%d", f,
+                     16.6f + line, W, H);
+            Overlay_DrawText(&ov, Vec2{8.0f, 8.0f + line * 8}, text,
+                             0xffffff00);
+        }
+        Overlay_Render(&ov, r.pixels);
+        hudMs += Bench_NowMs() - start;
+
+        start = Bench_NowMs();
+        Overlay_Begin(&ov, W, H);
+        for (int i = 0; i < CUBES; i++) {
+            Mat4 model = Renderer_ModelMatrix(
+                Vec3{(i % 25 - 12) * 0.3f, (i / 25 - 10) * 0.3f, -4.0f},
+                Vec3{i * 5.0f, i * 3.0f, 0.0f}, Vec3{0.2f, 0.2f, 0.2f});
+            Overlay_DrawWireframe(&ov, &cube, model, viewProj, 0xff00ffff);
+        }
+        Overlay_Render(&ov, r.pixels);
+        wireframeMs += Bench_NowMs() - start;
+    }
+
+    printf("  %d lines      legacy %8.3f ms  overlay %8.3f ms\n", LINES,
+           legacyLinesMs, linesMs / FRAMES);
+    printf("  %d triangles   legacy %8.3f ms  overlay %8.3f ms\n", TRIANGLES,
+           legacyTrianglesMs, trianglesMs / FRAMES);
+    printf("  HUD (10 lines of text)          overlay %8.3f ms\n",
+           hudMs / FRAMES);
+    printf("  %d wireframe cubes (%d edges)  overlay %8.3f ms\n", CUBES,
+           CUBES * 36, wireframeMs / FRAMES);
+
+    Renderer_Destroy(&r);
+}
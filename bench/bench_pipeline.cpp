@@ -0,0 +1,58 @@
+#include "bench.h"
+#include <cstdio>
+#include <thread>
+
+static const int W = 800, H = 600, FRAMES = 120;
+
+// Geometry-heavy frame: the demo scene plus a field of small cubes
+static void DrawPipelineScene(Renderer *r, float t) {
+    Bench_DrawDemoScene(r, t);
+
+    for (int i = 0; i < 400; i++) {
+        Vec3 position = {(i % 20) * 0.3f - 3.0f, (i / 20) * 0.3f - 3.0f,
+                         -4.0f};
+        Renderer_DrawCube(r, position, Vec3{t * 30.0f, t * 50.0f, 0.0f},
+                          Vec3{0.1f, 0.1f, 0.1f},
+                          ColorRGBA{0.2f, 0.6f, 0.9f, 1.0f});
+    }
+}
+
+// Also counts frames whose presentation target is not the presented one
+static double RunFrames(int framesInFlight, int *stale) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    if (framesInFlight > 1) {
+        Renderer_EnablePipelining(&r, framesInFlight);
+    }
+
+    double start = Bench_NowMs();
+
+    for (int f = 0; f < FRAMES; f++) {
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+        DrawPipelineScene(&r, f * 0.016f);
+        Renderer_EndFrame(&r);
+        *stale += r.outputPixels != r.presentTarget->pixels ||
+                  r.pixels != r.presentTarget->pixels;
+    }
+    Renderer_Finish(&r);
+
+    double elapsed = Bench_NowMs() - start;
+    Renderer_Destroy(&r);
+
+    return FRAMES * 1000.0 / elapsed;
+}
+
+void Bench_Pipeline() {
+    int stale = 0;
+    double serial = RunFrames(1, &stale);
+    printf("%dx%d, %d frames, %d threads\n", W, H, FRAMES,
+           std::max(1u, std::thread::hardware_concurrency()));
+    printf("  serial           %7.2f frames/sec\n", serial);
+
+    for (int n = 2; n <= MAX_FRAMES_IN_FLIGHT; n++) {
+        double fps = RunFrames(n, &stale);
+        printf("  %d frames in flight %7.2f frames/sec (%.2fx)\n", n, fps,
+               fps / serial);
+    }
+    printf("  %d frames presented a stale output target\n", stale);
+}
@@ -0,0 +1,128 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+static const int W = 1920, H = 1080, FRAMES = 10;
+
+static const PostProcess POST = {
+    .enabled = true,
+    .exposure = 1.5f,
+    .tonemap = true,
+    .srgb = true,
+    .vignette = 0.4f,
+    .fxaa = true,
+};
+
+// Rotated cubes for plenty of aliased edges
+static void DrawScene(Renderer *r) {
+    Renderer_ClearBackground(r, 0x202020);
+    Bench_DrawDemoScene(r, 0.5f);
+    for (int i = 0; i < 300; i++) {
+        Vec3 position = {(i % 20) * 0.36f - 3.4f, (i / 20) * 0.28f - 2.0f,
+                         -3.5f};
+        Renderer_DrawCube(r, position, Vec3{i * 7.0f, i * 11.0f, 0.0f},
+                          Vec3{0.2f, 0.2f, 0.2f},
+                          ColorRGBA{0.2f + 0.003f * i, 0.5f, 0.9f, 1.0f});
+    }
+}
+
+// The same effects as full-frame passes, each reading and writing the
+// whole frame: grading, vignette, then FXAA through a copy of the frame
+// padded by the apron and its luma
+static void SeparatePasses(uint32_t *pixels, std::vector<uint32_t> *padded,
+                           std::vector<float> *luma) {
+    uint8_t lut[256];
+    PostProcess_BuildLut(&POST, lut);
+    for (int i = 0; i < W * H; i++) {
+        pixels[i] = PostProcess_Grade(lut, pixels[i]);
+    }
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            pixels[y * W + x] = PostProcess_Scale(
+                pixels[y * W + x],
+                PostProcess_Vignette(POST.vignette, x, y, W, H));
+        }
+    }
+
+    const int R = FXAA_APRON;
+    const int stride = W + 2 * R;
+    padded->resize(stride * (H + 2 * R));
+    luma->resize(padded->size());
+    for (int y = 0; y < H + 2 * R; y++) {
+        const uint32_t *row = &pixels[std::clamp(y - R, 0, H - 1) * W];
+        for (int x = 0; x < stride; x++) {
+            (*padded)[y * stride + x] = row[std::clamp(x - R, 0, W - 1)];
+        }
+    }
+    for (size_t i = 0; i < padded->size(); i++) {
+        (*luma)[i] = PostProcess_Luma((*padded)[i]);
+    }
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            pixels[y * W + x] = PostProcess_Fxaa(padded->data(), luma->data(),
+                                                 stride, x + R, y + R);
+        }
+    }
+}
+
+void Bench_PostProcess() {
+    Renderer r = Bench_CreateRenderer(W, H);
+    std::vector<uint32_t> fused, separate, padded;
+    std::vector<float> luma;
+
+    // Best raster time without effects, with them fused into the tiles,
+    // and of the separate passes after the plain frame
+    double plainMs = 1e9, fusedMs = 1e9, passesMs = 1e9;
+    for (int f = 0; f < FRAMES; f++) {
+        r.post = {};
+        Renderer_BeginFrame(&r);
+        DrawScene(&r);
+        Renderer_EndFrame(&r);
+        plainMs = std::min(plainMs, (double)r.presentTarget->rasterMs);
+
+        separate.assign(r.pixels, r.pixels + W * H);
+        double start = Bench_NowMs();
+        SeparatePasses(separate.data(), &padded, &luma);
+        passesMs = std::min(passesMs, Bench_NowMs() - start);
+
+        r.post = POST;
+        Renderer_BeginFrame(&r);
+        DrawScene(&r);
+        Renderer_EndFrame(&r);
+        fusedMs = std::min(fusedMs, (double)r.presentTarget->rasterMs);
+    }
+    fused.assign(r.pixels, r.pixels + W * H);
+
+    // Bytes each variant streams besides the raster pass itself. Fused:
+    // the kept borders, written once and read by up to three neighbours.
+    // Separate: grade and vignette read and write the frame, FXAA reads it
+    // into the padded copy, derives the luma and reads both to write the
+    // frame again
+    int tiles = ((W + TILE_SIZE - 1) / TILE_SIZE) *
+                ((H + TILE_SIZE - 1) / TILE_SIZE);
+    double apronMB = tiles * 4.0 * FXAA_APRON * TILE_SIZE * 4 / 1048576.0;
+    double frameMB = W * H * 4 / 1048576.0;
+    double paddedMB = padded.size() * 4 / 1048576.0;
+    double fusedMB = apronMB * 4.0;
+    double separateMB = frameMB * 2 * 2 + frameMB + paddedMB +
+                        paddedMB * 2 + paddedMB * 2 + frameMB;
+
+    int differing = 0;
+    for (int i = 0; i < W * H; i++) {
+        differing += fused[i] != separate[i];
+    }
+
+    printf("%dx%d, exposure, tonemap, sRGB, vignette and FXAA, best of %d "
+           "frames; %d pixels differ between fused and separate\n",
+           W, H, FRAMES, differing);
+    printf("  %-16s raster %7.2f ms\n", "no effects", plainMs);
+    printf("  %-16s raster %7.2f ms  effects %6.2f ms  ~%5.1f MB streamed\n",
+           "fused per tile", fusedMs, std::max(fusedMs - plainMs, 0.0),
+           fusedMB);
+    printf("  %-16s raster %7.2f ms  effects %6.2f ms  ~%5.1f MB streamed\n",
+           "separate passes", plainMs + passesMs, passesMs, separateMB);
+
+    Renderer_Destroy(&r);
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "scene.h"
+#include <cstdio>
+#include <cstdlib>
+
+static const int W = 800, H = 600, OBJECTS = 100000, RUNS = 20;
+
+static float RandomRange(float lo, float hi) {
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// Cubes scattered over a wide, flat box around the camera. The camera sees
+// about 5% of it
+static Vec3 RandomPosition() {
+    return Vec3{RandomRange(-165.0f, 165.0f), RandomRange(-6.0f, 6.0f),
+                RandomRange(-165.0f, 165.0f)};
+}
+
+void Bench_Scene() {
+    srand(1);
+
+    Renderer r = Bench_CreateRenderer(W, H);
+    Mesh cube = Mesh_CreateCube();
+    Scene scene = Scene_Create();
+
+    for (int i = 0; i < OBJECTS; i++) {
+        Mat4 transform =
+            Renderer_ModelMatrix(RandomPosition(), Vec3{i * 7.0f, i * 13.0f, 0},
+                                 Vec3{0.5f, 0.5f, 0.5f});
+        Scene_AddObject(&scene, &cube, transform,
+                        ColorRGBA{0.3f, 0.6f, 0.9f, 1.0f});
+    }
+
+    Frustum frustum = Frustum_FromMatrix(Renderer_ViewProjection(&r));
+
+    double start = Bench_NowMs();
+    Scene_Build(&scene);
+    double buildMs = Bench_NowMs() - start;
+
+    // Linear reference: every object against every plane
+    uint32_t linearVisible = 0;
+    start = Bench_NowMs();
+    for (int run = 0; run < RUNS; run++) {
+        linearVisible = 0;
+        for (const SceneObject &object : scene.objects) {
+            linearVisible += Frustum_TestAABB(&frustum, object.min, object.max);
+        }
+    }
+    double linearMs = (Bench_NowMs() - start) / RUNS;
+
+    start = Bench_NowMs();
+    for (int run = 0; run < RUNS; run++) {
+        Scene_Cull(&scene, &frustum);
+    }
+    double bvhMs = (Bench_NowMs() - start) / RUNS;
+
+    printf("%d objects, %u visible (%.1f%%), %zu nodes, build %.2f ms\n",
+           OBJECTS, scene.stats.objectsVisible,
+           100.0 * scene.stats.objectsVisible / OBJECTS, scene.nodes.size(),
+           buildMs);
+    printf("  linear cull %8.3f ms  (%u visible)\n", linearMs, linearVisible);
+    printf("  BVH cull    %8.3f ms  (%u nodes visited, %u objects tested)\n",
+           bvhMs, scene.stats.nodesVisited, scene.stats.objectsTested);
+
+    // Move 1% of the objects a little each run and refit
+    double refitMs = 0;
+    for (int run = 0; run < RUNS; run++) {
+        for (int i = 0; i < OBJECTS / 100; i++) {
+            uint32_t object = rand() % OBJECTS;
+            Mat4 transform = scene.objects[object].transform;
+            transform.data[3] += RandomRange(-0.5f, 0.5f);
+            transform.data[11] += RandomRange(-0.5f, 0.5f);
+            Scene_SetTransform(&scene, object, transform);
+        }
+
+        start = Bench_NowMs();
+        Scene_Refit(&scene);
+        refitMs += Bench_NowMs() - start;
+    }
+    printf("  refit after moving %d objects %8.3f ms\n", OBJECTS / 100,
+           refitMs / RUNS);
+
+    start = Bench_NowMs();
+    Renderer_BeginFrame(&r);
+    Renderer_ClearBackground(&r, 0x101010);
+    Scene_Draw(&r, &scene);
+    Renderer_EndFrame(&r);
+    printf("  frame with Scene_Draw %8.2f ms\n", Bench_NowMs() - start);
+
+    Renderer_Destroy(&r);
+}
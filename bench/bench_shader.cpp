@@ -0,0 +1,92 @@
+#include "bench.h"
+#include "shader.h"
+#include <algorithm>
+#include <cstdio>
+
+static const int W = 800, H = 600, FRAMES = 10;
+
+// Vertex color only, no varyings
+struct FlatVertexShader {
+    struct Varyings {};
+
+    Mat4 modelViewProj;
+
+    Vec4 Vertex(const float *vertex, Varyings *out) const {
+        return Vec4_Transform(Vec4{vertex[0], vertex[1], vertex[2], 1.0f},
+                              modelViewProj);
+    }
+};
+
+struct FlatFragmentShader {
+    ColorRGBA color;
+
+    bool Fragment(const FlatVertexShader::Varyings &in, Vec3 fragCoord,
+                  ColorRGBA *out) const {
+        *out = color;
+        return true;
+    }
+};
+
+enum ShaderPath { PATH_BUILTIN, PATH_PHONG, PATH_FLAT };
+
+// A grid of medium sized spheres, drawn per object
+static void Run(const Mesh *sphere, ShaderPath path, int sampleCount) {
+    Renderer r = Bench_CreateRenderer(W, H, sampleCount);
+
+    // Best of FRAMES
+    double frameMs = 1e9, rasterMs = 1e9;
+    for (int f = 0; f < FRAMES; f++) {
+        double start = Bench_NowMs();
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+        Mat4 viewProj = Renderer_ViewProjection(&r);
+
+        for (int y = 0; y < 4; y++) {
+            for (int x = 0; x < 5; x++) {
+                Vec3 position = {(x - 2.0f) * 0.8f, (y - 1.5f) * 0.8f, -1.0f};
+                Vec3 rotation = {f * 5.0f, f * 3.0f, 0.0f};
+                Vec3 scale = {0.7f, 0.7f, 0.7f};
+                ColorRGBA color = {x / 5.0f, y / 4.0f, 0.8f, 1.0f};
+
+                Mat4 model = Renderer_ModelMatrix(position, rotation, scale);
+                Mat4 modelViewProj = Mat4_Mult(Mat4_Transpose(model), viewProj);
+
+                if (path == PATH_BUILTIN) {
+                    Renderer_DrawTriangles(&r, (float *)sphere->vertices.data(),
+                                           sphere->numVertices,
+                                           sphere->vertexSize, position,
+                                           rotation, scale, color);
+                } else if (path == PATH_PHONG) {
+                    Renderer_DrawShaded(
+                        &r, sphere, PhongVertexShader{modelViewProj},
+                        PhongFragmentShader{color, r.camera.position});
+                } else {
+                    Renderer_DrawShaded(&r, sphere,
+                                        FlatVertexShader{modelViewProj},
+                                        FlatFragmentShader{color});
+                }
+            }
+        }
+
+        Renderer_EndFrame(&r);
+        frameMs = std::min(frameMs, Bench_NowMs() - start);
+        rasterMs = std::min(rasterMs, (double)r.presentTarget->rasterMs);
+    }
+
+    const char *names[] = {"built-in", "Phong shader", "flat shader"};
+    printf("  %-12s  %s  frame %7.2f ms  raster %7.2f ms\n", names[path],
+           sampleCount > 1 ? "4x MSAA" : "no AA  ", frameMs, rasterMs);
+
+    Renderer_Destroy(&r);
+}
+
+void Bench_Shader() {
+    Mesh sphere = Mesh_CreateSphere(48, 24);
+    printf("20 spheres of %u triangles\n", sphere.numVertices / 3);
+
+    for (int sampleCount : {1, MSAA_SAMPLES}) {
+        for (ShaderPath path : {PATH_BUILTIN, PATH_PHONG, PATH_FLAT}) {
+            Run(&sphere, path, sampleCount);
+        }
+    }
+}
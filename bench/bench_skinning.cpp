@@ -0,0 +1,201 @@
+#include "bench.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+static const int W = 1280, H = 720, FRAMES = 10;
+static const int CHARACTERS = 64, BONES = 16;
+
+// A tall capsule bent by a chain of bones along y, every vertex blending
+// the two bones nearest to it
+static SkinnedMesh CreateTentacle() {
+    Mesh sphere = Mesh_CreateSphere(64, 32);
+    for (uint32_t i = 0; i < sphere.numVertices; i++) {
+        sphere.vertices[i * sphere.vertexSize + 1] *= 4.0f;
+    }
+    Mesh mesh = Mesh_Create(sphere.vertices.data(), sphere.numVertices,
+                            sphere.vertexSize);
+
+    std::vector<uint8_t> bones(mesh.numVertices * SKIN_MAX_INFLUENCES, 0);
+    std::vector<float> weights(mesh.numVertices * SKIN_MAX_INFLUENCES, 0.0f);
+    for (uint32_t i = 0; i < mesh.numVertices; i++) {
+        // Bone b starts at height b / BONES along the capsule
+        float t = (mesh.vertices[i * mesh.vertexSize + 1] + 2.0f) / 4.0f *
+                  (BONES - 1);
+        int b = std::min((int)t, BONES - 2);
+        bones[i * SKIN_MAX_INFLUENCES] = b;
+        bones[i * SKIN_MAX_INFLUENCES + 1] = b + 1;
+        weights[i * SKIN_MAX_INFLUENCES] = 1.0f - (t - b);
+        weights[i * SKIN_MAX_INFLUENCES + 1] = t - b;
+    }
+
+    return SkinnedMesh_Create(&mesh, bones.data(), weights.data(), BONES);
+}
+
+// Bones swaying around z with phase, as bind pose -> posed matrices
+static void Pose(float phase, Mat4 palette[BONES]) {
+    float length = 4.0f / (BONES - 1);
+    Mat4 global = Mat4_Translate(Mat4_Create(), Vec3{0.0f, -2.0f, 0.0f});
+    for (int b = 0; b < BONES; b++) {
+        float y = -2.0f + b * length;
+        if (b > 0) {
+            global = Mat4_Mult(global, Mat4_Translate(Mat4_Create(),
+                                                      Vec3{0.0f, length, 0.0f}));
+        }
+        global = Mat4_Mult(global, Mat4_RotateZ(Mat4_Create(),
+                                                8.0f * sinf(phase + b * 0.4f)));
+        palette[b] = Mat4_Mult(
+            global, Mat4_Translate(Mat4_Create(), Vec3{0.0f, -y, 0.0f}));
+    }
+}
+
+static Vec3 CharacterPosition(int i) {
+    return Vec3{(i % 16 - 7.5f) * 1.2f, (i / 16 - 1.5f) * 5.0f, -24.0f};
+}
+
+enum SkinningMode {
+    SKINNING_RIGID,
+    SKINNING_POSED,
+    SKINNING_SHARED,
+};
+
+struct SkinningRun {
+    double geometryMs;
+    uint64_t skinnedVertices;
+    uint64_t reuses;
+};
+
+// Best geometry time of FRAMES frames of the crowd: drawn in the bind pose,
+// each character in its own pose, or 4 poses shared by everybody
+static SkinningRun Run(const SkinnedMesh *mesh, SkinningMode mode,
+                       RendererIsa isa, std::vector<uint32_t> *pixels) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    Renderer_EnableShadows(&r, Vec3{-0.3f, -1.0f, -0.4f}, Vec3{0, 0, -24.0f},
+                           12.0f);
+    Renderer_SetIsa(&r, isa);
+
+    std::vector<Mat4> palettes(CHARACTERS * BONES);
+    SkinningRun best = {1e9};
+    for (int f = 0; f < FRAMES; f++) {
+        for (int i = 0; i < CHARACTERS; i++) {
+            int pose = mode == SKINNING_SHARED ? i % 4 : i;
+            Pose(f * 0.1f + pose * 0.7f, &palettes[i * BONES]);
+        }
+
+        uint64_t skinned = r.skinnedVertices, reuses = r.skinReuses;
+        double start = Bench_NowMs();
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+        for (int i = 0; i < CHARACTERS; i++) {
+            ColorRGBA color = {0.3f + 0.01f * i, 0.7f, 0.5f, 1.0f};
+            if (mode == SKINNING_RIGID) {
+                Renderer_DrawTriangles(
+                    &r, (float *)mesh->mesh.vertices.data(),
+                    mesh->mesh.numVertices, mesh->mesh.vertexSize,
+                    CharacterPosition(i), Vec3{0, 0, 0}, Vec3{1, 1, 1}, color);
+            } else {
+                Renderer_DrawSkinned(&r, mesh, &palettes[i * BONES],
+                                     CharacterPosition(i), Vec3{0, 0, 0},
+                                     Vec3{1, 1, 1}, color);
+            }
+        }
+        best.geometryMs = std::min(best.geometryMs, Bench_NowMs() - start);
+        Renderer_EndFrame(&r);
+
+        best.skinnedVertices = r.skinnedVertices - skinned;
+        best.reuses = r.skinReuses - reuses;
+    }
+
+    if (pixels != nullptr) {
+        pixels->assign(r.pixels, r.pixels + W * H);
+    }
+    Renderer_Destroy(&r);
+    return best;
+}
+
+// Pixels of the bind pose (identity palette) that differ from the rigid
+// draw, only where blended weights round differently from 1
+static double BindPoseDifference(const SkinnedMesh *mesh) {
+    std::vector<Mat4> identity(BONES, Mat4_Create());
+    std::vector<uint32_t> images[2];
+    for (int skinned = 0; skinned < 2; skinned++) {
+        Renderer r = Bench_CreateRenderer(320, 240);
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+        Vec3 position = {0.0f, 0.0f, -6.0f};
+        ColorRGBA color = {0.3f, 0.7f, 0.5f, 1.0f};
+        if (skinned) {
+            Renderer_DrawSkinned(&r, mesh, identity.data(), position,
+                                 Vec3{0, 30, 0}, Vec3{1, 1, 1}, color);
+        } else {
+            Renderer_DrawTriangles(&r, (float *)mesh->mesh.vertices.data(),
+                                   mesh->mesh.numVertices,
+                                   mesh->mesh.vertexSize, position,
+                                   Vec3{0, 30, 0}, Vec3{1, 1, 1}, color);
+        }
+        Renderer_EndFrame(&r);
+        images[skinned].assign(r.pixels, r.pixels + 320 * 240);
+        Renderer_Destroy(&r);
+    }
+    int differing = 0;
+    for (size_t i = 0; i < images[0].size(); i++) {
+        differing += images[0][i] != images[1][i];
+    }
+    return 100.0 * differing / images[0].size();
+}
+
+void Bench_Skinning() {
+    SkinnedMesh mesh = CreateTentacle();
+    printf("%dx%d, shadows, %d characters of %u vertices and %d bones, best "
+           "of %d frames; bind pose differs from the rigid draw in %.4f%% "
+           "of pixels\n",
+           W, H, CHARACTERS, mesh.mesh.numVertices, BONES, FRAMES,
+           BindPoseDifference(&mesh));
+
+    Renderer probe = Renderer_Create(1, 1);
+    RendererIsa detected = probe.isa;
+    Renderer_Destroy(&probe);
+
+    SkinningRun rigid = Run(&mesh, SKINNING_RIGID, detected, nullptr);
+    printf("  %-12s geometry %7.2f ms\n", "rigid", rigid.geometryMs);
+
+    struct {
+        const char *name;
+        SkinningMode mode;
+    } cases[] = {
+        {"own poses", SKINNING_POSED},
+        {"4 poses", SKINNING_SHARED},
+    };
+    for (const auto &c : cases) {
+        SkinningRun run = Run(&mesh, c.mode, detected, nullptr);
+        printf("  %-12s geometry %7.2f ms  %7llu vertices skinned, %2llu "
+               "draws reused",
+               c.name, run.geometryMs, (unsigned long long)run.skinnedVertices,
+               (unsigned long long)run.reuses);
+        if (c.mode == SKINNING_POSED) {
+            // What skinning adds to the rigid draws
+            double skinMs = std::max(run.geometryMs - rigid.geometryMs, 1e-3);
+            printf("  %.1f M skinned vertices/s",
+                   run.skinnedVertices / skinMs / 1000.0);
+        }
+        printf("\n");
+    }
+
+    // Every kernel variant skins to the same pixels
+    std::vector<uint32_t> generic, pixels;
+    for (int i = 0; i < RENDERER_ISA_COUNT; i++) {
+        RendererIsa isa = (RendererIsa)i;
+        if (!RendererIsa_Supported(isa)) {
+            continue;
+        }
+
+        SkinningRun run = Run(&mesh, SKINNING_POSED, isa,
+                              isa == RENDERER_ISA_GENERIC ? &generic : &pixels);
+        printf("  %-12s geometry %7.2f ms%s\n", RendererIsa_Name(isa),
+               run.geometryMs,
+               isa == RENDERER_ISA_GENERIC || pixels == generic
+                   ? ""
+                   : "  pixels differ from generic");
+    }
+}
@@ -0,0 +1,224 @@
+#include "bench.h"
+#include "scene.h"
+#include "streaming.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+static const int W = 800, H = 600, FRAMES = 300, RUNS = 3;
+static const int GRID = 20;
+static const float CHUNK_SIZE = 16.0f, LOAD_RADIUS = 64.0f;
+static const int OBJECTS_PER_CHUNK = 24, SPHERES_PER_CHUNK = 4;
+
+struct StreamingRun {
+    double avgMs;
+    double maxMs;
+    double p99Ms;
+    // CPU time of the render thread per frame, which leaves out the time
+    // the loaders and other processes took its core
+    double cpuP99Ms;
+    double cpuMaxMs;
+    // Worst StreamingWorld_Draw, where synchronous loads stall the frame
+    double maxDrawMs;
+    StreamingStats stats;
+    size_t peakBytes;
+    int placeholderFrames;
+    // Wall and render thread CPU time of each frame
+    std::vector<double> frameMs, cpuMs;
+};
+
+// The camera flies straight down the world's center line, looking ahead
+static Vec3 PathPosition(int frame) {
+    float half = GRID * CHUNK_SIZE * 0.5f;
+    float t = frame / (float)(FRAMES - 1);
+    return Vec3{0.0f, 4.0f, half - t * 2.0f * half};
+}
+
+// Spheres and cubes on every cell of a GRID x GRID world around the origin.
+// Every cell has its own spheres so chunks carry their mesh data
+static void BuildWorld(Scene *scene, std::vector<Mesh> *spheres,
+                       const Mesh *cube) {
+    srand(7);
+    spheres->reserve(GRID * GRID * SPHERES_PER_CHUNK);
+    for (int cz = 0; cz < GRID; cz++) {
+        for (int cx = 0; cx < GRID; cx++) {
+            for (int i = 0; i < OBJECTS_PER_CHUNK; i++) {
+                // Inset so objects stay in their cell
+                Vec3 position = {
+                    (cx - GRID / 2 + 0.1f + 0.8f * (rand() / (float)RAND_MAX)) *
+                        CHUNK_SIZE,
+                    0.5f + 2.0f * (rand() / (float)RAND_MAX),
+                    (cz - GRID / 2 + 0.1f + 0.8f * (rand() / (float)RAND_MAX)) *
+                        CHUNK_SIZE};
+                Mat4 transform =
+                    Renderer_ModelMatrix(position, Vec3{0.0f, i * 17.0f, 0.0f},
+                                         Vec3{1.0f, 1.0f, 1.0f});
+                const Mesh *mesh = cube;
+                if (i < SPHERES_PER_CHUNK) {
+                    spheres->push_back(Mesh_CreateSphere(48, 24));
+                    mesh = &spheres->back();
+                }
+                Scene_AddObject(scene, mesh, transform,
+                                ColorRGBA{0.2f + 0.6f * cx / GRID, 0.6f,
+                                          0.2f + 0.6f * cz / GRID, 1.0f});
+            }
+        }
+    }
+    Scene_Build(scene);
+}
+
+// Draws the path with world, or the whole scene when world is null
+static StreamingRun Run(Scene *scene, StreamingWorld *world) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    StreamingRun run = {};
+
+    for (int f = 0; f < FRAMES; f++) {
+        r.camera.position = PathPosition(f);
+
+        double start = Bench_NowMs();
+        double cpuStart = Bench_ThreadCpuMs();
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x202830);
+        if (world != nullptr) {
+            double drawStart = Bench_NowMs();
+            StreamingWorld_Draw(&r, world);
+            run.maxDrawMs = std::max(run.maxDrawMs, Bench_NowMs() - drawStart);
+            run.peakBytes =
+                std::max(run.peakBytes, world->stats.committedBytes);
+            run.placeholderFrames += world->stats.placeholders > 0;
+        } else {
+            Scene_Draw(&r, scene);
+        }
+        Renderer_EndFrame(&r);
+        run.frameMs.push_back(Bench_NowMs() - start);
+        run.cpuMs.push_back(Bench_ThreadCpuMs() - cpuStart);
+    }
+    if (world != nullptr) {
+        run.stats = world->stats;
+    }
+
+    Renderer_Destroy(&r);
+    return run;
+}
+
+// Average, p99 and max of the frame times
+static void Summarize(StreamingRun *run) {
+    std::vector<double> frameMs = run->frameMs, cpuMs = run->cpuMs;
+    for (double ms : frameMs) {
+        run->avgMs += ms / FRAMES;
+    }
+    std::sort(frameMs.begin(), frameMs.end());
+    std::sort(cpuMs.begin(), cpuMs.end());
+    run->p99Ms = frameMs[FRAMES * 99 / 100];
+    run->maxMs = frameMs.back();
+    run->cpuP99Ms = cpuMs[FRAMES * 99 / 100];
+    run->cpuMaxMs = cpuMs.back();
+}
+
+// Evicts the file from the page cache, so chunks are read from the disk as
+// in a world too large to stay cached
+static void DropFileCache(const char *path) {
+#ifdef __linux__
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+// Streams the path RUNS times from a freshly opened, uncached world and
+// keeps the best time of each frame, which filters out other processes
+// while keeping the frames every run stalls on
+static StreamingRun BestRun(Scene *scene, const char *path, size_t budget,
+                            int numLoaders) {
+    StreamingRun best = {};
+    for (int i = 0; i < RUNS; i++) {
+        DropFileCache(path);
+        StreamingWorld world;
+        if (!StreamingWorld_Open(&world, path, budget, LOAD_RADIUS,
+                                 numLoaders)) {
+            return best;
+        }
+        StreamingRun run = Run(scene, &world);
+        StreamingWorld_Close(&world);
+        if (i > 0) {
+            for (int f = 0; f < FRAMES; f++) {
+                run.frameMs[f] = std::min(run.frameMs[f], best.frameMs[f]);
+                run.cpuMs[f] = std::min(run.cpuMs[f], best.cpuMs[f]);
+            }
+            run.maxDrawMs = std::min(run.maxDrawMs, best.maxDrawMs);
+        }
+        best = run;
+    }
+    Summarize(&best);
+    return best;
+}
+
+static void Print(const char *name, const StreamingRun &run, bool streamed) {
+    printf("  %-14s avg %6.2f ms  p99 %6.2f ms  max %7.2f ms  render thread "
+           "p99 %6.2f ms  max %6.2f ms",
+           name, run.avgMs, run.p99Ms, run.maxMs, run.cpuP99Ms, run.cpuMaxMs);
+    if (streamed) {
+        printf("  draw max %6.2f ms  peak %5.1f MB  %d loads  %d evictions  "
+               "load max %.2f ms  %d frames with placeholders",
+               run.maxDrawMs, run.peakBytes / 1048576.0, run.stats.loads,
+               run.stats.evictions, run.stats.maxLoadMs,
+               run.placeholderFrames);
+    }
+    printf("\n");
+}
+
+void Bench_Streaming() {
+    Mesh cube = Mesh_CreateCube();
+    std::vector<Mesh> spheres;
+    Scene scene = Scene_Create();
+    BuildWorld(&scene, &spheres, &cube);
+
+    char path[] = "/tmp/bench_streaming_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return;
+    }
+    close(fd);
+
+    double start = Bench_NowMs();
+    if (!StreamingWorld_Write(path, &scene, CHUNK_SIZE)) {
+        unlink(path);
+        return;
+    }
+    double writeMs = Bench_NowMs() - start;
+
+    // About twice the chunks within the load radius
+    StreamingWorld probe;
+    StreamingWorld_Open(&probe, path, 0, LOAD_RADIUS, 0);
+    size_t fileBytes = 0;
+    for (const StreamingChunk &chunk : probe.chunks) {
+        fileBytes += chunk.size;
+    }
+    size_t budget = fileBytes / probe.chunks.size() * 2 *
+                    (size_t)(3.1416f * LOAD_RADIUS * LOAD_RADIUS /
+                             (CHUNK_SIZE * CHUNK_SIZE));
+    printf("%dx%d, %d frames, %d chunks of %.0f units, %.1f MB written in "
+           "%.0f ms, load radius %.0f, budget %.1f MB, streamed frames best "
+           "of %d uncached runs\n",
+           W, H, FRAMES, (int)probe.chunks.size(), CHUNK_SIZE,
+           fileBytes / 1048576.0, writeMs, LOAD_RADIUS, budget / 1048576.0,
+           RUNS);
+    StreamingWorld_Close(&probe);
+
+    StreamingRun inMemory = Run(&scene, nullptr);
+    Summarize(&inMemory);
+    Print("in memory", inMemory, false);
+
+    Print("synchronous", BestRun(&scene, path, budget, 0), true);
+    Print("2 loaders",
+          BestRun(&scene, path, budget, STREAMING_DEFAULT_LOADERS), true);
+
+    unlink(path);
+}
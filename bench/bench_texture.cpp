@@ -0,0 +1,94 @@
+#include "bench.h"
+#include <cstdio>
+
+static const int W = 800, H = 600, FRAMES = 20;
+
+// Textured quad filling most of the screen (magnified: many pixels per
+// texel) or a wall of small, distant quads (minified: many texels per pixel)
+static void DrawTextureScene(Renderer *r, const Texture *texture,
+                             bool minified) {
+    if (!minified) {
+        Renderer_DrawQuad(r, Vec3{0.0f, 0.0f, 0.5f}, Vec3{0.0f, 0.0f, 0.0f},
+                          Vec3{1.2f, 1.2f, 1.0f},
+                          ColorRGBA{1.0f, 1.0f, 1.0f, 1.0f}, texture);
+        return;
+    }
+
+    for (int i = 0; i < 64; i++) {
+        Vec3 position = {(i % 8) * 1.2f - 4.2f, (i / 8) * 1.2f - 4.2f, -12.0f};
+        Renderer_DrawQuad(r, position, Vec3{0.0f, 0.0f, 0.0f},
+                          Vec3{1.0f, 1.0f, 1.0f},
+                          ColorRGBA{1.0f, 1.0f, 1.0f, 1.0f}, texture);
+    }
+}
+
+static void RunTextureScene(Texture *texture, bool minified) {
+    static const char *filterNames[] = {"nearest", "bilinear", "trilinear"};
+    // Texel fetches per sample for each filter. Magnified trilinear stays
+    // on level 0 and only does one bilinear fetch
+    const int fetches[] = {1, 4, minified ? 8 : 4};
+
+    for (int f = TEXTURE_NEAREST; f <= TEXTURE_TRILINEAR; f++) {
+        texture->filter = (TextureFilter)f;
+        Renderer r = Bench_CreateRenderer(W, H);
+
+        double start = Bench_NowMs();
+        for (int i = 0; i < FRAMES; i++) {
+            Renderer_BeginFrame(&r);
+            Renderer_ClearBackground(&r, 0x101010);
+            DrawTextureScene(&r, texture, minified);
+            Renderer_EndFrame(&r);
+        }
+        double ms = (Bench_NowMs() - start) / FRAMES;
+
+        int covered = 0;
+        for (int i = 0; i < W * H; i++) {
+            covered += r.pixels[i] != 0x101010;
+        }
+
+        printf("  %-9s %-10s %8.3f ms/frame %7.1f Mtexel fetches/s\n",
+               minified ? "minified" : "magnified", filterNames[f], ms,
+               (double)covered * fetches[f] / (ms * 1000.0));
+
+        Renderer_Destroy(&r);
+    }
+}
+
+// Sampler alone, without raster cost: a coherent sweep over the texture
+static void RunSamplerOnly(Texture *texture, float lod, const char *label) {
+    static const char *filterNames[] = {"nearest", "bilinear", "trilinear"};
+    const int fetches[] = {1, 4, lod > 0.0f ? 8 : 4};
+    const int n = 512;
+
+    for (int f = TEXTURE_NEAREST; f <= TEXTURE_TRILINEAR; f++) {
+        texture->filter = (TextureFilter)f;
+        float sum = 0.0f;
+
+        double start = Bench_NowMs();
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                Vec2 uv = {(x + 0.5f) / n, (y + 0.5f) / n};
+                sum += Texture_Sample(texture, uv, lod).r;
+            }
+        }
+        double ms = Bench_NowMs() - start;
+
+        printf("  sampler %-9s %-10s %7.1f Mtexel fetches/s (%.0f)\n", label,
+               filterNames[f], (double)n * n * fetches[f] / (ms * 1000.0),
+               sum);
+    }
+}
+
+void Bench_Texture() {
+    Texture small = Texture_CreateChecker(64, 8, 0xFFFFFFFF, 0xFF3050A0);
+    Texture large = Texture_CreateChecker(1024, 64, 0xFFFFFFFF, 0xFF3050A0);
+
+    printf("%dx%d, %d frames\n", W, H, FRAMES);
+    RunTextureScene(&small, false);
+    RunTextureScene(&large, true);
+    RunSamplerOnly(&large, -2.0f, "magnified");
+    RunSamplerOnly(&large, 2.5f, "minified");
+
+    Texture_Destroy(&small);
+    Texture_Destroy(&large);
+}
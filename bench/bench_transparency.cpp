@@ -0,0 +1,110 @@
+#include "bench.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const int W = 800, H = 600, FRAMES = 5;
+
+struct TranslucentQuad {
+    Vec3 position;
+    Vec3 rotation;
+    float size;
+    ColorRGBA color;
+};
+
+// Overlapping translucent quads of size to 2.5 size in front of an opaque
+// wall, crossing each other at random angles
+static std::vector<TranslucentQuad> CreateQuads(int count, float size) {
+    std::vector<TranslucentQuad> quads(count);
+    srand(7);
+    auto random = [] { return (float)rand() / RAND_MAX; };
+
+    for (TranslucentQuad &q : quads) {
+        q.position = {random() * 3.0f - 1.5f, random() * 2.2f - 1.1f,
+                      -random() * 3.0f};
+        q.rotation = {random() * 60.0f - 30.0f, random() * 80.0f - 40.0f,
+                      random() * 360.0f};
+        q.size = size + random() * size * 1.5f;
+        q.color = {random(), random(), random(), 0.25f + random() * 0.3f};
+    }
+
+    return quads;
+}
+
+static void Run(const std::vector<TranslucentQuad> &quads,
+                TransparencyMode mode, std::vector<uint32_t> *image) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    r.transparency = mode;
+
+    // Best of FRAMES
+    double frameMs = 1e9, rasterMs = 1e9;
+    for (int f = 0; f < FRAMES; f++) {
+        double start = Bench_NowMs();
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0xFF101010);
+
+        Renderer_DrawQuad(&r, Vec3{0.0f, 0.0f, -4.0f}, Vec3{0.0f, 0.0f, 0.0f},
+                          Vec3{8.0f, 6.0f, 1.0f},
+                          ColorRGBA{0.8f, 0.8f, 0.8f, 1.0f});
+        for (const TranslucentQuad &q : quads) {
+            Renderer_DrawQuad(&r, q.position, q.rotation,
+                              Vec3{q.size, q.size, 1.0f}, q.color);
+        }
+
+        Renderer_EndFrame(&r);
+        frameMs = std::min(frameMs, Bench_NowMs() - start);
+        rasterMs = std::min(rasterMs, (double)r.presentTarget->rasterMs);
+    }
+
+    // Beyond the opaque path: the sort's scratch copy of the transparent
+    // triangles in the frame's arena, or the tile lists on the stack of
+    // each raster thread
+    double extraKB = mode == TRANSPARENCY_TILE_KBUFFER
+                         ? TILE_SIZE * TILE_SIZE *
+                               (TRANSPARENCY_FRAGMENTS * 8.0 + 1) / 1024.0
+                         : quads.size() * 2 * sizeof(Triangle) / 1024.0;
+
+    image->assign(r.pixels, r.pixels + W * H);
+    printf("  %-28s frame %7.2f ms  raster %7.2f ms  %8.0f KB %s\n",
+           mode == TRANSPARENCY_TILE_KBUFFER ? "tile k-buffer"
+                                             : "global triangle sort",
+           frameMs, rasterMs, extraKB,
+           mode == TRANSPARENCY_TILE_KBUFFER ? "per raster thread"
+                                             : "per frame");
+
+    Renderer_Destroy(&r);
+}
+
+void Bench_Transparency() {
+    // Large quads, then particles: many small ones, where the frame-wide
+    // sort costs more and scatters each tile's triangles
+    struct {
+        int count;
+        float size;
+    } cases[] = {{1000, 0.08f}, {4000, 0.08f}, {100000, 0.01f}};
+
+    for (const auto &c : cases) {
+        std::vector<TranslucentQuad> quads = CreateQuads(c.count, c.size);
+        printf("%d translucent quads of %.2f to %.2f units\n", c.count,
+               c.size, c.size * 2.5f);
+
+        std::vector<uint32_t> kbuffer, sorted;
+        Run(quads, TRANSPARENCY_TILE_KBUFFER, &kbuffer);
+        Run(quads, TRANSPARENCY_SORTED_TRIANGLES, &sorted);
+
+        // Where the per-triangle order is wrong, mostly intersecting quads
+        int differing = 0;
+        for (int i = 0; i < W * H; i++) {
+            for (int shift = 0; shift < 24; shift += 8) {
+                int a = kbuffer[i] >> shift & 0xFF;
+                int b = sorted[i] >> shift & 0xFF;
+                if (abs(a - b) > 8) {
+                    differing++;
+                    break;
+                }
+            }
+        }
+        printf("  %d pixels differ by more than 8 levels\n", differing);
+    }
+}
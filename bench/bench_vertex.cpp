@@ -0,0 +1,135 @@
+#include "bench.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const int W = 320, H = 240, FRAMES = 5;
+
+struct VertexFormatCase {
+    const char *name;
+    VertexLayout layout;
+};
+
+// Largest decoded position error relative to the mesh size, and normal
+// error in degrees
+static void MeasureError(const Mesh *mesh, const PackedMesh *packed,
+                         float *positionError, float *normalDegrees) {
+    *positionError = 0.0f;
+    *normalDegrees = 0.0f;
+
+    Mat4 decode = PackedMesh_PositionDecode(packed);
+    float extent = Vec3_Mag(Vec3_Subtract(mesh->max, mesh->min));
+    const VertexLayout &layout = packed->layout;
+
+    for (uint32_t i = 0; i < mesh->numVertices; i++) {
+        const float *v = mesh->vertices.data() + i * mesh->vertexSize;
+        const uint8_t *p = packed->vertices.data() + i * layout.stride;
+
+        Vec4 stored = {0, 0, 0, 1.0f};
+        if (layout.position == POSITION_FLOAT32) {
+            memcpy(&stored, p, 3 * sizeof(float));
+        } else {
+            uint16_t q[3];
+            memcpy(q, p, sizeof(q));
+            stored = {(float)q[0], (float)q[1], (float)q[2], 1.0f};
+        }
+        Vec4 position = Vec4_Transform(stored, decode);
+        Vec3 delta = {position.x - v[0], position.y - v[1], position.z - v[2]};
+        *positionError = std::max(*positionError, Vec3_Mag(delta) / extent);
+
+        Vec3 normal;
+        const uint8_t *n = p + layout.normalOffset;
+        if (layout.normal == NORMAL_FLOAT32) {
+            memcpy(&normal, n, sizeof(normal));
+        } else if (layout.normal == NORMAL_OCT16) {
+            int16_t oct[2];
+            memcpy(oct, n, sizeof(oct));
+            normal = OctDecode(oct[0] / 32767.0f, oct[1] / 32767.0f);
+        } else {
+            int8_t oct[2];
+            memcpy(oct, n, sizeof(oct));
+            normal = OctDecode(oct[0] / 127.0f, oct[1] / 127.0f);
+        }
+        Vec3 source = Vec3_Normalize({v[3], v[4], v[5]});
+        float angle = atan2f(Vec3_Mag(Vec3_Cross(normal, source)),
+                             Vec3_Dot(normal, source));
+        *normalDegrees = std::max(*normalDegrees, angle * 180.0f / PI);
+    }
+}
+
+// Best-of FRAMES time of the draw call alone, the transform and triangle
+// setup of every vertex
+static double MeasureTransformMs(const Mesh *mesh, const PackedMesh *packed) {
+    Renderer r = Bench_CreateRenderer(W, H);
+    double best = 1e9;
+
+    for (int f = 0; f < FRAMES; f++) {
+        Renderer_BeginFrame(&r);
+        Renderer_ClearBackground(&r, 0x101010);
+
+        Vec3 position = {0.0f, 0.0f, -2.0f};
+        Vec3 rotation = {f * 5.0f, f * 3.0f, 0.0f};
+        Vec3 scale = {1.5f, 1.5f, 1.5f};
+        ColorRGBA color = {0.8f, 0.6f, 0.4f, 1.0f};
+
+        double start = Bench_NowMs();
+        if (packed == nullptr) {
+            Renderer_DrawTriangles(&r, (float *)mesh->vertices.data(),
+                                   mesh->numVertices, mesh->vertexSize,
+                                   position, rotation, scale, color);
+        } else {
+            Renderer_DrawPackedMesh(&r, packed, position, rotation, scale,
+                                    color);
+        }
+        best = std::min(best, Bench_NowMs() - start);
+
+        Renderer_EndFrame(&r);
+    }
+
+    Renderer_Destroy(&r);
+    return best;
+}
+
+void Bench_VertexFormats() {
+    Mesh sphere = Mesh_CreateSphere(512, 256);
+    printf("sphere of %u vertices, transform best of %d frames\n",
+           sphere.numVertices, FRAMES);
+
+    double floatMs = MeasureTransformMs(&sphere, nullptr);
+    size_t floatBytes = sphere.vertices.size() * sizeof(float);
+    printf("  %-24s %2u B/vertex %7.2f MB  transform %7.2f ms "
+           "(%6.1f M vertices/s)\n",
+           "Mesh float", sphere.vertexSize * (uint32_t)sizeof(float),
+           floatBytes / (1024.0 * 1024.0), floatMs,
+           sphere.numVertices / (floatMs * 1000.0));
+
+    VertexFormatCase cases[] = {
+        {"float32 / float32 / uv32",
+         VertexLayout_Create(POSITION_FLOAT32, NORMAL_FLOAT32, UV_FLOAT32)},
+        {"unorm16 / oct16 / uv16",
+         VertexLayout_Create(POSITION_UNORM16, NORMAL_OCT16, UV_UNORM16)},
+        {"unorm16 / oct8 / uv16",
+         VertexLayout_Create(POSITION_UNORM16, NORMAL_OCT8, UV_UNORM16)},
+        {"unorm16 / oct8 / rgba8",
+         VertexLayout_Create(POSITION_UNORM16, NORMAL_OCT8, UV_NONE,
+                             COLOR_UNORM8)},
+        {"unorm16 / oct8",
+         VertexLayout_Create(POSITION_UNORM16, NORMAL_OCT8)},
+    };
+
+    for (const VertexFormatCase &c : cases) {
+        PackedMesh packed = Mesh_Pack(&sphere, c.layout);
+        float positionError, normalDegrees;
+        MeasureError(&sphere, &packed, &positionError, &normalDegrees);
+        double ms = MeasureTransformMs(&sphere, &packed);
+
+        printf("  %-24s %2u B/vertex %7.2f MB  transform %7.2f ms "
+               "(%6.1f M vertices/s)  error %.1e of size, %.2f deg\n",
+               c.name, c.layout.stride,
+               packed.vertices.size() / (1024.0 * 1024.0), ms,
+               sphere.numVertices / (ms * 1000.0), positionError,
+               normalDegrees);
+    }
+}
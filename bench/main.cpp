@@ -0,0 +1,51 @@
+#include "bench.h"
+#include <cstdio>
+#include <cstring>
+
+static const BenchScenario scenarios[] = {
+    {"msaa", Bench_MSAA},
+    {"dynres", Bench_DynamicResolution},
+    {"pipeline", Bench_Pipeline},
+    {"texture", Bench_Texture},
+    {"instancing", Bench_Instancing},
+    {"scene", Bench_Scene},
+    {"occlusion", Bench_Occlusion},
+    {"lod", Bench_Lod},
+    {"overlay", Bench_Overlay},
+    {"micro", Bench_MicroTriangles},
+    {"shader", Bench_Shader},
+    {"interpolation", Bench_Interpolation},
+    {"transparency", Bench_Transparency},
+    {"depth", Bench_Depth},
+    {"arena", Bench_Arena},
+    {"vertex", Bench_VertexFormats},
+    {"incremental", Bench_Incremental},
+    {"export", Bench_Export},
+    {"multiview", Bench_MultiView},
+    {"distributed", Bench_Distributed},
+    {"affinity", Bench_Affinity},
+    {"isa", Bench_Isa},
+    {"streaming", Bench_Streaming},
+    {"skinning", Bench_Skinning},
+    {"postprocess", Bench_PostProcess},
+};
+
+int main(int argc, char **argv) {
+    int numScenarios = sizeof(scenarios) / sizeof(scenarios[0]);
+
+    for (int i = 0; i < numScenarios; i++) {
+        bool selected = argc < 2;
+        for (int a = 1; a < argc; a++) {
+            if (strcmp(argv[a], scenarios[i].name) == 0) {
+                selected = true;
+            }
+        }
+
+        if (selected) {
+            printf("== %s ==\n", scenarios[i].name);
+            scenarios[i].run();
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "arena.h"
+#include <algorithm>
+
+// Heap block chained after Arena::base filled up, the data follows the
+// header
+struct alignas(ARENA_ALIGNMENT) ArenaBlock {
+    ArenaBlock *next;
+    size_t size;
+    size_t used;
+};
+
+static size_t Arena_AlignUp(size_t bytes) {
+    return (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static unsigned char *ArenaBlock_Data(ArenaBlock *block) {
+    return (unsigned char *)(block + 1);
+}
+
+static void Arena_FreeOverflow(Arena *arena) {
+    while (arena->overflow != nullptr) {
+        ArenaBlock *next = arena->overflow->next;
+        delete[](unsigned char *) arena->overflow;
+        arena->overflow = next;
+    }
+}
+
+void Arena_Destroy(Arena *arena) {
+    if (arena == nullptr) {
+        return;
+    }
+
+    Arena_FreeOverflow(arena);
+    delete[] arena->base;
+    *arena = {};
+}
+
+void Arena_Reset(Arena *arena) {
+    arena->highWater = std::max(arena->highWater, arena->frameBytes);
+
+    // Trade the chain for a single block that fits the busiest frame
+    if (arena->overflow != nullptr) {
+        Arena_FreeOverflow(arena);
+        delete[] arena->base;
+        arena->size = std::max(Arena_AlignUp(arena->highWater),
+                               ARENA_MIN_BLOCK_SIZE);
+        arena->base = new unsigned char[arena->size];
+        arena->heapAllocations++;
+    }
+
+    arena->used = 0;
+    arena->frameBytes = 0;
+}
+
+void *Arena_Alloc(Arena *arena, size_t bytes) {
+    bytes = Arena_AlignUp(bytes);
+    arena->frameBytes += bytes;
+
+    if (arena->overflow == nullptr && arena->used + bytes <= arena->size) {
+        void *p = arena->base + arena->used;
+        arena->used += bytes;
+        return p;
+    }
+
+    // Once base is full, everything comes from the newest block, at least
+    // as big as the frame so far so the chain stays short
+    ArenaBlock *block = arena->overflow;
+    if (block == nullptr || block->used + bytes > block->size) {
+        size_t size =
+            std::max({bytes, ARENA_MIN_BLOCK_SIZE, arena->frameBytes});
+        block = (ArenaBlock *)new unsigned char[sizeof(ArenaBlock) + size];
+        block->next = arena->overflow;
+        block->size = size;
+        block->used = 0;
+        arena->overflow = block;
+        arena->heapAllocations++;
+    }
+
+    void *p = ArenaBlock_Data(block) + block->used;
+    block->used += bytes;
+    return p;
+}
+
+bool Arena_Extend(Arena *arena, void *p, size_t oldBytes, size_t newBytes) {
+    oldBytes = Arena_AlignUp(oldBytes);
+    newBytes = Arena_AlignUp(newBytes);
+
+    unsigned char *data = arena->base;
+    size_t *used = &arena->used;
+    size_t size = arena->size;
+    if (arena->overflow != nullptr) {
+        data = ArenaBlock_Data(arena->overflow);
+        used = &arena->overflow->used;
+        size = arena->overflow->size;
+    }
+
+    if ((unsigned char *)p + oldBytes != data + *used ||
+        *used - oldBytes + newBytes > size) {
+        return false;
+    }
+
+    *used += newBytes - oldBytes;
+    arena->frameBytes += newBytes - oldBytes;
+    return true;
+}
@@ -0,0 +1,111 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Smallest block the arena takes from the heap
+const size_t ARENA_MIN_BLOCK_SIZE = 64 * 1024;
+// Every allocation is aligned to this many bytes
+const size_t ARENA_ALIGNMENT = 16;
+
+struct ArenaBlock;
+
+// Linear allocator for data that lives for one frame. Allocating bumps an
+// offset and Arena_Reset releases everything at once. A frame that outgrows
+// the block chains extra heap blocks; the next reset replaces them with one
+// block of the high-water size, so a steady workload stops touching the heap
+// after its first frames
+struct Arena {
+    unsigned char *base;
+    size_t size;
+    size_t used;
+    // Blocks chained this frame after base filled up
+    ArenaBlock *overflow;
+    // Bytes requested since the last reset, and the most of any frame
+    size_t frameBytes;
+    size_t highWater;
+    // Blocks taken from the heap over the arena's lifetime
+    uint64_t heapAllocations;
+};
+
+void Arena_Destroy(Arena *arena);
+void Arena_Reset(Arena *arena);
+void *Arena_Alloc(Arena *arena, size_t bytes);
+// Grows the most recent allocation p from oldBytes to newBytes where it is,
+// false if something was allocated after it or the block is full
+bool Arena_Extend(Arena *arena, void *p, size_t oldBytes, size_t newBytes);
+
+template <typename T> T *Arena_AllocArray(Arena *arena, size_t count) {
+    static_assert(std::is_trivially_copyable<T>::value &&
+                      alignof(T) <= ARENA_ALIGNMENT,
+                  "Arena memory is never constructed or destroyed");
+    return (T *)Arena_Alloc(arena, count * sizeof(T));
+}
+
+// Array growing inside an arena, for output whose size is only known once
+// it's written. Growth extends the array in place when it is the arena's
+// latest allocation and moves it otherwise. Becomes invalid when the arena
+// is reset
+template <typename T> struct ArenaArray {
+    T *data;
+    uint32_t count;
+    uint32_t capacity;
+
+    T &operator[](size_t i) { return data[i]; }
+    const T &operator[](size_t i) const { return data[i]; }
+    T *begin() { return data; }
+    T *end() { return data + count; }
+    const T *begin() const { return data; }
+    const T *end() const { return data + count; }
+    size_t size() const { return count; }
+};
+
+// Makes room for at least capacity elements, at least doubling so a series
+// of small reserves stays linear
+template <typename T>
+void ArenaArray_Reserve(Arena *arena, ArenaArray<T> *array,
+                        uint32_t capacity) {
+    if (capacity <= array->capacity) {
+        return;
+    }
+
+    uint32_t grown = array->capacity * 2;
+    if (grown < capacity) {
+        grown = capacity;
+    }
+
+    if (array->data != nullptr &&
+        Arena_Extend(arena, array->data, array->capacity * sizeof(T),
+                     grown * sizeof(T))) {
+        array->capacity = grown;
+        return;
+    }
+
+    T *data = Arena_AllocArray<T>(arena, grown);
+    if (array->count > 0) {
+        memcpy(data, array->data, array->count * sizeof(T));
+    }
+    array->data = data;
+    array->capacity = grown;
+}
+
+// Appends count uninitialized elements and returns the first
+template <typename T>
+T *ArenaArray_Push(Arena *arena, ArenaArray<T> *array, uint32_t count = 1) {
+    if (array->count + count > array->capacity) {
+        ArenaArray_Reserve(arena, array, array->count + count);
+    }
+
+    T *first = array->data + array->count;
+    array->count += count;
+    return first;
+}
+
+template <typename T> void ArenaArray_Clear(ArenaArray<T> *array) {
+    *array = {};
+}
+
+#endif
@@ -0,0 +1,669 @@
+#include "distributed.h"
+#include "renderer.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <map>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+enum DistributedMessageType : uint32_t {
+    DISTRIBUTED_MESSAGE_HELLO = 1, // worker -> coordinator
+    DISTRIBUTED_MESSAGE_JOB,       // coordinator -> worker, answers hello
+    DISTRIBUTED_MESSAGE_TASK,      // coordinator -> worker
+    DISTRIBUTED_MESSAGE_RESULT,    // worker -> coordinator
+    DISTRIBUTED_MESSAGE_BYE,       // coordinator -> worker
+};
+
+struct MessageHeader {
+    uint32_t type;
+    // Bytes following the header
+    uint32_t size;
+};
+
+struct HelloMessage {
+    uint32_t version;
+};
+
+struct JobMessage {
+    int32_t width, height;
+    int32_t regionSize;
+    int32_t sampleCount;
+};
+
+struct TaskMessage {
+    uint32_t id;
+    int32_t frame;
+    // Region of the frame
+    int32_t x, y, width, height;
+};
+
+// Followed by the compressed pixels of the task's region
+struct ResultMessage {
+    uint32_t id;
+};
+
+// Largest message accepted: a compressed region can grow by 1/128
+static const uint32_t DISTRIBUTED_MAX_MESSAGE_SIZE = 1u << 30;
+
+static uint64_t Distributed_NowMs() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Sends size bytes. Non-blocking sockets wait for room until the deadline,
+// after which the peer is taken as stuck and the send fails
+static bool Distributed_SendAll(int fd, const void *data, size_t size,
+                                uint64_t deadlineMs) {
+    const char *p = (const char *)data;
+    while (size > 0) {
+#ifdef MSG_NOSIGNAL
+        ssize_t sent = send(fd, p, size, MSG_NOSIGNAL);
+#else
+        ssize_t sent = send(fd, p, size, 0);
+#endif
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Non-blocking coordinator sockets: wait for room
+            uint64_t now = Distributed_NowMs();
+            if (now >= deadlineMs) {
+                return false;
+            }
+            pollfd pfd = {fd, POLLOUT, 0};
+            poll(&pfd, 1, (int)std::min<uint64_t>(deadlineMs - now, 100));
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        p += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Sends a message, failing if a non-blocking socket has no room for it
+// within timeoutMs
+static bool Distributed_SendMessage(int fd, int timeoutMs, uint32_t type,
+                                    const void *payload, uint32_t size,
+                                    const void *data = nullptr,
+                                    uint32_t dataSize = 0) {
+    MessageHeader header = {type, size + dataSize};
+    uint64_t deadline = Distributed_NowMs() + timeoutMs;
+    return Distributed_SendAll(fd, &header, sizeof(header), deadline) &&
+           Distributed_SendAll(fd, payload, size, deadline) &&
+           Distributed_SendAll(fd, data, dataSize, deadline);
+}
+
+static bool Distributed_RecvAll(int fd, void *data, size_t size) {
+    char *p = (char *)data;
+    while (size > 0) {
+        ssize_t received = recv(fd, p, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        p += received;
+        size -= received;
+    }
+    return true;
+}
+
+static void Distributed_ConfigureSocket(int fd) {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+}
+
+void Distributed_Compress(const uint32_t *pixels, size_t count,
+                          std::vector<uint8_t> *out) {
+    out->clear();
+    out->reserve(count * sizeof(uint32_t) / 4);
+
+    auto append = [&](const uint32_t *p, size_t n) {
+        const uint8_t *bytes = (const uint8_t *)p;
+        out->insert(out->end(), bytes, bytes + n * sizeof(uint32_t));
+    };
+
+    size_t i = 0;
+    while (i < count) {
+        size_t run = 1;
+        while (i + run < count && run < 129 && pixels[i + run] == pixels[i]) {
+            run++;
+        }
+        if (run >= 2) {
+            out->push_back((uint8_t)(run + 126));
+            append(&pixels[i], 1);
+            i += run;
+            continue;
+        }
+
+        // Literals up to the next run of two
+        size_t literal = 1;
+        while (i + literal < count && literal < 128 &&
+               !(i + literal + 1 < count &&
+                 pixels[i + literal] == pixels[i + literal + 1])) {
+            literal++;
+        }
+        out->push_back((uint8_t)(literal - 1));
+        append(&pixels[i], literal);
+        i += literal;
+    }
+}
+
+bool Distributed_Decompress(const uint8_t *data, size_t size,
+                            uint32_t *pixels, size_t count) {
+    size_t in = 0;
+    size_t written = 0;
+    while (in < size) {
+        uint8_t control = data[in++];
+        size_t n = control < 128 ? control + 1 : control - 126;
+        size_t bytes = (control < 128 ? n : 1) * sizeof(uint32_t);
+        if (written + n > count || in + bytes > size) {
+            return false;
+        }
+
+        if (control < 128) {
+            memcpy(&pixels[written], &data[in], bytes);
+        } else {
+            uint32_t pixel;
+            memcpy(&pixel, &data[in], sizeof(pixel));
+            std::fill(&pixels[written], &pixels[written + n], pixel);
+        }
+        in += bytes;
+        written += n;
+    }
+    return written == count;
+}
+
+bool Coordinator_Listen(Coordinator *coordinator, uint16_t port) {
+    *coordinator = {.listenFd = -1};
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    socklen_t length = sizeof(address);
+    if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(fd, DISTRIBUTED_MAX_WORKERS) != 0 ||
+        getsockname(fd, (sockaddr *)&address, &length) != 0) {
+        perror("listen");
+        close(fd);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    coordinator->listenFd = fd;
+    coordinator->port = ntohs(address.sin_port);
+    return true;
+}
+
+void Coordinator_Close(Coordinator *coordinator) {
+    if (coordinator == nullptr) {
+        return;
+    }
+
+    if (coordinator->listenFd >= 0) {
+        close(coordinator->listenFd);
+    }
+    *coordinator = {.listenFd = -1};
+}
+
+struct DistributedTask {
+    int frame;
+    int x, y, width, height;
+    bool done;
+};
+
+struct WorkerConnection {
+    int fd;
+    // Hello received and job sent
+    bool ready;
+    // Bytes received but not parsed yet
+    std::vector<uint8_t> input;
+    // Tasks sent and not answered, oldest first
+    std::deque<uint32_t> tasks;
+    // Last time the worker was sent work while idle or answered a task
+    uint64_t progressMs;
+};
+
+// Pixels of a frame whose regions are still arriving
+struct FrameAssembly {
+    std::vector<uint32_t> pixels;
+    int remaining;
+};
+
+struct CoordinatorState {
+    const DistributedJob *job;
+    std::vector<DistributedTask> tasks;
+    // Tasks to send, reassigned ones first
+    std::deque<uint32_t> pending;
+    std::vector<WorkerConnection> workers;
+    std::map<int, FrameAssembly> frames;
+    int regionsPerFrame;
+    int nextFrame;
+    DistributedFrameFunc onFrame;
+    void *user;
+    DistributedStats *stats;
+    std::vector<uint32_t> scratch;
+};
+
+// Closes a worker's connection; its unanswered tasks are sent to others
+static void Coordinator_DropWorker(CoordinatorState *state, size_t w,
+                                   bool lost) {
+    WorkerConnection &worker = state->workers[w];
+    for (auto it = worker.tasks.rbegin(); it != worker.tasks.rend(); ++it) {
+        if (!state->tasks[*it].done) {
+            state->pending.push_front(*it);
+            state->stats->reassigned++;
+        }
+    }
+    if (lost) {
+        state->stats->workersLost++;
+    }
+    close(worker.fd);
+    state->workers.erase(state->workers.begin() + w);
+}
+
+// Stores a task's pixels and hands every frame completed in order to
+// onFrame. False when the result is malformed
+static bool Coordinator_AcceptResult(CoordinatorState *state,
+                                     WorkerConnection *worker,
+                                     const uint8_t *payload, uint32_t size) {
+    ResultMessage result;
+    if (size < sizeof(result)) {
+        return false;
+    }
+    memcpy(&result, payload, sizeof(result));
+
+    auto it = std::find(worker->tasks.begin(), worker->tasks.end(), result.id);
+    if (it == worker->tasks.end()) {
+        return false;
+    }
+    worker->tasks.erase(it);
+    worker->progressMs = Distributed_NowMs();
+
+    DistributedTask &task = state->tasks[result.id];
+    if (task.done) {
+        return true;
+    }
+
+    size_t count = (size_t)task.width * task.height;
+    state->scratch.resize(count);
+    if (!Distributed_Decompress(payload + sizeof(result), size - sizeof(result),
+                                state->scratch.data(), count)) {
+        return false;
+    }
+    task.done = true;
+    state->stats->tasks++;
+    state->stats->rawBytes += count * sizeof(uint32_t);
+    state->stats->compressedBytes += size - sizeof(result);
+
+    const DistributedJob *job = state->job;
+    FrameAssembly &frame = state->frames[task.frame];
+    if (frame.pixels.empty()) {
+        frame.pixels.resize((size_t)job->width * job->height);
+        frame.remaining = state->regionsPerFrame;
+    }
+    for (int y = 0; y < task.height; y++) {
+        std::copy(&state->scratch[y * task.width],
+                  &state->scratch[(y + 1) * task.width],
+                  &frame.pixels[(task.y + y) * job->width + task.x]);
+    }
+    frame.remaining--;
+
+    for (auto f = state->frames.find(state->nextFrame);
+         f != state->frames.end() && f->second.remaining == 0;
+         f = state->frames.find(state->nextFrame)) {
+        if (state->onFrame != nullptr) {
+            state->onFrame(f->first, f->second.pixels.data(), job->width,
+                           job->height, state->user);
+        }
+        state->frames.erase(f);
+        state->nextFrame++;
+    }
+    return true;
+}
+
+// Reads what the worker sent and handles its complete messages. False when
+// the connection is closed or broken
+static bool Coordinator_ReadWorker(CoordinatorState *state,
+                                   WorkerConnection *worker) {
+    uint8_t buffer[64 * 1024];
+    for (;;) {
+        ssize_t received = recv(worker->fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            worker->input.insert(worker->input.end(), buffer,
+                                 buffer + received);
+            continue;
+        }
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return false;
+    }
+
+    size_t offset = 0;
+    while (worker->input.size() - offset >= sizeof(MessageHeader)) {
+        MessageHeader header;
+        memcpy(&header, &worker->input[offset], sizeof(header));
+        if (header.size > DISTRIBUTED_MAX_MESSAGE_SIZE) {
+            return false;
+        }
+        if (worker->input.size() - offset < sizeof(header) + header.size) {
+            break;
+        }
+        const uint8_t *payload = &worker->input[offset + sizeof(header)];
+        offset += sizeof(header) + header.size;
+
+        if (header.type == DISTRIBUTED_MESSAGE_HELLO) {
+            HelloMessage hello;
+            if (header.size != sizeof(hello)) {
+                return false;
+            }
+            memcpy(&hello, payload, sizeof(hello));
+            const DistributedJob *job = state->job;
+            JobMessage message = {job->width, job->height, job->regionSize,
+                                  job->sampleCount};
+            if (hello.version != DISTRIBUTED_VERSION ||
+                !Distributed_SendMessage(worker->fd, job->timeoutMs,
+                                         DISTRIBUTED_MESSAGE_JOB, &message,
+                                         sizeof(message))) {
+                return false;
+            }
+            worker->ready = true;
+        } else if (header.type == DISTRIBUTED_MESSAGE_RESULT) {
+            if (!Coordinator_AcceptResult(state, worker, payload,
+                                          header.size)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    worker->input.erase(worker->input.begin(),
+                        worker->input.begin() + offset);
+    return true;
+}
+
+bool Coordinator_Run(Coordinator *coordinator, const DistributedJob *job,
+                     DistributedFrameFunc onFrame, void *user,
+                     DistributedStats *stats) {
+    DistributedStats unused;
+    if (stats == nullptr) {
+        stats = &unused;
+    }
+    *stats = {};
+
+    CoordinatorState state = {
+        .job = job,
+        .onFrame = onFrame,
+        .user = user,
+        .stats = stats,
+    };
+
+    // Tasks in frame order, regions row by row
+    int regionSize = job->regionSize > 0
+                         ? job->regionSize
+                         : std::max(job->width, job->height);
+    for (int f = 0; f < job->numFrames; f++) {
+        state.regionsPerFrame = 0;
+        for (int y = 0; y < job->height; y += regionSize) {
+            for (int x = 0; x < job->width; x += regionSize) {
+                state.pending.push_back((uint32_t)state.tasks.size());
+                state.tasks.push_back({
+                    .frame = job->firstFrame + f,
+                    .x = x,
+                    .y = y,
+                    .width = std::min(regionSize, job->width - x),
+                    .height = std::min(regionSize, job->height - y),
+                });
+                state.regionsPerFrame++;
+            }
+        }
+    }
+    state.nextFrame = job->firstFrame;
+
+    uint64_t noWorkersSince = Distributed_NowMs();
+    bool ok = true;
+    std::vector<pollfd> pfds;
+
+    while (state.nextFrame < job->firstFrame + job->numFrames) {
+        pfds.clear();
+        pfds.push_back({coordinator->listenFd, POLLIN, 0});
+        for (const WorkerConnection &worker : state.workers) {
+            pfds.push_back({worker.fd, POLLIN, 0});
+        }
+        poll(pfds.data(), pfds.size(), 20);
+
+        if (pfds[0].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(coordinator->listenFd, nullptr, nullptr)) >=
+                   0) {
+                if ((int)state.workers.size() >= DISTRIBUTED_MAX_WORKERS) {
+                    close(fd);
+                    continue;
+                }
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                Distributed_ConfigureSocket(fd);
+                state.workers.push_back({.fd = fd});
+                stats->workersConnected++;
+            }
+        }
+
+        // Workers were appended after the polled ones, so pfds[w + 1] is
+        // worker w until the first drop; later ones wait for the next poll
+        size_t polled = pfds.size() - 1;
+        for (size_t w = 0; w < state.workers.size();) {
+            WorkerConnection &worker = state.workers[w];
+            bool readable = w < polled && pfds[w + 1].revents != 0;
+            bool alive = !readable || Coordinator_ReadWorker(&state, &worker);
+            // Read after the results, which move progressMs forward
+            uint64_t now = Distributed_NowMs();
+            bool late = !worker.tasks.empty() &&
+                        now - worker.progressMs > (uint64_t)job->timeoutMs;
+            if (!alive || late) {
+                Coordinator_DropWorker(&state, w, true);
+                polled = std::min(polled, w);
+                continue;
+            }
+            w++;
+        }
+
+        for (size_t w = 0; w < state.workers.size();) {
+            WorkerConnection &worker = state.workers[w];
+            bool sent = true;
+            while (sent && worker.ready && !state.pending.empty() &&
+                   (int)worker.tasks.size() < DISTRIBUTED_TASKS_PER_WORKER) {
+                uint32_t id = state.pending.front();
+                const DistributedTask &task = state.tasks[id];
+                TaskMessage message = {id,         task.frame, task.x,
+                                       task.y,     task.width, task.height};
+                sent = Distributed_SendMessage(
+                    worker.fd, job->timeoutMs, DISTRIBUTED_MESSAGE_TASK,
+                    &message, sizeof(message));
+                if (sent) {
+                    if (worker.tasks.empty()) {
+                        worker.progressMs = Distributed_NowMs();
+                    }
+                    worker.tasks.push_back(id);
+                    state.pending.pop_front();
+                }
+            }
+            if (!sent) {
+                Coordinator_DropWorker(&state, w, true);
+                continue;
+            }
+            w++;
+        }
+
+        if (!state.workers.empty()) {
+            noWorkersSince = Distributed_NowMs();
+        } else if (Distributed_NowMs() - noWorkersSince >
+                   (uint64_t)job->timeoutMs) {
+            fprintf(stderr, "no workers for %d ms, giving up\n",
+                    job->timeoutMs);
+            ok = false;
+            break;
+        }
+    }
+
+    while (!state.workers.empty()) {
+        Distributed_SendMessage(state.workers.back().fd, job->timeoutMs,
+                                DISTRIBUTED_MESSAGE_BYE, nullptr, 0);
+        Coordinator_DropWorker(&state, state.workers.size() - 1, false);
+    }
+    return ok;
+}
+
+// Connects to host:port, retrying until the deadline
+static int Worker_Connect(const char *host, uint16_t port,
+                          int connectTimeoutMs) {
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    uint64_t deadline = Distributed_NowMs() + connectTimeoutMs;
+    for (;;) {
+        addrinfo *addresses;
+        if (getaddrinfo(host, service, &hints, &addresses) == 0) {
+            for (addrinfo *a = addresses; a != nullptr; a = a->ai_next) {
+                int fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (fd < 0) {
+                    continue;
+                }
+                if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+                    freeaddrinfo(addresses);
+                    Distributed_ConfigureSocket(fd);
+                    return fd;
+                }
+                close(fd);
+            }
+            freeaddrinfo(addresses);
+        }
+
+        if (Distributed_NowMs() >= deadline) {
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+bool Worker_Run(const char *host, uint16_t port, const DistributedScene *scene,
+                int connectTimeoutMs) {
+    int fd = Worker_Connect(host, port, connectTimeoutMs);
+    if (fd < 0) {
+        fprintf(stderr, "could not connect to %s:%u\n", host, port);
+        return false;
+    }
+
+    // The worker's socket blocks, so its sends never reach the deadline
+    HelloMessage hello = {DISTRIBUTED_VERSION};
+    MessageHeader header;
+    JobMessage job;
+    if (!Distributed_SendMessage(fd, connectTimeoutMs,
+                                 DISTRIBUTED_MESSAGE_HELLO, &hello,
+                                 sizeof(hello)) ||
+        !Distributed_RecvAll(fd, &header, sizeof(header)) ||
+        header.type != DISTRIBUTED_MESSAGE_JOB || header.size != sizeof(job) ||
+        !Distributed_RecvAll(fd, &job, sizeof(job)) || job.width <= 0 ||
+        job.height <= 0) {
+        close(fd);
+        return false;
+    }
+
+    // Big enough for any task; each one renders at its region's size
+    int maxWidth = job.width, maxHeight = job.height;
+    if (job.regionSize > 0) {
+        maxWidth = std::min(maxWidth, job.regionSize);
+        maxHeight = std::min(maxHeight, job.regionSize);
+    }
+    Renderer r = Renderer_Create(maxWidth, maxHeight, 1, job.sampleCount);
+    std::vector<uint8_t> compressed;
+    bool ok = false;
+
+    for (;;) {
+        TaskMessage task;
+        if (!Distributed_RecvAll(fd, &header, sizeof(header))) {
+            break;
+        }
+        if (header.type == DISTRIBUTED_MESSAGE_BYE) {
+            ok = true;
+            break;
+        }
+        if (header.type != DISTRIBUTED_MESSAGE_TASK ||
+            header.size != sizeof(task) ||
+            !Distributed_RecvAll(fd, &task, sizeof(task))) {
+            break;
+        }
+        // Only regions of the job's frame that fit the renderer, as the
+        // result is read from r.pixels at the task's size
+        if (task.x < 0 || task.y < 0 || task.width <= 0 ||
+            task.height <= 0 || task.x > job.width - task.width ||
+            task.y > job.height - task.height || task.width > r.maxWidth ||
+            task.height > r.maxHeight) {
+            fprintf(stderr, "invalid task %d,%d %dx%d from %s:%u\n", task.x,
+                    task.y, task.width, task.height, host, port);
+            break;
+        }
+
+        if (scene->prepare != nullptr) {
+            scene->prepare(&r, task.frame, scene->user);
+        }
+
+        // The region is a view of the whole frame shifted so only the
+        // region's pixels land in the render target
+        Renderer_SetRenderSize(&r, task.width, task.height);
+        RenderView view = {r.camera, -task.x, -task.y, job.width, job.height};
+        Renderer_SetViews(&r, &view, 1);
+
+        Renderer_BeginFrame(&r);
+        scene->draw(&r, task.frame, scene->user);
+        Renderer_EndFrame(&r);
+        Renderer_Finish(&r);
+
+        Distributed_Compress(r.pixels, (size_t)task.width * task.height,
+                             &compressed);
+        ResultMessage result = {task.id};
+        if (!Distributed_SendMessage(fd, connectTimeoutMs,
+                                     DISTRIBUTED_MESSAGE_RESULT, &result,
+                                     sizeof(result), compressed.data(),
+                                     (uint32_t)compressed.size())) {
+            break;
+        }
+    }
+
+    Renderer_Destroy(&r);
+    close(fd);
+    return ok;
+}
@@ -0,0 +1,87 @@
+#ifndef DISTRIBUTED_H_
+#define DISTRIBUTED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Renderer;
+
+// Distributed rendering: a coordinator splits a job into tasks, whole frames
+// of a sequence or square regions of each frame, and hands them to worker
+// processes connected over TCP. Workers render their tasks with the same
+// scene callbacks and send the pixels back run-length compressed. A worker
+// that disconnects or doesn't answer in time is dropped and its tasks go to
+// the others. Messages are native-endian structs, so coordinator and
+// workers must share the architecture.
+
+const uint32_t DISTRIBUTED_VERSION = 1;
+const uint16_t DISTRIBUTED_DEFAULT_PORT = 7411;
+// Tasks sent to a worker before it answers the first, hiding the round trip
+const int DISTRIBUTED_TASKS_PER_WORKER = 2;
+const int DISTRIBUTED_MAX_WORKERS = 64;
+
+struct DistributedJob {
+    int width, height;
+    int firstFrame, numFrames;
+    // Each frame is split into regions of regionSize x regionSize pixels,
+    // 0 sends whole frames
+    int regionSize;
+    int sampleCount;
+    // A task unanswered for this long drops its worker, and the job fails
+    // when no worker is connected for this long
+    int timeoutMs;
+};
+
+// Scene of a job, the same in every worker. prepare (optional) sets up the
+// renderer for frame: camera, shadows, settings. draw records the frame
+// between Renderer_BeginFrame and Renderer_EndFrame, clear included
+struct DistributedScene {
+    void (*prepare)(Renderer *r, int frame, void *user);
+    void (*draw)(Renderer *r, int frame, void *user);
+    void *user;
+};
+
+// Called by the coordinator with each completed frame, in frame order
+typedef void (*DistributedFrameFunc)(int frame, const uint32_t *pixels,
+                                     int width, int height, void *user);
+
+struct DistributedStats {
+    int tasks;
+    // Tasks sent again after their worker was lost
+    int reassigned;
+    int workersConnected;
+    int workersLost;
+    uint64_t rawBytes;
+    uint64_t compressedBytes;
+};
+
+struct Coordinator {
+    int listenFd;
+    uint16_t port;
+};
+
+// Listens on port, 0 picks a free one (returned in coordinator->port)
+bool Coordinator_Listen(Coordinator *coordinator, uint16_t port);
+// Runs job to completion with the workers that connect, then tells them
+// to exit. False if it failed, e.g. no worker was left
+bool Coordinator_Run(Coordinator *coordinator, const DistributedJob *job,
+                     DistributedFrameFunc onFrame, void *user,
+                     DistributedStats *stats);
+void Coordinator_Close(Coordinator *coordinator);
+
+// Connects to a coordinator, retrying for up to connectTimeoutMs, and
+// renders its tasks until it is told to exit. False when the connection
+// failed or was lost
+bool Worker_Run(const char *host, uint16_t port, const DistributedScene *scene,
+                int connectTimeoutMs = 5000);
+
+// PackBits-style run-length coding of 32-bit pixels: a control byte n < 128
+// is followed by n + 1 literal pixels, n >= 128 by one pixel repeated
+// n - 126 times
+void Distributed_Compress(const uint32_t *pixels, size_t count,
+                          std::vector<uint8_t> *out);
+bool Distributed_Decompress(const uint8_t *data, size_t size,
+                            uint32_t *pixels, size_t count);
+
+#endif
@@ -0,0 +1,303 @@
+#include "framering.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "Atomics in shared memory must not rely on locks");
+
+static const size_t FRAME_RING_PAGE_SIZE = 4096;
+
+static size_t FrameRing_PageAlign(size_t bytes) {
+    return (bytes + FRAME_RING_PAGE_SIZE - 1) & ~(FRAME_RING_PAGE_SIZE - 1);
+}
+
+// Header and slot i of the mapped segment
+static FrameSlotHeader *FrameRing_Slot(const FrameRingHeader *header,
+                                       uint64_t i) {
+    unsigned char *base = (unsigned char *)header;
+    return (FrameSlotHeader *)(base + FrameRing_PageAlign(
+                                          sizeof(FrameRingHeader)) +
+                               i * header->slotSize);
+}
+
+uint64_t FrameRing_NowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Whether the segment name was left behind by a producer that no longer
+// runs. Segments of a live producer, of an unknown layout or still being
+// created are not stale
+static bool FrameRing_IsStale(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void *base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(FrameRingHeader)) {
+        base = mmap(nullptr, sizeof(FrameRingHeader), PROT_READ, MAP_SHARED,
+                    fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    const FrameRingHeader *header = (const FrameRingHeader *)base;
+    bool stale = header->magic == FRAME_RING_MAGIC &&
+                 header->version == FRAME_RING_VERSION &&
+                 header->producerPid > 0 &&
+                 kill(header->producerPid, 0) != 0 && errno == ESRCH;
+    munmap(base, sizeof(FrameRingHeader));
+    return stale;
+}
+
+bool FrameRing_Create(FrameRing *ring, const char *name, int numSlots,
+                      int maxWidth, int maxHeight) {
+    *ring = {.fd = -1};
+    if (numSlots < 2 || numSlots > FRAME_RING_MAX_SLOTS ||
+        strlen(name) >= sizeof(ring->name)) {
+        return false;
+    }
+    strcpy(ring->name, name);
+
+    uint64_t pixelOffset = 64;
+    uint64_t slotSize = FrameRing_PageAlign(
+        pixelOffset + (size_t)maxWidth * maxHeight * sizeof(uint32_t));
+    ring->size =
+        FrameRing_PageAlign(sizeof(FrameRingHeader)) + numSlots * slotSize;
+
+    // A stale segment of a crashed producer is replaced, a live one's is
+    // left alone
+    ring->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (ring->fd < 0 && errno == EEXIST && FrameRing_IsStale(name)) {
+        shm_unlink(name);
+        ring->fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    }
+    if (ring->fd < 0) {
+        int error = errno;
+        perror(name);
+        errno = error;
+        return false;
+    }
+    if (ftruncate(ring->fd, ring->size) != 0) {
+        perror("ftruncate");
+        FrameRing_Destroy(ring);
+        return false;
+    }
+
+    ring->base = mmap(nullptr, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      ring->fd, 0);
+    if (ring->base == MAP_FAILED) {
+        perror("mmap");
+        ring->base = nullptr;
+        FrameRing_Destroy(ring);
+        return false;
+    }
+
+    // The segment starts zeroed, a valid state for every atomic
+    FrameRingHeader *header = (FrameRingHeader *)ring->base;
+    header->version = FRAME_RING_VERSION;
+    header->numSlots = numSlots;
+    header->maxWidth = maxWidth;
+    header->maxHeight = maxHeight;
+    header->slotSize = slotSize;
+    header->pixelOffset = pixelOffset;
+    header->producerPid = (int32_t)getpid();
+    // Consumers check the magic before anything else
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = FRAME_RING_MAGIC;
+
+    ring->header = header;
+    return true;
+}
+
+void FrameRing_Destroy(FrameRing *ring) {
+    if (ring == nullptr) {
+        return;
+    }
+
+    if (ring->base != nullptr) {
+        munmap(ring->base, ring->size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+        shm_unlink(ring->name);
+    }
+    *ring = {.fd = -1};
+}
+
+FrameSlotHeader *FrameRing_Begin(FrameRing *ring) {
+    FrameSlotHeader *slot =
+        FrameRing_Slot(ring->header, ring->begun % ring->header->numSlots);
+    ring->begun++;
+
+    // Odd while written. The fence keeps the pixel writes after it
+    slot->sequence.store(ring->begun * 2 - 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot;
+}
+
+uint32_t *FrameRing_Pixels(FrameRing *ring, FrameSlotHeader *slot) {
+    return (uint32_t *)((unsigned char *)slot + ring->header->pixelOffset);
+}
+
+void FrameRing_Publish(FrameRing *ring, FrameSlotHeader *slot, int width,
+                       int height, uint64_t frameNumber, uint64_t submitNs) {
+    slot->width = width;
+    slot->height = height;
+    slot->stride = width;
+    slot->format = FRAME_FORMAT_BGRA8;
+    slot->frameNumber = frameNumber;
+    slot->submitNs = submitNs;
+    slot->publishNs = FrameRing_NowNs();
+
+    uint64_t sequence = (slot->sequence.load(std::memory_order_relaxed) + 1) / 2;
+    slot->sequence.store(sequence * 2, std::memory_order_release);
+
+    FrameRingHeader *header = ring->header;
+    header->published.store(sequence, std::memory_order_release);
+    // seq_cst so the waiters load below can't move before the store: a
+    // reader registering meanwhile either sees the new value or is woken
+    header->futex.store((uint32_t)sequence, std::memory_order_seq_cst);
+#ifdef __linux__
+    if (header->waiters.load(std::memory_order_seq_cst) > 0) {
+        syscall(SYS_futex, (uint32_t *)&header->futex, FUTEX_WAKE, INT_MAX,
+                nullptr, nullptr, 0);
+    }
+#endif
+}
+
+bool FrameRingReader_Open(FrameRingReader *reader, const char *name) {
+    *reader = {.fd = -1};
+
+    // Read-write, waiting updates FrameRingHeader::waiters
+    reader->fd = shm_open(name, O_RDWR, 0);
+    if (reader->fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0 ||
+        (size_t)st.st_size < sizeof(FrameRingHeader)) {
+        FrameRingReader_Close(reader);
+        return false;
+    }
+    reader->size = st.st_size;
+    reader->base = mmap(nullptr, reader->size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED, reader->fd, 0);
+    if (reader->base == MAP_FAILED) {
+        reader->base = nullptr;
+        FrameRingReader_Close(reader);
+        return false;
+    }
+
+    const FrameRingHeader *header = (const FrameRingHeader *)reader->base;
+    bool valid = header->magic == FRAME_RING_MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!valid || header->version != FRAME_RING_VERSION ||
+        reader->size < FrameRing_PageAlign(sizeof(FrameRingHeader)) +
+                           header->numSlots * header->slotSize) {
+        FrameRingReader_Close(reader);
+        return false;
+    }
+
+    reader->header = header;
+    reader->lastSequence = header->published.load(std::memory_order_acquire);
+    return true;
+}
+
+void FrameRingReader_Close(FrameRingReader *reader) {
+    if (reader == nullptr) {
+        return;
+    }
+
+    if (reader->base != nullptr) {
+        munmap(reader->base, reader->size);
+    }
+    if (reader->fd >= 0) {
+        close(reader->fd);
+    }
+    *reader = {.fd = -1};
+}
+
+bool FrameRingReader_Wait(FrameRingReader *reader, int timeoutMs,
+                          FrameView *view) {
+    FrameRingHeader *header = (FrameRingHeader *)reader->header;
+    uint64_t deadline = FrameRing_NowNs() + (uint64_t)timeoutMs * 1000000ull;
+
+    for (;;) {
+        uint32_t futex = header->futex.load(std::memory_order_acquire);
+        uint64_t sequence = header->published.load(std::memory_order_acquire);
+
+        if (sequence > reader->lastSequence) {
+            const FrameSlotHeader *slot =
+                FrameRing_Slot(header, (sequence - 1) % header->numSlots);
+            // Already being rewritten when the consumer fell a whole ring
+            // behind; the next publish is close
+            if (slot->sequence.load(std::memory_order_acquire) ==
+                sequence * 2) {
+                *view = {
+                    .slot = slot,
+                    .pixels = (const uint32_t *)((const unsigned char *)slot +
+                                                 header->pixelOffset),
+                    .sequence = sequence,
+                    .width = slot->width,
+                    .height = slot->height,
+                    .stride = slot->stride,
+                    .frameNumber = slot->frameNumber,
+                    .submitNs = slot->submitNs,
+                    .publishNs = slot->publishNs,
+                };
+                reader->lastSequence = sequence;
+                return true;
+            }
+        }
+
+        uint64_t now = FrameRing_NowNs();
+        if (now >= deadline) {
+            return false;
+        }
+
+#ifdef __linux__
+        uint64_t remaining = deadline - now;
+        timespec timeout = {(time_t)(remaining / 1000000000ull),
+                            (long)(remaining % 1000000000ull)};
+        header->waiters.fetch_add(1, std::memory_order_seq_cst);
+        // Returns right away if a frame was published since futex was read
+        syscall(SYS_futex, (uint32_t *)&header->futex, FUTEX_WAIT, futex,
+                &timeout, nullptr, 0);
+        header->waiters.fetch_sub(1, std::memory_order_seq_cst);
+#else
+        (void)futex;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+    }
+}
+
+bool FrameRingReader_Valid(const FrameRingReader *reader,
+                           const FrameView *view) {
+    (void)reader;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view->slot->sequence.load(std::memory_order_relaxed) ==
+           view->sequence * 2;
+}
@@ -0,0 +1,120 @@
+#ifndef FRAMERING_H_
+#define FRAMERING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Frames shared with other processes through a named POSIX shared memory
+// segment: a header followed by a ring of slots the renderer rasterizes into
+// directly. Consumers map the segment and read the pixels in place. On Linux
+// they sleep on a futex in the header until the next frame is published,
+// elsewhere they poll it.
+
+const uint32_t FRAME_RING_MAGIC = 0x464D5252; // "RRMF"
+const uint32_t FRAME_RING_VERSION = 2;
+const int FRAME_RING_SLOTS = 4;
+const int FRAME_RING_MAX_SLOTS = 16;
+
+enum FrameFormat {
+    // 32-bit pixels 0xAARRGGBB, so B, G, R, A in memory on little endian
+    FRAME_FORMAT_BGRA8 = 1,
+};
+
+// Start of the segment. Written by the producer only, except waiters
+struct FrameRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numSlots;
+    uint32_t maxWidth, maxHeight;
+    // Bytes from the start of one slot to the next, and from a slot to its
+    // pixels
+    uint64_t slotSize;
+    uint64_t pixelOffset;
+    // Sequence number of the newest complete frame (0 before the first),
+    // its low 32 bits double as the futex word
+    std::atomic<uint64_t> published;
+    std::atomic<uint32_t> futex;
+    // Consumers sleeping on the futex, so publishing skips the wake
+    // syscall when nobody waits
+    std::atomic<uint32_t> waiters;
+    // Process that created the segment
+    int32_t producerPid;
+};
+
+// Start of every slot, the pixels follow at FrameRingHeader::pixelOffset.
+// sequence works as a seqlock: odd while the producer writes the slot, the
+// frame's sequence number (even) once it is complete
+struct FrameSlotHeader {
+    std::atomic<uint64_t> sequence;
+    uint32_t width, height;
+    // Pixels per row
+    uint32_t stride;
+    uint32_t format;
+    uint64_t frameNumber;
+    // CLOCK_MONOTONIC nanoseconds when the frame was submitted
+    // (Renderer_EndFrame) and when its slot was published
+    uint64_t submitNs;
+    uint64_t publishNs;
+};
+
+// Producer side, owned by the renderer (Renderer_EnableFrameExport)
+struct FrameRing {
+    char name[64];
+    int fd;
+    void *base;
+    size_t size;
+    FrameRingHeader *header;
+    // Frames begun, the next one goes to slot begun % numSlots
+    uint64_t begun;
+};
+
+// Consumer side
+struct FrameRingReader {
+    int fd;
+    void *base;
+    size_t size;
+    const FrameRingHeader *header;
+    // Sequence of the last frame returned by FrameRingReader_Wait
+    uint64_t lastSequence;
+};
+
+// A published frame, read in place from the ring
+struct FrameView {
+    const FrameSlotHeader *slot;
+    const uint32_t *pixels;
+    uint64_t sequence;
+    uint32_t width, height, stride;
+    uint64_t frameNumber;
+    uint64_t submitNs, publishNs;
+};
+
+uint64_t FrameRing_NowNs();
+
+// Creates the segment name, e.g. "/rasterizer", with numSlots slots of up
+// to maxWidth x maxHeight pixels. An existing segment is only replaced when
+// the process that created it is gone; otherwise this fails with EEXIST
+bool FrameRing_Create(FrameRing *ring, const char *name, int numSlots,
+                      int maxWidth, int maxHeight);
+// Unmaps and removes the segment
+void FrameRing_Destroy(FrameRing *ring);
+// Marks the next slot as being written and returns it. Its pixels stay
+// valid until numSlots more frames are begun
+FrameSlotHeader *FrameRing_Begin(FrameRing *ring);
+uint32_t *FrameRing_Pixels(FrameRing *ring, FrameSlotHeader *slot);
+// Completes slot and wakes waiting consumers
+void FrameRing_Publish(FrameRing *ring, FrameSlotHeader *slot, int width,
+                       int height, uint64_t frameNumber, uint64_t submitNs);
+
+bool FrameRingReader_Open(FrameRingReader *reader, const char *name);
+void FrameRingReader_Close(FrameRingReader *reader);
+// Waits up to timeoutMs for a frame newer than the last one returned and
+// fills view with the newest. Frames published in between are skipped
+bool FrameRingReader_Wait(FrameRingReader *reader, int timeoutMs,
+                          FrameView *view);
+// Whether the producer left view's slot alone while it was read. False
+// means the ring wrapped around and the pixels may be torn
+bool FrameRingReader_Valid(const FrameRingReader *reader,
+                           const FrameView *view);
+
+#endif
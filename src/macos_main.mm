@@ -1,7 +1,10 @@
 #include "camera.h"
 #include "math.h"
+#include "overlay.h"
 #include "renderer.h"
 #import <Cocoa/Cocoa.h>
+#include <algorithm>
+#include <cstdio>
 #include <mach/mach_time.h>
 
 static double frameTimes[60];
@@ -17,6 +20,8 @@ static double GetElapsedMs(uint64_t start, uint64_t end) {
 }
 
 static Renderer gRenderer;
+static Texture gCheckerTexture;
+static Overlay gOverlay;
 
 static struct {
   BOOL w, a, s, d;
@@ -113,8 +118,8 @@ static struct {
 
   CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
   CGContextRef ctx = CGBitmapContextCreate(
-      gRenderer.pixels, gRenderer.width, gRenderer.height, 8,
-      gRenderer.width * 4, colorSpace,
+      gRenderer.outputPixels, gRenderer.outputWidth, gRenderer.outputHeight,
+      8, gRenderer.outputWidth * 4, colorSpace,
       kCGImageAlphaPremultipliedFirst | kCGBitmapByteOrder32Little);
 
   CGImageRef image = CGBitmapContextCreateImage(ctx);
@@ -144,10 +149,29 @@ static struct {
   const int w = 800, h = 600, pixelSize = 1;
   // const int w = 200, h = 150, pixelSize = 4;
 
-  gRenderer = Renderer_Create(w, h, pixelSize);
+  // 1 = no anti-aliasing, 4 = 4x MSAA
+  const int samples = 4;
+
+  gRenderer = Renderer_Create(w, h, pixelSize, samples);
+
+  // Let the internal resolution follow a 60 FPS budget (down to 1/4 of the
+  // output size), upscaled to w x h for presentation
+  const bool dynamicResolution = true;
+  if (dynamicResolution) {
+    Renderer_EnableDynamicResolution(&gRenderer, 1000.0f / 60.0f, 0.25f, 1.0f);
+  }
+
+  // Record the next frame while the previous one is rasterized on the
+  // render workers. Presentation always shows the last completed frame
+  const int framesInFlight = 2;
+  if (framesInFlight > 1) {
+    Renderer_EnablePipelining(&gRenderer, framesInFlight);
+  }
   gRenderer.camera =
       Camera_Create(Vec3{0.0f, 0.0f, 2.0f}, Vec3{0.0f, 1.0f, 0.0f}, YAW, PITCH);
 
+  gCheckerTexture = Texture_CreateChecker(256, 8, 0xFFFFFFFF, 0xFF808080);
+
   NSRect frame =
       NSMakeRect(100, 100, gRenderer.windowWidth, gRenderer.windowHeight);
   window = [[NSWindow alloc]
@@ -197,14 +221,16 @@ static struct {
   uint64_t start = mach_absolute_time();
 
   // Renderer
+  Renderer_BeginFrame(&gRenderer);
   Renderer_ClearBackground(&gRenderer, 0x101010);
 
   Vec3 position = Vec3{0.0f, 0.0f, 0.0f};
   // Vec3 rotation = Vec3{0.0f, 0.0f, 0.0f};
   Vec3 rotation = Vec3{0.0f, t * 40.f, t * 20.0f};
   Vec3 scale = Vec3{1.0f, 1.0f, 1.0f};
-  ColorRGBA color = ColorRGBA{1.0f, 0.3f, 0.1f};
-  Renderer_DrawCube(&gRenderer, position, rotation, scale, color);
+  ColorRGBA color = ColorRGBA{1.0f, 0.3f, 0.1f, 1.0f};
+  Renderer_DrawCube(&gRenderer, position, rotation, scale, color,
+                    &gCheckerTexture);
 
   position = Vec3{-1.0f, 0.0f, 0.0f};
   // rotation = Vec3{0.0f, 0.0f, 0.0f};
@@ -224,8 +250,26 @@ static struct {
   color = ColorRGBA{0.0f, 0.0f, 1.0f};
   Renderer_DrawCube(&gRenderer, position, rotation, scale, color);
 
+  Renderer_EndFrame(&gRenderer);
+
   uint64_t end = mach_absolute_time();
 
+  // With pipelining the frame cost is the slower of the two stages
+  float frameMs = std::max((float)GetElapsedMs(start, end),
+                           gRenderer.presentTarget->rasterMs);
+  Renderer_UpdateDynamicResolution(&gRenderer, frameMs);
+  Renderer_Upscale(&gRenderer);
+
+  // Stats HUD on the presented image
+  char hud[64];
+  snprintf(hud, sizeof(hud), "%.2f MS\n%dx%d", frameMs, gRenderer.width,
+           gRenderer.height);
+  Overlay_Begin(&gOverlay, gRenderer.outputWidth, gRenderer.outputHeight);
+  Overlay_FillRect(&gOverlay, Vec2{2.0f, 2.0f}, Vec2{54.0f, 18.0f},
+                   0xFF000000);
+  Overlay_DrawText(&gOverlay, Vec2{4.0f, 4.0f}, hud, 0xFFFFFF00);
+  Overlay_Render(&gOverlay, gRenderer.outputPixels);
+
   frameTimes[frameIndex] = GetElapsedMs(start, end);
   frameIndex = (frameIndex + 1) % 60;
 
@@ -234,7 +278,8 @@ static struct {
     for (int i = 0; i < 60; i++)
       avg += frameTimes[i];
     avg /= 60.0;
-    printf("Avg render: %.3f ms (%.1f FPS)\n", avg, 1000.0 / avg);
+    printf("Avg render: %.3f ms (%.1f FPS) at %dx%d\n", avg, 1000.0 / avg,
+           gRenderer.width, gRenderer.height);
   }
 
   [view setNeedsDisplay:YES];
@@ -242,6 +287,7 @@ static struct {
 
 - (void)applicationWillTerminate:(NSNotification *)notification {
   Renderer_Destroy(&gRenderer);
+  Texture_Destroy(&gCheckerTexture);
 }
 
 - (BOOL)applicationShouldTerminateAfterLastWindowClosed:
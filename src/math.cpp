@@ -281,82 +281,82 @@ Mat4 Mat4_Transpose(Mat4 mat4) {
     return result;
 }
 
-float Vec3_Mag(Vec3 vec3) {
-    return sqrtf(vec3.x * vec3.x + vec3.y * vec3.y + vec3.z * vec3.z);
-}
-
-Vec3 Vec3_ScalarMult(Vec3 vec3, float value) {
-    return {vec3.x * value, vec3.y * value, vec3.z * value};
-}
-
-Vec3 Vec3_ScalarDivide(Vec3 vec3, float value) {
-    return {vec3.x / value, vec3.y / value, vec3.z / value};
-}
+Frustum Frustum_FromMatrix(Mat4 viewProj) {
+    float *m = viewProj.data;
+    Frustum frustum;
+
+    // Vec4_Transform multiplies a row vector, so clip coordinate j is the
+    // dot product with column j
+    Vec4 col[4];
+    for (int j = 0; j < 4; j++) {
+        col[j] = {m[j], m[4 + j], m[8 + j], m[12 + j]};
+    }
 
-Vec3 Vec3_Mult(Vec3 a, Vec3 b) {
-    return {a.x * b.x, a.y * b.y, a.z * b.z};
-}
+    for (int i = 0; i < 3; i++) {
+        Vec4 c = col[i];
+        frustum.planes[i * 2] = {col[3].x + c.x, col[3].y + c.y,
+                                 col[3].z + c.z, col[3].w + c.w};
+        frustum.planes[i * 2 + 1] = {col[3].x - c.x, col[3].y - c.y,
+                                     col[3].z - c.z, col[3].w - c.w};
+    }
 
-Vec3 Vec3_Subtract(Vec3 a, Vec3 b) {
-    return {a.x - b.x, a.y - b.y, a.z - b.z};
-}
+    for (Vec4 &p : frustum.planes) {
+        float mag = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        p = {p.x / mag, p.y / mag, p.z / mag, p.w / mag};
+    }
 
-Vec3 Vec3_Add(Vec3 a, Vec3 b) {
-    return {a.x + b.x, a.y + b.y, a.z + b.z};
+    return frustum;
 }
 
-Vec3 Vec3_Normalize(Vec3 vec3) {
-    float mag = Vec3_Mag(vec3);
-
-    if (mag == 0.0f) {
-        return vec3;
+bool Frustum_TestSphere(const Frustum *frustum, Vec3 center, float radius) {
+    for (const Vec4 &p : frustum->planes) {
+        if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius) {
+            return false;
+        }
     }
 
-    return Vec3_ScalarDivide(vec3, mag);
+    return true;
 }
 
-float Vec3_Dot(Vec3 a, Vec3 b) {
-    return a.x * b.x + a.y * b.y + a.z * b.z;
-}
-
-Vec3 Vec3_Cross(Vec3 a, Vec3 b) {
-    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
-            a.x * b.y - a.y * b.x};
-}
+bool Frustum_TestAABB(const Frustum *frustum, Vec3 min, Vec3 max) {
+    for (const Vec4 &p : frustum->planes) {
+        // Corner furthest along the plane normal
+        Vec3 v = {p.x > 0 ? max.x : min.x, p.y > 0 ? max.y : min.y,
+                  p.z > 0 ? max.z : min.z};
+        if (p.x * v.x + p.y * v.y + p.z * v.z + p.w < 0) {
+            return false;
+        }
+    }
 
-Vec3 Vec3_Reflect(Vec3 incident, Vec3 normal) {
-    float d = Vec3_Dot(normal, incident);
-    return (Vec3){incident.x - 2.0f * d * normal.x,
-                  incident.y - 2.0f * d * normal.y,
-                  incident.z - 2.0f * d * normal.z};
+    return true;
 }
 
-Vec4 Vec4_Transform(Vec4 vec4, Mat4 mat4) {
-    float *m = mat4.data;
-
-    Vec4 result = {
-        vec4.x * m[0] + vec4.y * m[4] + vec4.z * m[8] + vec4.w * m[12],
-        vec4.x * m[1] + vec4.y * m[5] + vec4.z * m[9] + vec4.w * m[13],
-        vec4.x * m[2] + vec4.y * m[6] + vec4.z * m[10] + vec4.w * m[14],
-        vec4.x * m[3] + vec4.y * m[7] + vec4.z * m[11] + vec4.w * m[15],
+void Mat4_TransformAABB(Mat4 model, Vec3 min, Vec3 max, Vec3 *outMin,
+                        Vec3 *outMax) {
+    const float *m = model.data;
+    Vec3 c = Vec3_ScalarMult(Vec3_Add(min, max), 0.5f);
+    Vec3 e = Vec3_ScalarMult(Vec3_Subtract(max, min), 0.5f);
+
+    // Transformed center plus the extents projected on each world axis
+    Vec3 center = {
+        m[0] * c.x + m[1] * c.y + m[2] * c.z + m[3],
+        m[4] * c.x + m[5] * c.y + m[6] * c.z + m[7],
+        m[8] * c.x + m[9] * c.y + m[10] * c.z + m[11],
+    };
+    Vec3 extent = {
+        fabsf(m[0]) * e.x + fabsf(m[1]) * e.y + fabsf(m[2]) * e.z,
+        fabsf(m[4]) * e.x + fabsf(m[5]) * e.y + fabsf(m[6]) * e.z,
+        fabsf(m[8]) * e.x + fabsf(m[9]) * e.y + fabsf(m[10]) * e.z,
     };
 
-    return result;
+    *outMin = Vec3_Subtract(center, extent);
+    *outMax = Vec3_Add(center, extent);
 }
 
 float DegToRadians(float deg) {
     return deg * PI / 180.0f;
 }
 
-uint32_t ColorRGBAToInt(ColorRGBA color) {
-    uint8_t red = static_cast<uint8_t>(std::min(color.r * 255.0f, 255.0f));
-    uint8_t green = static_cast<uint8_t>(std::min(color.g * 255.0f, 255.0f));
-    uint8_t blue = static_cast<uint8_t>(std::min(color.b * 255.0f, 255.0f));
-    uint8_t alpha = static_cast<uint8_t>(std::min(color.a * 255.0f, 255.0f));
-
-    return (alpha << 24) | (red << 16) | (green << 8) | blue;
-}
-
 float LinearToSRGB(float linear) {
     if (linear <= 0.0031308f) {
         return 12.92f * linear;
@@ -390,17 +390,3 @@ ColorRGBA ColorToLinear(ColorRGBA sRGB) {
         .a = sRGB.a,
     };
 }
-
-ColorRGBA LerpRGB(ColorRGBA c1, ColorRGBA c2, float t) {
-    float r = c1.r + (c2.r - c1.r) * t;
-    float g = c1.g + (c2.g - c1.g) * t;
-    float b = c1.b + (c2.b - c1.b) * t;
-
-    return {r, g, b, 1.0f};
-}
-
-float LerpFloat(float f1, float f2, float t) {
-    float r = f1 + (f2 - f1) * t;
-
-    return r;
-}
@@ -1,6 +1,8 @@
 #ifndef MATH_H_
 #define MATH_H_
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
 
 const float PI = 3.141592653589793;
@@ -34,6 +36,12 @@ struct Mat4 {
     float data[4 * 4];
 };
 
+// Six planes (a, b, c, d) with normals pointing inside: left, right, bottom,
+// top, near, far
+struct Frustum {
+    Vec4 planes[6];
+};
+
 Mat4 Mat4_Create();
 Mat4 Mat4_Mult(Mat4 matA, Mat4 matB);
 Mat4 Mat4_Translate(Mat4 mat4, Vec3 vec3);
@@ -48,25 +56,106 @@ Mat4 Mat4_Ortho(float left, float right, float bottom, float top, float zNear,
                 float zFar);
 Mat4 Mat4_LookAt(Vec3 eye, Vec3 target, Vec3 up);
 
-Vec3 Vec3_ScalarMult(Vec3 vec3, float value);
-Vec3 Vec3_ScalarDivide(Vec3 vec3, float value);
-Vec3 Vec3_Normalize(Vec3 vec3);
-Vec3 Vec3_Subtract(Vec3 a, Vec3 b);
-Vec3 Vec3_Add(Vec3 a, Vec3 b);
-Vec3 Vec3_Mult(Vec3 a, Vec3 b);
-float Vec3_Mag(Vec3 vec3);
-float Vec3_Dot(Vec3 a, Vec3 b);
-Vec3 Vec3_Cross(Vec3 a, Vec3 b);
-Vec3 Vec3_Reflect(Vec3 incident, Vec3 normal);
+// The Vec3 functions, ColorRGBAToInt and the lerps are inline so the
+// renderer's instruction set variants (see RendererIsa) compile them too
+// rather than calling the generic build out of line
+inline float Vec3_Mag(Vec3 vec3) {
+    return sqrtf(vec3.x * vec3.x + vec3.y * vec3.y + vec3.z * vec3.z);
+}
+
+inline Vec3 Vec3_ScalarMult(Vec3 vec3, float value) {
+    return {vec3.x * value, vec3.y * value, vec3.z * value};
+}
+
+inline Vec3 Vec3_ScalarDivide(Vec3 vec3, float value) {
+    return {vec3.x / value, vec3.y / value, vec3.z / value};
+}
+
+inline Vec3 Vec3_Mult(Vec3 a, Vec3 b) {
+    return {a.x * b.x, a.y * b.y, a.z * b.z};
+}
+
+inline Vec3 Vec3_Subtract(Vec3 a, Vec3 b) {
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+inline Vec3 Vec3_Add(Vec3 a, Vec3 b) {
+    return {a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+inline Vec3 Vec3_Normalize(Vec3 vec3) {
+    float mag = Vec3_Mag(vec3);
+
+    if (mag == 0.0f) {
+        return vec3;
+    }
+
+    return Vec3_ScalarDivide(vec3, mag);
+}
+
+inline float Vec3_Dot(Vec3 a, Vec3 b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
 
-Vec4 Vec4_Transform(Vec4 vec4, Mat4 mat4);
+inline Vec3 Vec3_Cross(Vec3 a, Vec3 b) {
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+            a.x * b.y - a.y * b.x};
+}
+
+inline Vec3 Vec3_Reflect(Vec3 incident, Vec3 normal) {
+    float d = Vec3_Dot(normal, incident);
+    return (Vec3){incident.x - 2.0f * d * normal.x,
+                  incident.y - 2.0f * d * normal.y,
+                  incident.z - 2.0f * d * normal.z};
+}
+
+inline Vec4 Vec4_Transform(Vec4 vec4, Mat4 mat4) {
+    const float *m = mat4.data;
+
+    return {
+        vec4.x * m[0] + vec4.y * m[4] + vec4.z * m[8] + vec4.w * m[12],
+        vec4.x * m[1] + vec4.y * m[5] + vec4.z * m[9] + vec4.w * m[13],
+        vec4.x * m[2] + vec4.y * m[6] + vec4.z * m[10] + vec4.w * m[14],
+        vec4.x * m[3] + vec4.y * m[7] + vec4.z * m[11] + vec4.w * m[15],
+    };
+}
+
+// Extracts the frustum from a matrix used as Vec4_Transform(p, viewProj)
+Frustum Frustum_FromMatrix(Mat4 viewProj);
+bool Frustum_TestSphere(const Frustum *frustum, Vec3 center, float radius);
+bool Frustum_TestAABB(const Frustum *frustum, Vec3 min, Vec3 max);
+
+// World bounds of the box min..max under a model matrix in the
+// Mat4_Translate/Rotate/Scale layout (translation in the last column)
+void Mat4_TransformAABB(Mat4 model, Vec3 min, Vec3 max, Vec3 *outMin,
+                        Vec3 *outMax);
 
 float DegToRadians(float deg);
 
-uint32_t ColorRGBAToInt(ColorRGBA color);
+inline uint32_t ColorRGBAToInt(ColorRGBA color) {
+    uint8_t red = static_cast<uint8_t>(std::min(color.r * 255.0f, 255.0f));
+    uint8_t green = static_cast<uint8_t>(std::min(color.g * 255.0f, 255.0f));
+    uint8_t blue = static_cast<uint8_t>(std::min(color.b * 255.0f, 255.0f));
+    uint8_t alpha = static_cast<uint8_t>(std::min(color.a * 255.0f, 255.0f));
+
+    return (alpha << 24) | (red << 16) | (green << 8) | blue;
+}
+
 ColorRGBA ColorToSRGB(ColorRGBA linear);
 ColorRGBA SRGBToLinear(ColorRGBA sRGB);
-ColorRGBA LerpRGB(ColorRGBA c1, ColorRGBA c2, float t);
-float LerpFloat(float f1, float f2, float t);
+
+inline ColorRGBA LerpRGB(ColorRGBA c1, ColorRGBA c2, float t) {
+    float r = c1.r + (c2.r - c1.r) * t;
+    float g = c1.g + (c2.g - c1.g) * t;
+    float b = c1.b + (c2.b - c1.b) * t;
+
+    return {r, g, b, 1.0f};
+}
+
+inline float LerpFloat(float f1, float f2, float t) {
+    float r = f1 + (f2 - f1) * t;
+
+    return r;
+}
 
 #endif
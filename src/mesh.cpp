@@ -0,0 +1,673 @@
+#include "mesh.h"
+#include "renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+Mesh Mesh_Create(const float *vertices, int numVertices, int vertexSize) {
+    Mesh mesh = {
+        .vertices = std::vector<float>(vertices,
+                                       vertices + numVertices * vertexSize),
+        .numVertices = (uint32_t)numVertices,
+        .vertexSize = (uint32_t)vertexSize,
+    };
+
+    if (numVertices == 0) {
+        return mesh;
+    }
+
+    // Sphere around the bounding box center
+    Vec3 min = {vertices[0], vertices[1], vertices[2]};
+    Vec3 max = min;
+    for (int i = 0; i < numVertices * vertexSize; i += vertexSize) {
+        min = {std::min(min.x, vertices[i]), std::min(min.y, vertices[i + 1]),
+               std::min(min.z, vertices[i + 2])};
+        max = {std::max(max.x, vertices[i]), std::max(max.y, vertices[i + 1]),
+               std::max(max.z, vertices[i + 2])};
+    }
+
+    mesh.min = min;
+    mesh.max = max;
+    mesh.center = Vec3_ScalarMult(Vec3_Add(min, max), 0.5f);
+    for (int i = 0; i < numVertices * vertexSize; i += vertexSize) {
+        Vec3 p = {vertices[i], vertices[i + 1], vertices[i + 2]};
+        mesh.radius =
+            std::max(mesh.radius, Vec3_Mag(Vec3_Subtract(p, mesh.center)));
+    }
+
+    return mesh;
+}
+
+// Sphere of local center and radius under model
+static void Mesh_TransformSphere(Vec3 c, float localRadius, Mat4 model,
+                                 Vec3 *center, float *radius) {
+    const float *m = model.data;
+
+    *center = {
+        m[0] * c.x + m[1] * c.y + m[2] * c.z + m[3],
+        m[4] * c.x + m[5] * c.y + m[6] * c.z + m[7],
+        m[8] * c.x + m[9] * c.y + m[10] * c.z + m[11],
+    };
+    // Largest axis scale keeps the sphere conservative
+    *radius = localRadius * std::max({
+                                Vec3_Mag({m[0], m[4], m[8]}),
+                                Vec3_Mag({m[1], m[5], m[9]}),
+                                Vec3_Mag({m[2], m[6], m[10]}),
+                            });
+}
+
+void Mesh_WorldSphere(const Mesh *mesh, Mat4 model, Vec3 *center,
+                      float *radius) {
+    Mesh_TransformSphere(mesh->center, mesh->radius, model, center, radius);
+}
+
+void Mesh_WorldSphere(const PackedMesh *mesh, Mat4 model, Vec3 *center,
+                      float *radius) {
+    Mesh_TransformSphere(mesh->center, mesh->radius, model, center, radius);
+}
+
+Mesh Mesh_CreateCube() {
+    CubeMesh cube = CreateCubeMesh();
+    return Mesh_Create(cube.vertices, cube.numVertices, cube.vertexSize);
+}
+
+Mesh Mesh_CreateQuad() {
+    QuadMesh quad = CreateQuadMesh();
+    return Mesh_Create(quad.vertices, quad.numVertices, quad.vertexSize);
+}
+
+Mesh Mesh_CreateSphere(int segments, int rings) {
+    std::vector<float> vertices;
+
+    auto pushVertex = [&](int segment, int ring) {
+        float theta = 2.0f * PI * segment / segments;
+        float phi = PI * ring / rings;
+        Vec3 n = {sinf(phi) * cosf(theta), cosf(phi), sinf(phi) * sinf(theta)};
+        vertices.insert(vertices.end(),
+                        {n.x * 0.5f, n.y * 0.5f, n.z * 0.5f, n.x, n.y, n.z,
+                         (float)segment / segments, (float)ring / rings});
+    };
+
+    for (int ring = 0; ring < rings; ring++) {
+        for (int segment = 0; segment < segments; segment++) {
+            // The quads touching the poles collapse into one triangle
+            if (ring > 0) {
+                pushVertex(segment, ring);
+                pushVertex(segment + 1, ring);
+                pushVertex(segment + 1, ring + 1);
+            }
+            if (ring < rings - 1) {
+                pushVertex(segment, ring);
+                pushVertex(segment + 1, ring + 1);
+                pushVertex(segment, ring + 1);
+            }
+        }
+    }
+
+    return Mesh_Create(vertices.data(), vertices.size() / 8, 8);
+}
+
+// Symmetric 4x4 error quadric, upper triangle row by row
+struct Quadric {
+    double q[10];
+};
+
+static Quadric Quadric_FromPlane(Vec3 n, float d, double weight) {
+    double a = n.x, b = n.y, c = n.z;
+    return Quadric{{a * a * weight, a * b * weight, a * c * weight,
+                    a * d * weight, b * b * weight, b * c * weight,
+                    b * d * weight, c * c * weight, c * d * weight,
+                    d * d * weight}};
+}
+
+static void Quadric_Add(Quadric *a, const Quadric &b) {
+    for (int i = 0; i < 10; i++) {
+        a->q[i] += b.q[i];
+    }
+}
+
+static double Quadric_Error(const Quadric &a, const Quadric &b, Vec3 p) {
+    double q[10];
+    for (int i = 0; i < 10; i++) {
+        q[i] = a.q[i] + b.q[i];
+    }
+
+    double x = p.x, y = p.y, z = p.z;
+    return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z +
+           2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+           q[7] * z * z + 2 * q[8] * z + q[9];
+}
+
+struct PositionKey {
+    float x, y, z;
+
+    bool operator==(const PositionKey &o) const {
+        return x == o.x && y == o.y && z == o.z;
+    }
+};
+
+// Adding 0.0f turns -0.0f into 0.0f, which == already takes as equal
+static uint32_t FloatKeyBits(float f) {
+    f += 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey &k) const {
+        return FloatKeyBits(k.x) * 73856093u ^ FloatKeyBits(k.y) * 19349663u ^
+               FloatKeyBits(k.z) * 83492791u;
+    }
+};
+
+// A source vertex compared by all its attributes
+struct VertexKey {
+    const float *v;
+    uint32_t size;
+
+    bool operator==(const VertexKey &o) const {
+        for (uint32_t k = 0; k < size; k++) {
+            if (v[k] != o.v[k]) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey &k) const {
+        uint32_t h = 2166136261u;
+        for (uint32_t i = 0; i < k.size; i++) {
+            h = (h ^ FloatKeyBits(k.v[i])) * 16777619u;
+        }
+        return h;
+    }
+};
+
+// Moves vertex `from` onto vertex `to`, lower cost first
+struct EdgeCollapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+
+    bool operator>(const EdgeCollapse &o) const { return cost > o.cost; }
+};
+
+Mesh Mesh_Simplify(const Mesh *mesh, uint32_t targetTriangles) {
+    const float *src = mesh->vertices.data();
+    uint32_t size = mesh->vertexSize;
+
+    // Weld vertices equal in every attribute, so each output corner keeps
+    // its own normal and UV. Where several welded vertices share a position
+    // (hard edges, UV seams) the edges between them are borders
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash> welded;
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> atPosition;
+    std::vector<uint32_t> source;
+    std::vector<Vec3> positions;
+    std::vector<uint32_t> indices(mesh->numVertices);
+    for (uint32_t i = 0; i < mesh->numVertices; i++) {
+        const float *v = &src[i * size];
+        auto inserted = welded.emplace(VertexKey{v, size},
+                                       (uint32_t)positions.size());
+        if (inserted.second) {
+            source.push_back(i);
+            positions.push_back(Vec3{v[0], v[1], v[2]});
+            atPosition[PositionKey{v[0], v[1], v[2]}]++;
+        }
+        indices[i] = inserted.first->second;
+    }
+
+    uint32_t numVertices = positions.size();
+    // Seam vertices never move, so the two sides of a seam can't drift
+    // apart and open cracks; others can still collapse onto them
+    std::vector<bool> locked(numVertices);
+    for (uint32_t i = 0; i < numVertices; i++) {
+        Vec3 p = positions[i];
+        locked[i] = atPosition[PositionKey{p.x, p.y, p.z}] > 1;
+    }
+    uint32_t numFaces = mesh->numVertices / 3;
+    std::vector<Quadric> quadrics(numVertices, Quadric{});
+    std::vector<std::vector<uint32_t>> vertexFaces(numVertices);
+    std::vector<bool> faceAlive(numFaces, false);
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    uint32_t liveFaces = 0;
+
+    auto faceNormal = [&](uint32_t a, uint32_t b, uint32_t c) {
+        return Vec3_Cross(Vec3_Subtract(positions[b], positions[a]),
+                          Vec3_Subtract(positions[c], positions[a]));
+    };
+    auto edgeKey = [](uint32_t a, uint32_t b) {
+        return (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+    };
+
+    for (uint32_t f = 0; f < numFaces; f++) {
+        uint32_t *t = &indices[f * 3];
+        Vec3 n = faceNormal(t[0], t[1], t[2]);
+        float mag = Vec3_Mag(n);
+        if (mag == 0.0f) {
+            continue;
+        }
+
+        faceAlive[f] = true;
+        liveFaces++;
+
+        // Planes weighted by area so small faces don't dominate
+        n = Vec3_ScalarDivide(n, mag);
+        Quadric plane = Quadric_FromPlane(n, -Vec3_Dot(n, positions[t[0]]),
+                                          mag * 0.5f);
+        for (int k = 0; k < 3; k++) {
+            Quadric_Add(&quadrics[t[k]], plane);
+            vertexFaces[t[k]].push_back(f);
+            edgeUses[edgeKey(t[k], t[(k + 1) % 3])]++;
+        }
+    }
+
+    // Open edges get a steep plane along the face normal so borders stay put
+    for (uint32_t f = 0; f < numFaces; f++) {
+        if (!faceAlive[f]) {
+            continue;
+        }
+        uint32_t *t = &indices[f * 3];
+        Vec3 n = Vec3_Normalize(faceNormal(t[0], t[1], t[2]));
+        for (int k = 0; k < 3; k++) {
+            uint32_t a = t[k], b = t[(k + 1) % 3];
+            if (edgeUses[edgeKey(a, b)] != 1) {
+                continue;
+            }
+            Vec3 edge = Vec3_Subtract(positions[b], positions[a]);
+            Vec3 side = Vec3_Normalize(Vec3_Cross(edge, n));
+            Quadric border = Quadric_FromPlane(
+                side, -Vec3_Dot(side, positions[a]),
+                1000.0 * Vec3_Dot(edge, edge));
+            Quadric_Add(&quadrics[a], border);
+            Quadric_Add(&quadrics[b], border);
+        }
+    }
+
+    std::vector<bool> vertexAlive(numVertices, true);
+    std::vector<uint32_t> versions(numVertices, 0);
+    std::priority_queue<EdgeCollapse, std::vector<EdgeCollapse>,
+                        std::greater<EdgeCollapse>>
+        heap;
+
+    auto pushEdge = [&](uint32_t a, uint32_t b) {
+        if (locked[a] && locked[b]) {
+            return;
+        }
+        double toB = Quadric_Error(quadrics[a], quadrics[b], positions[b]);
+        double toA = Quadric_Error(quadrics[a], quadrics[b], positions[a]);
+        if ((toB <= toA && !locked[a]) || locked[b]) {
+            heap.push(EdgeCollapse{toB, a, b, versions[a], versions[b]});
+        } else {
+            heap.push(EdgeCollapse{toA, b, a, versions[b], versions[a]});
+        }
+    };
+
+    for (const auto &edge : edgeUses) {
+        pushEdge(edge.first >> 32, edge.first & 0xffffffff);
+    }
+
+    std::vector<uint32_t> neighbors;
+    while (liveFaces > targetTriangles && !heap.empty()) {
+        EdgeCollapse c = heap.top();
+        heap.pop();
+        if (!vertexAlive[c.from] || !vertexAlive[c.to] ||
+            versions[c.from] != c.fromVersion ||
+            versions[c.to] != c.toVersion) {
+            continue;
+        }
+
+        // Reject collapses that would flip a face that survives them
+        bool flips = false;
+        for (uint32_t f : vertexFaces[c.from]) {
+            uint32_t *t = &indices[f * 3];
+            if (!faceAlive[f] || t[0] == c.to || t[1] == c.to ||
+                t[2] == c.to) {
+                continue;
+            }
+            Vec3 before = faceNormal(t[0], t[1], t[2]);
+            uint32_t moved[3];
+            for (int k = 0; k < 3; k++) {
+                moved[k] = t[k] == c.from ? c.to : t[k];
+            }
+            Vec3 after = faceNormal(moved[0], moved[1], moved[2]);
+            if (Vec3_Dot(before, after) <= 0.0f) {
+                flips = true;
+                break;
+            }
+        }
+        if (flips) {
+            continue;
+        }
+
+        for (uint32_t f : vertexFaces[c.from]) {
+            uint32_t *t = &indices[f * 3];
+            if (!faceAlive[f]) {
+                continue;
+            }
+            if (t[0] == c.to || t[1] == c.to || t[2] == c.to) {
+                faceAlive[f] = false;
+                liveFaces--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                t[k] = t[k] == c.from ? c.to : t[k];
+            }
+            vertexFaces[c.to].push_back(f);
+        }
+
+        vertexAlive[c.from] = false;
+        vertexFaces[c.from].clear();
+        Quadric_Add(&quadrics[c.to], quadrics[c.from]);
+        versions[c.to]++;
+
+        // Drop dead faces and requeue every edge around the merged vertex
+        std::vector<uint32_t> &faces = vertexFaces[c.to];
+        faces.erase(std::remove_if(faces.begin(), faces.end(),
+                                   [&](uint32_t f) { return !faceAlive[f]; }),
+                    faces.end());
+
+        neighbors.clear();
+        for (uint32_t f : faces) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[f * 3 + k];
+                if (v != c.to && std::find(neighbors.begin(), neighbors.end(),
+                                           v) == neighbors.end()) {
+                    neighbors.push_back(v);
+                }
+            }
+        }
+        for (uint32_t v : neighbors) {
+            pushEdge(c.to, v);
+        }
+    }
+
+    std::vector<float> vertices;
+    vertices.reserve(liveFaces * 3 * size);
+    for (uint32_t f = 0; f < numFaces; f++) {
+        if (!faceAlive[f]) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            const float *v = &src[source[indices[f * 3 + k]] * size];
+            vertices.insert(vertices.end(), v, v + size);
+        }
+    }
+
+    return Mesh_Create(vertices.data(), vertices.size() / size, size);
+}
+
+MeshLods MeshLods_Create(const Mesh *mesh, int numLevels) {
+    MeshLods lods = {};
+    lods.levels[0] = *mesh;
+    lods.numLevels = 1;
+
+    numLevels = std::min(numLevels, MESH_MAX_LODS);
+    while (lods.numLevels < numLevels) {
+        const Mesh &previous = lods.levels[lods.numLevels - 1];
+        uint32_t triangles = previous.numVertices / 3;
+
+        Mesh next = Mesh_Simplify(&previous, triangles / 2);
+        if (next.numVertices == 0 || next.numVertices / 3 > triangles * 9 / 10) {
+            break;
+        }
+        lods.levels[lods.numLevels++] = next;
+    }
+
+    return lods;
+}
+
+static uint32_t VertexLayout_PositionBytes(PositionFormat format) {
+    return format == POSITION_FLOAT32 ? 12 : 6;
+}
+
+static uint32_t VertexLayout_NormalBytes(NormalFormat format) {
+    switch (format) {
+    case NORMAL_FLOAT32:
+        return 12;
+    case NORMAL_OCT16:
+        return 4;
+    case NORMAL_OCT8:
+        return 2;
+    }
+    return 0;
+}
+
+static uint32_t VertexLayout_UVBytes(UVFormat format) {
+    switch (format) {
+    case UV_NONE:
+        return 0;
+    case UV_FLOAT32:
+        return 8;
+    case UV_UNORM16:
+        return 4;
+    }
+    return 0;
+}
+
+VertexLayout VertexLayout_Create(PositionFormat position, NormalFormat normal,
+                                 UVFormat uv, ColorFormat color) {
+    VertexLayout layout = {
+        .position = position,
+        .normal = normal,
+        .uv = uv,
+        .color = color,
+    };
+
+    layout.normalOffset = VertexLayout_PositionBytes(position);
+    layout.uvOffset = layout.normalOffset + VertexLayout_NormalBytes(normal);
+    layout.colorOffset = layout.uvOffset + VertexLayout_UVBytes(uv);
+    layout.stride = layout.colorOffset + (color == COLOR_UNORM8 ? 4 : 0);
+    // Keeps 16 and 32-bit values aligned from one vertex to the next
+    uint32_t alignment = position == POSITION_FLOAT32 ||
+                                 normal == NORMAL_FLOAT32 || uv == UV_FLOAT32
+                             ? 4
+                             : 2;
+    layout.stride = (layout.stride + alignment - 1) & ~(alignment - 1);
+
+    return layout;
+}
+
+Vec2 OctEncode(Vec3 n) {
+    float sum = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    Vec2 p = {n.x / sum, n.y / sum};
+    if (n.z < 0.0f) {
+        // Lower hemisphere folds over the diagonals
+        p = {(1.0f - std::fabs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+             (1.0f - std::fabs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f)};
+    }
+    return p;
+}
+
+// Octahedral snorm pair of maxValue steps closest in direction to n, out of
+// the four roundings of its encoding
+static void Mesh_QuantizeNormal(Vec3 n, int maxValue, int out[2]) {
+    Vec2 p = OctEncode(Vec3_Normalize(n));
+    float bestDot = -2.0f;
+    for (int i = 0; i < 4; i++) {
+        float x = p.x * maxValue;
+        float y = p.y * maxValue;
+        int q[2] = {
+            (int)(i & 1 ? std::ceil(x) : std::floor(x)),
+            (int)(i & 2 ? std::ceil(y) : std::floor(y)),
+        };
+        q[0] = std::clamp(q[0], -maxValue, maxValue);
+        q[1] = std::clamp(q[1], -maxValue, maxValue);
+
+        float dot = Vec3_Dot(
+            OctDecode((float)q[0] / maxValue, (float)q[1] / maxValue), n);
+        if (dot > bestDot) {
+            bestDot = dot;
+            out[0] = q[0];
+            out[1] = q[1];
+        }
+    }
+}
+
+static uint16_t Mesh_QuantizeUnorm16(float value, float offset, float scale) {
+    if (scale == 0.0f) {
+        return 0;
+    }
+    return (uint16_t)std::clamp(std::lround((value - offset) / scale), 0L,
+                                65535L);
+}
+
+static uint8_t Mesh_QuantizeUnorm8(float value) {
+    return (uint8_t)std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f);
+}
+
+PackedMesh Mesh_Pack(const Mesh *mesh, VertexLayout layout,
+                     const ColorRGBA *colors) {
+    PackedMesh packed = {
+        .vertices = std::vector<uint8_t>(mesh->numVertices * layout.stride),
+        .numVertices = mesh->numVertices,
+        .layout = layout,
+        .positionOffset = {},
+        .positionScale = {1.0f, 1.0f, 1.0f},
+        .uvOffset = {},
+        .uvScale = {1.0f, 1.0f},
+        .min = mesh->min,
+        .max = mesh->max,
+        .center = mesh->center,
+        .radius = mesh->radius,
+    };
+
+    const float *source = mesh->vertices.data();
+    uint32_t size = mesh->vertexSize;
+    bool hasUV = size >= 8;
+
+    if (layout.position == POSITION_UNORM16) {
+        packed.positionOffset = mesh->min;
+        packed.positionScale =
+            Vec3_ScalarDivide(Vec3_Subtract(mesh->max, mesh->min), 65535.0f);
+    }
+    if (layout.uv == UV_UNORM16 && hasUV && mesh->numVertices > 0) {
+        Vec2 uvMin = {source[6], source[7]};
+        Vec2 uvMax = uvMin;
+        for (uint32_t i = 0; i < mesh->numVertices; i++) {
+            const float *uv = source + i * size + 6;
+            uvMin = {std::min(uvMin.x, uv[0]), std::min(uvMin.y, uv[1])};
+            uvMax = {std::max(uvMax.x, uv[0]), std::max(uvMax.y, uv[1])};
+        }
+        packed.uvOffset = uvMin;
+        packed.uvScale = {(uvMax.x - uvMin.x) / 65535.0f,
+                          (uvMax.y - uvMin.y) / 65535.0f};
+    }
+
+    for (uint32_t i = 0; i < mesh->numVertices; i++) {
+        const float *v = source + i * size;
+        uint8_t *out = packed.vertices.data() + i * layout.stride;
+
+        if (layout.position == POSITION_FLOAT32) {
+            memcpy(out, v, 3 * sizeof(float));
+        } else {
+            uint16_t q[3] = {
+                Mesh_QuantizeUnorm16(v[0], packed.positionOffset.x,
+                                     packed.positionScale.x),
+                Mesh_QuantizeUnorm16(v[1], packed.positionOffset.y,
+                                     packed.positionScale.y),
+                Mesh_QuantizeUnorm16(v[2], packed.positionOffset.z,
+                                     packed.positionScale.z),
+            };
+            memcpy(out, q, sizeof(q));
+        }
+
+        uint8_t *normal = out + layout.normalOffset;
+        int q[2];
+        switch (layout.normal) {
+        case NORMAL_FLOAT32:
+            memcpy(normal, v + 3, 3 * sizeof(float));
+            break;
+        case NORMAL_OCT16: {
+            Mesh_QuantizeNormal({v[3], v[4], v[5]}, 32767, q);
+            int16_t oct[2] = {(int16_t)q[0], (int16_t)q[1]};
+            memcpy(normal, oct, sizeof(oct));
+            break;
+        }
+        case NORMAL_OCT8: {
+            Mesh_QuantizeNormal({v[3], v[4], v[5]}, 127, q);
+            int8_t oct[2] = {(int8_t)q[0], (int8_t)q[1]};
+            memcpy(normal, oct, sizeof(oct));
+            break;
+        }
+        }
+
+        uint8_t *uv = out + layout.uvOffset;
+        float u = hasUV ? v[6] : 0.0f;
+        float w = hasUV ? v[7] : 0.0f;
+        if (layout.uv == UV_FLOAT32) {
+            float values[2] = {u, w};
+            memcpy(uv, values, sizeof(values));
+        } else if (layout.uv == UV_UNORM16) {
+            uint16_t values[2] = {
+                Mesh_QuantizeUnorm16(u, packed.uvOffset.x, packed.uvScale.x),
+                Mesh_QuantizeUnorm16(w, packed.uvOffset.y, packed.uvScale.y),
+            };
+            memcpy(uv, values, sizeof(values));
+        }
+
+        if (layout.color == COLOR_UNORM8) {
+            ColorRGBA c = colors != nullptr ? colors[i] : ColorRGBA{1, 1, 1, 1};
+            uint8_t *color = out + layout.colorOffset;
+            color[0] = Mesh_QuantizeUnorm8(c.r);
+            color[1] = Mesh_QuantizeUnorm8(c.g);
+            color[2] = Mesh_QuantizeUnorm8(c.b);
+            color[3] = Mesh_QuantizeUnorm8(c.a);
+        }
+    }
+
+    return packed;
+}
+
+Mat4 PackedMesh_PositionDecode(const PackedMesh *mesh) {
+    Mat4 decode = Mat4_Create();
+    decode.data[0] = mesh->positionScale.x;
+    decode.data[5] = mesh->positionScale.y;
+    decode.data[10] = mesh->positionScale.z;
+    decode.data[12] = mesh->positionOffset.x;
+    decode.data[13] = mesh->positionOffset.y;
+    decode.data[14] = mesh->positionOffset.z;
+    return decode;
+}
+
+SkinnedMesh SkinnedMesh_Create(const Mesh *mesh, const uint8_t *bones,
+                               const float *weights, int numBones) {
+    size_t count = (size_t)mesh->numVertices * SKIN_MAX_INFLUENCES;
+    SkinnedMesh skinned = {
+        .mesh = *mesh,
+        .bones = std::vector<uint8_t>(bones, bones + count),
+        .weights = std::vector<float>(weights, weights + count),
+        .numBones = std::min(std::max(numBones, 1), SKIN_MAX_BONES),
+    };
+
+    for (size_t i = 0; i < count; i += SKIN_MAX_INFLUENCES) {
+        uint8_t *b = &skinned.bones[i];
+        float *w = &skinned.weights[i];
+
+        float sum = 0.0f;
+        for (int k = 0; k < SKIN_MAX_INFLUENCES; k++) {
+            // Out of range bones would read past the palette
+            if (b[k] >= skinned.numBones || !(w[k] > 0.0f)) {
+                b[k] = 0;
+                w[k] = 0.0f;
+            }
+            sum += w[k];
+        }
+
+        if (sum == 0.0f) {
+            w[0] = 1.0f;
+            continue;
+        }
+        for (int k = 0; k < SKIN_MAX_INFLUENCES; k++) {
+            w[k] /= sum;
+        }
+    }
+
+    return skinned;
+}
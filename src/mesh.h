@@ -0,0 +1,151 @@
+#ifndef MESH_H_
+#define MESH_H_
+
+#include "math.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Non-indexed triangle list in the Renderer_DrawTriangles layout (position +
+// normal, optionally + uv), with local bounds for culling
+struct Mesh {
+    std::vector<float> vertices;
+    uint32_t numVertices;
+    uint32_t vertexSize;
+    Vec3 min;
+    Vec3 max;
+    Vec3 center;
+    float radius;
+};
+
+const int MESH_MAX_LODS = 8;
+// Projected diameter in pixels below which level 1 takes over from level 0.
+// Every further level halves the triangles and the switch size by sqrt(2)
+const float MESH_LOD_DETAIL_PIXELS = 256.0f;
+// Fraction of a level the projected size has to move past a switch point
+// before the level changes, so objects at a switch distance don't pop
+const float MESH_LOD_HYSTERESIS = 0.25f;
+
+// Level 0 is the source mesh, each further level has about half of the
+// triangles of the previous one
+struct MeshLods {
+    int numLevels;
+    Mesh levels[MESH_MAX_LODS];
+};
+
+// Storage formats of the attributes of a PackedMesh vertex
+enum PositionFormat {
+    POSITION_FLOAT32, // 3 x float
+    POSITION_UNORM16, // 3 x 16 bits, normalized to the mesh bounds
+};
+
+enum NormalFormat {
+    NORMAL_FLOAT32, // 3 x float
+    NORMAL_OCT16,   // octahedral, 2 x 16 bits snorm
+    NORMAL_OCT8,    // octahedral, 2 x 8 bits snorm
+};
+
+enum UVFormat {
+    UV_NONE,
+    UV_FLOAT32, // 2 x float
+    UV_UNORM16, // 2 x 16 bits, normalized to the uv bounds
+};
+
+enum ColorFormat {
+    COLOR_NONE,
+    COLOR_UNORM8, // RGBA, 4 x 8 bits
+};
+
+// What every attribute of a vertex is stored as, and where
+struct VertexLayout {
+    PositionFormat position;
+    NormalFormat normal;
+    UVFormat uv;
+    ColorFormat color;
+    // Byte offsets in a vertex (positions come first) and the vertex size
+    uint32_t normalOffset;
+    uint32_t uvOffset;
+    uint32_t colorOffset;
+    uint32_t stride;
+};
+
+// Triangle list like Mesh with the vertices stored in a VertexLayout.
+// Quantized positions and uvs decode as offset + q * scale
+struct PackedMesh {
+    std::vector<uint8_t> vertices;
+    uint32_t numVertices;
+    VertexLayout layout;
+    Vec3 positionOffset, positionScale;
+    Vec2 uvOffset, uvScale;
+    // Bounds of the source mesh, as in Mesh
+    Vec3 min;
+    Vec3 max;
+    Vec3 center;
+    float radius;
+};
+
+// Bones one vertex of a SkinnedMesh blends, and most bones it can reference
+const int SKIN_MAX_INFLUENCES = 4;
+const int SKIN_MAX_BONES = 256;
+
+// Mesh deformed by a palette of bone matrices (linear blend skinning): each
+// vertex is moved by the weighted sum of up to SKIN_MAX_INFLUENCES bones
+struct SkinnedMesh {
+    // Bind pose
+    Mesh mesh;
+    // SKIN_MAX_INFLUENCES per vertex. Weights sum to 1, unused influences
+    // have weight 0
+    std::vector<uint8_t> bones;
+    std::vector<float> weights;
+    int numBones;
+};
+
+Mesh Mesh_Create(const float *vertices, int numVertices, int vertexSize);
+Mesh Mesh_CreateCube();
+Mesh Mesh_CreateQuad();
+// Bounding sphere in world space for a Mat4_Translate/Rotate/Scale matrix
+void Mesh_WorldSphere(const Mesh *mesh, Mat4 model, Vec3 *center,
+                      float *radius);
+void Mesh_WorldSphere(const PackedMesh *mesh, Mat4 model, Vec3 *center,
+                      float *radius);
+// UV sphere of diameter 1 with normals and uvs
+Mesh Mesh_CreateSphere(int segments, int rings);
+// Quadric error edge collapse down to about targetTriangles. Vertices are
+// welded where all attributes match and collapsed onto one of the edge
+// endpoints, so the result keeps the attributes of the source vertices.
+// Hard edges and UV seams stay where they are
+Mesh Mesh_Simplify(const Mesh *mesh, uint32_t targetTriangles);
+// Stops early once simplification no longer removes triangles
+MeshLods MeshLods_Create(const Mesh *mesh, int numLevels);
+
+VertexLayout VertexLayout_Create(PositionFormat position, NormalFormat normal,
+                                 UVFormat uv = UV_NONE,
+                                 ColorFormat color = COLOR_NONE);
+// Encodes the vertices of mesh in layout. colors holds one color per vertex
+// for layouts with a color (white when null); uvs of meshes without them are
+// stored as 0
+PackedMesh Mesh_Pack(const Mesh *mesh, VertexLayout layout,
+                     const ColorRGBA *colors = nullptr);
+// Matrix decoding the stored positions of mesh to local space, in the
+// Vec4_Transform convention (identity for float positions)
+Mat4 PackedMesh_PositionDecode(const PackedMesh *mesh);
+
+// Binds the vertices of mesh to bones: SKIN_MAX_INFLUENCES bone indices
+// (below numBones) and weights per vertex. Weights are normalized, vertices
+// without any are bound to bone 0
+SkinnedMesh SkinnedMesh_Create(const Mesh *mesh, const uint8_t *bones,
+                               const float *weights, int numBones);
+
+// Octahedral normal encoding: the unit sphere is folded onto the square
+// [-1, 1]^2, so two values hold a direction
+Vec2 OctEncode(Vec3 normal);
+inline Vec3 OctDecode(float x, float y) {
+    Vec3 n = {x, y, 1.0f - std::fabs(x) - std::fabs(y)};
+    float t = n.z < 0.0f ? -n.z : 0.0f;
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    float invLength = 1.0f / std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+    return {n.x * invLength, n.y * invLength, n.z * invLength};
+}
+
+#endif
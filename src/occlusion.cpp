@@ -0,0 +1,194 @@
+#include "occlusion.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+OcclusionBuffer OcclusionBuffer_Create(int renderWidth, int renderHeight) {
+    OcclusionBuffer ob = {};
+
+    int w = OCCLUSION_WIDTH;
+    int h = std::max(1, OCCLUSION_WIDTH * renderHeight / renderWidth);
+    while (ob.numLevels < OCCLUSION_MAX_LEVELS) {
+        OcclusionLevel &level = ob.levels[ob.numLevels++];
+        level.width = w;
+        level.height = h;
+        level.depth.assign(w * h, 1.0f);
+
+        if (w == 1 && h == 1) {
+            break;
+        }
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+
+    return ob;
+}
+
+void Occlusion_Begin(OcclusionBuffer *ob, Mat4 viewProj) {
+    ob->viewProj = viewProj;
+    ob->stats = {};
+    std::fill(ob->levels[0].depth.begin(), ob->levels[0].depth.end(), 1.0f);
+}
+
+// Clip -> level 0 screen space, same mapping as Renderer_TransformTriangles
+static Vec3 Occlusion_ToScreen(const OcclusionBuffer *ob, Vec4 clip) {
+    const OcclusionLevel &level = ob->levels[0];
+    return Vec3{
+        level.width * 0.5f * (clip.x / clip.w + 1.0f),
+        level.height * 0.5f * (1.0f - clip.y / clip.w),
+        (clip.z / clip.w + 1.0f) * 0.5f,
+    };
+}
+
+static void Occlusion_RasterizeTriangle(OcclusionBuffer *ob, Vec3 v0, Vec3 v1,
+                                        Vec3 v2) {
+    OcclusionLevel &level = ob->levels[0];
+
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (std::abs(area) < 0.0001f) {
+        return;
+    }
+    // Occluders are drawn regardless of facing
+    if (area < 0) {
+        std::swap(v1, v2);
+        area = -area;
+    }
+    float invArea = 1.0f / area;
+
+    int x0 = std::max(0, (int)std::floor(std::min({v0.x, v1.x, v2.x})));
+    int y0 = std::max(0, (int)std::floor(std::min({v0.y, v1.y, v2.y})));
+    int x1 = std::min(level.width - 1,
+                      (int)std::ceil(std::max({v0.x, v1.x, v2.x})));
+    int y1 = std::min(level.height - 1,
+                      (int)std::ceil(std::max({v0.y, v1.y, v2.y})));
+
+    auto edge = [](Vec3 a, Vec3 b, float px, float py) {
+        return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+    };
+
+    for (int y = y0; y <= y1; y++) {
+        float py = y + 0.5f;
+        for (int x = x0; x <= x1; x++) {
+            float px = x + 0.5f;
+            float w0 = edge(v1, v2, px, py);
+            float w1 = edge(v2, v0, px, py);
+            float w2 = edge(v0, v1, px, py);
+            if (w0 < 0 || w1 < 0 || w2 < 0) {
+                continue;
+            }
+
+            float z = (w0 * v0.z + w1 * v1.z + w2 * v2.z) * invArea;
+            float &depth = level.depth[y * level.width + x];
+            depth = std::min(depth, z);
+        }
+    }
+}
+
+void Occlusion_AddOccluder(OcclusionBuffer *ob, const Mesh *mesh, Mat4 model) {
+    auto start = std::chrono::steady_clock::now();
+
+    Mat4 modelViewProj = Mat4_Mult(Mat4_Transpose(model), ob->viewProj);
+    const float *v = mesh->vertices.data();
+    int size = mesh->vertexSize;
+
+    for (uint32_t i = 0; i + 2 < mesh->numVertices; i += 3) {
+        Vec4 clip[3];
+        bool behind = false;
+        for (int k = 0; k < 3; k++) {
+            const float *p = &v[(i + k) * size];
+            clip[k] = Vec4_Transform(Vec4{p[0], p[1], p[2], 1.0f},
+                                     modelViewProj);
+            behind |= clip[k].w < 0.0001f;
+        }
+
+        // Dropping an occluder triangle is always safe
+        if (behind) {
+            continue;
+        }
+
+        Occlusion_RasterizeTriangle(ob, Occlusion_ToScreen(ob, clip[0]),
+                                    Occlusion_ToScreen(ob, clip[1]),
+                                    Occlusion_ToScreen(ob, clip[2]));
+        ob->stats.occluderTriangles++;
+    }
+
+    ob->stats.buildMs += std::chrono::duration<float, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+}
+
+void Occlusion_Finish(OcclusionBuffer *ob) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (int l = 1; l < ob->numLevels; l++) {
+        const OcclusionLevel &src = ob->levels[l - 1];
+        OcclusionLevel &dst = ob->levels[l];
+
+        for (int y = 0; y < dst.height; y++) {
+            int sy0 = y * 2;
+            int sy1 = std::min(sy0 + 1, src.height - 1);
+            for (int x = 0; x < dst.width; x++) {
+                int sx0 = x * 2;
+                int sx1 = std::min(sx0 + 1, src.width - 1);
+                dst.depth[y * dst.width + x] =
+                    std::max({src.depth[sy0 * src.width + sx0],
+                              src.depth[sy0 * src.width + sx1],
+                              src.depth[sy1 * src.width + sx0],
+                              src.depth[sy1 * src.width + sx1]});
+            }
+        }
+    }
+
+    ob->stats.buildMs += std::chrono::duration<float, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+}
+
+bool Occlusion_TestAABB(const OcclusionBuffer *ob, Vec3 min, Vec3 max) {
+    const OcclusionLevel &base = ob->levels[0];
+
+    float minX = INFINITY, minY = INFINITY, minZ = INFINITY;
+    float maxX = -INFINITY, maxY = -INFINITY;
+    for (int i = 0; i < 8; i++) {
+        Vec4 corner = {i & 1 ? max.x : min.x, i & 2 ? max.y : min.y,
+                       i & 4 ? max.z : min.z, 1.0f};
+        Vec4 clip = Vec4_Transform(corner, ob->viewProj);
+        if (clip.w < 0.0001f) {
+            return true;
+        }
+
+        Vec3 p = Occlusion_ToScreen(ob, clip);
+        minX = std::min(minX, p.x);
+        minY = std::min(minY, p.y);
+        minZ = std::min(minZ, p.z);
+        maxX = std::max(maxX, p.x);
+        maxY = std::max(maxY, p.y);
+    }
+
+    // Off screen boxes are left to frustum culling
+    int x0 = std::max(0, (int)std::floor(minX));
+    int y0 = std::max(0, (int)std::floor(minY));
+    int x1 = std::min(base.width - 1, (int)std::floor(maxX));
+    int y1 = std::min(base.height - 1, (int)std::floor(maxY));
+    if (x0 > x1 || y0 > y1) {
+        return true;
+    }
+
+    // Coarsest level where the rect spans at most 2x2 texels
+    int span = std::max(x1 - x0, y1 - y0) + 1;
+    int l = 0;
+    while ((1 << l) < span && l < ob->numLevels - 1) {
+        l++;
+    }
+
+    const OcclusionLevel &level = ob->levels[l];
+    for (int y = y0 >> l; y <= (y1 >> l); y++) {
+        for (int x = x0 >> l; x <= (x1 >> l); x++) {
+            if (minZ <= level.depth[y * level.width + x]) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
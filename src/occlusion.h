@@ -0,0 +1,48 @@
+#ifndef OCCLUSION_H_
+#define OCCLUSION_H_
+
+#include "math.h"
+#include "mesh.h"
+#include <cstdint>
+#include <vector>
+
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_MAX_LEVELS = 10;
+
+// Level 0 holds the nearest occluder depth per texel, each further level the
+// farthest depth of a 2x2 block of the level below
+struct OcclusionLevel {
+    int width;
+    int height;
+    std::vector<float> depth;
+};
+
+struct OcclusionStats {
+    uint32_t occluderTriangles;
+    uint32_t tested;
+    uint32_t culled;
+    float buildMs;
+};
+
+// Low resolution depth buffer for object level occlusion culling. Depth uses
+// the renderer's screen space convention, 0 near and 1 far
+struct OcclusionBuffer {
+    int numLevels;
+    OcclusionLevel levels[OCCLUSION_MAX_LEVELS];
+    Mat4 viewProj;
+    OcclusionStats stats;
+};
+
+// height follows the aspect of the render size
+OcclusionBuffer OcclusionBuffer_Create(int renderWidth, int renderHeight);
+// Clears the depth and sets the view-projection used for both occluders and
+// tests, usually Renderer_ViewProjection
+void Occlusion_Begin(OcclusionBuffer *ob, Mat4 viewProj);
+void Occlusion_AddOccluder(OcclusionBuffer *ob, const Mesh *mesh, Mat4 model);
+// Builds the max-depth pyramid, call after the last occluder
+void Occlusion_Finish(OcclusionBuffer *ob);
+// True if the world space box may be visible. Boxes crossing the near plane
+// are always visible
+bool Occlusion_TestAABB(const OcclusionBuffer *ob, Vec3 min, Vec3 max);
+
+#endif
@@ -0,0 +1,301 @@
+#include "overlay.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Rows of 3 bits, top row in bits 12-14 and the left pixel in the high bit
+static const uint16_t OVERLAY_FONT[64] = {
+    0x0000, 0x2482, 0x5a00, 0x5f7d, 0x0000, 0x52a5, 0x0000, 0x2400, 0x1491,
+    0x4494, 0x0aa8, 0x05d0, 0x0014, 0x01c0, 0x0002, 0x12a4, 0x7b6f, 0x2c97,
+    0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249, 0x7bef, 0x7bcf, 0x0410,
+    0x0000, 0x1511, 0x0e38, 0x4454, 0x6282, 0x0000, 0x2bed, 0x6bae, 0x3923,
+    0x6b6e, 0x79a7, 0x79a4, 0x396b, 0x5bed, 0x7497, 0x126a, 0x5bad, 0x4927,
+    0x5fed, 0x6b6d, 0x2b6a, 0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492, 0x5b6f,
+    0x5b6a, 0x5bfd, 0x5aad, 0x5a92, 0x72a7, 0x3493, 0x0000, 0x6496, 0x0000,
+    0x0007,
+};
+
+void Overlay_Begin(Overlay *ov, int width, int height) {
+    ov->width = width;
+    ov->height = height;
+    ov->commands.clear();
+    ov->text.clear();
+}
+
+void Overlay_DrawLine(Overlay *ov, Vec2 a, Vec2 b, uint32_t color) {
+    ov->commands.push_back(OverlayCommand{
+        .type = OVERLAY_LINE,
+        .color = color,
+        .p = {a, b},
+    });
+}
+
+void Overlay_FillTriangle(Overlay *ov, Vec2 a, Vec2 b, Vec2 c, uint32_t color) {
+    ov->commands.push_back(OverlayCommand{
+        .type = OVERLAY_TRIANGLE,
+        .color = color,
+        .p = {a, b, c},
+    });
+}
+
+void Overlay_FillRect(Overlay *ov, Vec2 min, Vec2 max, uint32_t color) {
+    ov->commands.push_back(OverlayCommand{
+        .type = OVERLAY_RECT,
+        .color = color,
+        .p = {min, max},
+    });
+}
+
+void Overlay_DrawRect(Overlay *ov, Vec2 min, Vec2 max, uint32_t color) {
+    Vec2 a = {min.x, min.y};
+    Vec2 b = {max.x - 1, min.y};
+    Vec2 c = {max.x - 1, max.y - 1};
+    Vec2 d = {min.x, max.y - 1};
+
+    Overlay_DrawLine(ov, a, b, color);
+    Overlay_DrawLine(ov, b, c, color);
+    Overlay_DrawLine(ov, c, d, color);
+    Overlay_DrawLine(ov, d, a, color);
+}
+
+void Overlay_DrawText(Overlay *ov, Vec2 position, const char *text,
+                      uint32_t color, int scale) {
+    size_t length = strlen(text);
+
+    ov->commands.push_back(OverlayCommand{
+        .type = OVERLAY_TEXT,
+        .color = color,
+        .p = {position},
+        .textOffset = (uint32_t)ov->text.size(),
+        .textLength = (uint16_t)std::min<size_t>(length, UINT16_MAX),
+        .scale = (uint16_t)std::max(1, scale),
+    });
+    ov->text.insert(ov->text.end(), text, text + length);
+}
+
+void Overlay_DrawWireframe(Overlay *ov, const Mesh *mesh, Mat4 model,
+                           Mat4 viewProj, uint32_t color) {
+    Mat4 modelViewProj = Mat4_Mult(Mat4_Transpose(model), viewProj);
+    const float *v = mesh->vertices.data();
+    uint32_t size = mesh->vertexSize;
+
+    // Clip -> pixel, matching the pixel centers of the 3D rasterizer
+    auto toPixel = [&](Vec4 p) {
+        return Vec2{ov->width * 0.5f * (p.x / p.w + 1.0f) - 0.5f,
+                    ov->height * 0.5f * (1.0f - p.y / p.w) - 0.5f};
+    };
+
+    for (uint32_t i = 0; i + 2 < mesh->numVertices; i += 3) {
+        Vec4 clip[3];
+        for (int k = 0; k < 3; k++) {
+            const float *p = &v[(i + k) * size];
+            clip[k] =
+                Vec4_Transform(Vec4{p[0], p[1], p[2], 1.0f}, modelViewProj);
+        }
+
+        for (int k = 0; k < 3; k++) {
+            Vec4 a = clip[k];
+            Vec4 b = clip[(k + 1) % 3];
+
+            // Near plane z = -w
+            float da = a.z + a.w;
+            float db = b.z + b.w;
+            if (da < 0 && db < 0) {
+                continue;
+            }
+            if (da < 0 || db < 0) {
+                float t = da / (da - db);
+                Vec4 p = {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t,
+                          a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t};
+                (da < 0 ? a : b) = p;
+            }
+
+            Overlay_DrawLine(ov, toPixel(a), toPixel(b), color);
+        }
+    }
+}
+
+// Fills rows y0..y1 and columns x0..x1 (exclusive), clamped to the target
+static void Overlay_FillSpans(uint32_t *pixels, int width, int height, int x0,
+                              int y0, int x1, int y1, uint32_t color) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, width);
+    y1 = std::min(y1, height);
+    if (x0 >= x1) {
+        return;
+    }
+
+    for (int y = y0; y < y1; y++) {
+        std::fill_n(&pixels[y * width + x0], x1 - x0, color);
+    }
+}
+
+void Overlay_RasterLine(uint32_t *pixels, int width, int height, Vec2 a,
+                        Vec2 b, uint32_t color) {
+    // Liang-Barsky against the pixel rect, so the loop needs no checks
+    float dx = b.x - a.x;
+    float dy = b.y - a.y;
+    float p[4] = {-dx, dx, -dy, dy};
+    float q[4] = {a.x, width - 1 - a.x, a.y, height - 1 - a.y};
+    float t0 = 0.0f, t1 = 1.0f;
+
+    for (int i = 0; i < 4; i++) {
+        if (p[i] == 0.0f) {
+            if (q[i] < 0.0f) {
+                return;
+            }
+            continue;
+        }
+
+        float t = q[i] / p[i];
+        if (p[i] < 0.0f) {
+            t0 = std::max(t0, t);
+        } else {
+            t1 = std::min(t1, t);
+        }
+    }
+    if (t0 > t1) {
+        return;
+    }
+
+    int x0 = std::clamp((int)floorf(a.x + dx * t0 + 0.5f), 0, width - 1);
+    int y0 = std::clamp((int)floorf(a.y + dy * t0 + 0.5f), 0, height - 1);
+    int x1 = std::clamp((int)floorf(a.x + dx * t1 + 0.5f), 0, width - 1);
+    int y1 = std::clamp((int)floorf(a.y + dy * t1 + 0.5f), 0, height - 1);
+
+    // Bresenham, stepping a pointer along the major axis
+    int adx = std::abs(x1 - x0);
+    int ady = std::abs(y1 - y0);
+    int stepX = x1 > x0 ? 1 : -1;
+    int stepY = y1 > y0 ? width : -width;
+    int major = std::max(adx, ady);
+    int minor = std::min(adx, ady);
+    int majorStep = adx >= ady ? stepX : stepY;
+    int minorStep = adx >= ady ? stepY : stepX;
+
+    uint32_t *pixel = &pixels[y0 * width + x0];
+    int error = 2 * minor - major;
+    for (int i = 0; i <= major; i++) {
+        *pixel = color;
+        pixel += majorStep;
+        if (error > 0) {
+            pixel += minorStep;
+            error -= 2 * major;
+        }
+        error += 2 * minor;
+    }
+}
+
+void Overlay_RasterTriangle(uint32_t *pixels, int width, int height, Vec2 a,
+                            Vec2 b, Vec2 c, uint32_t color) {
+    // Sort by y, then walk the long edge a-c against a-b and b-c
+    if (b.y < a.y) {
+        std::swap(a, b);
+    }
+    if (c.y < a.y) {
+        std::swap(a, c);
+    }
+    if (c.y < b.y) {
+        std::swap(b, c);
+    }
+    if (c.y == a.y) {
+        return;
+    }
+
+    // Rows whose center y + 0.5 lies in [a.y, c.y). Bounds clamp in float,
+    // as far off vertices overflow int
+    int y0 = (int)std::clamp(ceilf(a.y - 0.5f), 0.0f, (float)height);
+    int y1 = (int)std::clamp(ceilf(c.y - 0.5f), 0.0f, (float)height);
+
+    float longSlope = (c.x - a.x) / (c.y - a.y);
+    for (int y = y0; y < y1; y++) {
+        float center = y + 0.5f;
+        float xLong = a.x + (center - a.y) * longSlope;
+        float xShort = center < b.y
+                           ? a.x + (center - a.y) * (b.x - a.x) / (b.y - a.y)
+                           : b.x + (center - b.y) * (c.x - b.x) / (c.y - b.y);
+
+        // Columns whose center x + 0.5 lies in [left, right)
+        int x0 = (int)std::clamp(ceilf(std::min(xLong, xShort) - 0.5f), 0.0f,
+                                 (float)width);
+        int x1 = (int)std::clamp(ceilf(std::max(xLong, xShort) - 0.5f), 0.0f,
+                                 (float)width);
+        Overlay_FillSpans(pixels, width, height, x0, y, x1, y + 1, color);
+    }
+}
+
+static void Overlay_RasterText(const Overlay *ov, const OverlayCommand &cmd,
+                               uint32_t *pixels) {
+    int scale = cmd.scale;
+    // Text never reaches back past its own length, so the origin clamps to
+    // that in float before converting to int
+    float extent = (float)cmd.textLength * (OVERLAY_GLYPH_HEIGHT + 1) * scale;
+    int originX =
+        (int)std::clamp(floorf(cmd.p[0].x), -extent, (float)ov->width);
+    int x = originX;
+    int y = (int)std::clamp(floorf(cmd.p[0].y), -extent, (float)ov->height);
+
+    for (uint32_t i = 0; i < cmd.textLength; i++) {
+        char ch = ov->text[cmd.textOffset + i];
+        if (ch == '\n') {
+            x = originX;
+            y += (OVERLAY_GLYPH_HEIGHT + 1) * scale;
+            continue;
+        }
+
+        if (ch >= 'a' && ch <= 'z') {
+            ch -= 'a' - 'A';
+        }
+        uint16_t glyph = ch >= ' ' && ch <= '_' ? OVERLAY_FONT[ch - ' '] : 0;
+
+        // Glyphs fully outside the target are skipped, the rest clamp per
+        // block in Overlay_FillSpans
+        bool visible = x < ov->width && y < ov->height &&
+                       x + OVERLAY_GLYPH_WIDTH * scale > 0 &&
+                       y + OVERLAY_GLYPH_HEIGHT * scale > 0;
+        for (int row = 0; glyph != 0 && visible && row < OVERLAY_GLYPH_HEIGHT;
+             row++) {
+            int bits = glyph >> ((OVERLAY_GLYPH_HEIGHT - 1 - row) * 3);
+            for (int col = 0; col < OVERLAY_GLYPH_WIDTH; col++) {
+                if (bits & (4 >> col)) {
+                    int px = x + col * scale;
+                    int py = y + row * scale;
+                    Overlay_FillSpans(pixels, ov->width, ov->height, px, py,
+                                      px + scale, py + scale, cmd.color);
+                }
+            }
+        }
+
+        x += (OVERLAY_GLYPH_WIDTH + 1) * scale;
+    }
+}
+
+void Overlay_Render(const Overlay *ov, uint32_t *pixels) {
+    for (const OverlayCommand &cmd : ov->commands) {
+        switch (cmd.type) {
+        case OVERLAY_LINE:
+            Overlay_RasterLine(pixels, ov->width, ov->height, cmd.p[0],
+                               cmd.p[1], cmd.color);
+            break;
+        case OVERLAY_TRIANGLE:
+            Overlay_RasterTriangle(pixels, ov->width, ov->height, cmd.p[0],
+                                   cmd.p[1], cmd.p[2], cmd.color);
+            break;
+        case OVERLAY_RECT: {
+            // Clamped in float, as far off corners overflow int
+            float w = (float)ov->width, h = (float)ov->height;
+            Overlay_FillSpans(pixels, ov->width, ov->height,
+                              (int)std::clamp(ceilf(cmd.p[0].x), 0.0f, w),
+                              (int)std::clamp(ceilf(cmd.p[0].y), 0.0f, h),
+                              (int)std::clamp(ceilf(cmd.p[1].x), 0.0f, w),
+                              (int)std::clamp(ceilf(cmd.p[1].y), 0.0f, h),
+                              cmd.color);
+            break;
+        }
+        case OVERLAY_TEXT:
+            Overlay_RasterText(ov, cmd, pixels);
+            break;
+        }
+    }
+}
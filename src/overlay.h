@@ -0,0 +1,64 @@
+#ifndef OVERLAY_H_
+#define OVERLAY_H_
+
+#include "math.h"
+#include "mesh.h"
+#include <cstdint>
+#include <vector>
+
+// 3x5 pixel glyphs for ' ' to '_', lowercase is drawn as uppercase
+const int OVERLAY_GLYPH_WIDTH = 3;
+const int OVERLAY_GLYPH_HEIGHT = 5;
+
+enum OverlayCommandType {
+    OVERLAY_LINE,
+    OVERLAY_TRIANGLE,
+    OVERLAY_RECT,
+    OVERLAY_TEXT,
+};
+
+// Points are in pixels of the target, pixel (x, y) at integer coordinates
+struct OverlayCommand {
+    OverlayCommandType type;
+    uint32_t color;
+    Vec2 p[3];
+    // Text only: characters in Overlay::text and the glyph scale
+    uint32_t textOffset;
+    uint16_t textLength;
+    uint16_t scale;
+};
+
+// Batched 2D drawing on top of a finished frame. Commands are recorded during
+// the frame and drawn in order by Overlay_Render, clipped once per primitive
+// and written as spans. The command lists keep their capacity across frames,
+// so recording doesn't allocate once warmed up
+struct Overlay {
+    int width;
+    int height;
+    std::vector<OverlayCommand> commands;
+    std::vector<char> text;
+};
+
+// Starts a new batch for a target of width x height pixels
+void Overlay_Begin(Overlay *ov, int width, int height);
+void Overlay_DrawLine(Overlay *ov, Vec2 a, Vec2 b, uint32_t color);
+void Overlay_FillTriangle(Overlay *ov, Vec2 a, Vec2 b, Vec2 c, uint32_t color);
+// Rects cover min up to but not including max
+void Overlay_FillRect(Overlay *ov, Vec2 min, Vec2 max, uint32_t color);
+void Overlay_DrawRect(Overlay *ov, Vec2 min, Vec2 max, uint32_t color);
+// '\n' starts a new line
+void Overlay_DrawText(Overlay *ov, Vec2 position, const char *text,
+                      uint32_t color, int scale = 1);
+// Edges of every triangle of mesh, projected with model (Mat4_Translate/
+// Rotate/Scale layout) and viewProj. Edges are clipped at the near plane
+void Overlay_DrawWireframe(Overlay *ov, const Mesh *mesh, Mat4 model,
+                           Mat4 viewProj, uint32_t color);
+void Overlay_Render(const Overlay *ov, uint32_t *pixels);
+
+// Immediate span writers used by Overlay_Render, pixels is width x height
+void Overlay_RasterLine(uint32_t *pixels, int width, int height, Vec2 a,
+                        Vec2 b, uint32_t color);
+void Overlay_RasterTriangle(uint32_t *pixels, int width, int height, Vec2 a,
+                            Vec2 b, Vec2 c, uint32_t color);
+
+#endif
@@ -0,0 +1,21 @@
+#include "postprocess.h"
+#include "math.h"
+
+// Narkowicz's fit of the ACES filmic curve
+static float PostProcess_Tonemap(float x) {
+    return std::clamp((x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) +
+                                                   0.14f),
+                      0.0f, 1.0f);
+}
+
+void PostProcess_BuildLut(const PostProcess *post, uint8_t lut[256]) {
+    for (int i = 0; i < 256; i++) {
+        float value = i / 255.0f * post->exposure;
+        value = post->tonemap ? PostProcess_Tonemap(value)
+                              : std::min(value, 1.0f);
+        if (post->srgb) {
+            value = ColorToSRGB(ColorRGBA{value, value, value, 1.0f}).r;
+        }
+        lut[i] = (uint8_t)(value * 255.0f + 0.5f);
+    }
+}
@@ -0,0 +1,152 @@
+#ifndef POSTPROCESS_H_
+#define POSTPROCESS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Full-screen effects on 0xAARRGGBB pixels holding linear colors, in this
+// order: exposure and tonemapping, sRGB encoding, vignette and FXAA. The
+// renderer applies them to each tile right after rasterizing it (see
+// Renderer.post); the per-pixel functions here are shared with anything
+// applying them as separate passes. FXAA runs last, on the encoded colors
+// it is tuned for
+struct PostProcess {
+    bool enabled;
+    // Linear colors are scaled by exposure before tonemapping
+    float exposure;
+    // Filmic curve (Narkowicz's ACES fit) instead of clamping to 1
+    bool tonemap;
+    bool srgb;
+    // Darkening towards the corners, 0 for none and 1 for black corners
+    float vignette;
+    bool fxaa;
+};
+
+// Pixels around a pixel FXAA reads: edge taps reach FXAA_SPAN_MAX / 2
+// pixels away and are filtered bilinearly
+const float FXAA_SPAN_MAX = 8.0f;
+const int FXAA_APRON = 5;
+// Local contrast (of luma 0-255) below which a pixel is left alone
+const float FXAA_EDGE_THRESHOLD = 1.0f / 8.0f;
+const float FXAA_EDGE_THRESHOLD_MIN = 255.0f / 32.0f;
+const float FXAA_REDUCE_MUL = 1.0f / 8.0f;
+const float FXAA_REDUCE_MIN = 255.0f / 128.0f;
+
+// Exposure, tonemapping and sRGB encoding of an 8-bit channel, one table
+// for all three since they act on each channel alone
+void PostProcess_BuildLut(const PostProcess *post, uint8_t lut[256]);
+
+inline uint32_t PostProcess_Grade(const uint8_t lut[256], uint32_t color) {
+    return (color & 0xFF000000) | lut[(color >> 16) & 0xFF] << 16 |
+           lut[(color >> 8) & 0xFF] << 8 | lut[color & 0xFF];
+}
+
+// Squared distance of pixel i from the center of a size pixel axis, -1 to 1
+// across. Separate per axis so tiles can compute each once
+inline float PostProcess_VignetteTerm(int i, int size) {
+    float d = (i + 0.5f) * 2.0f / size - 1.0f;
+    return d * d;
+}
+
+// Vignette factor of pixel (x, y) of a width x height frame
+inline float PostProcess_Vignette(float vignette, int x, int y, int width,
+                                  int height) {
+    return 1.0f - vignette *
+                      (PostProcess_VignetteTerm(x, width) +
+                       PostProcess_VignetteTerm(y, height)) *
+                      0.5f;
+}
+
+// Scales the color channels by factor, from 0 to 1
+inline uint32_t PostProcess_Scale(uint32_t color, float factor) {
+    // Signed conversions, which vectorize
+    int r = (int)(((color >> 16) & 0xFF) * factor + 0.5f);
+    int g = (int)(((color >> 8) & 0xFF) * factor + 0.5f);
+    int b = (int)((color & 0xFF) * factor + 0.5f);
+    return (color & 0xFF000000) | r << 16 | g << 8 | b;
+}
+
+inline float PostProcess_Luma(uint32_t color) {
+    return ((color >> 16) & 0xFF) * 0.299f + ((color >> 8) & 0xFF) * 0.587f +
+           (color & 0xFF) * 0.114f;
+}
+
+// Bilinear sample of image at (x + dx, y + dy), pixel centers at whole
+// coordinates. The offset is split from the pixel so the filter rounds the
+// same wherever the pixel lies
+inline void PostProcess_Sample(const uint32_t *image, int stride, int x,
+                               int y, float dx, float dy, float rgb[3]) {
+    float fx0 = floorf(dx), fy0 = floorf(dy);
+    float fx = dx - fx0, fy = dy - fy0;
+    const uint32_t *p = image + (y + (int)fy0) * stride + x + (int)fx0;
+    uint32_t c[4] = {p[0], p[1], p[stride], p[stride + 1]};
+    float w[4] = {(1.0f - fx) * (1.0f - fy), fx * (1.0f - fy),
+                  (1.0f - fx) * fy, fx * fy};
+    for (int k = 0; k < 3; k++) {
+        int shift = 16 - 8 * k;
+        rgb[k] = ((c[0] >> shift) & 0xFF) * w[0] +
+                 ((c[1] >> shift) & 0xFF) * w[1] +
+                 ((c[2] >> shift) & 0xFF) * w[2] +
+                 ((c[3] >> shift) & 0xFF) * w[3];
+    }
+}
+
+// FXAA (the compact variant of Lottes' FXAA) of pixel (x, y) of image, a
+// row-major buffer of stride pixels per row with luma the
+// PostProcess_Luma of every pixel. FXAA_APRON pixels around (x, y) must be
+// readable
+inline uint32_t PostProcess_Fxaa(const uint32_t *image, const float *luma,
+                                 int stride, int x, int y) {
+    int i = y * stride + x;
+    float lumaM = luma[i];
+    float lumaNW = luma[i - stride - 1];
+    float lumaNE = luma[i - stride + 1];
+    float lumaSW = luma[i + stride - 1];
+    float lumaSE = luma[i + stride + 1];
+
+    float lumaMin =
+        std::min(lumaM, std::min(std::min(lumaNW, lumaNE),
+                                 std::min(lumaSW, lumaSE)));
+    float lumaMax =
+        std::max(lumaM, std::max(std::max(lumaNW, lumaNE),
+                                 std::max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin <
+        std::max(FXAA_EDGE_THRESHOLD_MIN, lumaMax * FXAA_EDGE_THRESHOLD)) {
+        return image[i];
+    }
+
+    // Along the edge, scaled so the shorter axis is one pixel
+    float dirX = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    float dirY = (lumaNW + lumaSW) - (lumaNE + lumaSE);
+    float reduce = std::max((lumaNW + lumaNE + lumaSW + lumaSE) *
+                                (0.25f * FXAA_REDUCE_MUL),
+                            FXAA_REDUCE_MIN);
+    float scale =
+        1.0f / (std::min(std::fabs(dirX), std::fabs(dirY)) + reduce);
+    dirX = std::clamp(dirX * scale, -FXAA_SPAN_MAX, FXAA_SPAN_MAX);
+    dirY = std::clamp(dirY * scale, -FXAA_SPAN_MAX, FXAA_SPAN_MAX);
+
+    // Two taps near the pixel, and two more at the ends of the span
+    float a0[3], a1[3], b0[3], b1[3];
+    PostProcess_Sample(image, stride, x, y, dirX * (1.0f / 3.0f - 0.5f),
+                       dirY * (1.0f / 3.0f - 0.5f), a0);
+    PostProcess_Sample(image, stride, x, y, dirX * (2.0f / 3.0f - 0.5f),
+                       dirY * (2.0f / 3.0f - 0.5f), a1);
+    PostProcess_Sample(image, stride, x, y, dirX * -0.5f, dirY * -0.5f, b0);
+    PostProcess_Sample(image, stride, x, y, dirX * 0.5f, dirY * 0.5f, b1);
+
+    float rgbA[3], rgbB[3];
+    for (int k = 0; k < 3; k++) {
+        rgbA[k] = 0.5f * (a0[k] + a1[k]);
+        rgbB[k] = rgbA[k] * 0.5f + 0.25f * (b0[k] + b1[k]);
+    }
+
+    // The wide taps crossed another edge when they leave the local range
+    float lumaB = rgbB[0] * 0.299f + rgbB[1] * 0.587f + rgbB[2] * 0.114f;
+    const float *rgb = lumaB < lumaMin || lumaB > lumaMax ? rgbA : rgbB;
+    return (image[i] & 0xFF000000) | (uint32_t)(rgb[0] + 0.5f) << 16 |
+           (uint32_t)(rgb[1] + 0.5f) << 8 | (uint32_t)(rgb[2] + 0.5f);
+}
+
+#endif
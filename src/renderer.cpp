@@ -1,398 +1,3312 @@
 #include "renderer.h"
 #include "math.h"
+#include "overlay.h"
+#include "shader.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
 #include <thread>
 #include <vector>
 
-Renderer Renderer_Create(int w, int h, int pixelScale) {
+#if defined(__x86_64__) || defined(__i386__)
+// Attributes of a kernel compiled for one instruction set: everything it
+// calls in this file is inlined into it, so that is compiled for the set too
+#define RENDERER_ISA_KERNEL(isa) __attribute__((target(isa), flatten))
+#endif
+
+struct RenderPipeline {
+    std::thread rasterThread;
+    std::mutex mutex;
+    // Signalled when a frame is queued or the pipeline shuts down
+    std::condition_variable frameQueued;
+    // Signalled when a frame finished rasterizing
+    std::condition_variable frameDone;
+    // Frames waiting for or in the raster stage, oldest at queueHead
+    RenderFrame *queue[MAX_FRAMES_IN_FLIGHT];
+    int queueHead;
+    int queueCount;
+    bool quit;
+};
+
+struct FrameExport {
+    FrameRing ring;
+    // Per slot, as RenderTarget::tileHashes: a slot keeps the colors last
+    // rasterized into it
+    uint64_t *tileHashes;
+    // The targets' own buffers, swapped back in by Renderer_Destroy
+    uint32_t *targetPixels[MAX_FRAMES_IN_FLIGHT];
+    uint64_t *targetTileHashes[MAX_FRAMES_IN_FLIGHT];
+};
+
+const int POST_APRON_PIXELS = 4 * FXAA_APRON * TILE_SIZE;
+
+struct PostTiles {
+    // POST_APRON_PIXELS per tile: its top and bottom FXAA_APRON rows, then
+    // its left and right FXAA_APRON columns, as rasterized and graded
+    uint32_t *apron;
+    // Tiles of each tile's 3x3 neighbourhood not rasterized yet
+    std::atomic<int> *pending;
+    int maxTiles;
+};
+
+static void Renderer_RasterizeFrame(Renderer *r, RenderFrame *frame,
+                                    RenderTarget *target);
+
+// Tiles of a frame at the largest render size
+static int Renderer_MaxTiles(const Renderer *r) {
+    return ((r->maxWidth + TILE_SIZE - 1) / TILE_SIZE) *
+           ((r->maxHeight + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+// Points pixels at the presented target, and outputPixels too when it is
+// not dynamic resolution's own buffer
+static void Renderer_PointAtPresented(Renderer *r) {
+    r->pixels = r->presentTarget->pixels;
+    if (!r->dynres.enabled) {
+        r->outputPixels = r->pixels;
+    }
+}
+
+Renderer Renderer_Create(int w, int h, int pixelScale, int sampleCount) {
     Renderer r = {.width = w,
                   .height = h,
+                  .maxWidth = w,
+                  .maxHeight = h,
                   .windowWidth = w * pixelScale,
                   .windowHeight = h * pixelScale,
-                  .pixelScale = pixelScale};
+                  .pixelScale = pixelScale,
+                  .outputWidth = w,
+                  .outputHeight = h};
+
+    r.framesInFlight = 1;
+    r.targets[0].pixels = new uint32_t[w * h];
+    r.zBuffer = new float[w * h];
+    r.targets[0].tileHashes = new uint64_t[Renderer_MaxTiles(&r)]();
+    r.depthTileHashes = new uint64_t[Renderer_MaxTiles(&r)]();
+
+    r.presentTarget = &r.targets[0];
+    r.presentTarget->state = TARGET_PRESENT;
+    r.pixels = r.presentTarget->pixels;
+    r.outputPixels = r.pixels;
+
+    r.microTriangleSize = MICRO_TRIANGLE_SIZE;
+
+    r.sampleCount = sampleCount > 1 ? MSAA_SAMPLES : 1;
+    if (r.sampleCount > 1) {
+        r.sampleColors = new uint32_t[w * h * MSAA_SAMPLES];
+        r.sampleDepths = new float[w * h * MSAA_SAMPLES];
+        r.sampleFlags = new uint8_t[w * h];
+    }
+
+    r.isa = RendererIsa_Detect();
+
+    // The calling thread takes part in every parallel pass
+    int numThreads = std::max(1u, std::thread::hardware_concurrency());
+    r.pool = ThreadPool_Create(numThreads - 1);
+
+    r.ready = true;
+
+    return r;
+}
+
+const char *RendererIsa_Name(RendererIsa isa) {
+    static const char *names[RENDERER_ISA_COUNT] = {"generic", "sse4.2"};
+    return isa >= 0 && isa < RENDERER_ISA_COUNT ? names[isa] : "unknown";
+}
+
+bool RendererIsa_Supported(RendererIsa isa) {
+    switch (isa) {
+    case RENDERER_ISA_GENERIC:
+        return true;
+#ifdef RENDERER_ISA_KERNEL
+    case RENDERER_ISA_SSE42:
+        return __builtin_cpu_supports("sse4.2");
+#endif
+    default:
+        return false;
+    }
+}
+
+RendererIsa RendererIsa_Detect() {
+    const char *name = getenv("RASTERIZER_ISA");
+    if (name != nullptr && name[0] != '\0') {
+        for (int i = 0; i < RENDERER_ISA_COUNT; i++) {
+            RendererIsa isa = (RendererIsa)i;
+            if (strcmp(name, RendererIsa_Name(isa)) == 0 &&
+                RendererIsa_Supported(isa)) {
+                return isa;
+            }
+        }
+        fprintf(stderr, "RASTERIZER_ISA=%s is not supported here\n", name);
+    }
+
+    if (RendererIsa_Supported(RENDERER_ISA_SSE42)) {
+        return RENDERER_ISA_SSE42;
+    }
+    return RENDERER_ISA_GENERIC;
+}
+
+bool Renderer_SetIsa(Renderer *r, RendererIsa isa) {
+    if (r == nullptr || !RendererIsa_Supported(isa)) {
+        return false;
+    }
+
+    // Frames already handed to the raster thread finish with the old one
+    Renderer_Finish(r);
+    r->isa = isa;
+    return true;
+}
+
+void Renderer_Destroy(Renderer *r) {
+    if (r == nullptr) {
+        return;
+    }
+
+    if (r->pipeline != nullptr) {
+        Renderer_Finish(r);
+        {
+            std::lock_guard<std::mutex> lock(r->pipeline->mutex);
+            r->pipeline->quit = true;
+        }
+        r->pipeline->frameQueued.notify_all();
+        r->pipeline->rasterThread.join();
+        delete r->pipeline;
+    }
+
+    ThreadPool_Destroy(r->pool);
+
+    if (r->frameExport != nullptr) {
+        FrameExport *e = r->frameExport;
+        for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            if (e->targetPixels[i] != nullptr) {
+                r->targets[i].pixels = e->targetPixels[i];
+                r->targets[i].tileHashes = e->targetTileHashes[i];
+            }
+        }
+        FrameRing_Destroy(&e->ring);
+        delete[] e->tileHashes;
+        delete e;
+    }
+
+    for (int i = 0; i < r->framesInFlight; i++) {
+        delete[] r->targets[i].pixels;
+        delete[] r->targets[i].tileHashes;
+    }
+    delete[] r->zBuffer;
+    delete[] r->depthTileHashes;
+    delete[] r->sampleColors;
+    delete[] r->sampleDepths;
+    delete[] r->sampleFlags;
+    delete[] r->shadow.depth;
+    for (RenderFrame &frame : r->frames) {
+        Arena_Destroy(&frame.arena);
+    }
+    if (r->postTiles != nullptr) {
+        delete[] r->postTiles->apron;
+        delete[] r->postTiles->pending;
+        delete r->postTiles;
+    }
+
+    if (r->dynres.enabled) {
+        delete[] r->outputPixels;
+        delete[] r->dynres.upscaleColumns;
+        delete[] r->dynres.upscaleWeights;
+    }
+}
+
+// Raster stage of a pipelined renderer: rasterizes queued frames in order
+static void Renderer_RasterLoop(Renderer *r) {
+    RenderPipeline *pipeline = r->pipeline;
+
+    for (;;) {
+        RenderFrame *frame;
+        RenderTarget *target = nullptr;
+
+        {
+            std::unique_lock<std::mutex> lock(pipeline->mutex);
+            pipeline->frameQueued.wait(lock, [&] {
+                return pipeline->quit || pipeline->queueCount > 0;
+            });
+
+            if (pipeline->queueCount == 0) {
+                return;
+            }
+            frame = pipeline->queue[pipeline->queueHead];
+
+            // Prefer a free target, otherwise recycle the oldest completed
+            // frame that was never presented
+            for (int i = 0; i < r->framesInFlight; i++) {
+                RenderTarget *t = &r->targets[i];
+                if (t->state == TARGET_FREE) {
+                    target = t;
+                    break;
+                }
+                if (t->state == TARGET_READY &&
+                    (target == nullptr || t->frameNumber < target->frameNumber)) {
+                    target = t;
+                }
+            }
+            target->state = TARGET_RASTER;
+        }
+
+        Renderer_RasterizeFrame(r, frame, target);
+
+        {
+            std::lock_guard<std::mutex> lock(pipeline->mutex);
+            target->state = TARGET_READY;
+            frame->busy = false;
+            pipeline->queueHead =
+                (pipeline->queueHead + 1) % MAX_FRAMES_IN_FLIGHT;
+            pipeline->queueCount--;
+        }
+        pipeline->frameDone.notify_all();
+    }
+}
+
+// A frame-sized buffer of perPixel values per pixel, each tile written
+// (from old, or zeroed when null) by the thread that rasterizes it under
+// thread affinity, so its pages are placed on that thread's node. Tiles are
+// laid out for the largest render size
+template <typename T>
+static T *Renderer_AllocateTileLocal(Renderer *r, const T *old, int perPixel) {
+    int width = r->maxWidth;
+    T *buffer = new T[(size_t)width * r->maxHeight * perPixel];
+
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    ThreadPool_ParallelForAffine(r->pool, Renderer_MaxTiles(r), [&](int i) {
+        int x0 = (i % tilesX) * TILE_SIZE;
+        int y0 = (i / tilesX) * TILE_SIZE;
+        int x1 = std::min(x0 + TILE_SIZE, width);
+        int y1 = std::min(y0 + TILE_SIZE, r->maxHeight);
+        for (int y = y0; y < y1; y++) {
+            size_t start = ((size_t)y * width + x0) * perPixel;
+            size_t end = ((size_t)y * width + x1) * perPixel;
+            if (old != nullptr) {
+                std::copy(&old[start], &old[end], &buffer[start]);
+            } else {
+                std::fill(&buffer[start], &buffer[end], T());
+            }
+        }
+    });
+    return buffer;
+}
+
+// Swaps *buffer for a tile-local copy
+template <typename T>
+static void Renderer_MakeTileLocal(Renderer *r, T **buffer, int perPixel) {
+    if (*buffer != nullptr) {
+        // Allocated before the old buffer is freed, so the pages are fresh
+        T *local = Renderer_AllocateTileLocal(r, *buffer, perPixel);
+        delete[] *buffer;
+        *buffer = local;
+    }
+}
+
+int Renderer_EnableThreadAffinity(Renderer *r) {
+    if (r == nullptr) {
+        return 0;
+    }
+    Renderer_Finish(r);
+    int nodes = ThreadPool_PinWorkers(r->pool);
+    if (r->threadAffinity) {
+        return nodes;
+    }
+    r->threadAffinity = true;
+
+    // Exported targets point into the ring
+    if (r->frameExport == nullptr) {
+        for (int i = 0; i < r->framesInFlight; i++) {
+            Renderer_MakeTileLocal(r, &r->targets[i].pixels, 1);
+        }
+        Renderer_PointAtPresented(r);
+    }
+    Renderer_MakeTileLocal(r, &r->zBuffer, 1);
+    Renderer_MakeTileLocal(r, &r->sampleColors, MSAA_SAMPLES);
+    Renderer_MakeTileLocal(r, &r->sampleDepths, MSAA_SAMPLES);
+    Renderer_MakeTileLocal(r, &r->sampleFlags, 1);
+    return nodes;
+}
+
+void Renderer_EnablePipelining(Renderer *r, int framesInFlight) {
+    if (r == nullptr || r->pipeline != nullptr) {
+        return;
+    }
+
+    // One frame recording while one rasterizes, and a target being
+    // presented while another one is written
+    r->framesInFlight = std::clamp(framesInFlight, 2, MAX_FRAMES_IN_FLIGHT);
+    for (int i = 1; i < r->framesInFlight; i++) {
+        r->targets[i].pixels =
+            r->threadAffinity
+                ? Renderer_AllocateTileLocal<uint32_t>(r, nullptr, 1)
+                : new uint32_t[r->maxWidth * r->maxHeight];
+        r->targets[i].tileHashes = new uint64_t[Renderer_MaxTiles(r)]();
+        r->targets[i].state = TARGET_FREE;
+    }
+
+    r->pipeline = new RenderPipeline();
+    r->pipeline->rasterThread = std::thread(Renderer_RasterLoop, r);
+}
+
+bool Renderer_EnableFrameExport(Renderer *r, const char *name,
+                                int numSlots) {
+    if (r == nullptr || r->frameExport != nullptr) {
+        return false;
+    }
+    Renderer_Finish(r);
+
+    // The presented frame can be framesInFlight frames behind the one
+    // being rasterized
+    numSlots = std::max(numSlots, r->framesInFlight + 1);
+
+    FrameExport *e = new FrameExport();
+    if (!FrameRing_Create(&e->ring, name, numSlots, r->maxWidth,
+                          r->maxHeight)) {
+        delete e;
+        return false;
+    }
+    e->tileHashes = new uint64_t[numSlots * Renderer_MaxTiles(r)]();
+
+    r->frameExport = e;
+    return true;
+}
+
+// Points target at the next slot of the export ring
+static FrameSlotHeader *Renderer_BeginExport(Renderer *r,
+                                             RenderTarget *target) {
+    FrameExport *e = r->frameExport;
+    int t = (int)(target - r->targets);
+    if (e->targetPixels[t] == nullptr) {
+        e->targetPixels[t] = target->pixels;
+        e->targetTileHashes[t] = target->tileHashes;
+    }
+
+    uint64_t index = e->ring.begun % e->ring.header->numSlots;
+    FrameSlotHeader *slot = FrameRing_Begin(&e->ring);
+    target->pixels = FrameRing_Pixels(&e->ring, slot);
+    target->tileHashes = e->tileHashes + index * Renderer_MaxTiles(r);
+    return slot;
+}
+
+// Exposes the newest completed target through r->pixels and releases the
+// previously presented one. Called with the pipeline mutex held
+static void Renderer_PresentLatest(Renderer *r) {
+    RenderTarget *latest = r->presentTarget;
+
+    for (int i = 0; i < r->framesInFlight; i++) {
+        RenderTarget *t = &r->targets[i];
+        if (t->state == TARGET_READY && t->frameNumber > latest->frameNumber) {
+            latest = t;
+        }
+    }
+
+    if (latest == r->presentTarget) {
+        return;
+    }
+
+    for (int i = 0; i < r->framesInFlight; i++) {
+        RenderTarget *t = &r->targets[i];
+        if (t->state == TARGET_PRESENT ||
+            (t->state == TARGET_READY && t != latest)) {
+            t->state = TARGET_FREE;
+        }
+    }
+
+    latest->state = TARGET_PRESENT;
+    r->presentTarget = latest;
+    Renderer_PointAtPresented(r);
+}
+
+void Renderer_BeginFrame(Renderer *r) {
+    if (r == nullptr) {
+        return;
+    }
+
+    RenderFrame *frame = &r->frames[r->frameNumber % r->framesInFlight];
+
+    if (r->pipeline != nullptr) {
+        // Wait for the raster stage to release the slot
+        std::unique_lock<std::mutex> lock(r->pipeline->mutex);
+        r->pipeline->frameDone.wait(lock, [&] { return !frame->busy; });
+    }
+
+    // Everything the slot's previous frame allocated goes at once
+    Arena_Reset(&frame->arena);
+    ArenaArray_Clear(&frame->triangles);
+    ArenaArray_Clear(&frame->shadowTriangles);
+    ArenaArray_Clear(&frame->draws);
+    ArenaArray_Clear(&frame->skinned);
+    frame->recordDraws = r->incremental;
+    ArenaArray_Reserve(&frame->arena, &frame->triangles, frame->lastTriangles);
+    ArenaArray_Reserve(&frame->arena, &frame->shadowTriangles,
+                       frame->lastShadowTriangles);
+
+    frame->numShaderBatches = 0;
+    frame->clear = false;
+    frame->number = ++r->frameNumber;
+    r->frame = frame;
+}
+
+void Renderer_ClearBackground(Renderer *r, uint32_t color) {
+    if (r == nullptr || r->frame == nullptr) {
+        return;
+    }
+
+    r->frame->clear = true;
+    r->frame->clearColor = color;
+    // Anything recorded before the clear would be hidden by it
+    r->frame->triangles.count = 0;
+    r->frame->shadowTriangles.count = 0;
+    r->frame->draws.count = 0;
+    r->frame->numShaderBatches = 0;
+}
+
+void Renderer_ClearTile(Renderer *r, const RenderFrame *frame,
+                        RenderTarget *target, int x0, int y0, int x1, int y1) {
+    for (int y = y0; y < y1; y++) {
+        int row = y * frame->width;
+        std::fill(&target->pixels[row + x0], &target->pixels[row + x1],
+                  frame->clearColor);
+        std::fill(&r->zBuffer[row + x0], &r->zBuffer[row + x1],
+                  std::numeric_limits<float>::infinity());
+
+        if (r->sampleCount > 1) {
+            // Every pixel starts compressed, so only slot 0 needs the color
+            for (int x = x0; x < x1; x++) {
+                r->sampleColors[(row + x) * MSAA_SAMPLES] = frame->clearColor;
+            }
+            std::fill(&r->sampleDepths[(row + x0) * MSAA_SAMPLES],
+                      &r->sampleDepths[(row + x1) * MSAA_SAMPLES],
+                      std::numeric_limits<float>::infinity());
+            memset(&r->sampleFlags[row + x0], MSAA_PIXEL_COMPRESSED, x1 - x0);
+        }
+    }
+}
+
+void Renderer_EnableDynamicResolution(Renderer *r, float targetFrameMs,
+                                      float minScale, float maxScale) {
+    if (r == nullptr || r->dynres.enabled) {
+        return;
+    }
+
+    DynamicResolution *d = &r->dynres;
+    d->enabled = true;
+    d->targetFrameMs = targetFrameMs;
+    d->minScale = std::clamp(minScale, 0.05f, 1.0f);
+    d->maxScale = std::clamp(maxScale, d->minScale, 1.0f);
+    d->scale = d->maxScale;
+    d->avgFrameMs = targetFrameMs;
+
+    // The output keeps the allocation size, rendering happens in a
+    // sub-rectangle of the existing buffers
+    r->outputPixels = new uint32_t[r->outputWidth * r->outputHeight];
+    d->upscaleColumns = new int[r->outputWidth];
+    d->upscaleWeights = new uint8_t[r->outputWidth];
+
+    Renderer_SetRenderSize(r, r->maxWidth * d->scale,
+                           r->maxHeight * d->scale);
+}
+
+void Renderer_SetRenderSize(Renderer *r, int w, int h) {
+    if (r == nullptr) {
+        return;
+    }
+
+    r->width = std::clamp(w, 1, r->maxWidth);
+    r->height = std::clamp(h, 1, r->maxHeight);
+}
+
+void Renderer_EnableShadows(Renderer *r, Vec3 lightDirection, Vec3 center,
+                            float extent, int size) {
+    if (r == nullptr || size <= 0 || extent <= 0.0f) {
+        return;
+    }
+
+    // Frames handed to the raster thread point at r->shadow
+    Renderer_Finish(r);
+    ShadowMap *shadow = &r->shadow;
+    if (shadow->size != size) {
+        delete[] shadow->depth;
+        shadow->depth = new float[size * size];
+        shadow->size = size;
+    }
+    shadow->enabled = true;
+    shadow->bias = SHADOW_BIAS;
+    shadow->hash = 0;
+
+    // Looks along the light from outside the box, the depth range spans it
+    Vec3 direction = Vec3_Normalize(lightDirection);
+    Vec3 eye = Vec3_Subtract(center, Vec3_ScalarMult(direction, 2.0f * extent));
+    Vec3 up = fabsf(direction.y) > 0.99f ? Vec3{1.0f, 0.0f, 0.0f}
+                                         : Vec3{0.0f, 1.0f, 0.0f};
+    Mat4 view = Mat4_LookAt(eye, center, up);
+    // Mat4_Ortho is laid out for column vectors
+    Mat4 projection = Mat4_Transpose(
+        Mat4_Ortho(-extent, extent, -extent, extent, 0.0f, 4.0f * extent));
+    shadow->viewProj = Mat4_Mult(view, projection);
+}
+
+float ShadowMap_Visibility(const ShadowMap *shadow, float x, float y,
+                           float z) {
+    // Outside the map nothing is known to occlude
+    if (x < 0.0f || y < 0.0f || x >= shadow->size || y >= shadow->size) {
+        return 1.0f;
+    }
+
+    int cx = (int)x;
+    int cy = (int)y;
+    float biased = z - shadow->bias;
+
+    int lit = 0;
+    for (int dy = -SHADOW_PCF_RADIUS; dy <= SHADOW_PCF_RADIUS; dy++) {
+        int ty = std::clamp(cy + dy, 0, shadow->size - 1);
+        const float *row = &shadow->depth[ty * shadow->size];
+        for (int dx = -SHADOW_PCF_RADIUS; dx <= SHADOW_PCF_RADIUS; dx++) {
+            int tx = std::clamp(cx + dx, 0, shadow->size - 1);
+            lit += biased <= row[tx];
+        }
+    }
+
+    const int taps = (2 * SHADOW_PCF_RADIUS + 1) * (2 * SHADOW_PCF_RADIUS + 1);
+    return lit * (1.0f / taps);
+}
+
+void Renderer_UpdateDynamicResolution(Renderer *r, float frameMs) {
+    if (r == nullptr || !r->dynres.enabled) {
+        return;
+    }
+
+    DynamicResolution *d = &r->dynres;
+    d->avgFrameMs = d->avgFrameMs * 0.8f + frameMs * 0.2f;
+
+    // Hysteresis: only react to a sustained violation, and leave some
+    // headroom before scaling back up
+    if (d->avgFrameMs > d->targetFrameMs) {
+        d->framesOverBudget++;
+        d->framesUnderBudget = 0;
+    } else if (d->avgFrameMs < d->targetFrameMs * 0.8f) {
+        d->framesUnderBudget++;
+        d->framesOverBudget = 0;
+    } else {
+        d->framesOverBudget = 0;
+        d->framesUnderBudget = 0;
+    }
+
+    if (d->framesOverBudget < DYNRES_HYSTERESIS_FRAMES &&
+        d->framesUnderBudget < DYNRES_HYSTERESIS_FRAMES) {
+        return;
+    }
+
+    // Raster cost is roughly proportional to the pixel count (scale^2).
+    // Aim slightly below the budget so the next frame lands inside the band
+    float ratio = d->targetFrameMs * 0.9f / std::max(d->avgFrameMs, 0.001f);
+    float scale = std::clamp(d->scale * sqrtf(ratio), d->minScale, d->maxScale);
+
+    const int step = DYNRES_WIDTH_STEP;
+    int minWidth = ((int)ceilf(r->maxWidth * d->minScale) + step - 1) / step;
+    int w = (int)(r->maxWidth * scale + step / 2) / step * step;
+    // The rounded up minimum can pass maxWidth, which wins
+    w = std::clamp(w, std::min(std::max(minWidth * step, step), r->maxWidth),
+                   r->maxWidth);
+    int h = (int)((float)w * r->maxHeight / r->maxWidth);
+
+    d->framesOverBudget = 0;
+    d->framesUnderBudget = 0;
+
+    if (w == r->width) {
+        return;
+    }
+
+    d->scale = (float)w / r->maxWidth;
+    // Assume the new size costs what the model predicts until measured
+    d->avgFrameMs *= (float)(w * h) / (r->width * r->height);
+    Renderer_SetRenderSize(r, w, h);
+}
+
+// Lerps two 8-bit channels packed in the 0x00FF00FF lanes of a and b, with an
+// 8-bit weight (0 = a, 256 = b)
+static inline uint32_t LerpPackedChannels(uint32_t a, uint32_t b, uint32_t w) {
+    return ((a * (256 - w) + b * w) >> 8) & 0x00FF00FF;
+}
+
+// Blends src over dst by the alpha of src
+static inline uint32_t BlendOver(uint32_t dst, uint32_t src) {
+    const uint32_t m = 0x00FF00FF;
+    // 0-255 -> 0-256, so opaque replaces dst
+    uint32_t a = (src >> 24) + (src >> 31);
+
+    return LerpPackedChannels(dst & m, src & m, a) |
+           LerpPackedChannels(dst >> 8 & m, src >> 8 & m, a) << 8;
+}
+
+// Bilinear upscale of the render rectangle to the output buffer. Columns come
+// from a precomputed table and blending is 8-bit fixed point, two channels at
+// a time
+void Renderer_Upscale(Renderer *r) {
+    if (r == nullptr || r->outputPixels == r->pixels) {
+        return;
+    }
+
+    // The presented frame may be older than the current render size when
+    // frames are pipelined
+    int srcWidth = r->presentTarget->width;
+    int srcHeight = r->presentTarget->height;
+    if (srcWidth == 0) {
+        return;
+    }
+
+    if (srcWidth == r->outputWidth && srcHeight == r->outputHeight) {
+        memcpy(r->outputPixels, r->pixels,
+               sizeof(uint32_t) * srcWidth * srcHeight);
+        return;
+    }
+
+    DynamicResolution *d = &r->dynres;
+    if (d->upscaleSourceWidth != srcWidth) {
+        // Rebuild the horizontal lookup (pixel-center aligned)
+        float stepX = (float)srcWidth / r->outputWidth;
+        for (int x = 0; x < r->outputWidth; x++) {
+            float srcX = std::max((x + 0.5f) * stepX - 0.5f, 0.0f);
+            int x0 = std::min((int)srcX, srcWidth - 1);
+            d->upscaleColumns[x] = x0;
+            d->upscaleWeights[x] =
+                x0 + 1 < srcWidth ? (uint8_t)((srcX - x0) * 256.0f) : 0;
+        }
+        d->upscaleSourceWidth = srcWidth;
+    }
+
+    const int *columns = d->upscaleColumns;
+    const uint8_t *weights = d->upscaleWeights;
+    float stepY = (float)srcHeight / r->outputHeight;
+    const uint32_t m = 0x00FF00FF;
+
+    for (int y = 0; y < r->outputHeight; y++) {
+        float srcY = std::max((y + 0.5f) * stepY - 0.5f, 0.0f);
+        int y0 = std::min((int)srcY, srcHeight - 1);
+        int y1 = std::min(y0 + 1, srcHeight - 1);
+        uint32_t wy = (uint32_t)((srcY - y0) * 256.0f);
+
+        const uint32_t *row0 = &r->pixels[y0 * srcWidth];
+        const uint32_t *row1 = &r->pixels[y1 * srcWidth];
+        uint32_t *out = &r->outputPixels[y * r->outputWidth];
+
+        for (int x = 0; x < r->outputWidth; x++) {
+            int x0 = columns[x];
+            int x1 = x0 + (weights[x] != 0);
+            uint32_t wx = weights[x];
+
+            uint32_t p00 = row0[x0], p01 = row0[x1];
+            uint32_t p10 = row1[x0], p11 = row1[x1];
+
+            // Red and blue
+            uint32_t rb = LerpPackedChannels(
+                LerpPackedChannels(p00 & m, p01 & m, wx),
+                LerpPackedChannels(p10 & m, p11 & m, wx), wy);
+            // Alpha and green
+            uint32_t ag = LerpPackedChannels(
+                LerpPackedChannels(p00 >> 8 & m, p01 >> 8 & m, wx),
+                LerpPackedChannels(p10 >> 8 & m, p11 >> 8 & m, wx), wy);
+
+            out[x] = rb | ag << 8;
+        }
+    }
+}
+
+void Renderer_SetPixel(Renderer *r, int x, int y, float z, uint32_t color) {
+    if (r == nullptr) {
+        return;
+    }
+
+    if (x < 0 || x >= r->width || y < 0 || y >= r->height)
+        return;
+
+    int idx = y * r->width + x;
+
+    if (z < r->zBuffer[idx]) {
+        r->zBuffer[idx] = z;
+        r->pixels[idx] = color;
+    }
+}
+
+void Renderer_DrawCube(Renderer *r, Vec3 position, Vec3 rotation, Vec3 scale,
+                       ColorRGBA color, const Texture *texture) {
+    if (r == nullptr) {
+        return;
+    }
+
+    CubeMesh mesh = CreateCubeMesh();
+
+    Renderer_DrawTriangles(r, mesh.vertices, mesh.numVertices, mesh.vertexSize,
+                           position, rotation, scale, color, texture);
+}
+
+void Renderer_DrawQuad(Renderer *r, Vec3 position, Vec3 rotation, Vec3 scale,
+                       ColorRGBA color, const Texture *texture) {
+    if (r == nullptr) {
+        return;
+    }
+
+    QuadMesh mesh = CreateQuadMesh();
+
+    Renderer_DrawTriangles(r, mesh.vertices, mesh.numVertices, mesh.vertexSize,
+                           position, rotation, scale, color, texture);
+}
+
+bool TriangleIntersectsTile(Triangle triangle, int tileX0, int tileY0,
+                            int tileX1, int tileY1) {
+    return !(triangle.max.x < tileX0 || triangle.min.x > tileX1 ||
+             triangle.max.y < tileY0 || triangle.min.y > tileY1);
+}
+
+float TriangleEdgeFunction(Vec2 a, Vec2 b, Vec2 p) {
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// Plane equation of the values a0-a2 at the triangle's vertices
+static void TriangleSetPlane(Triangle *t, int attribute, float a0, float a1,
+                             float a2, float invArea) {
+    float dx = ((a1 - a0) * (t->v2.y - t->v0.y) -
+                (a2 - a0) * (t->v1.y - t->v0.y)) *
+               invArea;
+    float dy = ((a2 - a0) * (t->v1.x - t->v0.x) -
+                (a1 - a0) * (t->v2.x - t->v0.x)) *
+               invArea;
+
+    t->planes.dx[attribute] = dx;
+    t->planes.dy[attribute] = dy;
+    t->planes.c[attribute] = a0 - dx * t->v0.x - dy * t->v0.y;
+}
+
+static inline float TriangleEvaluatePlane(const TrianglePlanes &planes,
+                                          int attribute, float px, float py) {
+    return planes.dx[attribute] * px + planes.dy[attribute] * py +
+           planes.c[attribute];
+}
+
+// Every attribute at (px, py), one straight-line pass the compiler keeps in
+// vector registers
+static inline void TriangleEvaluatePlanes(const TrianglePlanes &planes,
+                                          float px, float py,
+                                          float values[TRIANGLE_PLANE_WIDTH]) {
+    for (int i = 0; i < TRIANGLE_PLANE_WIDTH; i++) {
+        values[i] = planes.dx[i] * px + planes.dy[i] * py + planes.c[i];
+    }
+}
+
+// Perspective-correct fragment at the pixel center (px, py) with depth z:
+// one reciprocal for all attributes. The normal is left unnormalized for
+// the lighting to normalize once. With a shadow map the light planes are
+// looked up in it
+Fragment TriangleInterpolatePoint(const Triangle &triangle, float px,
+                                  float py, float z, const ShadowMap *shadow) {
+    float values[TRIANGLE_PLANE_WIDTH];
+    TriangleEvaluatePlanes(triangle.planes, px, py, values);
+    float w = 1.0f / values[ATTR_INV_W];
+
+    return {
+        .position = {px, py, z},
+        .normal = {values[ATTR_NORMAL_X] * w, values[ATTR_NORMAL_Y] * w,
+                   values[ATTR_NORMAL_Z] * w},
+        .color = triangle.color,
+        .uv = {values[ATTR_U] * w, values[ATTR_V] * w},
+        .shadow = shadow != nullptr
+                      ? ShadowMap_Visibility(shadow, values[ATTR_LIGHT_X] * w,
+                                             values[ATTR_LIGHT_Y] * w,
+                                             values[ATTR_LIGHT_Z] * w)
+                      : 1.0f,
+    };
+}
+
+// Perspective-correct UV at any screen position, including the helper pixels
+// of a quad that fall outside the triangle
+Vec2 TriangleInterpolateUV(const Triangle &triangle, Vec2 p) {
+    const TrianglePlanes &planes = triangle.planes;
+    float w = 1.0f / TriangleEvaluatePlane(planes, ATTR_INV_W, p.x, p.y);
+
+    return {
+        TriangleEvaluatePlane(planes, ATTR_U, p.x, p.y) * w,
+        TriangleEvaluatePlane(planes, ATTR_V, p.x, p.y) * w,
+    };
+}
+
+// Texture LOD shared by the 2x2 pixel quad containing (x, y), from the UV
+// differences across the quad. Consecutive pixels of the same quad reuse the
+// cached value
+float TriangleQuadLod(const Triangle &triangle, int x, int y,
+                      QuadLodCache *cache) {
+    int qx = x & ~1;
+    int qy = y & ~1;
+
+    if (qx != cache->quadX || qy != cache->quadY) {
+        Vec2 uv00 = TriangleInterpolateUV(triangle, {qx + 0.5f, qy + 0.5f});
+        Vec2 uv10 = TriangleInterpolateUV(triangle, {qx + 1.5f, qy + 0.5f});
+        Vec2 uv01 = TriangleInterpolateUV(triangle, {qx + 0.5f, qy + 1.5f});
+
+        cache->quadX = qx;
+        cache->quadY = qy;
+        cache->lod = Texture_ComputeLod(
+            triangle.texture, {uv10.x - uv00.x, uv10.y - uv00.y},
+            {uv01.x - uv00.x, uv01.y - uv00.y});
+    }
+
+    return cache->lod;
+}
+
+// Modulates the fragment color with the triangle's texture
+void TriangleApplyTexture(const Triangle &triangle, Fragment *frag, int x,
+                          int y, QuadLodCache *cache) {
+    float lod = TriangleQuadLod(triangle, x, y, cache);
+    ColorRGBA texel = Texture_Sample(triangle.texture, frag->uv, lod);
+
+    frag->color.r *= texel.r;
+    frag->color.g *= texel.g;
+    frag->color.b *= texel.b;
+    frag->color.a *= texel.a;
+}
+
+// Textured and lit color of the pixel (x, y) at depth z
+static inline uint32_t Renderer_ShadeFragment(const RenderFrame *frame,
+                                              const Triangle &triangle, int x,
+                                              int y, float z,
+                                              QuadLodCache *lodCache) {
+    Fragment frag = TriangleInterpolatePoint(triangle, x + 0.5f, y + 0.5f, z,
+                                             frame->shadow);
+
+    if (triangle.texture != nullptr) {
+        TriangleApplyTexture(triangle, &frag, x, y, lodCache);
+    }
+
+    // Gamma Correction
+    // frag.color = ColorToSRGB(frag.color);
+
+    const RenderView &view = frame->views[triangle.view];
+    frag.position.x -= view.x;
+    frag.position.y -= view.y;
+    return ColorRGBAToInt(
+        Renderer_CalculateFragmentLighting(frame, triangle.view, frag));
+}
+
+// Depth tests, shades and writes one covered pixel
+static inline void Renderer_ShadePixel(Renderer *r, const RenderFrame *frame,
+                                       RenderTarget *target,
+                                       const Triangle &triangle, int x, int y,
+                                       QuadLodCache *lodCache) {
+    float z = TriangleEvaluatePlane(triangle.planes, ATTR_Z, x + 0.5f, y + 0.5f);
+
+    int idx = y * frame->width + x;
+    if (z >= r->zBuffer[idx]) {
+        return;
+    }
+
+    r->zBuffer[idx] = z;
+    target->pixels[idx] =
+        Renderer_ShadeFragment(frame, triangle, x, y, z, lodCache);
+}
+
+// A micro triangle's covered pixels within the 4x4 block at (x, y), bit
+// row * 4 + column
+struct MicroTriangle {
+    const Triangle *triangle;
+    int x;
+    int y;
+    uint16_t mask;
+};
+
+// Four lanes of a pixel row (GCC/Clang vector extensions, SSE or NEON)
+typedef float Float4 __attribute__((vector_size(16)));
+typedef int32_t Int4 __attribute__((vector_size(16)));
+
+// Evaluates the 16 pixel centers of the block one row vector at a time,
+// without branches. The terms are the ones of TriangleEdgeFunction, so
+// coverage matches the regular path exactly
+static inline uint16_t Renderer_MicroCoverage(const Triangle &triangle, int x,
+                                              int y, int width, int height) {
+    // Clockwise triangles are inside where all edge values are <= 0
+    float sign = triangle.area < 0 ? -1.0f : 1.0f;
+
+    // (x + i) + 0.5f, exact for any on-screen x
+    Float4 px = (float)x + Float4{0.5f, 1.5f, 2.5f, 3.5f};
+
+    // Edge i runs from a[i] to b[i] as in Renderer_RasterizeTile
+    const Vec2 *a[3] = {&triangle.v1, &triangle.v2, &triangle.v0};
+    const Vec2 *b[3] = {&triangle.v2, &triangle.v0, &triangle.v1};
+
+    Float4 dx[3];
+    float ex[3], ey[3];
+    for (int e = 0; e < 3; e++) {
+        dx[e] = px - a[e]->x;
+        ex[e] = b[e]->x - a[e]->x;
+        ey[e] = b[e]->y - a[e]->y;
+    }
+
+    uint32_t mask = 0;
+    for (int row = 0; row < 4; row++) {
+        float py = (y + row) + 0.5f;
+        Int4 inside = {-1, -1, -1, -1};
+        for (int e = 0; e < 3; e++) {
+            Float4 w = sign * (ex[e] * (py - a[e]->y) - ey[e] * dx[e]);
+            inside &= w >= 0.0f;
+        }
+
+        Int4 bits = inside & Int4{1, 2, 4, 8};
+        mask |= (uint32_t)(bits[0] | bits[1] | bits[2] | bits[3]) << (row * 4);
+    }
+
+    // Only the part of the block inside the bounding box
+    uint32_t rows = (1u << (4 * height)) - 1;
+    uint32_t cols = 0x1111 * ((1u << width) - 1);
+    return mask & rows & cols;
+}
+
+// Edges of a triangle for the 4-wide row loops. Edge i runs from a[i] to
+// b[i] as in Renderer_RasterizeTile, sign makes inside >= 0 for both windings
+struct TriangleEdges {
+    float sign;
+    float ax[3], ay[3];
+    float ex[3], ey[3];
+};
+
+static inline TriangleEdges TriangleSetupEdges(const Triangle &triangle) {
+    const Vec2 *a[3] = {&triangle.v1, &triangle.v2, &triangle.v0};
+    const Vec2 *b[3] = {&triangle.v2, &triangle.v0, &triangle.v1};
+
+    TriangleEdges edges;
+    // Clockwise triangles are inside where all edge values are <= 0
+    edges.sign = triangle.area < 0 ? -1.0f : 1.0f;
+    for (int e = 0; e < 3; e++) {
+        edges.ax[e] = a[e]->x;
+        edges.ay[e] = a[e]->y;
+        edges.ex[e] = b[e]->x - a[e]->x;
+        edges.ey[e] = b[e]->y - a[e]->y;
+    }
+    return edges;
+}
+
+// Coverage of the pixels x to x + 3 of row y, lanes past maxX excluded. The
+// terms are the ones of TriangleEdgeFunction, so every path agrees on which
+// pixels a triangle covers
+static inline Int4 TriangleRowCoverage(const TriangleEdges &edges, int x,
+                                       int y, int maxX) {
+    float py = y + 0.5f;
+    Float4 px = (float)x + Float4{0.5f, 1.5f, 2.5f, 3.5f};
+
+    Int4 inside = Int4{0, 1, 2, 3} + x <= maxX;
+    for (int e = 0; e < 3; e++) {
+        Float4 w = edges.ex[e] * (py - edges.ay[e]) -
+                   edges.ey[e] * (px - edges.ax[e]);
+        inside &= edges.sign * w >= 0.0f;
+    }
+    return inside;
+}
+
+// No triangle covers the pixel in a Z-prepass tile's winners
+const uint32_t PREPASS_NO_TRIANGLE = UINT32_MAX;
+
+// Depth-only raster of the opaque triangles in bin [binStart, binEnd) within
+// [x0, x1) x [y0, y1) of a width pixels wide depth buffer: no attributes, no
+// shading, four pixels per step. Coverage and depth use the terms of
+// TriangleEdgeFunction and TriangleEvaluatePlane, so a Z-prepass matches the
+// color pass exactly. With winners, also records the index of the triangle
+// that set each pixel's depth, TILE_SIZE per row from (x0, y0); ties keep
+// the first one drawn, as the color pass does
+static void Renderer_RasterizeDepth(const Triangle *triangles,
+                                    const uint32_t *binIndices,
+                                    uint32_t binStart, uint32_t binEnd,
+                                    float *depth, int width, int x0, int y0,
+                                    int x1, int y1,
+                                    uint32_t *winners = nullptr) {
+    for (uint32_t i = binStart; i < binEnd; i++) {
+        const Triangle &triangle = triangles[binIndices[i]];
+        if (triangle.transparent) {
+            continue;
+        }
+
+        int minX = std::max(x0, (int)triangle.min.x);
+        int minY = std::max(y0, (int)triangle.min.y);
+        int maxX = std::min(x1 - 1, (int)triangle.max.x);
+        int maxY = std::min(y1 - 1, (int)triangle.max.y);
+
+        TriangleEdges edges = TriangleSetupEdges(triangle);
+        float dzdx = triangle.planes.dx[ATTR_Z];
+        float dzdy = triangle.planes.dy[ATTR_Z];
+        float zc = triangle.planes.c[ATTR_Z];
+
+        for (int y = minY; y <= maxY; y++) {
+            float rowZ = dzdy * (y + 0.5f);
+            float *row = &depth[y * width];
+            uint32_t *rowWinners =
+                winners != nullptr ? &winners[(y - y0) * TILE_SIZE - x0]
+                                   : nullptr;
+
+            for (int x = minX; x <= maxX; x += 4) {
+                Int4 inside = TriangleRowCoverage(edges, x, y, maxX);
+                if ((inside[0] | inside[1] | inside[2] | inside[3]) == 0) {
+                    continue;
+                }
+
+                Float4 px = (float)x + Float4{0.5f, 1.5f, 2.5f, 3.5f};
+                Float4 z = dzdx * px + rowZ + zc;
+                if (x + 3 >= x1) {
+                    // Lanes past the tile belong to another thread
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (inside[lane] && z[lane] < row[x + lane]) {
+                            row[x + lane] = z[lane];
+                            if (rowWinners != nullptr) {
+                                rowWinners[x + lane] = binIndices[i];
+                            }
+                        }
+                    }
+                    continue;
+                }
+
+                Float4 old;
+                memcpy(&old, &row[x], sizeof(old));
+                Int4 write = inside & (z < old);
+                Int4 result = ((Int4)z & write) | ((Int4)old & ~write);
+                memcpy(&row[x], &result, sizeof(result));
+
+                if (rowWinners != nullptr) {
+                    Int4 oldWinners;
+                    memcpy(&oldWinners, &rowWinners[x], sizeof(oldWinners));
+                    Int4 winner = Int4{} + (int32_t)binIndices[i];
+                    Int4 newWinners = (winner & write) | (oldWinners & ~write);
+                    memcpy(&rowWinners[x], &newWinners, sizeof(newWinners));
+                }
+            }
+        }
+    }
+}
+
+// Clears and renders one tile of the frame's shadow map
+static void Renderer_RasterizeShadowTile(const RenderFrame *frame,
+                                         int tilesX, int tileX, int tileY) {
+    const ShadowMap *shadow = frame->shadow;
+    int x0 = tileX * TILE_SIZE;
+    int y0 = tileY * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, shadow->size);
+    int y1 = std::min(y0 + TILE_SIZE, shadow->size);
+
+    for (int y = y0; y < y1; y++) {
+        std::fill(&shadow->depth[y * shadow->size + x0],
+                  &shadow->depth[y * shadow->size + x1],
+                  std::numeric_limits<float>::infinity());
+    }
+
+    int tile = tileY * tilesX + tileX;
+    Renderer_RasterizeDepth(
+        frame->shadowTriangles.data, frame->shadowBinIndices,
+        frame->shadowBinOffsets[tile], frame->shadowBinOffsets[tile + 1],
+        shadow->depth, shadow->size, x0, y0, x1, y1);
+}
+
+#ifdef RENDERER_ISA_KERNEL
+RENDERER_ISA_KERNEL("sse4.2")
+static void Renderer_RasterizeShadowTileSSE42(const RenderFrame *frame,
+                                              int tilesX, int tileX,
+                                              int tileY) {
+    Renderer_RasterizeShadowTile(frame, tilesX, tileX, tileY);
+}
+
+#endif
+
+// Depth-only frames: clears the tile's depth and rasterizes the opaque
+// triangles into it
+static void Renderer_RasterizeDepthTile(Renderer *r, const RenderFrame *frame,
+                                        int tileX, int tileY) {
+    int x0 = tileX * TILE_SIZE;
+    int y0 = tileY * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, frame->width);
+    int y1 = std::min(y0 + TILE_SIZE, frame->height);
+
+    if (frame->clear) {
+        for (int y = y0; y < y1; y++) {
+            std::fill(&r->zBuffer[y * frame->width + x0],
+                      &r->zBuffer[y * frame->width + x1],
+                      std::numeric_limits<float>::infinity());
+        }
+    }
+
+    int tile = tileY * frame->tilesX + tileX;
+    Renderer_RasterizeDepth(frame->triangles.data, frame->binIndices,
+                            frame->binOffsets[tile],
+                            frame->binOffsets[tile + 1], r->zBuffer,
+                            frame->width, x0, y0, x1, y1);
+}
+
+// Z-prepass color pass: shades each pixel of the tile once, with the
+// triangle the prepass found in front and at the depth it left, without
+// evaluating coverage again
+static void Renderer_ShadeWinners(Renderer *r, const RenderFrame *frame,
+                                  RenderTarget *target,
+                                  const uint32_t *winners, int x0, int y0,
+                                  int x1, int y1) {
+    uint32_t last = PREPASS_NO_TRIANGLE;
+    QuadLodCache lodCache = {-1, -1, 0.0f};
+
+    for (int y = y0; y < y1; y++) {
+        const uint32_t *row = &winners[(y - y0) * TILE_SIZE - x0];
+        for (int x = x0; x < x1; x++) {
+            if (row[x] == PREPASS_NO_TRIANGLE) {
+                continue;
+            }
+            if (row[x] != last) {
+                last = row[x];
+                lodCache = {-1, -1, 0.0f};
+            }
+
+            int idx = y * frame->width + x;
+            target->pixels[idx] =
+                Renderer_ShadeFragment(frame, frame->triangles[row[x]], x, y,
+                                       r->zBuffer[idx], &lodCache);
+        }
+    }
+}
+
+void Renderer_RasterizeTile(Renderer *r, const RenderFrame *frame,
+                            RenderTarget *target, int tileX, int tileY) {
+    int x0 = tileX * TILE_SIZE;
+    int y0 = tileY * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, frame->width);
+    int y1 = std::min(y0 + TILE_SIZE, frame->height);
+
+    int tile = tileY * frame->tilesX + tileX;
+    uint32_t binStart = frame->binOffsets[tile];
+    uint32_t binEnd = frame->binOffsets[tile + 1];
+
+    if (frame->zPrepass) {
+        uint32_t winners[TILE_SIZE * TILE_SIZE];
+        std::fill(winners, winners + TILE_SIZE * TILE_SIZE,
+                  PREPASS_NO_TRIANGLE);
+        Renderer_RasterizeDepth(frame->triangles.data, frame->binIndices,
+                                binStart, binEnd, r->zBuffer, frame->width, x0,
+                                y0, x1, y1, winners);
+        Renderer_ShadeWinners(r, frame, target, winners, x0, y0, x1, y1);
+        return;
+    }
+
+    uint32_t i = binStart;
+    while (i < binEnd) {
+        const Triangle &triangle = frame->triangles[frame->binIndices[i]];
+
+        // Micro path: coverage for a run of consecutive tiny triangles first,
+        // then shading in submission order
+        if (triangle.micro) {
+            MicroTriangle batch[MICRO_TRIANGLE_BATCH];
+            int count = 0;
+
+            for (; i < binEnd && count < MICRO_TRIANGLE_BATCH; i++) {
+                const Triangle &t = frame->triangles[frame->binIndices[i]];
+                if (!t.micro) {
+                    break;
+                }
+                int minX = std::max(x0, (int)t.min.x);
+                int minY = std::max(y0, (int)t.min.y);
+                int maxX = std::min(x1 - 1, (int)t.max.x);
+                int maxY = std::min(y1 - 1, (int)t.max.y);
+                batch[count++] = {
+                    .triangle = &t,
+                    .x = minX,
+                    .y = minY,
+                    .mask = Renderer_MicroCoverage(t, minX, minY,
+                                                   maxX - minX + 1,
+                                                   maxY - minY + 1),
+                };
+            }
+
+            for (int b = 0; b < count; b++) {
+                const MicroTriangle &m = batch[b];
+                QuadLodCache lodCache = {-1, -1, 0.0f};
+
+                for (uint32_t bits = m.mask; bits != 0; bits &= bits - 1) {
+                    int lane = __builtin_ctz(bits);
+                    Renderer_ShadePixel(r, frame, target, *m.triangle,
+                                        m.x + (lane & 3), m.y + (lane >> 2),
+                                        &lodCache);
+                }
+            }
+            continue;
+        }
+        i++;
+
+        if (triangle.transparent) {
+            continue;
+        }
+
+        TriangleEdges edges = TriangleSetupEdges(triangle);
+        QuadLodCache lodCache = {-1, -1, 0.0f};
+
+        // Rasterize only the part of the bounding box inside the tile
+        int minX = std::max(x0, (int)triangle.min.x);
+        int minY = std::max(y0, (int)triangle.min.y);
+        int maxX = std::min(x1 - 1, (int)triangle.max.x);
+        int maxY = std::min(y1 - 1, (int)triangle.max.y);
+
+        for (int y = minY; y <= maxY; y++) {
+            for (int x = minX; x <= maxX; x += 4) {
+                Int4 inside = TriangleRowCoverage(edges, x, y, maxX);
+                Int4 bits = inside & Int4{1, 2, 4, 8};
+
+                for (uint32_t mask = bits[0] | bits[1] | bits[2] | bits[3];
+                     mask != 0; mask &= mask - 1) {
+                    Renderer_ShadePixel(r, frame, target, triangle,
+                                        x + __builtin_ctz(mask), y,
+                                        &lodCache);
+                }
+            }
+        }
+    }
+}
+
+uint32_t Renderer_ResolvePixel(const uint32_t *samples, uint8_t flags) {
+    if (flags & MSAA_PIXEL_COMPRESSED) {
+        return samples[0];
+    }
+
+    uint32_t a = 0, red = 0, green = 0, blue = 0;
+    for (int s = 0; s < MSAA_SAMPLES; s++) {
+        a += (samples[s] >> 24) & 0xFF;
+        red += (samples[s] >> 16) & 0xFF;
+        green += (samples[s] >> 8) & 0xFF;
+        blue += samples[s] & 0xFF;
+    }
+
+    return ((a / MSAA_SAMPLES) << 24) | ((red / MSAA_SAMPLES) << 16) |
+           ((green / MSAA_SAMPLES) << 8) | (blue / MSAA_SAMPLES);
+}
+
+void Renderer_ResolveTile(Renderer *r, const RenderFrame *frame,
+                          RenderTarget *target, int x0, int y0, int x1,
+                          int y1) {
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int idx = y * frame->width + x;
+            const float *depths = &r->sampleDepths[idx * MSAA_SAMPLES];
+
+            target->pixels[idx] = Renderer_ResolvePixel(
+                &r->sampleColors[idx * MSAA_SAMPLES], r->sampleFlags[idx]);
+
+            // Keep the farthest sample so depth consumers stay conservative
+            r->zBuffer[idx] = std::max(std::max(depths[0], depths[1]),
+                                       std::max(depths[2], depths[3]));
+        }
+    }
+}
+
+void Renderer_WriteSamples(Renderer *r, int idx, uint32_t passMask,
+                           const float *sampleZ, uint32_t color) {
+    uint32_t *colors = &r->sampleColors[idx * MSAA_SAMPLES];
+    float *depths = &r->sampleDepths[idx * MSAA_SAMPLES];
+    uint8_t &flags = r->sampleFlags[idx];
+    const uint32_t fullMask = (1u << MSAA_SAMPLES) - 1;
+
+    if (passMask == fullMask) {
+        colors[0] = color;
+        flags |= MSAA_PIXEL_COMPRESSED;
+    } else {
+        // Partial coverage: expand the pixel before writing
+        if (flags & MSAA_PIXEL_COMPRESSED) {
+            for (int s = 1; s < MSAA_SAMPLES; s++) {
+                colors[s] = colors[0];
+            }
+            flags &= ~MSAA_PIXEL_COMPRESSED;
+        }
+        for (int s = 0; s < MSAA_SAMPLES; s++) {
+            if (passMask & (1u << s)) {
+                colors[s] = color;
+            }
+        }
+    }
+
+    for (int s = 0; s < MSAA_SAMPLES; s++) {
+        if (passMask & (1u << s)) {
+            depths[s] = sampleZ[s];
+        }
+    }
+}
+
+// 4x MSAA: coverage and depth are evaluated per sample, but the fragment is
+// shaded once per pixel at its center and the result is written to every
+// covered sample that passes the depth test
+void Renderer_RasterizeTileMSAA(Renderer *r, const RenderFrame *frame,
+                                RenderTarget *target, int tileX, int tileY) {
+    int x0 = tileX * TILE_SIZE;
+    int y0 = tileY * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, frame->width);
+    int y1 = std::min(y0 + TILE_SIZE, frame->height);
+
+    int tile = tileY * frame->tilesX + tileX;
+    uint32_t binStart = frame->binOffsets[tile];
+    uint32_t binEnd = frame->binOffsets[tile + 1];
+
+    for (uint32_t i = binStart; i < binEnd; i++) {
+        const Triangle &triangle = frame->triangles[frame->binIndices[i]];
+        if (triangle.transparent) {
+            continue;
+        }
+
+        bool clockwise = triangle.area < 0;
+
+        QuadLodCache lodCache = {-1, -1, 0.0f};
+
+        int minX = std::max(x0, (int)triangle.min.x);
+        int minY = std::max(y0, (int)triangle.min.y);
+        int maxX = std::min(x1 - 1, (int)triangle.max.x);
+        int maxY = std::min(y1 - 1, (int)triangle.max.y);
+
+        for (int y = minY; y <= maxY; y++) {
+            for (int x = minX; x <= maxX; x++) {
+                int idx = y * frame->width + x;
+                const float *depths = &r->sampleDepths[idx * MSAA_SAMPLES];
+
+                uint32_t passMask = 0;
+                float sampleZ[MSAA_SAMPLES];
+
+                for (int s = 0; s < MSAA_SAMPLES; s++) {
+                    Vec2 p = {x + MSAA_SAMPLE_OFFSETS[s].x,
+                              y + MSAA_SAMPLE_OFFSETS[s].y};
+
+                    float w0 =
+                        TriangleEdgeFunction(triangle.v1, triangle.v2, p);
+                    float w1 =
+                        TriangleEdgeFunction(triangle.v2, triangle.v0, p);
+                    float w2 =
+                        TriangleEdgeFunction(triangle.v0, triangle.v1, p);
+
+                    bool inside = clockwise ? (w0 <= 0 && w1 <= 0 && w2 <= 0)
+                                            : (w0 >= 0 && w1 >= 0 && w2 >= 0);
+                    if (!inside) {
+                        continue;
+                    }
+
+                    // Screen-space depth is affine, its plane is enough
+                    // per sample
+                    sampleZ[s] =
+                        TriangleEvaluatePlane(triangle.planes, ATTR_Z, p.x, p.y);
+
+                    if (sampleZ[s] < depths[s]) {
+                        passMask |= 1u << s;
+                    }
+                }
+
+                if (passMask == 0) {
+                    continue;
+                }
+
+                // Shade once at the pixel center
+                float z = TriangleEvaluatePlane(triangle.planes, ATTR_Z,
+                                                x + 0.5f, y + 0.5f);
+                uint32_t color =
+                    Renderer_ShadeFragment(frame, triangle, x, y, z, &lodCache);
+
+                Renderer_WriteSamples(r, idx, passMask, sampleZ, color);
+            }
+        }
+    }
+}
+
+struct TransparentFragment {
+    float z;
+    uint32_t color;
+};
+
+// Keeps the nearest TRANSPARENCY_FRAGMENTS fragments of a pixel. A fragment
+// pushed out is farther than all kept ones and is blended right away
+static inline void Renderer_InsertFragment(TransparentFragment *list,
+                                           uint8_t *count, uint32_t *pixel,
+                                           TransparentFragment frag) {
+    if (*count < TRANSPARENCY_FRAGMENTS) {
+        list[(*count)++] = frag;
+        return;
+    }
+
+    int farthest = 0;
+    for (int k = 1; k < TRANSPARENCY_FRAGMENTS; k++) {
+        if (list[k].z > list[farthest].z) {
+            farthest = k;
+        }
+    }
+
+    if (frag.z >= list[farthest].z) {
+        *pixel = BlendOver(*pixel, frag.color);
+    } else {
+        *pixel = BlendOver(*pixel, list[farthest].color);
+        list[farthest] = frag;
+    }
+}
+
+// Transparent triangles of a tile, after everything opaque in it. Fragments
+// test against the opaque depth; with the k-buffer they are collected per
+// pixel and blended back to front at the end, while the tile is in cache
+static void Renderer_RasterizeTransparentTile(Renderer *r,
+                                              const RenderFrame *frame,
+                                              RenderTarget *target, int tileX,
+                                              int tileY) {
+    int x0 = tileX * TILE_SIZE;
+    int y0 = tileY * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, frame->width);
+    int y1 = std::min(y0 + TILE_SIZE, frame->height);
+
+    int tile = tileY * frame->tilesX + tileX;
+    uint32_t binStart = frame->binOffsets[tile];
+    uint32_t binEnd = frame->binOffsets[tile + 1];
+
+    bool sorted = frame->transparency == TRANSPARENCY_SORTED_TRIANGLES;
+
+    // Tile-local k-buffer, only the counts need clearing
+    uint8_t counts[TILE_SIZE * TILE_SIZE];
+    TransparentFragment fragments[TILE_SIZE * TILE_SIZE]
+                                 [TRANSPARENCY_FRAGMENTS];
+    bool anyFragments = false;
+
+    for (uint32_t i = binStart; i < binEnd; i++) {
+        const Triangle &triangle = frame->triangles[frame->binIndices[i]];
+        if (!triangle.transparent) {
+            continue;
+        }
+
+        if (!anyFragments) {
+            memset(counts, 0, sizeof(counts));
+            anyFragments = true;
+        }
+
+        bool clockwise = triangle.area < 0;
+        QuadLodCache lodCache = {-1, -1, 0.0f};
+
+        int minX = std::max(x0, (int)triangle.min.x);
+        int minY = std::max(y0, (int)triangle.min.y);
+        int maxX = std::min(x1 - 1, (int)triangle.max.x);
+        int maxY = std::min(y1 - 1, (int)triangle.max.y);
+
+        for (int y = minY; y <= maxY; y++) {
+            for (int x = minX; x <= maxX; x++) {
+                Vec2 p = {x + 0.5f, y + 0.5f};
+
+                float w0 = TriangleEdgeFunction(triangle.v1, triangle.v2, p);
+                float w1 = TriangleEdgeFunction(triangle.v2, triangle.v0, p);
+                float w2 = TriangleEdgeFunction(triangle.v0, triangle.v1, p);
+
+                bool inside = clockwise ? (w0 <= 0 && w1 <= 0 && w2 <= 0)
+                                        : (w0 >= 0 && w1 >= 0 && w2 >= 0);
+                if (!inside) {
+                    continue;
+                }
+
+                int idx = y * frame->width + x;
+                float z = TriangleEvaluatePlane(triangle.planes, ATTR_Z, p.x,
+                                                p.y);
+                if (z >= r->zBuffer[idx]) {
+                    continue;
+                }
+
+                uint32_t color =
+                    Renderer_ShadeFragment(frame, triangle, x, y, z, &lodCache);
+
+                if (sorted) {
+                    target->pixels[idx] =
+                        BlendOver(target->pixels[idx], color);
+                } else {
+                    int local = (y - y0) * TILE_SIZE + (x - x0);
+                    Renderer_InsertFragment(fragments[local], &counts[local],
+                                            &target->pixels[idx], {z, color});
+                }
+            }
+        }
+    }
+
+    if (sorted || !anyFragments) {
+        return;
+    }
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int local = (y - y0) * TILE_SIZE + (x - x0);
+            int count = counts[local];
+            if (count == 0) {
+                continue;
+            }
+
+            // Insertion sort, farthest first
+            TransparentFragment *list = fragments[local];
+            for (int k = 1; k < count; k++) {
+                TransparentFragment frag = list[k];
+                int j = k;
+                for (; j > 0 && list[j - 1].z < frag.z; j--) {
+                    list[j] = list[j - 1];
+                }
+                list[j] = frag;
+            }
+
+            uint32_t *pixel = &target->pixels[y * frame->width + x];
+            for (int k = 0; k < count; k++) {
+                *pixel = BlendOver(*pixel, list[k].color);
+            }
+        }
+    }
+}
+
+Mat4 Renderer_ModelMatrix(Vec3 position, Vec3 rotation, Vec3 scale) {
+    Mat4 model = Mat4_Create();
+    model = Mat4_Rotate(model, rotation);
+    model = Mat4_Scale(model, scale);
+    model = Mat4_Translate(model, position);
+
+    return model;
+}
+
+// A view as draws see it: its projection and frustum, and the mapping of
+// NDC to its rectangle of the frame, which triangles are clipped to
+struct ViewTransform {
+    Mat4 viewProj;
+    Frustum frustum;
+    float x, y;
+    float halfWidth, halfHeight;
+    int minX, minY, maxX, maxY;
+};
+
+// A view a draw is visible in, with the draw's stored -> clip transform
+struct DrawView {
+    Mat4 modelViewProj;
+    const ViewTransform *view;
+    uint8_t index;
+};
+
+// World -> clip of camera for a viewport of the given aspect ratio
+static Mat4 Renderer_CameraViewProjection(Camera camera, float aspect) {
+    Mat4 view = Camera_GetViewMatrix(&camera);
+    // Mat4 view = Mat4_Create();
+    // view = Mat4_Translate(view, {0.0f, 0.0f, -3.0f});
+    Mat4 projection = Mat4_Perspective(DegToRadians(camera.zoom), aspect,
+                                       0.1f, 100.0f);
+
+    // World -> View -> Clip (Projection)
+    return Mat4_Mult(view, projection);
+}
+
+Mat4 Renderer_ViewProjection(Renderer *r) {
+    if (r->numViews == 1) {
+        return RenderView_ViewProjection(&r->views[0]);
+    }
+    return Renderer_CameraViewProjection(r->camera,
+                                         (float)r->width / r->height);
+}
+
+Mat4 RenderView_ViewProjection(const RenderView *view) {
+    return Renderer_CameraViewProjection(view->camera,
+                                         (float)view->width / view->height);
+}
+
+void Renderer_SetViews(Renderer *r, const RenderView *views, int count) {
+    if (r == nullptr) {
+        return;
+    }
+
+    r->numViews = std::clamp(count, 0, MAX_VIEWS);
+    std::copy(views, views + r->numViews, r->views);
+}
+
+// Views the draws of the frame are projected into: the renderer's camera
+// over the whole frame, or Renderer.views
+static int Renderer_ViewTransforms(const Renderer *r,
+                                   ViewTransform views[MAX_VIEWS]) {
+    if (r->numViews == 0) {
+        Mat4 viewProj = Renderer_ViewProjection((Renderer *)r);
+        views[0] = {
+            .viewProj = viewProj,
+            .frustum = Frustum_FromMatrix(viewProj),
+            .halfWidth = (float)r->width / 2,
+            .halfHeight = (float)r->height / 2,
+            .maxX = r->width - 1,
+            .maxY = r->height - 1,
+        };
+        return 1;
+    }
+
+    for (int v = 0; v < r->numViews; v++) {
+        const RenderView *view = &r->views[v];
+        Mat4 viewProj = RenderView_ViewProjection(view);
+        views[v] = {
+            .viewProj = viewProj,
+            .frustum = Frustum_FromMatrix(viewProj),
+            .x = (float)view->x,
+            .y = (float)view->y,
+            .halfWidth = (float)view->width / 2,
+            .halfHeight = (float)view->height / 2,
+            .minX = std::max(view->x, 0),
+            .minY = std::max(view->y, 0),
+            .maxX = std::min(view->x + view->width, r->width) - 1,
+            .maxY = std::min(view->y + view->height, r->height) - 1,
+        };
+    }
+    return r->numViews;
+}
+
+// Views whose frustum the world space box overlaps, bit v for view v
+static uint32_t Renderer_CullViews(const ViewTransform *views, int numViews,
+                                   Vec3 min, Vec3 max) {
+    uint32_t mask = 0;
+    for (int v = 0; v < numViews; v++) {
+        mask |= (uint32_t)Frustum_TestAABB(&views[v].frustum, min, max) << v;
+    }
+    return mask;
+}
+
+// Depth-only copy of a triangle in shadow map space, light holds the
+// vertices' texel positions and light depths
+static Triangle Renderer_ShadowCaster(const ShadowMap *shadow,
+                                      const Vec3 light[3]) {
+    Triangle caster = {
+        .v0 = {light[0].x, light[0].y},
+        .v1 = {light[1].x, light[1].y},
+        .v2 = {light[2].x, light[2].y},
+        .min = {(float)std::max(0, (int)std::floor(std::min(
+                                       {light[0].x, light[1].x, light[2].x}))),
+                (float)std::max(0, (int)std::floor(std::min(
+                                       {light[0].y, light[1].y, light[2].y})))},
+        .max = {(float)std::min(shadow->size - 1,
+                                (int)std::ceil(std::max(
+                                    {light[0].x, light[1].x, light[2].x}))),
+                (float)std::min(shadow->size - 1,
+                                (int)std::ceil(std::max(
+                                    {light[0].y, light[1].y, light[2].y})))},
+        .area = TriangleEdgeFunction({light[0].x, light[0].y},
+                                     {light[1].x, light[1].y},
+                                     {light[2].x, light[2].y}),
+    };
+
+    float invArea = caster.area != 0.0f ? 1.0f / caster.area : 0.0f;
+    TriangleSetPlane(&caster, ATTR_Z, light[0].z, light[1].z, light[2].z,
+                     invArea);
+    return caster;
+}
+
+// Triangles Renderer_TransformTriangles writes for length vertices
+static int Renderer_TriangleCount(int length) { return (length + 2) / 3; }
+
+// Whether triangles of this color are drawn into the shadow map
+static bool Renderer_CastsShadow(const Renderer *r, ColorRGBA color) {
+    return r->shadow.enabled && color.a >= 1.0f;
+}
+
+// Multiply-xorshift hash for change tracking, fed 8 bytes at a time
+static inline uint64_t Hash_Mix(uint64_t h, uint64_t value) {
+    h = (h ^ value) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 32);
+}
+
+uint64_t Renderer_HashBytes(uint64_t h, const void *data, size_t bytes) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (; bytes >= 8; p += 8, bytes -= 8) {
+        uint64_t value;
+        memcpy(&value, p, 8);
+        h = Hash_Mix(h, value);
+    }
+    if (bytes > 0) {
+        uint64_t value = 0;
+        memcpy(&value, p, bytes);
+        h = Hash_Mix(h, value);
+    }
+    return h;
+}
+
+uint64_t Renderer_HashVertices(const void *vertices, size_t bytes) {
+    uint64_t h = Hash_Mix(0, bytes);
+    if (bytes <= INCREMENTAL_HASHED_VERTEX_BYTES) {
+        return Renderer_HashBytes(h, vertices, bytes);
+    }
+    return Hash_Mix(h, (uint64_t)(uintptr_t)vertices);
+}
+
+// Everything of a triangle the raster stage reads, skipping padding
+static uint64_t Hash_Triangle(uint64_t h, const Triangle &t) {
+    h = Renderer_HashBytes(h, &t.v0, offsetof(Triangle, micro));
+    h = Hash_Mix(h, t.micro | t.transparent << 1);
+    h = Renderer_HashBytes(h, &t.planes, sizeof(t.planes));
+    h = Renderer_HashBytes(h, &t.color, sizeof(t.color));
+    return Hash_Mix(h, (uint64_t)(uintptr_t)t.texture);
+}
+
+// Starts a draw of the frame's next triangles, for incremental frames
+static void Renderer_RecordDraw(RenderFrame *frame, uint64_t hash) {
+    *ArenaArray_Push(&frame->arena, &frame->draws) = {
+        .firstTriangle = frame->triangles.count,
+        .hash = hash,
+    };
+}
+
+// Vertex as read by Renderer_TransformTriangles. Stored positions go
+// through the transforms as they are, so decoding quantized ones is folded
+// into the matrices
+struct TransformVertex {
+    Vec4 position;
+    Vec3 normal;
+    Vec2 uv;
+};
+
+// Renderer_DrawTriangles layout: size floats per vertex, position + normal
+// and optionally uv
+struct FloatVertexReader {
+    const float *vertices;
+    int size;
+
+    TransformVertex Read(int index) const {
+        const float *v = vertices + index * size;
+        TransformVertex vertex = {
+            .position = {v[0], v[1], v[2], 1.0f},
+            .normal = {v[3], v[4], v[5]},
+            .uv = {},
+        };
+        if (size >= 8) {
+            vertex.uv = {v[6], v[7]};
+        }
+        return vertex;
+    }
+
+    bool HasColors() const { return false; }
+    ColorRGBA Color(int) const { return {1, 1, 1, 1}; }
+
+    uint64_t Hash(int length) const {
+        return Hash_Mix(Renderer_HashVertices(
+                            vertices, (size_t)length * size * sizeof(float)),
+                        size);
+    }
+};
+
+// PackedMesh layout, specialized on the formats so decoding has no
+// branches. Loads go through memcpy, the vertices are only aligned to their
+// largest component
+template <PositionFormat POSITION, NormalFormat NORMAL, UVFormat UV>
+struct PackedVertexReader {
+    const uint8_t *vertices;
+    VertexLayout layout;
+    Vec2 uvOffset, uvScale;
+
+    TransformVertex Read(int index) const {
+        const uint8_t *v = vertices + index * layout.stride;
+        TransformVertex vertex = {.position = {0, 0, 0, 1.0f}};
+
+        if (POSITION == POSITION_FLOAT32) {
+            memcpy(&vertex.position, v, 3 * sizeof(float));
+        } else {
+            uint16_t q[3];
+            memcpy(q, v, sizeof(q));
+            vertex.position = {(float)q[0], (float)q[1], (float)q[2], 1.0f};
+        }
+
+        const uint8_t *normal = v + layout.normalOffset;
+        if (NORMAL == NORMAL_FLOAT32) {
+            memcpy(&vertex.normal, normal, sizeof(Vec3));
+        } else if (NORMAL == NORMAL_OCT16) {
+            int16_t oct[2];
+            memcpy(oct, normal, sizeof(oct));
+            vertex.normal =
+                OctDecode(std::max(oct[0] * (1.0f / 32767.0f), -1.0f),
+                          std::max(oct[1] * (1.0f / 32767.0f), -1.0f));
+        } else {
+            int8_t oct[2];
+            memcpy(oct, normal, sizeof(oct));
+            vertex.normal = OctDecode(std::max(oct[0] * (1.0f / 127.0f), -1.0f),
+                                      std::max(oct[1] * (1.0f / 127.0f), -1.0f));
+        }
+
+        const uint8_t *uv = v + layout.uvOffset;
+        if (UV == UV_FLOAT32) {
+            memcpy(&vertex.uv, uv, sizeof(Vec2));
+        } else if (UV == UV_UNORM16) {
+            uint16_t q[2];
+            memcpy(q, uv, sizeof(q));
+            vertex.uv = {uvOffset.x + q[0] * uvScale.x,
+                         uvOffset.y + q[1] * uvScale.y};
+        }
+
+        return vertex;
+    }
+
+    bool HasColors() const { return layout.color == COLOR_UNORM8; }
+
+    ColorRGBA Color(int index) const {
+        const uint8_t *c = vertices + index * layout.stride + layout.colorOffset;
+        const float scale = 1.0f / 255.0f;
+        return {c[0] * scale, c[1] * scale, c[2] * scale, c[3] * scale};
+    }
+
+    uint64_t Hash(int length) const {
+        uint64_t h =
+            Renderer_HashVertices(vertices, (size_t)length * layout.stride);
+        h = Renderer_HashBytes(h, &layout, sizeof(layout));
+        h = Renderer_HashBytes(h, &uvOffset, sizeof(uvOffset));
+        return Renderer_HashBytes(h, &uvScale, sizeof(uvScale));
+    }
+};
+
+// Calls f with the PackedVertexReader matching the formats of mesh
+template <PositionFormat POSITION, NormalFormat NORMAL, UVFormat UV,
+          typename F>
+static void PackedVertexReader_Dispatch(const PackedMesh *mesh, const F &f) {
+    f(PackedVertexReader<POSITION, NORMAL, UV>{
+        .vertices = mesh->vertices.data(),
+        .layout = mesh->layout,
+        .uvOffset = mesh->uvOffset,
+        .uvScale = mesh->uvScale,
+    });
+}
+
+template <PositionFormat POSITION, NormalFormat NORMAL, typename F>
+static void PackedVertexReader_Dispatch(const PackedMesh *mesh, const F &f) {
+    switch (mesh->layout.uv) {
+    case UV_NONE:
+        PackedVertexReader_Dispatch<POSITION, NORMAL, UV_NONE>(mesh, f);
+        break;
+    case UV_FLOAT32:
+        PackedVertexReader_Dispatch<POSITION, NORMAL, UV_FLOAT32>(mesh, f);
+        break;
+    case UV_UNORM16:
+        PackedVertexReader_Dispatch<POSITION, NORMAL, UV_UNORM16>(mesh, f);
+        break;
+    }
+}
+
+template <PositionFormat POSITION, typename F>
+static void PackedVertexReader_Dispatch(const PackedMesh *mesh, const F &f) {
+    switch (mesh->layout.normal) {
+    case NORMAL_FLOAT32:
+        PackedVertexReader_Dispatch<POSITION, NORMAL_FLOAT32>(mesh, f);
+        break;
+    case NORMAL_OCT16:
+        PackedVertexReader_Dispatch<POSITION, NORMAL_OCT16>(mesh, f);
+        break;
+    case NORMAL_OCT8:
+        PackedVertexReader_Dispatch<POSITION, NORMAL_OCT8>(mesh, f);
+        break;
+    }
+}
+
+template <typename F>
+static void PackedVertexReader_Dispatch(const PackedMesh *mesh, const F &f) {
+    if (mesh->layout.position == POSITION_FLOAT32) {
+        PackedVertexReader_Dispatch<POSITION_FLOAT32>(mesh, f);
+    } else {
+        PackedVertexReader_Dispatch<POSITION_UNORM16>(mesh, f);
+    }
+}
+
+// Nearest multiple of 1 / SUBPIXEL_STEPS pixel
+static inline float Renderer_SnapSubpixel(float x) {
+    return roundf(x * SUBPIXEL_STEPS) * (1.0f / SUBPIXEL_STEPS);
+}
+
+// Vertex stage: stored vertices -> screen space triangles. Every three
+// vertices of length are read once and projected into each of the numViews
+// views, writing numViews triangles in a row to out. A view's
+// modelViewProj maps stored positions to its clip space in one transform.
+// With lightModelViewProj (stored -> shadow light clip space) the triangles
+// get their shadow map planes, and shadowOut, when not null, receives one
+// caster per three vertices. Vertex colors are flat, the first vertex of a
+// triangle modulates color
+template <typename Reader>
+static void Renderer_TransformTriangles(Renderer *r, const Reader &reader,
+                                        int length, const DrawView *views,
+                                        int numViews, ColorRGBA drawColor,
+                                        const Texture *texture, Triangle *out,
+                                        const Mat4 *lightModelViewProj,
+                                        Triangle *shadowOut) {
+    float halfShadow = r->shadow.size * 0.5f;
+    // The micro path covers a single 4x4 block
+    float microSize = std::min(r->microTriangleSize, MICRO_TRIANGLE_SIZE);
+
+    for (int i = 0; i < length; i += 3) {
+        TransformVertex vertices[3] = {reader.Read(i), reader.Read(i + 1),
+                                       reader.Read(i + 2)};
+
+        Vec4 local[3] = {vertices[0].position, vertices[1].position,
+                         vertices[2].position};
+
+        Vec3 v1Norm = vertices[0].normal;
+        Vec3 v2Norm = vertices[1].normal;
+        Vec3 v3Norm = vertices[2].normal;
+
+        Vec2 v1UV = vertices[0].uv;
+        Vec2 v2UV = vertices[1].uv;
+        Vec2 v3UV = vertices[2].uv;
+
+        ColorRGBA color = drawColor;
+        if (reader.HasColors()) {
+            ColorRGBA c = reader.Color(i);
+            color = {color.r * c.r, color.g * c.g, color.b * c.b,
+                     color.a * c.a};
+        }
+
+        // Local -> shadow map texels and depth, the orthographic light keeps
+        // w at 1. Shared by every view
+        Vec3 light[3];
+        if (lightModelViewProj != nullptr) {
+            for (int k = 0; k < 3; k++) {
+                Vec4 clip = Vec4_Transform(local[k], *lightModelViewProj);
+                light[k] = {halfShadow * (clip.x + 1.0f),
+                            halfShadow * (1.0f - clip.y),
+                            (clip.z + 1.0f) * 0.5f};
+            }
+            if (shadowOut != nullptr) {
+                *shadowOut++ = Renderer_ShadowCaster(&r->shadow, light);
+            }
+        }
+
+        for (int v = 0; v < numViews; v++) {
+            const ViewTransform &view = *views[v].view;
+
+            // Local -> Clip
+            Vec4 v1 = Vec4_Transform(local[0], views[v].modelViewProj);
+            Vec4 v2 = Vec4_Transform(local[1], views[v].modelViewProj);
+            Vec4 v3 = Vec4_Transform(local[2], views[v].modelViewProj);
+
+            // TODO: Handle the offscreen vertices later on the draw call
+            // if (v1.w <= 0.0f) {
+            //     // Offscreen marker
+            //     vertices[i] = -1.0f;
+            //     vertices[i + 1] = -1.0f;
+            //     vertices[i + 2] = -1.0f;
+            //     continue;
+            // }
+
+            // Clip -> NDC (Perspective Divide)
+            v1.x = v1.x / v1.w;
+            v1.y = v1.y / v1.w;
+            v1.z = v1.z / v1.w;
+
+            v2.x = v2.x / v2.w;
+            v2.y = v2.y / v2.w;
+            v2.z = v2.z / v2.w;
+
+            v3.x = v3.x / v3.w;
+            v3.y = v3.y / v3.w;
+            v3.z = v3.z / v3.w;
+
+            // NDC -> Screen
+            v1.x = view.halfWidth * (v1.x + 1.0f);
+            v1.y = view.halfHeight * (1.0f - v1.y);
+            v1.z = (v1.z + 1.0f) * 0.5;
+
+            v2.x = view.halfWidth * (v2.x + 1.0f);
+            v2.y = view.halfHeight * (1.0f - v2.y);
+            v2.z = (v2.z + 1.0f) * 0.5;
+
+            v3.x = view.halfWidth * (v3.x + 1.0f);
+            v3.y = view.halfHeight * (1.0f - v3.y);
+            v3.z = (v3.z + 1.0f) * 0.5;
+
+            // Snapped to the subpixel grid, so moving a vertex by whole
+            // pixels is exact and a region of the frame rendered on its own
+            // covers the same pixels as in the whole frame
+            v1.x = Renderer_SnapSubpixel(v1.x);
+            v1.y = Renderer_SnapSubpixel(v1.y);
+            v2.x = Renderer_SnapSubpixel(v2.x);
+            v2.y = Renderer_SnapSubpixel(v2.y);
+            v3.x = Renderer_SnapSubpixel(v3.x);
+            v3.y = Renderer_SnapSubpixel(v3.y);
+
+            // Into the view's rectangle. Kept apart from the products above
+            // so they are never fused into a differently rounded FMA
+            v1.x += view.x;
+            v1.y += view.y;
+            v2.x += view.x;
+            v2.y += view.y;
+            v3.x += view.x;
+            v3.y += view.y;
+
+            // Clipped to the rectangle, so views never draw into each other
+            Vec2 vMin = {
+                (float)std::max(view.minX,
+                                static_cast<int>(std::floor(
+                                    std::min({v1.x, v2.x, v3.x})))),
+                (float)std::max(view.minY,
+                                static_cast<int>(std::floor(
+                                    std::min({v1.y, v2.y, v3.y})))),
+            };
+            Vec2 vMax = {
+                (float)std::min(view.maxX,
+                                static_cast<int>(std::ceil(
+                                    std::max({v1.x, v2.x, v3.x})))),
+                (float)std::min(view.maxY,
+                                static_cast<int>(std::ceil(
+                                    std::max({v1.y, v2.y, v3.y})))),
+            };
+
+            // Outside the view: binning skips it, so the planes are not
+            // set up
+            if (vMin.x > vMax.x || vMin.y > vMax.y) {
+                *out++ = {
+                    .min = vMin,
+                    .max = vMax,
+                    .transparent = color.a < 1.0f,
+                    .view = views[v].index,
+                };
+                continue;
+            }
+
+            Triangle triangle = {
+                .v0 = {v1.x, v1.y},
+                .v1 = {v2.x, v2.y},
+                .v2 = {v3.x, v3.y},
+                .min = vMin,
+                .max = vMax,
+                .area = TriangleEdgeFunction({v1.x, v1.y}, {v2.x, v2.y},
+                                             {v3.x, v3.y}),
+                .micro = vMax.x - vMin.x < microSize &&
+                         vMax.y - vMin.y < microSize && color.a >= 1.0f,
+                .transparent = color.a < 1.0f,
+                .view = views[v].index,
+                .color = color,
+                .texture = texture,
+            };
+
+            // Attribute planes. v.w still holds the clip w
+            float invArea =
+                triangle.area != 0.0f ? 1.0f / triangle.area : 0.0f;
+            Vec3 invW = {1.0f / v1.w, 1.0f / v2.w, 1.0f / v3.w};
+            TriangleSetPlane(&triangle, ATTR_Z, v1.z, v2.z, v3.z, invArea);
+            TriangleSetPlane(&triangle, ATTR_INV_W, invW.x, invW.y, invW.z,
+                             invArea);
+            TriangleSetPlane(&triangle, ATTR_NORMAL_X, v1Norm.x * invW.x,
+                             v2Norm.x * invW.y, v3Norm.x * invW.z, invArea);
+            TriangleSetPlane(&triangle, ATTR_NORMAL_Y, v1Norm.y * invW.x,
+                             v2Norm.y * invW.y, v3Norm.y * invW.z, invArea);
+            TriangleSetPlane(&triangle, ATTR_NORMAL_Z, v1Norm.z * invW.x,
+                             v2Norm.z * invW.y, v3Norm.z * invW.z, invArea);
+            TriangleSetPlane(&triangle, ATTR_U, v1UV.x * invW.x,
+                             v2UV.x * invW.y, v3UV.x * invW.z, invArea);
+            TriangleSetPlane(&triangle, ATTR_V, v1UV.y * invW.x,
+                             v2UV.y * invW.y, v3UV.y * invW.z, invArea);
+
+            if (lightModelViewProj != nullptr) {
+                TriangleSetPlane(&triangle, ATTR_LIGHT_X, light[0].x * invW.x,
+                                 light[1].x * invW.y, light[2].x * invW.z,
+                                 invArea);
+                TriangleSetPlane(&triangle, ATTR_LIGHT_Y, light[0].y * invW.x,
+                                 light[1].y * invW.y, light[2].y * invW.z,
+                                 invArea);
+                TriangleSetPlane(&triangle, ATTR_LIGHT_Z, light[0].z * invW.x,
+                                 light[1].z * invW.y, light[2].z * invW.z,
+                                 invArea);
+            }
+
+            *out++ = triangle;
+        }
+    }
+}
+
+#ifdef RENDERER_ISA_KERNEL
+#define RENDERER_TRANSFORM_VARIANT(name, isa)                                 \
+    template <typename Reader>                                                 \
+    RENDERER_ISA_KERNEL(isa)                                                   \
+    static void name(Renderer *r, const Reader &reader, int length,            \
+                     const DrawView *views, int numViews, ColorRGBA color,     \
+                     const Texture *texture, Triangle *out,                    \
+                     const Mat4 *lightModelViewProj, Triangle *shadowOut) {    \
+        Renderer_TransformTriangles(r, reader, length, views, numViews, color, \
+                                    texture, out, lightModelViewProj,          \
+                                    shadowOut);                                \
+    }
+
+RENDERER_TRANSFORM_VARIANT(Renderer_TransformTrianglesSSE42, "sse4.2")
+#endif
+
+// Renderer_TransformTriangles in the variant of r's instruction set
+template <typename Reader>
+static void Renderer_TransformTrianglesIsa(Renderer *r, const Reader &reader,
+                                           int length, const DrawView *views,
+                                           int numViews, ColorRGBA color,
+                                           const Texture *texture,
+                                           Triangle *out,
+                                           const Mat4 *lightModelViewProj,
+                                           Triangle *shadowOut) {
+    switch (r->isa) {
+#ifdef RENDERER_ISA_KERNEL
+    case RENDERER_ISA_SSE42:
+        Renderer_TransformTrianglesSSE42(r, reader, length, views, numViews,
+                                         color, texture, out,
+                                         lightModelViewProj, shadowOut);
+        return;
+#endif
+    default:
+        Renderer_TransformTriangles(r, reader, length, views, numViews, color,
+                                    texture, out, lightModelViewProj,
+                                    shadowOut);
+    }
+}
+
+// Stored -> clip transforms of a draw for the views of viewMask, returns
+// how many
+static int Renderer_DrawViews(const ViewTransform *views, int numViews,
+                              uint32_t viewMask, Mat4 decode, Mat4 model,
+                              DrawView drawViews[MAX_VIEWS]) {
+    int count = 0;
+    for (int v = 0; v < numViews; v++) {
+        if (viewMask & (1u << v)) {
+            // Stored -> Model -> World -> Clip
+            drawViews[count++] = {
+                .modelViewProj = Mat4_Mult(
+                    decode,
+                    Mat4_Mult(Mat4_Transpose(model), views[v].viewProj)),
+                .view = &views[v],
+                .index = (uint8_t)v,
+            };
+        }
+    }
+    return count;
+}
+
+// Appends the triangles of length stored vertices, and their shadow casters,
+// to the frame. decode maps stored positions to local space. Without views
+// set, bounds (the draw's world space box, may be null) is tested against
+// the occlusion buffer, with views it picks the views the draw is seen in
+template <typename Reader>
+static void Renderer_SubmitTriangles(Renderer *r, const Reader &reader,
+                                     int length, Mat4 decode, Mat4 model,
+                                     ColorRGBA color, const Texture *texture,
+                                     const Vec3 bounds[2]) {
+    ViewTransform views[MAX_VIEWS];
+    int numViews = Renderer_ViewTransforms(r, views);
+    uint32_t viewMask = (1u << numViews) - 1;
+
+    if (bounds != nullptr && r->numViews > 0) {
+        viewMask = Renderer_CullViews(views, numViews, bounds[0], bounds[1]);
+        if (viewMask == 0) {
+            return;
+        }
+    } else if (bounds != nullptr && r->occlusion != nullptr) {
+        r->occlusion->stats.tested++;
+        if (!Occlusion_TestAABB(r->occlusion, bounds[0], bounds[1])) {
+            r->occlusion->stats.culled++;
+            return;
+        }
+    }
+
+    DrawView drawViews[MAX_VIEWS];
+    int numDrawViews =
+        Renderer_DrawViews(views, numViews, viewMask, decode, model, drawViews);
+
+    Mat4 lightModelViewProj;
+    if (r->shadow.enabled) {
+        lightModelViewProj = Mat4_Mult(
+            decode, Mat4_Mult(Mat4_Transpose(model), r->shadow.viewProj));
+    }
+
+    RenderFrame *frame = r->frame;
+    if (frame->recordDraws) {
+        uint64_t h = reader.Hash(length);
+        h = Renderer_HashBytes(h, &decode, sizeof(decode));
+        h = Renderer_HashBytes(h, &model, sizeof(model));
+        h = Renderer_HashBytes(h, &color, sizeof(color));
+        Renderer_RecordDraw(frame, Hash_Mix(h, (uint64_t)(uintptr_t)texture));
+    }
+
+    int numTriangles = Renderer_TriangleCount(length);
+    Triangle *out = ArenaArray_Push(&frame->arena, &frame->triangles,
+                                    numTriangles * numDrawViews);
+    Triangle *shadowOut = nullptr;
+    if (Renderer_CastsShadow(r, color)) {
+        shadowOut = ArenaArray_Push(&frame->arena, &frame->shadowTriangles,
+                                    numTriangles);
+    }
+
+    Renderer_TransformTrianglesIsa(
+        r, reader, length, drawViews, numDrawViews, color, texture, out,
+        r->shadow.enabled ? &lightModelViewProj : nullptr, shadowOut);
+}
+
+void Renderer_DrawTriangles(Renderer *r, float *vertices, int length, int size,
+                            Vec3 position, Vec3 rotation, Vec3 scale,
+                            ColorRGBA color, const Texture *texture) {
+    Mat4 model = Renderer_ModelMatrix(position, rotation, scale);
+
+    // The bounds cost a pass over the vertices, taken only when culled
+    Vec3 bounds[2];
+    bool culled =
+        (r->occlusion != nullptr || r->numViews > 0) && length > 0;
+    if (culled) {
+        Vec3 min = {vertices[0], vertices[1], vertices[2]};
+        Vec3 max = min;
+        for (int i = size; i < length * size; i += size) {
+            min = {std::min(min.x, vertices[i]),
+                   std::min(min.y, vertices[i + 1]),
+                   std::min(min.z, vertices[i + 2])};
+            max = {std::max(max.x, vertices[i]),
+                   std::max(max.y, vertices[i + 1]),
+                   std::max(max.z, vertices[i + 2])};
+        }
+        Mat4_TransformAABB(model, min, max, &bounds[0], &bounds[1]);
+    }
 
-    r.pixels = new uint32_t[w * h];
-    r.zBuffer = new float[w * h];
+    Renderer_SubmitTriangles(r, FloatVertexReader{vertices, size}, length,
+                             Mat4_Create(), model, color, texture,
+                             culled ? bounds : nullptr);
+}
 
-    r.ready = true;
+void Renderer_DrawPackedMesh(Renderer *r, const PackedMesh *mesh,
+                             Vec3 position, Vec3 rotation, Vec3 scale,
+                             ColorRGBA color, const Texture *texture) {
+    Mat4 model = Renderer_ModelMatrix(position, rotation, scale);
 
-    return r;
+    Vec3 bounds[2];
+    Mat4_TransformAABB(model, mesh->min, mesh->max, &bounds[0], &bounds[1]);
+
+    Mat4 decode = PackedMesh_PositionDecode(mesh);
+    PackedVertexReader_Dispatch(mesh, [&](const auto &reader) {
+        Renderer_SubmitTriangles(r, reader, mesh->numVertices, decode, model,
+                                 color, texture,
+                                 mesh->numVertices > 0 ? bounds : nullptr);
+    });
 }
 
-void Renderer_Destroy(Renderer *r) {
-    if (r == nullptr) {
+// Renderer_DrawInstanced for Mesh and PackedMesh, reader reads the mesh's
+// vertices and decode maps them to local space
+template <typename MeshType, typename Reader>
+static void Renderer_DrawInstancedMesh(Renderer *r, const MeshType *mesh,
+                                       const Reader &reader, Mat4 decode,
+                                       const Mat4 *transforms,
+                                       const ColorRGBA *colors, int count,
+                                       const Texture *texture) {
+    if (r == nullptr || r->frame == nullptr || count <= 0) {
         return;
     }
 
-    delete[] r->pixels;
-    delete[] r->zBuffer;
-}
+    RenderFrame *frame = r->frame;
+    ViewTransform views[MAX_VIEWS];
+    int numViews = Renderer_ViewTransforms(r, views);
+    // The occlusion buffer is built from Renderer.camera
+    bool occlusion = r->occlusion != nullptr && r->numViews == 0;
 
-void Renderer_ClearBackground(Renderer *r, uint32_t color) {
-    if (r == nullptr) {
-        return;
+    auto instanceColor = [&](int i) {
+        return colors != nullptr ? colors[i] : ColorRGBA{1, 1, 1, 1};
+    };
+
+    // Instances are culled per view, then transformed, in fixed-size
+    // chunks. visible[i] has bit v set when instance i is seen by view v
+    int numChunks = (count + INSTANCE_CHUNK_SIZE - 1) / INSTANCE_CHUNK_SIZE;
+    uint8_t *visible = Arena_AllocArray<uint8_t>(&frame->arena, count);
+
+    std::atomic<uint32_t> occlusionTested(0);
+    std::atomic<uint32_t> occlusionCulled(0);
+
+    ThreadPool_ParallelFor(r->pool, numChunks, [&](int c) {
+        uint32_t tested = 0;
+        uint32_t culled = 0;
+
+        int end = std::min((c + 1) * INSTANCE_CHUNK_SIZE, count);
+        for (int i = c * INSTANCE_CHUNK_SIZE; i < end; i++) {
+            Vec3 center;
+            float radius;
+            Mesh_WorldSphere(mesh, transforms[i], &center, &radius);
+
+            uint8_t mask = 0;
+            for (int v = 0; v < numViews; v++) {
+                mask |= Frustum_TestSphere(&views[v].frustum, center, radius)
+                        << v;
+            }
+            visible[i] = 0;
+            if (mask == 0) {
+                continue;
+            }
+
+            if (occlusion) {
+                Vec3 min, max;
+                Mat4_TransformAABB(transforms[i], mesh->min, mesh->max, &min,
+                                   &max);
+                tested++;
+                if (!Occlusion_TestAABB(r->occlusion, min, max)) {
+                    culled++;
+                    continue;
+                }
+            }
+
+            visible[i] = mask;
+        }
+
+        occlusionTested += tested;
+        occlusionCulled += culled;
+    });
+
+    if (occlusion) {
+        r->occlusion->stats.tested += occlusionTested;
+        r->occlusion->stats.culled += occlusionCulled;
     }
 
-    for (int i = 0; i < r->width * r->height; i++) {
-        r->pixels[i] = color;
-        r->zBuffer[i] = std::numeric_limits<float>::infinity();
+    // Every visible instance writes all mesh triangles per view it is seen
+    // in, and as many casters as triangles when opaque, so each chunk's
+    // output range is known before the transform and the workers write
+    // straight into the frame's lists in submission order
+    int numTriangles = Renderer_TriangleCount(mesh->numVertices);
+    uint32_t *offsets = Arena_AllocArray<uint32_t>(&frame->arena, numChunks);
+    uint32_t *shadowOffsets =
+        Arena_AllocArray<uint32_t>(&frame->arena, numChunks);
+    uint32_t total = 0;
+    uint32_t shadowTotal = 0;
+    uint64_t drawHash = 0;
+    if (frame->recordDraws) {
+        drawHash = reader.Hash(mesh->numVertices);
+        drawHash = Renderer_HashBytes(drawHash, &decode, sizeof(decode));
+        drawHash = Hash_Mix(drawHash, (uint64_t)(uintptr_t)texture);
+    }
+    for (int c = 0; c < numChunks; c++) {
+        offsets[c] = total;
+        shadowOffsets[c] = shadowTotal;
+
+        int end = std::min((c + 1) * INSTANCE_CHUNK_SIZE, count);
+        for (int i = c * INSTANCE_CHUNK_SIZE; i < end; i++) {
+            if (visible[i] && frame->recordDraws) {
+                // Every instance is a draw of its own
+                ColorRGBA color = instanceColor(i);
+                uint64_t h = Renderer_HashBytes(drawHash, &transforms[i],
+                                                sizeof(Mat4));
+                *ArenaArray_Push(&frame->arena, &frame->draws) = {
+                    .firstTriangle = frame->triangles.count + total,
+                    .hash = Renderer_HashBytes(h, &color, sizeof(color)),
+                };
+            }
+            if (visible[i]) {
+                total += numTriangles * __builtin_popcount(visible[i]);
+                shadowTotal +=
+                    Renderer_CastsShadow(r, instanceColor(i)) ? numTriangles
+                                                              : 0;
+            }
+        }
     }
+
+    Triangle *out = ArenaArray_Push(&frame->arena, &frame->triangles, total);
+    Triangle *shadowOut =
+        ArenaArray_Push(&frame->arena, &frame->shadowTriangles, shadowTotal);
+
+    ThreadPool_ParallelFor(r->pool, numChunks, [&](int c) {
+        Triangle *chunkOut = out + offsets[c];
+        Triangle *chunkShadowOut = shadowOut + shadowOffsets[c];
+
+        int end = std::min((c + 1) * INSTANCE_CHUNK_SIZE, count);
+        for (int i = c * INSTANCE_CHUNK_SIZE; i < end; i++) {
+            if (!visible[i]) {
+                continue;
+            }
+
+            DrawView drawViews[MAX_VIEWS];
+            int numDrawViews = Renderer_DrawViews(
+                views, numViews, visible[i], decode, transforms[i], drawViews);
+            ColorRGBA color = instanceColor(i);
+
+            Mat4 lightModelViewProj;
+            if (r->shadow.enabled) {
+                lightModelViewProj =
+                    Mat4_Mult(decode, Mat4_Mult(Mat4_Transpose(transforms[i]),
+                                                r->shadow.viewProj));
+            }
+
+            bool casts = Renderer_CastsShadow(r, color);
+            Renderer_TransformTrianglesIsa(
+                r, reader, mesh->numVertices, drawViews, numDrawViews, color,
+                texture, chunkOut,
+                r->shadow.enabled ? &lightModelViewProj : nullptr,
+                casts ? chunkShadowOut : nullptr);
+
+            chunkOut += numTriangles * numDrawViews;
+            if (casts) {
+                chunkShadowOut += numTriangles;
+            }
+        }
+    });
 }
 
-void Renderer_SetPixel(Renderer *r, int x, int y, float z, uint32_t color) {
-    if (r == nullptr) {
-        return;
+void Renderer_DrawInstanced(Renderer *r, const Mesh *mesh,
+                            const Mat4 *transforms, const ColorRGBA *colors,
+                            int count, const Texture *texture) {
+    Renderer_DrawInstancedMesh(
+        r, mesh, FloatVertexReader{mesh->vertices.data(), (int)mesh->vertexSize},
+        Mat4_Create(), transforms, colors, count, texture);
+}
+
+void Renderer_DrawInstanced(Renderer *r, const PackedMesh *mesh,
+                            const Mat4 *transforms, const ColorRGBA *colors,
+                            int count, const Texture *texture) {
+    Mat4 decode = PackedMesh_PositionDecode(mesh);
+    PackedVertexReader_Dispatch(mesh, [&](const auto &reader) {
+        Renderer_DrawInstancedMesh(r, mesh, reader, decode, transforms, colors,
+                                   count, texture);
+    });
+}
+
+// A palette matrix by columns, the translation in the last
+struct SkinBone {
+    Float4 columns[4];
+};
+
+// Skins vertices [first, end) of mesh into out (the mesh's layout) and
+// returns their bounds. Every vertex blends the columns of its bones, so
+// positions and normals are transformed four lanes at a time. Normals
+// assume bones without non-uniform scale and are left unnormalized, as the
+// lighting normalizes them
+static void Renderer_SkinVertices(const SkinBone *palette,
+                                  const SkinnedMesh *mesh, int first, int end,
+                                  float *out, Vec3 bounds[2]) {
+    const int size = mesh->mesh.vertexSize;
+    Vec3 min = {INFINITY, INFINITY, INFINITY};
+    Vec3 max = {-INFINITY, -INFINITY, -INFINITY};
+
+    for (int i = first; i < end; i++) {
+        const uint8_t *bones = &mesh->bones[i * SKIN_MAX_INFLUENCES];
+        const float *weights = &mesh->weights[i * SKIN_MAX_INFLUENCES];
+
+        const SkinBone &bone = palette[bones[0]];
+        Float4 c0 = bone.columns[0] * weights[0];
+        Float4 c1 = bone.columns[1] * weights[0];
+        Float4 c2 = bone.columns[2] * weights[0];
+        Float4 c3 = bone.columns[3] * weights[0];
+        for (int k = 1; k < SKIN_MAX_INFLUENCES; k++) {
+            const SkinBone &b = palette[bones[k]];
+            c0 += b.columns[0] * weights[k];
+            c1 += b.columns[1] * weights[k];
+            c2 += b.columns[2] * weights[k];
+            c3 += b.columns[3] * weights[k];
+        }
+
+        const float *v = &mesh->mesh.vertices[i * size];
+        Float4 position = c0 * v[0] + c1 * v[1] + c2 * v[2] + c3;
+        Float4 normal = c0 * v[3] + c1 * v[4] + c2 * v[5];
+        min = {std::min(min.x, position[0]), std::min(min.y, position[1]),
+               std::min(min.z, position[2])};
+        max = {std::max(max.x, position[0]), std::max(max.y, position[1]),
+               std::max(max.z, position[2])};
+
+        float *o = out + i * size;
+        memcpy(o, &position, 3 * sizeof(float));
+        memcpy(o + 3, &normal, 3 * sizeof(float));
+        for (int k = 6; k < size; k++) {
+            o[k] = v[k];
+        }
     }
 
-    if (x < 0 || x >= r->width || y < 0 || y >= r->height)
+    bounds[0] = min;
+    bounds[1] = max;
+}
+
+#ifdef RENDERER_ISA_KERNEL
+RENDERER_ISA_KERNEL("sse4.2")
+static void Renderer_SkinVerticesSSE42(const SkinBone *palette,
+                                       const SkinnedMesh *mesh, int first,
+                                       int end, float *out, Vec3 bounds[2]) {
+    Renderer_SkinVertices(palette, mesh, first, end, out, bounds);
+}
+#endif
+
+// Renderer_SkinVertices in the variant of isa
+static void Renderer_SkinVerticesIsa(RendererIsa isa, const SkinBone *palette,
+                                     const SkinnedMesh *mesh, int first,
+                                     int end, float *out, Vec3 bounds[2]) {
+    switch (isa) {
+#ifdef RENDERER_ISA_KERNEL
+    case RENDERER_ISA_SSE42:
+        Renderer_SkinVerticesSSE42(palette, mesh, first, end, out, bounds);
         return;
+#endif
+    default:
+        Renderer_SkinVertices(palette, mesh, first, end, out, bounds);
+    }
+}
 
-    int idx = y * r->width + x;
+// Skinned vertices in the frame's arena. They move with the palette while
+// their address may repeat across frames, so the palette identifies them
+// for incremental frames rather than their contents
+struct SkinnedVertexReader {
+    FloatVertexReader vertices;
+    uint64_t hash;
+
+    TransformVertex Read(int index) const { return vertices.Read(index); }
+    bool HasColors() const { return false; }
+    ColorRGBA Color(int) const { return {1, 1, 1, 1}; }
+    uint64_t Hash(int) const { return hash; }
+};
+
+// The vertices of mesh posed by palette, skinned now unless an earlier draw
+// of the frame did
+static const SkinnedVertices *Renderer_SkinMesh(Renderer *r,
+                                                const SkinnedMesh *mesh,
+                                                const Mat4 *palette) {
+    RenderFrame *frame = r->frame;
+    uint64_t hash = Renderer_HashBytes(
+        Hash_Mix(0, (uint64_t)(uintptr_t)mesh), palette,
+        mesh->numBones * sizeof(Mat4));
+    for (uint32_t i = 0; i < frame->skinned.count; i++) {
+        const SkinnedVertices &skinned = frame->skinned.data[i];
+        if (skinned.mesh == mesh && skinned.hash == hash) {
+            r->skinReuses++;
+            return &skinned;
+        }
+    }
 
-    if (z < r->zBuffer[idx]) {
-        r->zBuffer[idx] = z;
-        r->pixels[idx] = color;
+    // Renderer_ModelMatrix rows -> columns
+    SkinBone *bones =
+        Arena_AllocArray<SkinBone>(&frame->arena, mesh->numBones);
+    for (int b = 0; b < mesh->numBones; b++) {
+        const float *m = palette[b].data;
+        for (int c = 0; c < 4; c++) {
+            bones[b].columns[c] = Float4{m[c], m[4 + c], m[8 + c], 0.0f};
+        }
     }
+
+    int count = mesh->mesh.numVertices;
+    int numChunks = (count + SKIN_CHUNK_SIZE - 1) / SKIN_CHUNK_SIZE;
+    float *vertices = Arena_AllocArray<float>(
+        &frame->arena, (size_t)count * mesh->mesh.vertexSize);
+    Vec3 *chunkBounds = Arena_AllocArray<Vec3>(&frame->arena, numChunks * 2);
+    ThreadPool_ParallelFor(r->pool, numChunks, [&](int c) {
+        Renderer_SkinVerticesIsa(r->isa, bones, mesh, c * SKIN_CHUNK_SIZE,
+                                 std::min((c + 1) * SKIN_CHUNK_SIZE, count),
+                                 vertices, &chunkBounds[c * 2]);
+    });
+    r->skinnedVertices += count;
+
+    SkinnedVertices *skinned =
+        ArenaArray_Push(&frame->arena, &frame->skinned);
+    *skinned = {
+        .mesh = mesh,
+        .hash = hash,
+        .vertices = vertices,
+        .min = chunkBounds[0],
+        .max = chunkBounds[1],
+    };
+    for (int c = 1; c < numChunks; c++) {
+        const Vec3 &min = chunkBounds[c * 2];
+        const Vec3 &max = chunkBounds[c * 2 + 1];
+        skinned->min = {std::min(skinned->min.x, min.x),
+                        std::min(skinned->min.y, min.y),
+                        std::min(skinned->min.z, min.z)};
+        skinned->max = {std::max(skinned->max.x, max.x),
+                        std::max(skinned->max.y, max.y),
+                        std::max(skinned->max.z, max.z)};
+    }
+    return skinned;
 }
 
-void Renderer_DrawCube(Renderer *r, Vec3 position, Vec3 rotation, Vec3 scale,
-                       ColorRGBA color) {
-    if (r == nullptr) {
+void Renderer_DrawSkinned(Renderer *r, const SkinnedMesh *mesh,
+                          const Mat4 *palette, Vec3 position, Vec3 rotation,
+                          Vec3 scale, ColorRGBA color, const Texture *texture) {
+    if (r == nullptr || r->frame == nullptr || mesh->mesh.numVertices == 0) {
         return;
     }
 
-    CubeMesh mesh = CreateCubeMesh();
+    const SkinnedVertices *skinned = Renderer_SkinMesh(r, mesh, palette);
+    Mat4 model = Renderer_ModelMatrix(position, rotation, scale);
 
-    Renderer_DrawTriangles(r, mesh.vertices, mesh.numVertices, mesh.vertexSize,
-                           position, rotation, scale, color);
+    // The posed bounds come with the skinning, so occlusion and views always
+    // get them
+    Vec3 bounds[2];
+    Mat4_TransformAABB(model, skinned->min, skinned->max, &bounds[0],
+                       &bounds[1]);
+
+    SkinnedVertexReader reader = {
+        .vertices = {skinned->vertices, (int)mesh->mesh.vertexSize},
+        .hash = Hash_Mix(skinned->hash, mesh->mesh.vertexSize),
+    };
+    Renderer_SubmitTriangles(r, reader, mesh->mesh.numVertices, Mat4_Create(),
+                             model, color, texture, bounds);
 }
 
-void Renderer_DrawQuad(Renderer *r, Vec3 position, Vec3 rotation, Vec3 scale,
-                       ColorRGBA color) {
-    if (r == nullptr) {
-        return;
+int Renderer_SelectLod(Renderer *r, const MeshLods *lods, Mat4 model,
+                       int previous) {
+    Vec3 center;
+    float radius;
+    Mesh_WorldSphere(&lods->levels[0], model, &center, &radius);
+
+    float distance = Vec3_Mag(Vec3_Subtract(center, r->camera.position));
+    if (distance <= radius) {
+        return 0;
     }
 
-    QuadMesh mesh = CreateQuadMesh();
+    // Projected diameter in pixels, then the continuous level: +1 for every
+    // halving of the projected area
+    float pixels = radius * r->height /
+                   (distance * tanf(DegToRadians(r->camera.zoom) * 0.5f));
+    float level =
+        std::max(0.0f, 2.0f * log2f(MESH_LOD_DETAIL_PIXELS / pixels));
 
-    Renderer_DrawTriangles(r, mesh.vertices, mesh.numVertices, mesh.vertexSize,
-                           position, rotation, scale, color);
+    if (previous >= 0 && level >= previous - MESH_LOD_HYSTERESIS &&
+        level < previous + 1 + MESH_LOD_HYSTERESIS) {
+        return std::min(previous, lods->numLevels - 1);
+    }
+
+    return std::min((int)level, lods->numLevels - 1);
 }
 
-bool TriangleIntersectsTile(Triangle triangle, int tileX0, int tileY0,
-                            int tileX1, int tileY1) {
-    return !(triangle.max.x < tileX0 || triangle.min.x > tileX1 ||
-             triangle.max.y < tileY0 || triangle.min.y > tileY1);
+ShaderBatch *Renderer_AddShaderBatch(Renderer *r, ShaderTileFunc rasterizeTile,
+                                     const void *fragmentShader, size_t size) {
+    RenderFrame *frame = r->frame;
+    if (frame->numShaderBatches == (int)frame->shaderBatches.size()) {
+        frame->shaderBatches.emplace_back();
+    }
+
+    ShaderBatch *batch = &frame->shaderBatches[frame->numShaderBatches++];
+    batch->rasterizeTile = rasterizeTile;
+    memcpy(batch->fragmentShader, fragmentShader, size);
+    ArenaArray_Clear(&batch->triangles);
+    ArenaArray_Clear(&batch->varyings);
+
+    return batch;
 }
 
-float TriangleEdgeFunction(Vec3 a, Vec3 b, Vec2 p) {
-    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+bool Renderer_SetupShaderTriangle(const Renderer *r, const Vec4 clip[3],
+                                  ShaderTriangle *out) {
+    // No near plane clipping, as in Renderer_TransformTriangles
+    if (clip[0].w < 0.0001f || clip[1].w < 0.0001f || clip[2].w < 0.0001f) {
+        return false;
+    }
+
+    float halfWidth = (float)r->width / 2;
+    float halfHeight = (float)r->height / 2;
+
+    Vec3 v[3];
+    for (int k = 0; k < 3; k++) {
+        float invW = 1.0f / clip[k].w;
+        v[k] = {
+            halfWidth * (clip[k].x * invW + 1.0f),
+            halfHeight * (1.0f - clip[k].y * invW),
+            (clip[k].z * invW + 1.0f) * 0.5f,
+        };
+    }
+
+    *out = {
+        .v0 = v[0],
+        .v1 = v[1],
+        .v2 = v[2],
+        .invW = {1.0f / clip[0].w, 1.0f / clip[1].w, 1.0f / clip[2].w},
+        .min = {(float)std::max(0, (int)std::floor(std::min(
+                                       {v[0].x, v[1].x, v[2].x}))),
+                (float)std::max(0, (int)std::floor(std::min(
+                                       {v[0].y, v[1].y, v[2].y})))},
+        .max = {(float)std::min(r->width - 1, (int)std::ceil(std::max(
+                                                  {v[0].x, v[1].x, v[2].x}))),
+                (float)std::min(r->height - 1, (int)std::ceil(std::max(
+                                                   {v[0].y, v[1].y, v[2].y})))},
+        .area = Shader_EdgeFunction(v[0], v[1], v[2].x, v[2].y),
+    };
+
+    return std::abs(out->area) >= 0.0001f && out->min.x <= out->max.x &&
+           out->min.y <= out->max.y;
 }
 
-Fragment TriangleInterpolatePoint(Triangle triangle, float b0, float b1,
-                                  float b2) {
-    Fragment frag;
-
-    // Perspective-correct interpolation
-    float invZ0 = 1.0f / triangle.v0.coords.z;
-    float invZ1 = 1.0f / triangle.v1.coords.z;
-    float invZ2 = 1.0f / triangle.v2.coords.z;
-
-    float invZ = b0 * invZ0 + b1 * invZ1 + b2 * invZ2;
-    float z = 1.0f / invZ;
-
-    // Frag Depth
-    frag.z = z;
-
-    // Frag Color
-    frag.color.r =
-        (b0 * triangle.v0.color.r * invZ0 + b1 * triangle.v1.color.r * invZ1 +
-         b2 * triangle.v2.color.r * invZ2) *
-        z;
-    frag.color.g =
-        (b0 * triangle.v0.color.g * invZ0 + b1 * triangle.v1.color.g * invZ1 +
-         b2 * triangle.v2.color.g * invZ2) *
-        z;
-    frag.color.b =
-        (b0 * triangle.v0.color.b * invZ0 + b1 * triangle.v1.color.b * invZ1 +
-         b2 * triangle.v2.color.b * invZ2) *
-        z;
-
-    // Frag Normals
-    frag.normal.x =
-        (b0 * triangle.v0.normal.x * invZ0 + b1 * triangle.v1.normal.x * invZ1 +
-         b2 * triangle.v2.normal.x * invZ2) *
-        z;
-    frag.normal.y =
-        (b0 * triangle.v0.normal.y * invZ0 + b1 * triangle.v1.normal.y * invZ1 +
-         b2 * triangle.v2.normal.y * invZ2) *
-        z;
-    frag.normal.z =
-        (b0 * triangle.v0.normal.z * invZ0 + b1 * triangle.v1.normal.z * invZ1 +
-         b2 * triangle.v2.normal.z * invZ2) *
-        z;
-
-    frag.normal = Vec3_Normalize(frag.normal);
-
-    return frag;
-}
-
-void Renderer_RasterizeTile(Renderer *r, const std::vector<Triangle> &triangles,
-                            int tileX, int tileY, int tileSize) {
-    int x0 = tileX * tileSize;
-    int y0 = tileY * tileSize;
-    int x1 = std::min(x0 + tileSize, r->width);
-    int y1 = std::min(y0 + tileSize, r->height);
-
-    for (const auto &triangle : triangles) {
-        // Triangle area (for barycentric coordinates)
-        // Skip degenerate triangles
-        if (std::abs(triangle.area) < 0.0001f) {
-            return;
+// Counting sort of triangles (Triangle or ShaderTriangle) into the bins of
+// a tilesX x tilesY grid, so each bin keeps submission order. The bins are
+// allocated from arena
+template <typename T>
+static void Renderer_BinTriangles(Arena *arena, int tilesX, int tilesY,
+                                  const ArenaArray<T> &triangles,
+                                  uint32_t **binOffsets,
+                                  uint32_t **binIndices) {
+    int numTiles = tilesX * tilesY;
+    uint32_t *offsets = Arena_AllocArray<uint32_t>(arena, numTiles + 1);
+    std::fill(offsets, offsets + numTiles + 1, 0);
+
+    // Tile range covered by a triangle, false if it covers nothing
+    auto tileRange = [&](const T &t, int *tx0, int *ty0, int *tx1, int *ty1) {
+        if (std::abs(t.area) < 0.0001f || t.min.x > t.max.x ||
+            t.min.y > t.max.y) {
+            return false;
         }
+        *tx0 = (int)t.min.x / TILE_SIZE;
+        *ty0 = (int)t.min.y / TILE_SIZE;
+        *tx1 = (int)t.max.x / TILE_SIZE;
+        *ty1 = (int)t.max.y / TILE_SIZE;
+        return true;
+    };
 
-        // Determine winding
-        bool clockwise = triangle.area < 0;
-        float invArea = 1.0f / triangle.area;
+    for (const T &t : triangles) {
+        int tx0, ty0, tx1, ty1;
+        if (!tileRange(t, &tx0, &ty0, &tx1, &ty1)) {
+            continue;
+        }
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                offsets[ty * tilesX + tx + 1]++;
+            }
+        }
+    }
+
+    for (int i = 0; i < numTiles; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    uint32_t *indices = Arena_AllocArray<uint32_t>(arena, offsets[numTiles]);
+
+    uint32_t *cursor = Arena_AllocArray<uint32_t>(arena, numTiles);
+    std::copy(offsets, offsets + numTiles, cursor);
+    for (uint32_t i = 0; i < triangles.size(); i++) {
+        int tx0, ty0, tx1, ty1;
+        if (!tileRange(triangles[i], &tx0, &ty0, &tx1, &ty1)) {
+            continue;
+        }
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                indices[cursor[ty * tilesX + tx]++] = i;
+            }
+        }
+    }
+
+    *binOffsets = offsets;
+    *binIndices = indices;
+}
+
+// Frame state every tile depends on, taken when the frame ends
+static uint64_t Renderer_FrameStateHash(const Renderer *r,
+                                        const RenderFrame *frame) {
+    uint64_t h = Hash_Mix(0, (uint64_t)frame->width << 32 | frame->height);
+    h = Hash_Mix(h, (uint64_t)frame->clearColor << 32 | r->sampleCount);
+    h = Hash_Mix(h, frame->transparency | frame->zPrepass << 8 |
+                        frame->depthOnly << 9 | r->microTriangleSize << 16);
+    h = Renderer_HashBytes(h, frame->views,
+                           frame->numViews * sizeof(RenderView));
+    if (frame->post.enabled) {
+        h = Renderer_HashBytes(h, frame->postLut, sizeof(frame->postLut));
+        h = Renderer_HashBytes(h, &frame->post.vignette,
+                               sizeof(frame->post.vignette));
+    }
+    return Hash_Mix(h, frame->shadowHash);
+}
 
-        if (!TriangleIntersectsTile(triangle, x0, y0, x1, y1)) {
+// Casters of the frame's shadow map: the projection and every draw, as the
+// opaque ones cast
+static uint64_t Renderer_ShadowHash(const RenderFrame *frame) {
+    const ShadowMap *shadow = frame->shadow;
+    uint64_t h = Hash_Mix(0, shadow->size);
+    h = Renderer_HashBytes(h, &shadow->bias, sizeof(shadow->bias));
+    h = Renderer_HashBytes(h, &shadow->viewProj, sizeof(shadow->viewProj));
+    for (const DrawRecord &draw : frame->draws) {
+        h = Hash_Mix(h, draw.hash);
+    }
+    // 0 stands for unknown
+    return h | 1;
+}
+
+// Frame state and the draws binned to one tile, in raster order. Triangles
+// of a draw are consecutive, so each draw is looked up once per tile
+static uint64_t Renderer_TileHash(const RenderFrame *frame, int tile) {
+    uint64_t h = frame->stateHash;
+
+    const DrawRecord *draws = frame->draws.data;
+    uint32_t numDraws = frame->draws.count;
+    uint32_t drawEnd = 0;
+    for (uint32_t i = frame->binOffsets[tile]; i < frame->binOffsets[tile + 1];
+         i++) {
+        uint32_t index = frame->binIndices[i];
+        if (index >= frame->orderedTriangles) {
+            // Reordered by depth, hashed one by one
+            h = Hash_Triangle(h, frame->triangles[index]);
+            continue;
+        }
+        if (index < drawEnd) {
             continue;
         }
 
-        // Rasterize only within tile bounds
+        const DrawRecord *draw =
+            std::upper_bound(draws, draws + numDraws, index,
+                             [](uint32_t index, const DrawRecord &d) {
+                                 return index < d.firstTriangle;
+                             }) -
+            1;
+        drawEnd = draw + 1 < draws + numDraws ? draw[1].firstTriangle
+                                              : frame->triangles.count;
+        h = Hash_Mix(h, draw->hash);
+    }
+
+    for (int b = 0; b < frame->numShaderBatches; b++) {
+        const ShaderBatch *batch = &frame->shaderBatches[b];
+        uint32_t count = batch->binOffsets[tile + 1] - batch->binOffsets[tile];
+        if (count > 0) {
+            h = Hash_Mix(Hash_Mix(h, batch->hash), count);
+        }
+    }
+    return h | 1;
+}
+
+// Grades and vignettes the pixels [x0, x1) x [y0, y1) of tile i in place
+// and, with FXAA, keeps the tile's borders for its neighbours
+static void Renderer_PostProcessTile(Renderer *r, const RenderFrame *frame,
+                                     RenderTarget *target, int i, int x0,
+                                     int y0, int x1, int y1) {
+    // Locals, as the pixel stores could otherwise alias them
+    const PostProcess post = frame->post;
+    uint8_t lut[256];
+    memcpy(lut, frame->postLut, sizeof(lut));
+    if (post.vignette > 0.0f) {
+        float columns[TILE_SIZE];
+        for (int x = x0; x < x1; x++) {
+            columns[x - x0] = PostProcess_VignetteTerm(x, frame->width);
+        }
         for (int y = y0; y < y1; y++) {
+            uint32_t *row = &target->pixels[y * frame->width + x0];
+            float rowTerm = PostProcess_VignetteTerm(y, frame->height);
+            for (int x = 0; x < x1 - x0; x++) {
+                // As PostProcess_Vignette, term by term
+                float factor =
+                    1.0f - post.vignette * (columns[x] + rowTerm) * 0.5f;
+                row[x] = PostProcess_Scale(PostProcess_Grade(lut, row[x]),
+                                           factor);
+            }
+        }
+    } else {
+        for (int y = y0; y < y1; y++) {
+            uint32_t *row = &target->pixels[y * frame->width];
             for (int x = x0; x < x1; x++) {
-                Vec2 p = {x + 0.5f, y + 0.5f};
+                row[x] = PostProcess_Grade(lut, row[x]);
+            }
+        }
+    }
 
-                float w0 = TriangleEdgeFunction(triangle.v1.coords,
-                                                triangle.v2.coords, p);
-                float w1 = TriangleEdgeFunction(triangle.v2.coords,
-                                                triangle.v0.coords, p);
-                float w2 = TriangleEdgeFunction(triangle.v0.coords,
-                                                triangle.v1.coords, p);
+    if (!post.fxaa) {
+        return;
+    }
 
-                // Check inside based on winding
-                bool inside = clockwise ? (w0 <= 0 && w1 <= 0 && w2 <= 0)
-                                        : (w0 >= 0 && w1 >= 0 && w2 >= 0);
+    // Tiles at the frame's edges can be smaller than the apron, their
+    // strips then overlap
+    const int R = FXAA_APRON;
+    uint32_t *apron = r->postTiles->apron + (size_t)i * POST_APRON_PIXELS;
+    int w = x1 - x0, h = y1 - y0;
+    int bottom = std::max(h - R, 0), right = std::max(w - R, 0);
+    for (int y = 0; y < h; y++) {
+        const uint32_t *row = &target->pixels[(y0 + y) * frame->width + x0];
+        if (y < R) {
+            memcpy(&apron[y * TILE_SIZE], row, w * sizeof(uint32_t));
+        }
+        if (y >= bottom) {
+            memcpy(&apron[(R + y - bottom) * TILE_SIZE], row,
+                   w * sizeof(uint32_t));
+        }
+        for (int x = 0; x < std::min(R, w); x++) {
+            apron[2 * R * TILE_SIZE + y * R + x] = row[x];
+        }
+        for (int x = right; x < w; x++) {
+            apron[3 * R * TILE_SIZE + y * R + x - right] = row[x];
+        }
+    }
+}
 
-                if (inside) {
-                    float b0 = w0 * invArea;
-                    float b1 = w1 * invArea;
-                    float b2 = w2 * invArea;
+// Pixel (x, y) before FXAA, from the borders its tile kept. (x, y) is
+// within FXAA_APRON pixels of the tile next to it being filtered; the
+// pixels to its right up to the end of the strip follow it
+static inline const uint32_t *Renderer_ApronPixel(const RenderFrame *frame,
+                                                  const uint32_t *apron,
+                                                  int x, int y) {
+    const int R = FXAA_APRON;
+    int tx = x / TILE_SIZE, ty = y / TILE_SIZE;
+    const uint32_t *strips =
+        apron + (size_t)(ty * frame->tilesX + tx) * POST_APRON_PIXELS;
+    int lx = x - tx * TILE_SIZE, ly = y - ty * TILE_SIZE;
+    int w = std::min(TILE_SIZE, frame->width - tx * TILE_SIZE);
+    int h = std::min(TILE_SIZE, frame->height - ty * TILE_SIZE);
+
+    if (ly < R) {
+        return &strips[ly * TILE_SIZE + lx];
+    }
+    int bottom = std::max(h - R, 0);
+    if (ly >= bottom) {
+        return &strips[(R + ly - bottom) * TILE_SIZE + lx];
+    }
+    if (lx < R) {
+        return &strips[2 * R * TILE_SIZE + ly * R + lx];
+    }
+    return &strips[3 * R * TILE_SIZE + ly * R + lx - std::max(w - R, 0)];
+}
 
-                    Fragment frag =
-                        TriangleInterpolatePoint(triangle, b0, b1, b2);
-                    frag.coords = {p.x, p.y};
+// FXAA of tile i, once the tiles around it are graded. Reads the tile and
+// its apron into a local image, repeating the frame's edges, and writes
+// the filtered pixels back. Scalar float code with no ISA variants: they
+// gain nothing here
+static void Renderer_FxaaTile(Renderer *r, const RenderFrame *frame,
+                              RenderTarget *target, int i) {
+    const int R = FXAA_APRON;
+    const int SIZE = TILE_SIZE + 2 * R;
+    uint32_t image[SIZE * SIZE];
+    float luma[SIZE * SIZE];
+
+    int x0 = (i % frame->tilesX) * TILE_SIZE;
+    int y0 = (i / frame->tilesX) * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, frame->width);
+    int y1 = std::min(y0 + TILE_SIZE, frame->height);
+    int w = x1 - x0, h = y1 - y0;
+    // Columns right of the tile inside the frame
+    int right = std::min(x1 + R, frame->width) - x1;
+
+    // Pixels [xa, xb) of row y, all in one tile, into dst
+    auto copy = [&](int xa, int xb, int y, uint32_t *dst) {
+        const uint32_t *src =
+            y >= y0 && y < y1 && xa >= x0 && xa < x1
+                ? &target->pixels[y * frame->width + xa]
+                : Renderer_ApronPixel(frame, r->postTiles->apron, xa, y);
+        memcpy(dst, src, (xb - xa) * sizeof(uint32_t));
+    };
 
-                    ColorRGBA fragColor =
-                        Renderer_CalculateFragmentLighting(r, frag);
-                    frag.color = fragColor;
+    for (int sy = 0; sy < h + 2 * R; sy++) {
+        int y = std::clamp(y0 - R + sy, 0, frame->height - 1);
+        uint32_t *row = &image[sy * SIZE];
+        copy(x0, x1, y, &row[R]);
+        if (x0 > 0) {
+            copy(x0 - R, x0, y, row);
+        } else {
+            std::fill(row, row + R, row[R]);
+        }
+        if (right > 0) {
+            copy(x1, x1 + right, y, &row[R + w]);
+        }
+        std::fill(row + R + w + right, row + w + 2 * R,
+                  row[R + w + right - 1]);
 
-                    // Gamma Correction
-                    // frag.color = ColorToSRGB(frag.color);
+        for (int sx = 0; sx < w + 2 * R; sx++) {
+            luma[sy * SIZE + sx] = PostProcess_Luma(row[sx]);
+        }
+    }
 
-                    Renderer_SetPixel(r, frag.coords.x, frag.coords.y, frag.z,
-                                      ColorRGBAToInt(frag.color));
-                }
-            }
+    for (int y = 0; y < h; y++) {
+        uint32_t *row = &target->pixels[(y0 + y) * frame->width + x0];
+        for (int x = 0; x < w; x++) {
+            row[x] = PostProcess_Fxaa(image, luma, SIZE, x + R, y + R);
         }
     }
 }
 
-void Renderer_RasterizeTriangles(Renderer *r,
-                                 const std::vector<Triangle> &triangles) {
-    for (const auto &triangle : triangles) {
-        // Triangle area (for barycentric coordinates)
-        // Skip degenerate triangles
-        if (std::abs(triangle.area) < 0.0001f) {
-            return;
+// Raster stage: clears, rasterizes and (with MSAA) resolves each tile in one
+// go, so a tile is touched exactly once per frame
+// Everything tile i of the frame goes through: clear, opaque triangles,
+// shader batches, resolve and transparency. False when the tile is kept
+// from an earlier incremental frame
+static bool Renderer_RenderTile(Renderer *r, const RenderFrame *frame,
+                                RenderTarget *target, int i) {
+    int tx = i % frame->tilesX;
+    int ty = i / frame->tilesX;
+
+    // A tile rasterized from the same hash still holds this
+    // frame's depths, and its colors unless only depth is written
+    uint64_t hash = 0;
+    if (frame->incremental) {
+        hash = Renderer_TileHash(frame, i);
+        if (r->depthTileHashes[i] == hash &&
+            (frame->depthOnly || target->tileHashes[i] == hash)) {
+            return false;
         }
+    }
+    r->depthTileHashes[i] = hash;
 
-        // Determine winding
-        bool clockwise = triangle.area < 0;
-        float invArea = 1.0f / triangle.area;
+    if (frame->depthOnly) {
+        Renderer_RasterizeDepthTile(r, frame, tx, ty);
+        return true;
+    }
+    target->tileHashes[i] = hash;
+
+    if (frame->clear) {
+        int x0 = tx * TILE_SIZE;
+        int y0 = ty * TILE_SIZE;
+        Renderer_ClearTile(r, frame, target, x0, y0,
+                           std::min(x0 + TILE_SIZE, frame->width),
+                           std::min(y0 + TILE_SIZE, frame->height));
+    }
 
-        // Rasterize only within tile bounds
-        for (int y = triangle.min.y; y <= triangle.max.y; y++) {
-            for (int x = triangle.min.x; x <= triangle.max.x; x++) {
-                Vec2 p = {x + 0.5f, y + 0.5f};
+    if (r->sampleCount > 1) {
+        Renderer_RasterizeTileMSAA(r, frame, target, tx, ty);
+    } else {
+        Renderer_RasterizeTile(r, frame, target, tx, ty);
+    }
 
-                float w0 = TriangleEdgeFunction(triangle.v1.coords,
-                                                triangle.v2.coords, p);
-                float w1 = TriangleEdgeFunction(triangle.v2.coords,
-                                                triangle.v0.coords, p);
-                float w2 = TriangleEdgeFunction(triangle.v0.coords,
-                                                triangle.v1.coords, p);
+    for (int b = 0; b < frame->numShaderBatches; b++) {
+        const ShaderBatch *batch = &frame->shaderBatches[b];
+        batch->rasterizeTile(r, frame, target, batch, tx, ty);
+    }
 
-                // Check inside based on winding
-                bool inside = clockwise ? (w0 <= 0 && w1 <= 0 && w2 <= 0)
-                                        : (w0 >= 0 && w1 >= 0 && w2 >= 0);
+    if (r->sampleCount > 1) {
+        // Resolve while the tile is still in cache
+        int x0 = tx * TILE_SIZE;
+        int y0 = ty * TILE_SIZE;
+        Renderer_ResolveTile(r, frame, target, x0, y0,
+                             std::min(x0 + TILE_SIZE, frame->width),
+                             std::min(y0 + TILE_SIZE, frame->height));
+    }
+
+    if (frame->numTransparent > 0) {
+        Renderer_RasterizeTransparentTile(r, frame, target, tx, ty);
+    }
+
+    if (frame->post.enabled) {
+        int x0 = tx * TILE_SIZE;
+        int y0 = ty * TILE_SIZE;
+        Renderer_PostProcessTile(r, frame, target, i, x0, y0,
+                                 std::min(x0 + TILE_SIZE, frame->width),
+                                 std::min(y0 + TILE_SIZE, frame->height));
+    }
+    return true;
+}
+
+#ifdef RENDERER_ISA_KERNEL
+RENDERER_ISA_KERNEL("sse4.2")
+static bool Renderer_RenderTileSSE42(Renderer *r, const RenderFrame *frame,
+                                     RenderTarget *target, int i) {
+    return Renderer_RenderTile(r, frame, target, i);
+}
+#endif
+
+// The tile kernels of each RendererIsa
+struct RendererKernels {
+    bool (*renderTile)(Renderer *r, const RenderFrame *frame,
+                       RenderTarget *target, int i);
+    void (*shadowTile)(const RenderFrame *frame, int tilesX, int tileX,
+                       int tileY);
+};
+
+static const RendererKernels RENDERER_KERNELS[RENDERER_ISA_COUNT] = {
+    {Renderer_RenderTile, Renderer_RasterizeShadowTile},
+#ifdef RENDERER_ISA_KERNEL
+    {Renderer_RenderTileSSE42, Renderer_RasterizeShadowTileSSE42},
+#endif
+};
+
+// The renderer's PostTiles, allocated on the first frame with FXAA
+static PostTiles *Renderer_PostTiles(Renderer *r) {
+    if (r->postTiles == nullptr) {
+        int maxTiles = Renderer_MaxTiles(r);
+        r->postTiles = new PostTiles{
+            .apron = new uint32_t[(size_t)maxTiles * POST_APRON_PIXELS],
+            .pending = new std::atomic<int>[maxTiles],
+            .maxTiles = maxTiles,
+        };
+    }
+    return r->postTiles;
+}
 
-                if (inside) {
-                    float b0 = w0 * invArea;
-                    float b1 = w1 * invArea;
-                    float b2 = w2 * invArea;
+static void Renderer_RasterizeFrame(Renderer *r, RenderFrame *frame,
+                                    RenderTarget *target) {
+    auto start = std::chrono::steady_clock::now();
+
+    target->width = frame->width;
+    target->height = frame->height;
+    target->frameNumber = frame->number;
+    target->shadowMs = 0.0f;
+
+    FrameSlotHeader *exportSlot = nullptr;
+    if (r->frameExport != nullptr) {
+        exportSlot = Renderer_BeginExport(r, target);
+    }
+    const RendererKernels &kernels = RENDERER_KERNELS[r->isa];
+
+    // The shadow map is complete before any receiver looks it up. An
+    // incremental frame keeps the map when its casters didn't change
+    ShadowMap *shadowMap = frame->shadow != nullptr ? &r->shadow : nullptr;
+    bool shadowKept = shadowMap != nullptr && frame->incremental &&
+                      shadowMap->hash == frame->shadowHash;
+    if (shadowMap != nullptr && !frame->depthOnly && !shadowKept) {
+        shadowMap->hash = frame->incremental ? frame->shadowHash : 0;
+        int shadowTiles = (frame->shadow->size + TILE_SIZE - 1) / TILE_SIZE;
+        ThreadPool_ParallelFor(r->pool, shadowTiles * shadowTiles, [&](int i) {
+            kernels.shadowTile(frame, shadowTiles, i % shadowTiles,
+                               i / shadowTiles);
+        });
+        target->shadowMs = std::chrono::duration<float, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    }
 
-                    Fragment frag =
-                        TriangleInterpolatePoint(triangle, b0, b1, b2);
-                    frag.coords = {p.x, p.y};
+    target->numTiles = frame->tilesX * frame->tilesY;
+    std::atomic<int> dirtyTiles(0);
+
+    // FXAA of a tile waits for its 3x3 neighbourhood
+    PostTiles *post = nullptr;
+    if (frame->post.enabled && frame->post.fxaa) {
+        post = Renderer_PostTiles(r);
+        for (int i = 0; i < target->numTiles; i++) {
+            int tx = i % frame->tilesX;
+            int ty = i / frame->tilesX;
+            int columns = 1 + (tx > 0) + (tx < frame->tilesX - 1);
+            int rows = 1 + (ty > 0) + (ty < frame->tilesY - 1);
+            post->pending[i] = columns * rows;
+        }
+    }
 
-                    ColorRGBA fragColor =
-                        Renderer_CalculateFragmentLighting(r, frag);
-                    frag.color = fragColor;
+    auto rasterizeTile = [&](int i) {
+        if (kernels.renderTile(r, frame, target, i)) {
+            dirtyTiles++;
+        }
+        if (post == nullptr) {
+            return;
+        }
 
-                    Renderer_SetPixel(r, frag.coords.x, frag.coords.y, frag.z,
-                                      ColorRGBAToInt(frag.color));
+        // The last tile of a neighbourhood to finish filters its center,
+        // usually while the neighbourhood is still in cache
+        int tx = i % frame->tilesX;
+        int ty = i / frame->tilesX;
+        for (int ny = std::max(ty - 1, 0);
+             ny <= std::min(ty + 1, frame->tilesY - 1); ny++) {
+            for (int nx = std::max(tx - 1, 0);
+                 nx <= std::min(tx + 1, frame->tilesX - 1); nx++) {
+                int n = ny * frame->tilesX + nx;
+                if (post->pending[n].fetch_sub(1) == 1) {
+                    Renderer_FxaaTile(r, frame, target, n);
                 }
             }
         }
+    };
+
+    // With thread affinity each tile goes to the thread that first touched
+    // its memory
+    int numTiles = frame->tilesX * frame->tilesY;
+    target->stolenTiles = 0;
+    if (r->threadAffinity) {
+        target->stolenTiles =
+            ThreadPool_ParallelForAffine(r->pool, numTiles, rasterizeTile);
+    } else {
+        ThreadPool_ParallelFor(r->pool, numTiles, rasterizeTile);
     }
-}
 
-void Renderer_DrawTriangles(Renderer *r, float *vertices, int length, int size,
-                            Vec3 position, Vec3 rotation, Vec3 scale,
-                            ColorRGBA color) {
-    float halfWidth = (float)r->width / 2;
-    float halfHeight = (float)r->height / 2;
+    target->dirtyTiles = dirtyTiles;
+    target->rasterMs = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
 
-    // Transformations
-    Mat4 view = Camera_GetViewMatrix(&r->camera);
-    // Mat4 view = Mat4_Create();
-    // view = Mat4_Translate(view, {0.0f, 0.0f, -3.0f});
-    Mat4 projection =
-        Mat4_Perspective(DegToRadians(r->camera.zoom),
-                         (float)r->width / r->height, 0.1f, 100.0f);
+    if (exportSlot != nullptr) {
+        FrameRing_Publish(&r->frameExport->ring, exportSlot, frame->width,
+                          frame->height, frame->number, frame->submitNs);
+    }
+}
 
-    Mat4 model = Mat4_Create();
-    model = Mat4_Rotate(model, rotation);
-    model = Mat4_Scale(model, scale);
-    model = Mat4_Translate(model, position);
+// Moves the transparent triangles behind the opaque ones and orders them
+// back to front by the depth at their centroid, for the whole frame
+static void Renderer_SortTransparent(RenderFrame *frame) {
+    // Stable partition through arena scratch
+    Triangle *scratch =
+        Arena_AllocArray<Triangle>(&frame->arena, frame->numTransparent);
+    uint32_t numOpaque = 0;
+    uint32_t numTransparent = 0;
+    for (const Triangle &t : frame->triangles) {
+        if (t.transparent) {
+            scratch[numTransparent++] = t;
+        } else {
+            frame->triangles[numOpaque++] = t;
+        }
+    }
+    memcpy(&frame->triangles[numOpaque], scratch,
+           numTransparent * sizeof(Triangle));
+    Triangle *transparent = frame->triangles.begin() + numOpaque;
+
+    auto centroidZ = [](const Triangle &t) {
+        return TriangleEvaluatePlane(t.planes, ATTR_Z,
+                                     (t.v0.x + t.v1.x + t.v2.x) / 3.0f,
+                                     (t.v0.y + t.v1.y + t.v2.y) / 3.0f);
+    };
+    std::sort(transparent, frame->triangles.end(),
+              [&](const Triangle &a, const Triangle &b) {
+                  return centroidZ(a) > centroidZ(b);
+              });
+}
 
-    std::vector<Triangle> triangles;
-
-    // Vertices are in local space
-    for (int i = 0; i < length * size; i += (size * 3)) {
-        int v1i = i;
-        int v2i = i + size;
-        int v3i = i + (size * 2);
-
-        Vec4 v1 = {vertices[v1i], vertices[v1i + 1], vertices[v1i + 2], 1.0f};
-        Vec4 v2 = {vertices[v2i], vertices[v2i + 1], vertices[v2i + 2], 1.0f};
-        Vec4 v3 = {vertices[v3i], vertices[v3i + 1], vertices[v3i + 2], 1.0f};
-
-        Vec3 v1Norm = {vertices[v1i + 3], vertices[v1i + 4], vertices[v1i + 5]};
-        Vec3 v2Norm = {vertices[v2i + 3], vertices[v2i + 4], vertices[v2i + 5]};
-        Vec3 v3Norm = {vertices[v3i + 3], vertices[v3i + 4], vertices[v3i + 5]};
-
-        // Model -> World
-        v1 = Vec4_Transform(v1, Mat4_Transpose(model));
-        v2 = Vec4_Transform(v2, Mat4_Transpose(model));
-        v3 = Vec4_Transform(v3, Mat4_Transpose(model));
-
-        // World -> View
-        v1 = Vec4_Transform(v1, view);
-        v2 = Vec4_Transform(v2, view);
-        v3 = Vec4_Transform(v3, view);
-
-        // View -> Clip (Projection)
-        v1 = Vec4_Transform(v1, projection);
-        v2 = Vec4_Transform(v2, projection);
-        v3 = Vec4_Transform(v3, projection);
-
-        // TODO: Handle the offscreen vertices later on the draw call
-        // if (v1.w <= 0.0f) {
-        //     // Offscreen marker
-        //     vertices[i] = -1.0f;
-        //     vertices[i + 1] = -1.0f;
-        //     vertices[i + 2] = -1.0f;
-        //     continue;
-        // }
-
-        // Clip -> NDC (Perspective Divide)
-        v1.x = v1.x / v1.w;
-        v1.y = v1.y / v1.w;
-        v1.z = v1.z / v1.w;
-
-        v2.x = v2.x / v2.w;
-        v2.y = v2.y / v2.w;
-        v2.z = v2.z / v2.w;
-
-        v3.x = v3.x / v3.w;
-        v3.y = v3.y / v3.w;
-        v3.z = v3.z / v3.w;
-
-        // NDC -> Screen
-        v1.x = halfWidth * (v1.x + 1.0f);
-        v1.y = halfHeight * (1.0f - v1.y);
-        v1.z = (v1.z + 1.0f) * 0.5;
-
-        v2.x = halfWidth * (v2.x + 1.0f);
-        v2.y = halfHeight * (1.0f - v2.y);
-        v2.z = (v2.z + 1.0f) * 0.5;
-
-        v3.x = halfWidth * (v3.x + 1.0f);
-        v3.y = halfHeight * (1.0f - v3.y);
-        v3.z = (v3.z + 1.0f) * 0.5;
-
-        ColorRGBA v1Color = color;
-        ColorRGBA v2Color = color;
-        ColorRGBA v3Color = color;
-
-        Vec2 vMin = {
-            (float)std::max(
-                0, static_cast<int>(std::floor(std::min({v1.x, v2.x, v3.x})))),
-            (float)std::max(
-                0, static_cast<int>(std::floor(std::min({v1.y, v2.y, v3.y})))),
-        };
-        Vec2 vMax = {
-            (float)std::min(r->width - 1, static_cast<int>(std::ceil(
-                                              std::max({v1.x, v2.x, v3.x})))),
-            (float)std::min(r->height - 1, static_cast<int>(std::ceil(
-                                               std::max({v1.y, v2.y, v3.y})))),
-        };
+void Renderer_EndFrame(Renderer *r) {
+    if (r == nullptr || r->frame == nullptr) {
+        return;
+    }
 
-        Triangle triangle = {
-            .v0 = Vertex{Vec3{v1.x, v1.y, v1.z}, v1Norm, v1Color},
-            .v1 = Vertex{Vec3{v2.x, v2.y, v2.z}, v2Norm, v2Color},
-            .v2 = Vertex{Vec3{v3.x, v3.y, v3.z}, v3Norm, v3Color},
-            .min = vMin,
-            .max = vMax,
-            .area =
-                TriangleEdgeFunction(Vec3{v1.x, v1.y, v1.z},
-                                     Vec3{v2.x, v2.y, v2.z}, Vec2{v3.x, v3.y}),
-        };
+    RenderFrame *frame = r->frame;
+    r->frame = nullptr;
+    if (r->frameExport != nullptr) {
+        frame->submitNs = FrameRing_NowNs();
+    }
+
+    frame->width = r->width;
+    frame->height = r->height;
+    frame->tilesX = (frame->width + TILE_SIZE - 1) / TILE_SIZE;
+    frame->tilesY = (frame->height + TILE_SIZE - 1) / TILE_SIZE;
+    if (r->numViews == 0) {
+        frame->views[0] = {r->camera, 0, 0, r->width, r->height};
+        frame->numViews = 1;
+    } else {
+        std::copy(r->views, r->views + r->numViews, frame->views);
+        frame->numViews = r->numViews;
+    }
 
-        triangles.push_back(triangle);
+    frame->shadow = r->shadow.enabled ? &r->shadow : nullptr;
+    frame->zPrepass = r->zPrepass && r->sampleCount == 1;
+    frame->depthOnly = r->depthOnly;
+    frame->post = r->post;
+    frame->post.enabled = r->post.enabled && !r->depthOnly;
+    if (frame->post.enabled) {
+        PostProcess_BuildLut(&frame->post, frame->postLut);
+    }
+    // Without a clear the tiles build on what they held before. FXAA of a
+    // kept tile would miss changes next to it
+    frame->incremental = r->incremental && frame->recordDraws &&
+                         frame->clear &&
+                         !(frame->post.enabled && frame->post.fxaa);
+    frame->orderedTriangles = frame->triangles.count;
+    frame->transparency = r->transparency;
+    frame->numTransparent = 0;
+    for (const Triangle &t : frame->triangles) {
+        frame->numTransparent += t.transparent;
+    }
+    if (frame->numTransparent > 0 &&
+        frame->transparency == TRANSPARENCY_SORTED_TRIANGLES) {
+        // Opaque triangles after the first transparent one move down
+        frame->orderedTriangles = 0;
+        while (!frame->triangles[frame->orderedTriangles].transparent) {
+            frame->orderedTriangles++;
+        }
+        Renderer_SortTransparent(frame);
     }
 
-    // Single-Tread
-    // Renderer_RasterizeTriangles(r, triangles);
+    Renderer_BinTriangles(&frame->arena, frame->tilesX, frame->tilesY,
+                          frame->triangles, &frame->binOffsets,
+                          &frame->binIndices);
+    for (int b = 0; b < frame->numShaderBatches; b++) {
+        ShaderBatch *batch = &frame->shaderBatches[b];
+        Renderer_BinTriangles(&frame->arena, frame->tilesX, frame->tilesY,
+                              batch->triangles, &batch->binOffsets,
+                              &batch->binIndices);
+    }
+    if (frame->shadow != nullptr) {
+        int shadowTiles = (r->shadow.size + TILE_SIZE - 1) / TILE_SIZE;
+        Renderer_BinTriangles(&frame->arena, shadowTiles, shadowTiles,
+                              frame->shadowTriangles, &frame->shadowBinOffsets,
+                              &frame->shadowBinIndices);
+    }
+    frame->lastTriangles = frame->triangles.count;
+    frame->lastShadowTriangles = frame->shadowTriangles.count;
 
-    // Rasterize Triangles Multi-Threat
-    // Render by tiles 32x32
-    const int tileSize = 32;
-    int tilesX = (r->width + tileSize - 1) / tileSize;
-    int tilesY = (r->height + tileSize - 1) / tileSize;
+    if (frame->incremental) {
+        frame->shadowHash =
+            frame->shadow != nullptr ? Renderer_ShadowHash(frame) : 0;
+        frame->stateHash = Renderer_FrameStateHash(r, frame);
+    }
 
-    std::vector<std::thread> threads;
-    int numThreads = std::thread::hardware_concurrency();
+    if (r->pipeline == nullptr) {
+        Renderer_RasterizeFrame(r, frame, r->presentTarget);
+        // Exported frames move to the next slot
+        Renderer_PointAtPresented(r);
+        return;
+    }
 
-    for (int t = 0; t < numThreads; t++) {
-        threads.emplace_back([&, t]() {
-            for (int i = t; i < tilesX * tilesY; i += numThreads) {
-                int tx = i % tilesX;
-                int ty = i / tilesX;
-                Renderer_RasterizeTile(r, triangles, tx, ty, tileSize);
-            }
-        });
+    {
+        std::lock_guard<std::mutex> lock(r->pipeline->mutex);
+        frame->busy = true;
+        RenderPipeline *pipeline = r->pipeline;
+        pipeline->queue[(pipeline->queueHead + pipeline->queueCount) %
+                        MAX_FRAMES_IN_FLIGHT] = frame;
+        pipeline->queueCount++;
+        Renderer_PresentLatest(r);
     }
+    r->pipeline->frameQueued.notify_one();
+}
 
-    for (auto &th : threads) {
-        th.join();
+void Renderer_Finish(Renderer *r) {
+    if (r == nullptr || r->pipeline == nullptr) {
+        return;
     }
+
+    std::unique_lock<std::mutex> lock(r->pipeline->mutex);
+    r->pipeline->frameDone.wait(lock,
+                                [&] { return r->pipeline->queueCount == 0; });
+    Renderer_PresentLatest(r);
 }
 
 void Renderer_FillTriangle(Renderer *r, std::vector<Vec2> *points,
@@ -430,17 +3344,17 @@ void Renderer_FillTriangle(Renderer *r, std::vector<Vec2> *points,
 }
 
 void Renderer_DrawTriangle(Renderer *r, Vec2 vertices[3], uint32_t color) {
-    Vec2 p1 = vertices[0];
-    Vec2 p2 = vertices[1];
-    Vec2 p3 = vertices[2];
-
-    std::vector<Vec2> points;
-
-    Renderer_DrawLine(r, &points, p1, p2, color);
-    Renderer_DrawLine(r, &points, p2, p3, color);
-    Renderer_DrawLine(r, &points, p1, p3, color);
+    if (r == nullptr) {
+        return;
+    }
 
-    Renderer_FillTriangle(r, &points, color);
+    // Filled with its outline, written as clipped spans
+    Overlay_RasterTriangle(r->pixels, r->width, r->height, vertices[0],
+                           vertices[1], vertices[2], color);
+    for (int i = 0; i < 3; i++) {
+        Overlay_RasterLine(r->pixels, r->width, r->height, vertices[i],
+                           vertices[(i + 1) % 3], color);
+    }
 }
 
 // Bresenham's Line algorithm
@@ -487,8 +3401,9 @@ void Renderer_DrawLineHorizontal(Renderer *r, std::vector<Vec2> *points,
     for (int x = p1.x; x <= p2.x; ++x) {
         Renderer_SetPixel(r, x, y, 0.0f, color);
 
-        Vec2 p = {(float)x, (float)y};
-        points->push_back(p);
+        if (points != nullptr) {
+            points->push_back(Vec2{(float)x, (float)y});
+        }
 
         if (d > 0) {
             y += yi;
@@ -520,8 +3435,9 @@ void Renderer_DrawLineVertical(Renderer *r, std::vector<Vec2> *points, Vec2 p1,
     for (int y = p1.y; y <= p2.y; ++y) {
         Renderer_SetPixel(r, x, y, 0.0f, color);
 
-        Vec2 p = {(float)x, (float)y};
-        points->push_back(p);
+        if (points != nullptr) {
+            points->push_back(Vec2{(float)x, (float)y});
+        }
 
         if (d > 0) {
             x += xi;
@@ -532,76 +3448,61 @@ void Renderer_DrawLineVertical(Renderer *r, std::vector<Vec2> *points, Vec2 p1,
     }
 }
 
-ColorRGBA Renderer_CalculateFragmentLighting(Renderer *r, Fragment frag) {
-    // Ambient
-    float ambientStrength = 0.1f;
-    Vec3 lightColor = {1.0f, 1.0f, 1.0f};
-    Vec3 ambient = Vec3_ScalarMult(lightColor, ambientStrength);
-
-    Vec3 fragPos = {(float)frag.coords.x, (float)frag.coords.y, frag.z};
-
-    // Diffuse
-    Vec3 lightPos = {80.0f, 50.0f, 50.0f};
-    Vec3 norm = Vec3_Normalize(frag.normal);
-    Vec3 lightDir = Vec3_Normalize(Vec3_Subtract(lightPos, fragPos));
-    float dp = Vec3_Dot(norm, lightDir);
-    float diff = dp > 0.0 ? dp : 0.0;
-    Vec3 diffuse = Vec3_ScalarMult(lightColor, diff);
-
-    // Specular
-    float specularStrength = 0.5f;
-    Vec3 viewDir = Vec3_Normalize(Vec3_Subtract(r->camera.position, fragPos));
-    Vec3 reflectDir = Vec3_Reflect(Vec3_ScalarMult(lightDir, -1), norm);
-    float spec = powf(fmaxf(Vec3_Dot(viewDir, reflectDir), 0.0), 32);
-    Vec3 specular = Vec3_ScalarMult(lightColor, specularStrength * spec);
-
-    Vec3 lighting = Vec3_Add(ambient, diffuse);
-    lighting = Vec3_Add(lighting, specular);
-
-    return {
-        frag.color.r * lighting.x,
-        frag.color.g * lighting.y,
-        frag.color.b * lighting.z,
-        frag.color.a,
-    };
+ColorRGBA Renderer_CalculateFragmentLighting(const RenderFrame *frame,
+                                            int view, Fragment frag) {
+    return Shader_PhongLighting(frame->views[view].camera.position,
+                                frag.position,
+                                frag.normal, frag.color, frag.shadow);
 }
 
 CubeMesh CreateCubeMesh() {
     CubeMesh mesh = {
         .vertices{
-            // Geometry + Normals
-            -0.5f, -0.5f, -0.5f, 0.0f,  0.0f,  -1.0f, 0.5f,  -0.5f, -0.5f,
-            0.0f,  0.0f,  -1.0f, 0.5f,  0.5f,  -0.5f, 0.0f,  0.0f,  -1.0f,
-            0.5f,  0.5f,  -0.5f, 0.0f,  0.0f,  -1.0f, -0.5f, 0.5f,  -0.5f,
-            0.0f,  0.0f,  -1.0f, -0.5f, -0.5f, -0.5f, 0.0f,  0.0f,  -1.0f,
-
-            -0.5f, -0.5f, 0.5f,  0.0f,  0.0f,  1.0f,  0.5f,  -0.5f, 0.5f,
-            0.0f,  0.0f,  1.0f,  0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  0.0f,  1.0f,  -0.5f, 0.5f,  0.5f,
-            0.0f,  0.0f,  1.0f,  -0.5f, -0.5f, 0.5f,  0.0f,  0.0f,  1.0f,
-
-            -0.5f, 0.5f,  0.5f,  -1.0f, 0.0f,  0.0f,  -0.5f, 0.5f,  -0.5f,
-            -1.0f, 0.0f,  0.0f,  -0.5f, -0.5f, -0.5f, -1.0f, 0.0f,  0.0f,
-            -0.5f, -0.5f, -0.5f, -1.0f, 0.0f,  0.0f,  -0.5f, -0.5f, 0.5f,
-            -1.0f, 0.0f,  0.0f,  -0.5f, 0.5f,  0.5f,  -1.0f, 0.0f,  0.0f,
-
-            0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  0.5f,  0.5f,  -0.5f,
-            1.0f,  0.0f,  0.0f,  0.5f,  -0.5f, -0.5f, 1.0f,  0.0f,  0.0f,
-            0.5f,  -0.5f, -0.5f, 1.0f,  0.0f,  0.0f,  0.5f,  -0.5f, 0.5f,
-            1.0f,  0.0f,  0.0f,  0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,
-
-            -0.5f, -0.5f, -0.5f, 0.0f,  -1.0f, 0.0f,  0.5f,  -0.5f, -0.5f,
-            0.0f,  -1.0f, 0.0f,  0.5f,  -0.5f, 0.5f,  0.0f,  -1.0f, 0.0f,
-            0.5f,  -0.5f, 0.5f,  0.0f,  -1.0f, 0.0f,  -0.5f, -0.5f, 0.5f,
-            0.0f,  -1.0f, 0.0f,  -0.5f, -0.5f, -0.5f, 0.0f,  -1.0f, 0.0f,
-
-            -0.5f, 0.5f,  -0.5f, 0.0f,  1.0f,  0.0f,  0.5f,  0.5f,  -0.5f,
-            0.0f,  1.0f,  0.0f,  0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,
-            0.5f,  0.5f,  0.5f,  0.0f,  1.0f,  0.0f,  -0.5f, 0.5f,  0.5f,
-            0.0f,  1.0f,  0.0f,  -0.5f, 0.5f,  -0.5f, 0.0f,  1.0f,  0.0f,
+            // Geometry + Normals + UVs
+            -0.5f, -0.5f, -0.5f, 0.0f,  0.0f,  -1.0f, 0.0f,  0.0f,  0.5f,
+            -0.5f, -0.5f, 0.0f,  0.0f,  -1.0f, 1.0f,  0.0f,  0.5f,  0.5f,
+            -0.5f, 0.0f,  0.0f,  -1.0f, 1.0f,  1.0f,  0.5f,  0.5f,  -0.5f,
+            0.0f,  0.0f,  -1.0f, 1.0f,  1.0f,  -0.5f, 0.5f,  -0.5f, 0.0f,
+            0.0f,  -1.0f, 0.0f,  1.0f,  -0.5f, -0.5f, -0.5f, 0.0f,  0.0f,
+            -1.0f, 0.0f,  0.0f,
+
+            -0.5f, -0.5f, 0.5f,  0.0f,  0.0f,  1.0f,  0.0f,  0.0f,  0.5f,
+            -0.5f, 0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  0.0f,  0.5f,  0.5f,
+            0.5f,  0.0f,  0.0f,  1.0f,  1.0f,  1.0f,  0.5f,  0.5f,  0.5f,
+            0.0f,  0.0f,  1.0f,  1.0f,  1.0f,  -0.5f, 0.5f,  0.5f,  0.0f,
+            0.0f,  1.0f,  0.0f,  1.0f,  -0.5f, -0.5f, 0.5f,  0.0f,  0.0f,
+            1.0f,  0.0f,  0.0f,
+
+            -0.5f, 0.5f,  0.5f,  -1.0f, 0.0f,  0.0f,  1.0f,  1.0f,  -0.5f,
+            0.5f,  -0.5f, -1.0f, 0.0f,  0.0f,  1.0f,  0.0f,  -0.5f, -0.5f,
+            -0.5f, -1.0f, 0.0f,  0.0f,  0.0f,  0.0f,  -0.5f, -0.5f, -0.5f,
+            -1.0f, 0.0f,  0.0f,  0.0f,  0.0f,  -0.5f, -0.5f, 0.5f,  -1.0f,
+            0.0f,  0.0f,  0.0f,  1.0f,  -0.5f, 0.5f,  0.5f,  -1.0f, 0.0f,
+            0.0f,  1.0f,  1.0f,
+
+            0.5f,  0.5f,  0.5f,  1.0f,  0.0f,  0.0f,  1.0f,  1.0f,  0.5f,
+            0.5f,  -0.5f, 1.0f,  0.0f,  0.0f,  1.0f,  0.0f,  0.5f,  -0.5f,
+            -0.5f, 1.0f,  0.0f,  0.0f,  0.0f,  0.0f,  0.5f,  -0.5f, -0.5f,
+            1.0f,  0.0f,  0.0f,  0.0f,  0.0f,  0.5f,  -0.5f, 0.5f,  1.0f,
+            0.0f,  0.0f,  0.0f,  1.0f,  0.5f,  0.5f,  0.5f,  1.0f,  0.0f,
+            0.0f,  1.0f,  1.0f,
+
+            -0.5f, -0.5f, -0.5f, 0.0f,  -1.0f, 0.0f,  0.0f,  0.0f,  0.5f,
+            -0.5f, -0.5f, 0.0f,  -1.0f, 0.0f,  1.0f,  0.0f,  0.5f,  -0.5f,
+            0.5f,  0.0f,  -1.0f, 0.0f,  1.0f,  1.0f,  0.5f,  -0.5f, 0.5f,
+            0.0f,  -1.0f, 0.0f,  1.0f,  1.0f,  -0.5f, -0.5f, 0.5f,  0.0f,
+            -1.0f, 0.0f,  0.0f,  1.0f,  -0.5f, -0.5f, -0.5f, 0.0f,  -1.0f,
+            0.0f,  0.0f,  0.0f,
+
+            -0.5f, 0.5f,  -0.5f, 0.0f,  1.0f,  0.0f,  0.0f,  0.0f,  0.5f,
+            0.5f,  -0.5f, 0.0f,  1.0f,  0.0f,  1.0f,  0.0f,  0.5f,  0.5f,
+            0.5f,  0.0f,  1.0f,  0.0f,  1.0f,  1.0f,  0.5f,  0.5f,  0.5f,
+            0.0f,  1.0f,  0.0f,  1.0f,  1.0f,  -0.5f, 0.5f,  0.5f,  0.0f,
+            1.0f,  0.0f,  0.0f,  1.0f,  -0.5f, 0.5f,  -0.5f, 0.0f,  1.0f,
+            0.0f,  0.0f,  0.0f,
         },
         .numVertices = 36,
-        .vertexSize = 6,
+        .vertexSize = 8,
     };
 
     return mesh;
@@ -610,14 +3511,15 @@ CubeMesh CreateCubeMesh() {
 QuadMesh CreateQuadMesh() {
     QuadMesh mesh = {
         .vertices{
-            // Geometry + Normals
-            -0.5f, -0.5f, 0.0f, 0.0f,  1.0f,  0.0f, 0.5f,  -0.5f, 0.0f,
-            0.0f,  1.0f,  0.0f, 0.5f,  0.5f,  0.0f, 0.0f,  1.0f,  0.0f,
-            0.5f,  0.5f,  0.0f, 0.0f,  1.0f,  0.0f, -0.5f, 0.5f,  0.0f,
-            0.0f,  1.0f,  0.0f, -0.5f, -0.5f, 0.0f, 0.0f,  1.0f,  0.0f,
+            // Geometry + Normals + UVs
+            -0.5f, -0.5f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.5f, -0.5f,
+            0.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, 0.5f, 0.5f, 0.0f, 0.0f,
+            1.0f,  0.0f,  1.0f,  1.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f,
+            1.0f,  1.0f,  -0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+            -0.5f, -0.5f, 0.0f,  0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
         },
         .numVertices = 6,
-        .vertexSize = 6,
+        .vertexSize = 8,
     };
 
     return mesh;
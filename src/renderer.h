@@ -1,68 +1,577 @@
 #ifndef RASTERIZER_H_
 #define RASTERIZER_H_
 
+#include "arena.h"
 #include "camera.h"
+#include "framering.h"
 #include "math.h"
+#include "mesh.h"
+#include "occlusion.h"
+#include "postprocess.h"
+#include "texture.h"
+#include "threadpool.h"
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
 struct CubeMesh {
-    float vertices[216];
+    float vertices[288];
     uint32_t numVertices;
     uint32_t vertexSize;
 };
 
 struct QuadMesh {
-    float vertices[36];
+    float vertices[48];
     uint32_t numVertices;
     uint32_t vertexSize;
 };
 
 struct Fragment {
-    Vec2 coords;
+    // Pixel center and depth
+    Vec3 position;
     Vec3 normal;
-    float z;
     ColorRGBA color;
+    Vec2 uv;
+    // Fraction of the shadow casting light reaching the fragment
+    float shadow;
 };
 
-struct Vertex {
-    Vec3 coords;
-    Vec3 normal;
-    ColorRGBA color;
+// Last texture LOD computed while rasterizing a triangle, keyed by the
+// top-left pixel of its 2x2 quad
+struct QuadLodCache {
+    int quadX, quadY;
+    float lod;
+};
+
+// Attributes interpolated across a triangle. Everything but the depth is
+// divided by the vertex's clip w, for perspective-correct interpolation
+enum TriangleAttribute {
+    ATTR_Z,     // screen depth, affine in screen space
+    ATTR_INV_W, // 1 / clip w
+    ATTR_NORMAL_X,
+    ATTR_NORMAL_Y,
+    ATTR_NORMAL_Z,
+    ATTR_U,
+    ATTR_V,
+    // Shadow map texel position and light depth, when shadows are enabled
+    ATTR_LIGHT_X,
+    ATTR_LIGHT_Y,
+    ATTR_LIGHT_Z,
+    TRIANGLE_ATTRIBUTES,
+};
+
+// Padded so the planes are evaluated as 4-wide vectors
+const int TRIANGLE_PLANE_WIDTH = 12;
+
+// Screen space plane equations set up once per triangle: attribute i at
+// (px, py) is dx[i] * px + dy[i] * py + c[i]
+struct TrianglePlanes {
+    float dx[TRIANGLE_PLANE_WIDTH];
+    float dy[TRIANGLE_PLANE_WIDTH];
+    float c[TRIANGLE_PLANE_WIDTH];
 };
 
 struct Triangle {
-    Vertex v0, v1, v2;
+    // Coverage, read for every pixel of the bounding box
+    Vec2 v0, v1, v2;
+    Vec2 min, max;
+    float area;
+    // Bounding box within Renderer::microTriangleSize pixels per axis
+    bool micro;
+    // Color alpha below 1, drawn after the opaque triangles of its tile
+    bool transparent;
+    // Index of the RenderFrame view the triangle was projected into
+    uint8_t view;
+    // Shading, read for covered pixels only
+    TrianglePlanes planes;
+    ColorRGBA color;
+    // Modulates the color when set
+    const Texture *texture;
+};
+
+// Largest bounding box size (pixels per axis) of triangles taking the
+// micro-triangle path, and how many consecutive ones are set up together
+const int MICRO_TRIANGLE_SIZE = 4;
+const int MICRO_TRIANGLE_BATCH = 8;
+
+enum TransparencyMode {
+    // Per-pixel fragment lists in tile-local memory, sorted and blended back
+    // to front when the tile is done
+    TRANSPARENCY_TILE_KBUFFER,
+    // Transparent triangles sorted back to front by centroid depth for the
+    // whole frame, blended as they are rasterized
+    TRANSPARENCY_SORTED_TRIANGLES,
+};
+
+// Transparent fragments kept per pixel by the tile k-buffer. When a list is
+// full the farthest fragment is blended right away
+const int TRANSPARENCY_FRAGMENTS = 8;
+
+// Rotated-grid sample positions used for 4x multisampling, relative to the
+// pixel's top-left corner
+const int MSAA_SAMPLES = 4;
+const Vec2 MSAA_SAMPLE_OFFSETS[MSAA_SAMPLES] = {
+    {0.375f, 0.125f},
+    {0.875f, 0.375f},
+    {0.125f, 0.625f},
+    {0.625f, 0.875f},
+};
+
+// A multisampled pixel is "compressed" while every sample holds the same
+// color; only slot 0 of its sample colors is valid in that state
+const uint8_t MSAA_PIXEL_COMPRESSED = 1;
+
+// Number of consecutive frames a budget violation must persist before the
+// dynamic resolution scale is changed
+const int DYNRES_HYSTERESIS_FRAMES = 8;
+// Render widths are kept on multiples of this many pixels
+const int DYNRES_WIDTH_STEP = 16;
+
+struct DynamicResolution {
+    bool enabled;
+    float targetFrameMs;
+    float minScale, maxScale;
+    float scale;
+    // Smoothed frame time and the budget-violation streaks (hysteresis)
+    float avgFrameMs;
+    int framesOverBudget, framesUnderBudget;
+    // Bilinear upscale lookup: per output column the source column and
+    // its 8-bit blend weight, built for upscaleSourceWidth
+    int *upscaleColumns;
+    uint8_t *upscaleWeights;
+    int upscaleSourceWidth;
+};
+
+const int SHADOW_MAP_SIZE = 1024;
+// Shadow map texels on each side of the center sampled by PCF
+const int SHADOW_PCF_RADIUS = 1;
+// Light depth subtracted before comparing against the map, against acne
+const float SHADOW_BIAS = 0.002f;
+
+// Depth of the scene seen from a directional light, an orthographic
+// projection of the box of half size extent around center
+struct ShadowMap {
+    bool enabled;
+    int size;
+    float *depth;
+    float bias;
+    // World -> light clip space (Vec4_Transform convention)
+    Mat4 viewProj;
+    // Casters the map was last rendered from (incremental frames), 0 when
+    // unknown
+    uint64_t hash;
+};
+
+// Most cameras Renderer_SetViews takes
+const int MAX_VIEWS = 8;
+
+// One camera of a multi-view frame and the pixel rectangle of the frame it
+// renders into, e.g. a stereo eye, a cubemap face or a split-screen player
+struct RenderView {
+    Camera camera;
+    int x, y, width, height;
+};
+
+// Instruction set variants of the hot kernels: vertex transform, and the
+// tile pass (edge evaluation, depth test, shading, resolve, color packing)
+// and shadow map tiles. All variants produce the same pixels
+enum RendererIsa {
+    // The compiler's target, e.g. SSE2 on x86-64 or NEON on arm64
+    RENDERER_ISA_GENERIC,
+    // x86 only
+    RENDERER_ISA_SSE42,
+    RENDERER_ISA_COUNT,
+};
+
+const int TILE_SIZE = 32;
+// Screen space vertex positions are snapped to this many steps per pixel
+const int SUBPIXEL_STEPS = 256;
+const int MAX_FRAMES_IN_FLIGHT = 3;
+// Instances transformed per thread pool item by Renderer_DrawInstanced
+const int INSTANCE_CHUNK_SIZE = 64;
+// Vertices skinned per thread pool item by Renderer_DrawSkinned
+const int SKIN_CHUNK_SIZE = 1024;
+// Bytes available for the fragment shader copied into a ShaderBatch
+const int SHADER_MAX_FRAGMENT_SHADER_SIZE = 256;
+// Incremental frames identify the vertex data of a draw by its contents up
+// to this many bytes and by its address beyond
+const size_t INCREMENTAL_HASHED_VERTEX_BYTES = 4096;
+
+struct Renderer;
+struct RenderFrame;
+struct RenderTarget;
+struct ShaderBatch;
+
+// Rasterizes the triangles of a batch overlapping one tile. Instantiated per
+// vertex/fragment shader pair by Renderer_DrawShaded (shader.h)
+typedef void (*ShaderTileFunc)(Renderer *r, const RenderFrame *frame,
+                               RenderTarget *target, const ShaderBatch *batch,
+                               int tileX, int tileY);
+
+// Screen space triangle of a shader batch; its varyings live in the batch
+struct ShaderTriangle {
+    Vec3 v0, v1, v2;
+    // 1 / clip w of each vertex
+    Vec3 invW;
     Vec2 min, max;
     float area;
 };
 
+// Triangles of one Renderer_DrawShaded call. Batches are kept across frames,
+// their lists live in the frame's arena
+struct ShaderBatch {
+    ShaderTileFunc rasterizeTile;
+    alignas(16) unsigned char fragmentShader[SHADER_MAX_FRAGMENT_SHADER_SIZE];
+    // Vertex data, shaders and draw state, for incremental frames
+    uint64_t hash;
+    ArenaArray<ShaderTriangle> triangles;
+    // Three vertices of varyings per triangle, each already divided by w
+    ArenaArray<float> varyings;
+    // Per-tile bins, as in RenderFrame
+    uint32_t *binOffsets;
+    uint32_t *binIndices;
+};
+
+// Draw recorded for incremental frames: the triangles from firstTriangle up
+// to the next record's were produced by a draw hashing to hash
+struct DrawRecord {
+    uint32_t firstTriangle;
+    uint64_t hash;
+};
+
+// Vertices of a SkinnedMesh posed by one palette, in the Renderer_DrawTriangles
+// layout and the frame's arena, with their local bounds
+struct SkinnedVertices {
+    const SkinnedMesh *mesh;
+    // Of the palette
+    uint64_t hash;
+    float *vertices;
+    Vec3 min, max;
+};
+
+// Output of the geometry stage: everything the raster stage needs to produce
+// one frame, so recording the next frame never touches it
+struct RenderFrame {
+    // Backs the triangles, bins and shader batch data below. Reset when the
+    // slot starts a new frame
+    Arena arena;
+    ArenaArray<Triangle> triangles;
+    // Programmable draws of the frame, rasterized per tile after triangles
+    // in submission order. Only the first numShaderBatches are in use
+    std::vector<ShaderBatch> shaderBatches;
+    int numShaderBatches;
+    // Triangles overlapping tile i are
+    // binIndices[binOffsets[i] .. binOffsets[i + 1]]
+    uint32_t *binOffsets;
+    uint32_t *binIndices;
+    int width, height;
+    int tilesX, tilesY;
+    // Shadow casters in shadow map space with their per-tile bins, and the
+    // map to render them into (null without shadows)
+    ArenaArray<Triangle> shadowTriangles;
+    uint32_t *shadowBinOffsets;
+    uint32_t *shadowBinIndices;
+    const ShadowMap *shadow;
+    // Draws of the triangles, recorded when the frame began incremental.
+    // Triangles before orderedTriangles are still in submission order
+    ArenaArray<DrawRecord> draws;
+    bool recordDraws;
+    // Skinned by the frame's Renderer_DrawSkinned calls, reused by later
+    // draws of the same mesh and palette
+    ArenaArray<SkinnedVertices> skinned;
+    uint32_t orderedTriangles;
+    // Triangle counts the slot's previous frame ended with, reserved up
+    // front so the lists don't move while they are recorded
+    uint32_t lastTriangles;
+    uint32_t lastShadowTriangles;
+    // Copied from the renderer when the frame ends
+    TransparencyMode transparency;
+    uint32_t numTransparent;
+    // And the table of its exposure, tonemapping and sRGB encoding
+    PostProcess post;
+    uint8_t postLut[256];
+    bool zPrepass;
+    bool depthOnly;
+    bool incremental;
+    bool clear;
+    uint32_t clearColor;
+    // At least one: the renderer's camera over the whole frame when no
+    // views are set
+    RenderView views[MAX_VIEWS];
+    int numViews;
+    // FrameRing_NowNs when the frame ended, for exported frames
+    uint64_t submitNs;
+    // With incremental, everything but the binned draws that a tile's
+    // output depends on, and the shadow casters
+    uint64_t stateHash;
+    uint64_t shadowHash;
+    uint64_t number;
+    // Queued for or being rasterized (guarded by the pipeline mutex)
+    bool busy;
+};
+
+enum RenderTargetState {
+    TARGET_FREE,
+    TARGET_RASTER,  // being written by the raster stage
+    TARGET_READY,   // complete, not presented yet
+    TARGET_PRESENT, // exposed through Renderer.pixels
+};
+
+struct RenderTarget {
+    uint32_t *pixels;
+    int width, height;
+    uint64_t frameNumber;
+    RenderTargetState state;
+    // Time the raster stage spent on this frame, and the part of it spent
+    // on the shadow map
+    float rasterMs;
+    float shadowMs;
+    // Hash of the frame each tile's colors were last rasterized from (0
+    // when unknown), and how many of the frame's tiles were rasterized
+    // rather than kept
+    uint64_t *tileHashes;
+    int numTiles;
+    int dirtyTiles;
+    // With thread affinity, tiles rasterized by a thread other than their
+    // owner, e.g. because it finished its own tiles first
+    int stolenTiles;
+};
+
+// Raster thread and queue used when frames are pipelined (renderer.cpp)
+struct RenderPipeline;
+// Shared memory ring the targets are rasterized into (renderer.cpp)
+struct FrameExport;
+// FXAA's view of the tiles of the frame being rasterized (renderer.cpp)
+struct PostTiles;
+
 struct Renderer {
     bool ready;
+    // Last completed frame, valid after Renderer_EndFrame. With pipelining
+    // this can lag behind the frame that was just recorded
     uint32_t *pixels;
+    // Current render size. Always <= maxWidth/maxHeight, the size the
+    // buffers were allocated with, so changing it never reallocates
     int width, height;
+    int maxWidth, maxHeight;
     int windowWidth, windowHeight;
     int pixelScale;
 
+    // Fixed-size presentation target. Equal to pixels unless dynamic
+    // resolution is enabled, in which case Renderer_Upscale fills it
+    uint32_t *outputPixels;
+    int outputWidth, outputHeight;
+    DynamicResolution dynres;
+
     float *zBuffer;
+    // Hash of the frame each tile of zBuffer and the samples was last
+    // rasterized from, as in RenderTarget
+    uint64_t *depthTileHashes;
+
+    // Multisampling (sampleCount is 1 or MSAA_SAMPLES)
+    int sampleCount;
+    uint32_t *sampleColors;
+    float *sampleDepths;
+    uint8_t *sampleFlags;
+
+    // Frame recording and presentation. Frames recorded between
+    // Renderer_BeginFrame and Renderer_EndFrame go to frames[] and are
+    // rasterized into one of the targets[]
+    int framesInFlight;
+    RenderFrame frames[MAX_FRAMES_IN_FLIGHT];
+    RenderTarget targets[MAX_FRAMES_IN_FLIGHT];
+    RenderFrame *frame;
+    RenderTarget *presentTarget;
+    uint64_t frameNumber;
+
+    ThreadPool *pool;
+    // See Renderer_EnableThreadAffinity
+    bool threadAffinity;
+    // Kernel variant in use, see Renderer_SetIsa
+    RendererIsa isa;
+    // Null when frames are rasterized synchronously in Renderer_EndFrame
+    RenderPipeline *pipeline;
+    // Optional, see Renderer_EnableFrameExport
+    FrameExport *frameExport;
+    // Optional. Objects hidden behind its occluders are skipped by
+    // Renderer_DrawTriangles and Renderer_DrawInstanced
+    OcclusionBuffer *occlusion;
+    // Triangles whose bounding box spans at most this many pixels per axis
+    // (up to MICRO_TRIANGLE_SIZE) are batched through a fixed 4x4 coverage
+    // step, 0 disables it
+    int microTriangleSize;
+    // How triangles whose color alpha is below 1 are blended. They are drawn
+    // after the opaque triangles and shader batches of their tile, test
+    // against the opaque depth and never write it. With MSAA they are
+    // blended per pixel after the resolve
+    TransparencyMode transparency;
+    // Each tile first rasterizes the depth of its opaque triangles and which
+    // one is in front at each pixel, then shades every pixel once with that
+    // triangle. Ignored with MSAA
+    bool zPrepass;
+    // Frames only rasterize the depth of opaque triangles into zBuffer;
+    // colors are left untouched
+    bool depthOnly;
+    // Tiles whose draws, camera and settings hash the same as the last frame
+    // rasterized into them keep their colors and depths instead of being
+    // rasterized again, so mostly static frames only pay for what changed.
+    // Assumes nothing else writes the targets or zBuffer, and that large
+    // vertex buffers (see INCREMENTAL_HASHED_VERTEX_BYTES), textures and
+    // data shaders point to don't change in place
+    bool incremental;
+    // Optional, see Renderer_EnableShadows
+    ShadowMap shadow;
+    // Effects applied to each tile as soon as it is rasterized, while it is
+    // still in cache, instead of in passes over the whole frame. FXAA reads
+    // FXAA_APRON pixels into the neighbouring tiles: every tile keeps a copy
+    // of its borders from before FXAA, and runs FXAA once the tiles around
+    // it are done. Frames with FXAA rasterize every tile, incremental or
+    // not. Ignored by depth only frames
+    PostProcess post;
+    PostTiles *postTiles;
+    // Totals of Renderer_DrawSkinned: vertices skinned, and draws that
+    // reused the vertices of an earlier draw in the same frame
+    uint64_t skinnedVertices;
+    uint64_t skinReuses;
 
     Camera camera;
+    // Optional, see Renderer_SetViews. Without views, camera renders the
+    // whole frame
+    RenderView views[MAX_VIEWS];
+    int numViews;
 };
 
-Renderer Renderer_Create(int w, int h, int pixelScale = 1);
+Renderer Renderer_Create(int w, int h, int pixelScale = 1,
+                         int sampleCount = 1);
 void Renderer_Destroy(Renderer *r);
+// Frame pipelining: with framesInFlight > 1, Renderer_EndFrame only bins
+// the frame and hands it to a raster thread, so the caller can record the
+// next frame while the previous one is rasterized. Renderer.pixels always
+// points at the most recent completed frame. The raster thread keeps a
+// pointer to r, so the Renderer must not move afterwards.
+void Renderer_EnablePipelining(Renderer *r, int framesInFlight = 2);
+// Frame export: frames are rasterized straight into the slots of a shared
+// memory ring named name (see framering.h) and published as they complete,
+// so other processes read them without a copy. Renderer.pixels then points
+// into the ring. Call after Renderer_EnablePipelining; numSlots is raised
+// to framesInFlight + 1 so the presented frame is never overwritten
+bool Renderer_EnableFrameExport(Renderer *r, const char *name,
+                                int numSlots = FRAME_RING_SLOTS);
+// Thread affinity: the pool's workers are pinned to CPUs grouped by NUMA
+// node, every tile is rasterized by the same thread each frame (others only
+// help once their own tiles are done), and the per-pixel buffers are
+// reallocated and first touched tile by tile by their owners, so the pages
+// of a tile live on its thread's node. On single-socket machines this is
+// plain core pinning. Call before Renderer_EnableFrameExport, whose shared
+// memory is placed by the OS. Returns the number of NUMA nodes, 0 when
+// threads can't be pinned (the stable tile mapping is used regardless)
+int Renderer_EnableThreadAffinity(Renderer *r);
+// Kernel variants. Renderer_Create picks SSE4.2 when the CPU supports it,
+// or the one named by the RASTERIZER_ISA environment variable (generic or
+// sse4.2) when it is supported
+const char *RendererIsa_Name(RendererIsa isa);
+bool RendererIsa_Supported(RendererIsa isa);
+RendererIsa RendererIsa_Detect();
+// Switches r to isa's kernels, false (and unchanged) when the CPU lacks it
+bool Renderer_SetIsa(Renderer *r, RendererIsa isa);
+void Renderer_BeginFrame(Renderer *r);
+void Renderer_EndFrame(Renderer *r);
+// Waits until every submitted frame is rasterized and presents the last one
+void Renderer_Finish(Renderer *r);
+// Records a clear of the frame; applied per tile during rasterization
 void Renderer_ClearBackground(Renderer *r, uint32_t color = 0xFF000000);
+
+// Dynamic resolution: the render size follows the measured frame time within
+// [minScale, maxScale] of the output size and is upscaled on presentation
+void Renderer_EnableDynamicResolution(Renderer *r, float targetFrameMs,
+                                      float minScale = 0.25f,
+                                      float maxScale = 1.0f);
+void Renderer_SetRenderSize(Renderer *r, int w, int h);
+// Multi-view: the draws of following frames are seen by count cameras, each
+// into its own rectangle of the frame, in one pass. Vertices are read and
+// projected for the shadow map once per draw, then culled, projected and
+// clipped per view, and the tiles of every view share one raster pass.
+// count 0 goes back to Renderer.camera. The occlusion buffer is ignored
+// while views are set; Scene culling and Renderer_DrawShaded batches still
+// follow Renderer.camera
+void Renderer_SetViews(Renderer *r, const RenderView *views, int count);
+// Shadows from a directional light shining along lightDirection, covering
+// the world space box of half size extent around center. Opaque triangles
+// drawn afterwards cast shadows (instances culled by the camera do not), and
+// the light's diffuse and specular terms are filtered through the map
+void Renderer_EnableShadows(Renderer *r, Vec3 lightDirection, Vec3 center,
+                            float extent, int size = SHADOW_MAP_SIZE);
+// Fraction of the PCF footprint around shadow map position (x, y) whose
+// occluder depth is not in front of z
+float ShadowMap_Visibility(const ShadowMap *shadow, float x, float y, float z);
+void Renderer_UpdateDynamicResolution(Renderer *r, float frameMs);
+void Renderer_Upscale(Renderer *r);
 void Renderer_SetPixel(Renderer *r, int x, int y, float z, uint32_t color);
 void Renderer_DrawQuad(Renderer *r, Vec3 position, Vec3 rotation, Vec3 scale,
-                       ColorRGBA color);
+                       ColorRGBA color, const Texture *texture = nullptr);
 void Renderer_DrawCube(Renderer *r, Vec3 position, Vec3 rotation, Vec3 scale,
-                       ColorRGBA color);
+                       ColorRGBA color, const Texture *texture = nullptr);
+// Vertices are position + normal (size 6) or position + normal + uv (size 8)
 void Renderer_DrawTriangles(Renderer *r, float *vertices, int length, int size,
                             Vec3 position, Vec3 rotation, Vec3 scale,
-                            ColorRGBA color);
+                            ColorRGBA color, const Texture *texture = nullptr);
+// Draws count copies of mesh, one per model matrix (Renderer_ModelMatrix
+// layout). Instances are culled against the view frustum and transformed in
+// parallel; colors may be null (white)
+void Renderer_DrawInstanced(Renderer *r, const Mesh *mesh,
+                            const Mat4 *transforms, const ColorRGBA *colors,
+                            int count, const Texture *texture = nullptr);
+// Mesh with quantized or compact vertices, decoded as they are transformed.
+// Vertex colors shade their triangles flat with the first vertex's color,
+// times color; whether the draw casts shadows depends on color alone
+void Renderer_DrawPackedMesh(Renderer *r, const PackedMesh *mesh,
+                             Vec3 position, Vec3 rotation, Vec3 scale,
+                             ColorRGBA color, const Texture *texture = nullptr);
+void Renderer_DrawInstanced(Renderer *r, const PackedMesh *mesh,
+                            const Mat4 *transforms, const ColorRGBA *colors,
+                            int count, const Texture *texture = nullptr);
+// Draws mesh deformed by palette, mesh->numBones matrices in the
+// Renderer_ModelMatrix layout mapping bind pose to posed model space, then
+// placed like Renderer_DrawTriangles. Vertices are skinned in parallel
+// chunks into the frame and kept there, so drawing the same mesh with the
+// same palette again in the frame (e.g. a crowd sharing a pose, or another
+// pass) skins it only once
+void Renderer_DrawSkinned(Renderer *r, const SkinnedMesh *mesh,
+                          const Mat4 *palette, Vec3 position, Vec3 rotation,
+                          Vec3 scale, ColorRGBA color,
+                          const Texture *texture = nullptr);
+Mat4 Renderer_ModelMatrix(Vec3 position, Vec3 rotation, Vec3 scale);
+// World -> clip of the camera over the render size, or of the view when
+// Renderer_SetViews set only one, e.g. a region of a larger frame
+Mat4 Renderer_ViewProjection(Renderer *r);
+Mat4 RenderView_ViewProjection(const RenderView *view);
+// Level of lods to draw for model, from its projected size at the current
+// camera zoom and render height. previous is the level picked last frame for
+// the same object (-1 if none) and is kept near switch points
+int Renderer_SelectLod(Renderer *r, const MeshLods *lods, Mat4 model,
+                       int previous = -1);
+// Pipeline hooks for Renderer_DrawShaded (shader.h). AddShaderBatch starts
+// a batch drawn with rasterizeTile and a copy of the fragment shader.
+// SetupShaderTriangle maps clip space positions to the screen and returns
+// false for triangles that are off screen, degenerate or cross w = 0
+ShaderBatch *Renderer_AddShaderBatch(Renderer *r, ShaderTileFunc rasterizeTile,
+                                     const void *fragmentShader, size_t size);
+bool Renderer_SetupShaderTriangle(const Renderer *r, const Vec4 clip[3],
+                                  ShaderTriangle *out);
+// Change tracking for incremental frames: HashBytes continues h with bytes
+// of data, HashVertices identifies vertex data as described at
+// INCREMENTAL_HASHED_VERTEX_BYTES
+uint64_t Renderer_HashBytes(uint64_t h, const void *data, size_t bytes);
+uint64_t Renderer_HashVertices(const void *vertices, size_t bytes);
+// Writes color to the samples of passMask and their depths sampleZ,
+// keeping the pixel compressed when every sample is covered
+void Renderer_WriteSamples(Renderer *r, int idx, uint32_t passMask,
+                           const float *sampleZ, uint32_t color);
+
 void Renderer_DrawTriangle(Renderer *r, Vec2 vertices[3], uint32_t color);
 void Renderer_FillTriangle(Renderer *r, std::vector<Vec2> *points,
                            uint32_t color);
+// Per-pixel Bresenham through Renderer_SetPixel, appending the pixels to
+// points unless it is null. Overlay is the batched path for many lines
 void Renderer_DrawLine(Renderer *r, std::vector<Vec2> *points, Vec2 p1, Vec2 p2,
                        uint32_t color);
 void Renderer_DrawLineVertical(Renderer *r, std::vector<Vec2> *points, Vec2 p1,
@@ -70,7 +579,9 @@ void Renderer_DrawLineVertical(Renderer *r, std::vector<Vec2> *points, Vec2 p1,
 void Renderer_DrawLineHorizontal(Renderer *r, std::vector<Vec2> *points,
                                  Vec2 p1, Vec2 p2, uint32_t color);
 
-ColorRGBA Renderer_CalculateFragmentLighting(Renderer *r, Fragment frag);
+// frag.position is relative to the view's rectangle
+ColorRGBA Renderer_CalculateFragmentLighting(const RenderFrame *frame,
+                                            int view, Fragment frag);
 
 CubeMesh CreateCubeMesh();
 QuadMesh CreateQuadMesh();
@@ -0,0 +1,396 @@
+#include "scene.h"
+#include "renderer.h"
+#include <algorithm>
+#include <cmath>
+
+static Vec3 Vec3_Min(Vec3 a, Vec3 b) {
+    return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+}
+
+static Vec3 Vec3_Max(Vec3 a, Vec3 b) {
+    return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+}
+
+static float Vec3_Axis(Vec3 v, int axis) {
+    return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+static float SurfaceArea(Vec3 min, Vec3 max) {
+    Vec3 d = Vec3_Subtract(max, min);
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+static void SceneObject_UpdateBounds(SceneObject *object) {
+    Mat4_TransformAABB(object->transform, object->mesh->min, object->mesh->max,
+                       &object->min, &object->max);
+}
+
+Scene Scene_Create() {
+    Scene scene = {
+        .needsBuild = true,
+    };
+
+    return scene;
+}
+
+uint32_t Scene_AddObject(Scene *scene, const Mesh *mesh, Mat4 transform,
+                         ColorRGBA color, const Texture *texture) {
+    SceneObject object = {
+        .transform = transform,
+        .mesh = mesh,
+        .texture = texture,
+        .color = color,
+    };
+    SceneObject_UpdateBounds(&object);
+
+    scene->objects.push_back(object);
+    scene->needsBuild = true;
+
+    return scene->objects.size() - 1;
+}
+
+uint32_t Scene_AddLodObject(Scene *scene, const MeshLods *lods, Mat4 transform,
+                            ColorRGBA color, const Texture *texture) {
+    uint32_t object =
+        Scene_AddObject(scene, &lods->levels[0], transform, color, texture);
+    scene->objects[object].lods = lods;
+    scene->objects[object].lod = -1;
+
+    return object;
+}
+
+void Scene_SetTransform(Scene *scene, uint32_t object, Mat4 transform) {
+    scene->objects[object].transform = transform;
+    SceneObject_UpdateBounds(&scene->objects[object]);
+
+    if (!scene->needsBuild) {
+        scene->moved.push_back(object);
+    }
+}
+
+static void Scene_NodeBounds(Scene *scene, BVHNode *node) {
+    if (node->left != 0) {
+        const BVHNode &a = scene->nodes[node->left];
+        const BVHNode &b = scene->nodes[node->left + 1];
+        node->min = Vec3_Min(a.min, b.min);
+        node->max = Vec3_Max(a.max, b.max);
+        return;
+    }
+
+    const SceneObject &first = scene->objects[scene->order[node->first]];
+    node->min = first.min;
+    node->max = first.max;
+    for (uint32_t i = node->first + 1; i < node->first + node->count; i++) {
+        const SceneObject &object = scene->objects[scene->order[i]];
+        node->min = Vec3_Min(node->min, object.min);
+        node->max = Vec3_Max(node->max, object.max);
+    }
+}
+
+// Splits node n at the cheapest of SCENE_BVH_BINS centroid bins per axis, or
+// leaves it a leaf when no split beats intersecting all of its objects
+static void Scene_Subdivide(Scene *scene, uint32_t n,
+                            const std::vector<Vec3> &centroids) {
+    BVHNode node = scene->nodes[n];
+    if (node.count <= SCENE_BVH_LEAF_SIZE) {
+        return;
+    }
+
+    Vec3 cmin = centroids[scene->order[node.first]];
+    Vec3 cmax = cmin;
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        cmin = Vec3_Min(cmin, centroids[scene->order[i]]);
+        cmax = Vec3_Max(cmax, centroids[scene->order[i]]);
+    }
+
+    struct Bin {
+        Vec3 min;
+        Vec3 max;
+        uint32_t count;
+    };
+
+    float bestCost = INFINITY;
+    int bestAxis = -1;
+    int bestSplit = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        float lo = Vec3_Axis(cmin, axis);
+        float extent = Vec3_Axis(cmax, axis) - lo;
+        if (extent <= 0.0f) {
+            continue;
+        }
+        float binScale = SCENE_BVH_BINS / extent;
+
+        Bin bins[SCENE_BVH_BINS] = {};
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            uint32_t o = scene->order[i];
+            int b = std::min(
+                (int)((Vec3_Axis(centroids[o], axis) - lo) * binScale),
+                SCENE_BVH_BINS - 1);
+            const SceneObject &object = scene->objects[o];
+            if (bins[b].count++ == 0) {
+                bins[b].min = object.min;
+                bins[b].max = object.max;
+            } else {
+                bins[b].min = Vec3_Min(bins[b].min, object.min);
+                bins[b].max = Vec3_Max(bins[b].max, object.max);
+            }
+        }
+
+        // Sweep from the right storing area * count, then from the left
+        float rightCost[SCENE_BVH_BINS];
+        Bin acc = {};
+        for (int b = SCENE_BVH_BINS - 1; b > 0; b--) {
+            if (bins[b].count > 0) {
+                acc.min = acc.count ? Vec3_Min(acc.min, bins[b].min)
+                                    : bins[b].min;
+                acc.max = acc.count ? Vec3_Max(acc.max, bins[b].max)
+                                    : bins[b].max;
+                acc.count += bins[b].count;
+            }
+            rightCost[b] = acc.count ? SurfaceArea(acc.min, acc.max) *
+                                           acc.count
+                                     : 0.0f;
+        }
+
+        acc = {};
+        for (int b = 0; b < SCENE_BVH_BINS - 1; b++) {
+            if (bins[b].count > 0) {
+                acc.min = acc.count ? Vec3_Min(acc.min, bins[b].min)
+                                    : bins[b].min;
+                acc.max = acc.count ? Vec3_Max(acc.max, bins[b].max)
+                                    : bins[b].max;
+                acc.count += bins[b].count;
+            }
+            if (acc.count == 0 || acc.count == node.count) {
+                continue;
+            }
+
+            float cost =
+                SurfaceArea(acc.min, acc.max) * acc.count + rightCost[b + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b + 1;
+            }
+        }
+    }
+
+    // All centroids coincide, nothing to split on
+    if (bestAxis < 0) {
+        return;
+    }
+
+    float leafCost = SurfaceArea(node.min, node.max) * node.count;
+    if (bestCost >= leafCost && node.count <= SCENE_BVH_MAX_LEAF_SIZE) {
+        return;
+    }
+
+    float lo = Vec3_Axis(cmin, bestAxis);
+    float binScale = SCENE_BVH_BINS / (Vec3_Axis(cmax, bestAxis) - lo);
+    uint32_t *begin = scene->order.data() + node.first;
+    uint32_t *mid = std::partition(begin, begin + node.count, [&](uint32_t o) {
+        int b = std::min(
+            (int)((Vec3_Axis(centroids[o], bestAxis) - lo) * binScale),
+            SCENE_BVH_BINS - 1);
+        return b < bestSplit;
+    });
+    uint32_t leftCount = mid - begin;
+
+    uint32_t left = scene->nodes.size();
+    scene->nodes.push_back(BVHNode{
+        .first = node.first,
+        .count = leftCount,
+        .parent = n,
+    });
+    scene->nodes.push_back(BVHNode{
+        .first = node.first + leftCount,
+        .count = node.count - leftCount,
+        .parent = n,
+    });
+    scene->nodes[n].left = left;
+
+    for (uint32_t child = left; child < left + 2; child++) {
+        Scene_NodeBounds(scene, &scene->nodes[child]);
+        Scene_Subdivide(scene, child, centroids);
+    }
+}
+
+void Scene_Build(Scene *scene) {
+    uint32_t count = scene->objects.size();
+
+    scene->nodes.clear();
+    scene->moved.clear();
+    scene->needsBuild = false;
+    scene->order.resize(count);
+    if (count == 0) {
+        return;
+    }
+
+    std::vector<Vec3> centroids(count);
+    for (uint32_t i = 0; i < count; i++) {
+        scene->order[i] = i;
+        centroids[i] = Vec3_ScalarMult(
+            Vec3_Add(scene->objects[i].min, scene->objects[i].max), 0.5f);
+    }
+
+    scene->nodes.reserve(2 * count);
+    scene->nodes.push_back(BVHNode{.count = count});
+    Scene_NodeBounds(scene, &scene->nodes[0]);
+    Scene_Subdivide(scene, 0, centroids);
+
+    for (uint32_t n = 0; n < scene->nodes.size(); n++) {
+        const BVHNode &node = scene->nodes[n];
+        if (node.left != 0) {
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            scene->objects[scene->order[i]].leaf = n;
+        }
+    }
+}
+
+void Scene_Refit(Scene *scene) {
+    // Walk up from each moved object's leaf, stopping once a node's bounds
+    // come out unchanged since its ancestors then are too
+    for (uint32_t object : scene->moved) {
+        uint32_t n = scene->objects[object].leaf;
+        while (true) {
+            BVHNode *node = &scene->nodes[n];
+            Vec3 oldMin = node->min;
+            Vec3 oldMax = node->max;
+            Scene_NodeBounds(scene, node);
+
+            bool unchanged =
+                oldMin.x == node->min.x && oldMin.y == node->min.y &&
+                oldMin.z == node->min.z && oldMax.x == node->max.x &&
+                oldMax.y == node->max.y && oldMax.z == node->max.z;
+            if (unchanged || n == 0) {
+                break;
+            }
+            n = node->parent;
+        }
+    }
+
+    scene->moved.clear();
+}
+
+// Bit i of planeMask is set while plane i still needs testing. Returns
+// false if the box is outside, and clears the planes it is fully inside of
+static bool Scene_TestBounds(const Frustum *frustum, Vec3 min, Vec3 max,
+                             uint32_t *planeMask) {
+    for (int i = 0; i < 6; i++) {
+        if (!(*planeMask & (1u << i))) {
+            continue;
+        }
+
+        const Vec4 &p = frustum->planes[i];
+        // Corners furthest along and against the plane normal
+        Vec3 pos = {p.x > 0 ? max.x : min.x, p.y > 0 ? max.y : min.y,
+                    p.z > 0 ? max.z : min.z};
+        Vec3 neg = {p.x > 0 ? min.x : max.x, p.y > 0 ? min.y : max.y,
+                    p.z > 0 ? min.z : max.z};
+
+        if (p.x * pos.x + p.y * pos.y + p.z * pos.z + p.w < 0) {
+            return false;
+        }
+        if (p.x * neg.x + p.y * neg.y + p.z * neg.z + p.w >= 0) {
+            *planeMask &= ~(1u << i);
+        }
+    }
+
+    return true;
+}
+
+static void Scene_CullNode(Scene *scene, const Frustum *frustum, uint32_t n,
+                           uint32_t planeMask) {
+    const BVHNode &node = scene->nodes[n];
+    scene->stats.nodesVisited++;
+
+    if (!Scene_TestBounds(frustum, node.min, node.max, &planeMask)) {
+        return;
+    }
+
+    // Fully inside, accept the whole subtree without further tests
+    if (planeMask == 0) {
+        scene->visible.insert(scene->visible.end(),
+                              scene->order.begin() + node.first,
+                              scene->order.begin() + node.first + node.count);
+        return;
+    }
+
+    if (node.left != 0) {
+        Scene_CullNode(scene, frustum, node.left, planeMask);
+        Scene_CullNode(scene, frustum, node.left + 1, planeMask);
+        return;
+    }
+
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        const SceneObject &object = scene->objects[scene->order[i]];
+        uint32_t objectMask = planeMask;
+        scene->stats.objectsTested++;
+        if (Scene_TestBounds(frustum, object.min, object.max, &objectMask)) {
+            scene->visible.push_back(scene->order[i]);
+        }
+    }
+}
+
+void Scene_Cull(Scene *scene, const Frustum *frustum) {
+    if (scene->needsBuild) {
+        Scene_Build(scene);
+    } else if (!scene->moved.empty()) {
+        Scene_Refit(scene);
+    }
+
+    scene->visible.clear();
+    scene->stats = {};
+    if (!scene->nodes.empty()) {
+        Scene_CullNode(scene, frustum, 0, 0x3f);
+    }
+
+    // Traversal order depends on the tree, draw in object order instead
+    std::sort(scene->visible.begin(), scene->visible.end());
+    scene->stats.objectsVisible = scene->visible.size();
+}
+
+void Scene_Draw(Renderer *r, Scene *scene) {
+    if (r == nullptr || r->frame == nullptr) {
+        return;
+    }
+
+    Frustum frustum = Frustum_FromMatrix(Renderer_ViewProjection(r));
+    Scene_Cull(scene, &frustum);
+
+    auto meshOf = [](const SceneObject &object) {
+        return object.lods ? &object.lods->levels[object.lod] : object.mesh;
+    };
+
+    for (uint32_t o : scene->visible) {
+        SceneObject &object = scene->objects[o];
+        if (object.lods != nullptr) {
+            object.lod =
+                Renderer_SelectLod(r, object.lods, object.transform, object.lod);
+        }
+    }
+
+    size_t i = 0;
+    while (i < scene->visible.size()) {
+        const SceneObject &first = scene->objects[scene->visible[i]];
+        const Mesh *mesh = meshOf(first);
+
+        scene->batchTransforms.clear();
+        scene->batchColors.clear();
+        for (; i < scene->visible.size(); i++) {
+            const SceneObject &object = scene->objects[scene->visible[i]];
+            if (meshOf(object) != mesh || object.texture != first.texture) {
+                break;
+            }
+            scene->batchTransforms.push_back(object.transform);
+            scene->batchColors.push_back(object.color);
+        }
+
+        Renderer_DrawInstanced(r, mesh, scene->batchTransforms.data(),
+                               scene->batchColors.data(),
+                               scene->batchTransforms.size(), first.texture);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef SCENE_H_
+#define SCENE_H_
+
+#include "math.h"
+#include "mesh.h"
+#include "texture.h"
+#include <cstdint>
+#include <vector>
+
+struct Renderer;
+
+// Binned SAH build parameters
+const int SCENE_BVH_BINS = 16;
+const int SCENE_BVH_LEAF_SIZE = 4;
+const int SCENE_BVH_MAX_LEAF_SIZE = 16;
+
+struct SceneObject {
+    // Mat4_Translate/Rotate/Scale layout, as for Renderer_DrawInstanced
+    Mat4 transform;
+    const Mesh *mesh;
+    // Optional, mesh is then lods->levels[0] and lod the level drawn last
+    const MeshLods *lods;
+    int lod;
+    const Texture *texture;
+    ColorRGBA color;
+    // World space bounds
+    Vec3 min;
+    Vec3 max;
+    // BVH leaf holding the object
+    uint32_t leaf;
+};
+
+// Every node covers the objects order[first, first + count). Internal nodes
+// have their children at left and left + 1, leaves have left = 0
+struct BVHNode {
+    Vec3 min;
+    Vec3 max;
+    uint32_t left;
+    uint32_t first;
+    uint32_t count;
+    uint32_t parent;
+};
+
+struct SceneStats {
+    uint32_t nodesVisited;
+    uint32_t objectsTested;
+    uint32_t objectsVisible;
+};
+
+// Retained scene: objects are added once and moved with Scene_SetTransform,
+// which refits the BVH incrementally. Refitting keeps the tree valid but not
+// optimal, call Scene_Build after large changes
+struct Scene {
+    std::vector<SceneObject> objects;
+    std::vector<uint32_t> order;
+    std::vector<BVHNode> nodes;
+    // Objects moved since the last refit
+    std::vector<uint32_t> moved;
+    bool needsBuild;
+    // Draw list of the last Scene_Cull, in object order
+    std::vector<uint32_t> visible;
+    SceneStats stats;
+    // Scratch for Scene_Draw batches
+    std::vector<Mat4> batchTransforms;
+    std::vector<ColorRGBA> batchColors;
+};
+
+Scene Scene_Create();
+uint32_t Scene_AddObject(Scene *scene, const Mesh *mesh, Mat4 transform,
+                         ColorRGBA color, const Texture *texture = nullptr);
+uint32_t Scene_AddLodObject(Scene *scene, const MeshLods *lods, Mat4 transform,
+                            ColorRGBA color, const Texture *texture = nullptr);
+void Scene_SetTransform(Scene *scene, uint32_t object, Mat4 transform);
+void Scene_Build(Scene *scene);
+void Scene_Refit(Scene *scene);
+// Builds or refits as needed, then fills scene->visible with the objects
+// whose bounds intersect the frustum
+void Scene_Cull(Scene *scene, const Frustum *frustum);
+// Culls against the renderer's camera, selects the level of objects with
+// lods and draws the visible objects, batching consecutive objects that end
+// up with the same mesh and texture
+void Scene_Draw(Renderer *r, Scene *scene);
+
+#endif
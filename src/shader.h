@@ -0,0 +1,341 @@
+#ifndef SHADER_H_
+#define SHADER_H_
+
+#include "renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+// Programmable pipeline. Shaders are plain types, so the tile rasterizer is
+// instantiated per vertex/fragment shader pair and both the interpolation of
+// the declared varyings and the fragment code inline into the pixel loop.
+//
+// A vertex shader declares its varyings and maps one vertex (vertexSize
+// floats) to clip space:
+//
+//     struct Varyings { Vec3 normal; };  // floats only
+//     Vec4 Vertex(const float *vertex, Varyings *out) const;
+//
+// A fragment shader receives the perspective-correct varyings and the pixel
+// center with its depth, and returns false to discard the fragment:
+//
+//     bool Fragment(const Varyings &in, Vec3 fragCoord, ColorRGBA *out) const;
+//
+// Member variables act as uniforms. The fragment shader is copied into the
+// frame, so it must be trivially copyable and fit in
+// SHADER_MAX_FRAGMENT_SHADER_SIZE bytes.
+
+template <typename Varyings> constexpr int Shader_VaryingCount() {
+    return std::is_empty<Varyings>::value ? 0
+                                          : sizeof(Varyings) / sizeof(float);
+}
+
+inline float Shader_EdgeFunction(Vec3 a, Vec3 b, float px, float py) {
+    return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+
+// Interpolates the varyings at barycentrics b0-b2 and runs the fragment
+// shader. varyings holds the three vertices' values, divided by their w
+template <typename VS, typename FS>
+inline bool Shader_ShadeFragment(const FS &fs, const ShaderTriangle &t,
+                                 const float *varyings, float b0, float b1,
+                                 float b2, Vec3 fragCoord, uint32_t *color) {
+    using Varyings = typename VS::Varyings;
+    const int N = Shader_VaryingCount<Varyings>();
+
+    Varyings in;
+    if constexpr (N > 0) {
+        float w = 1.0f / (b0 * t.invW.x + b1 * t.invW.y + b2 * t.invW.z);
+        float values[N];
+        for (int k = 0; k < N; k++) {
+            values[k] = (b0 * varyings[k] + b1 * varyings[N + k] +
+                         b2 * varyings[2 * N + k]) *
+                        w;
+        }
+        memcpy(&in, values, sizeof(in));
+    }
+
+    ColorRGBA out;
+    if (!fs.Fragment(in, fragCoord, &out)) {
+        return false;
+    }
+    *color = ColorRGBAToInt(out);
+    return true;
+}
+
+// Pixel loop of one triangle over the box minX..maxX, minY..maxY
+template <typename VS, typename FS>
+void Shader_RasterizeTriangle(Renderer *r, const RenderFrame *frame,
+                              RenderTarget *target, const FS &fs,
+                              const ShaderTriangle &t, const float *varyings,
+                              int minX, int minY, int maxX, int maxY) {
+    // Clockwise triangles are inside where all edge values are <= 0
+    float sign = t.area < 0 ? -1.0f : 1.0f;
+    float invArea = 1.0f / t.area;
+
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+            float py = y + 0.5f;
+            float w0 = Shader_EdgeFunction(t.v1, t.v2, px, py);
+            float w1 = Shader_EdgeFunction(t.v2, t.v0, px, py);
+            float w2 = Shader_EdgeFunction(t.v0, t.v1, px, py);
+            if (sign * w0 < 0 || sign * w1 < 0 || sign * w2 < 0) {
+                continue;
+            }
+
+            float b0 = w0 * invArea;
+            float b1 = w1 * invArea;
+            float b2 = w2 * invArea;
+            float z = b0 * t.v0.z + b1 * t.v1.z + b2 * t.v2.z;
+
+            int idx = y * frame->width + x;
+            if (z >= r->zBuffer[idx]) {
+                continue;
+            }
+
+            uint32_t color;
+            if (Shader_ShadeFragment<VS>(fs, t, varyings, b0, b1, b2,
+                                         {px, py, z}, &color)) {
+                r->zBuffer[idx] = z;
+                target->pixels[idx] = color;
+            }
+        }
+    }
+}
+
+// 4x MSAA: per-sample coverage and depth, shaded once at the pixel center
+template <typename VS, typename FS>
+void Shader_RasterizeTriangleMSAA(Renderer *r, const RenderFrame *frame,
+                                  const FS &fs, const ShaderTriangle &t,
+                                  const float *varyings, int minX, int minY,
+                                  int maxX, int maxY) {
+    float sign = t.area < 0 ? -1.0f : 1.0f;
+    float invArea = 1.0f / t.area;
+
+    for (int y = minY; y <= maxY; y++) {
+        for (int x = minX; x <= maxX; x++) {
+            int idx = y * frame->width + x;
+            const float *depths = &r->sampleDepths[idx * MSAA_SAMPLES];
+
+            uint32_t passMask = 0;
+            float sampleZ[MSAA_SAMPLES];
+
+            for (int s = 0; s < MSAA_SAMPLES; s++) {
+                float sx = x + MSAA_SAMPLE_OFFSETS[s].x;
+                float sy = y + MSAA_SAMPLE_OFFSETS[s].y;
+                float w0 = Shader_EdgeFunction(t.v1, t.v2, sx, sy);
+                float w1 = Shader_EdgeFunction(t.v2, t.v0, sx, sy);
+                float w2 = Shader_EdgeFunction(t.v0, t.v1, sx, sy);
+                if (sign * w0 < 0 || sign * w1 < 0 || sign * w2 < 0) {
+                    continue;
+                }
+
+                sampleZ[s] =
+                    (w0 * t.v0.z + w1 * t.v1.z + w2 * t.v2.z) * invArea;
+                if (sampleZ[s] < depths[s]) {
+                    passMask |= 1u << s;
+                }
+            }
+
+            if (passMask == 0) {
+                continue;
+            }
+
+            float px = x + 0.5f;
+            float py = y + 0.5f;
+            float b0 = Shader_EdgeFunction(t.v1, t.v2, px, py) * invArea;
+            float b1 = Shader_EdgeFunction(t.v2, t.v0, px, py) * invArea;
+            float b2 = 1.0f - b0 - b1;
+            float z = b0 * t.v0.z + b1 * t.v1.z + b2 * t.v2.z;
+
+            uint32_t color;
+            if (Shader_ShadeFragment<VS>(fs, t, varyings, b0, b1, b2,
+                                         {px, py, z}, &color)) {
+                Renderer_WriteSamples(r, idx, passMask, sampleZ, color);
+            }
+        }
+    }
+}
+
+// ShaderTileFunc of a shader pair. Same coverage rules as the built-in
+// rasterizer; depth is interpolated linearly in screen space
+template <typename VS, typename FS>
+void Shader_RasterizeTile(Renderer *r, const RenderFrame *frame,
+                          RenderTarget *target, const ShaderBatch *batch,
+                          int tileX, int tileY) {
+    const int N = Shader_VaryingCount<typename VS::Varyings>();
+    const FS &fs = *reinterpret_cast<const FS *>(batch->fragmentShader);
+
+    int x0 = tileX * TILE_SIZE;
+    int y0 = tileY * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, frame->width);
+    int y1 = std::min(y0 + TILE_SIZE, frame->height);
+
+    int tile = tileY * frame->tilesX + tileX;
+    uint32_t binStart = batch->binOffsets[tile];
+    uint32_t binEnd = batch->binOffsets[tile + 1];
+
+    for (uint32_t i = binStart; i < binEnd; i++) {
+        uint32_t index = batch->binIndices[i];
+        const ShaderTriangle &t = batch->triangles[index];
+        const float *varyings = batch->varyings.data + index * 3 * N;
+
+        // Only the part of the bounding box inside the tile
+        int minX = std::max(x0, (int)t.min.x);
+        int minY = std::max(y0, (int)t.min.y);
+        int maxX = std::min(x1 - 1, (int)t.max.x);
+        int maxY = std::min(y1 - 1, (int)t.max.y);
+
+        if (r->sampleCount > 1) {
+            Shader_RasterizeTriangleMSAA<VS>(r, frame, fs, t, varyings, minX,
+                                             minY, maxX, maxY);
+        } else {
+            Shader_RasterizeTriangle<VS>(r, frame, target, fs, t, varyings,
+                                         minX, minY, maxX, maxY);
+        }
+    }
+}
+
+// Draws numVertices / 3 triangles of vertexSize floats per vertex through a
+// vertex and fragment shader pair. The vertex shader runs here; fragments
+// are shaded when the frame is rasterized, after the frame's built-in
+// triangles and earlier shaded draws
+template <typename VS, typename FS>
+void Renderer_DrawShaded(Renderer *r, const float *vertices, int numVertices,
+                         int vertexSize, const VS &vertexShader,
+                         const FS &fragmentShader) {
+    using Varyings = typename VS::Varyings;
+    const int N = Shader_VaryingCount<Varyings>();
+    static_assert(std::is_trivially_copyable<Varyings>::value &&
+                      (N == 0 || sizeof(Varyings) == N * sizeof(float)),
+                  "Varyings must only hold floats");
+    static_assert(std::is_trivially_copyable<FS>::value &&
+                      sizeof(FS) <= SHADER_MAX_FRAGMENT_SHADER_SIZE &&
+                      alignof(FS) <= 16,
+                  "The fragment shader is copied into the frame");
+
+    if (r == nullptr || r->frame == nullptr) {
+        return;
+    }
+
+    ShaderBatch *batch = Renderer_AddShaderBatch(
+        r, Shader_RasterizeTile<VS, FS>, &fragmentShader, sizeof(FS));
+    if (r->frame->recordDraws) {
+        uint64_t h = Renderer_HashVertices(
+            vertices, (size_t)numVertices * vertexSize * sizeof(float));
+        h = Renderer_HashBytes(h, &vertexShader, sizeof(VS));
+        h = Renderer_HashBytes(h, &fragmentShader, sizeof(FS));
+        batch->hash = Renderer_HashBytes(h, &batch->rasterizeTile,
+                                         sizeof(batch->rasterizeTile));
+    }
+
+    // Both lists are reserved for every triangle up front, so they never
+    // move while they fill
+    Arena *arena = &r->frame->arena;
+    ArenaArray_Reserve(arena, &batch->triangles, numVertices / 3);
+    ArenaArray_Reserve(arena, &batch->varyings, numVertices / 3 * 3 * N);
+
+    for (int i = 0; i + 2 < numVertices; i += 3) {
+        Vec4 clip[3];
+        Varyings out[3];
+        for (int k = 0; k < 3; k++) {
+            clip[k] = vertexShader.Vertex(&vertices[(i + k) * vertexSize],
+                                          &out[k]);
+        }
+
+        ShaderTriangle t;
+        if (!Renderer_SetupShaderTriangle(r, clip, &t)) {
+            continue;
+        }
+        *ArenaArray_Push(arena, &batch->triangles) = t;
+
+        if constexpr (N > 0) {
+            const float invW[3] = {t.invW.x, t.invW.y, t.invW.z};
+            float *dst = ArenaArray_Push(arena, &batch->varyings, 3 * N);
+            for (int k = 0; k < 3; k++) {
+                memcpy(&dst[k * N], &out[k], sizeof(Varyings));
+                for (int j = 0; j < N; j++) {
+                    dst[k * N + j] *= invW[k];
+                }
+            }
+        }
+    }
+}
+
+template <typename VS, typename FS>
+void Renderer_DrawShaded(Renderer *r, const Mesh *mesh, const VS &vertexShader,
+                         const FS &fragmentShader) {
+    Renderer_DrawShaded(r, mesh->vertices.data(), mesh->numVertices,
+                        mesh->vertexSize, vertexShader, fragmentShader);
+}
+
+// Ambient, diffuse and specular lighting of the built-in path, a white light
+// at a fixed position. fragPos is the pixel center and its depth. shadow is
+// the fraction of the light reaching the fragment, it scales diffuse and
+// specular
+inline ColorRGBA Shader_PhongLighting(Vec3 cameraPosition, Vec3 fragPos,
+                                      Vec3 normal, ColorRGBA color,
+                                      float shadow = 1.0f) {
+    // Ambient
+    float ambientStrength = 0.1f;
+    Vec3 lightColor = {1.0f, 1.0f, 1.0f};
+    Vec3 ambient = Vec3_ScalarMult(lightColor, ambientStrength);
+
+    // Diffuse
+    Vec3 lightPos = {80.0f, 50.0f, 50.0f};
+    Vec3 norm = Vec3_Normalize(normal);
+    Vec3 lightDir = Vec3_Normalize(Vec3_Subtract(lightPos, fragPos));
+    float dp = Vec3_Dot(norm, lightDir);
+    float diff = dp > 0.0 ? dp : 0.0;
+    Vec3 diffuse = Vec3_ScalarMult(lightColor, diff * shadow);
+
+    // Specular
+    float specularStrength = 0.5f;
+    Vec3 viewDir = Vec3_Normalize(Vec3_Subtract(cameraPosition, fragPos));
+    Vec3 reflectDir = Vec3_Reflect(Vec3_ScalarMult(lightDir, -1), norm);
+    float spec = powf(std::max(0.0f, Vec3_Dot(viewDir, reflectDir)), 32);
+    Vec3 specular =
+        Vec3_ScalarMult(lightColor, specularStrength * spec * shadow);
+
+    Vec3 lighting = Vec3_Add(ambient, diffuse);
+    lighting = Vec3_Add(lighting, specular);
+
+    return {
+        color.r * lighting.x,
+        color.g * lighting.y,
+        color.b * lighting.z,
+        color.a,
+    };
+}
+
+// The built-in shading as a shader pair, for position + normal vertices.
+// Like Renderer_DrawTriangles, normals are lit in model space
+struct PhongVertexShader {
+    struct Varyings {
+        Vec3 normal;
+    };
+
+    Mat4 modelViewProj;
+
+    Vec4 Vertex(const float *vertex, Varyings *out) const {
+        out->normal = {vertex[3], vertex[4], vertex[5]};
+        return Vec4_Transform(Vec4{vertex[0], vertex[1], vertex[2], 1.0f},
+                              modelViewProj);
+    }
+};
+
+struct PhongFragmentShader {
+    ColorRGBA color;
+    Vec3 cameraPosition;
+
+    bool Fragment(const PhongVertexShader::Varyings &in, Vec3 fragCoord,
+                  ColorRGBA *out) const {
+        *out = Shader_PhongLighting(cameraPosition, fragCoord, in.normal,
+                                    color);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,567 @@
+#include "streaming.h"
+#include "renderer.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+const uint32_t STREAMING_FILE_MAGIC = 0x4D525453; // "STRM"
+
+struct StreamingFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numChunks;
+    float chunkSize;
+};
+
+struct StreamingFileChunk {
+    int32_t x, z;
+    Vec3 min, max;
+    uint64_t offset, size;
+};
+
+// A chunk's data starts with the counts, then per mesh its vertex count,
+// vertex size and vertices, then the objects
+struct StreamingFileChunkHeader {
+    uint32_t numMeshes;
+    uint32_t numObjects;
+};
+
+struct StreamingFileObject {
+    uint32_t mesh;
+    Mat4 transform;
+    ColorRGBA color;
+};
+
+struct StreamingChunkData {
+    // Sized once before the scene points into it
+    std::vector<Mesh> meshes;
+    Scene scene;
+};
+
+static void Streaming_Append(std::vector<uint8_t> *out, const void *data,
+                             size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    out->insert(out->end(), bytes, bytes + size);
+}
+
+bool StreamingWorld_Write(const char *path, const Scene *scene,
+                          float chunkSize) {
+    if (scene == nullptr || chunkSize <= 0.0f) {
+        return false;
+    }
+
+    // Objects per grid cell, in a stable order
+    std::map<std::pair<int, int>, std::vector<uint32_t>> cells;
+    for (uint32_t o = 0; o < scene->objects.size(); o++) {
+        const SceneObject &object = scene->objects[o];
+        float cx = (object.min.x + object.max.x) * 0.5f;
+        float cz = (object.min.z + object.max.z) * 0.5f;
+        cells[{(int)floorf(cx / chunkSize), (int)floorf(cz / chunkSize)}]
+            .push_back(o);
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+
+    StreamingFileHeader header = {STREAMING_FILE_MAGIC,
+                                  STREAMING_FILE_VERSION,
+                                  (uint32_t)cells.size(), chunkSize};
+    std::vector<StreamingFileChunk> index;
+    uint64_t offset =
+        sizeof(header) + cells.size() * sizeof(StreamingFileChunk);
+    std::vector<uint8_t> data;
+    bool ok = fseek(file, (long)offset, SEEK_SET) == 0;
+
+    for (const auto &cell : cells) {
+        // The chunk's distinct meshes, in first use order
+        std::vector<const Mesh *> meshes;
+        std::vector<StreamingFileObject> objects;
+        StreamingFileChunk chunk = {
+            .x = cell.first.first,
+            .z = cell.first.second,
+            .min = scene->objects[cell.second[0]].min,
+            .max = scene->objects[cell.second[0]].max,
+        };
+        for (uint32_t o : cell.second) {
+            const SceneObject &object = scene->objects[o];
+            auto it = std::find(meshes.begin(), meshes.end(), object.mesh);
+            if (it == meshes.end()) {
+                it = meshes.insert(it, object.mesh);
+            }
+            objects.push_back({(uint32_t)(it - meshes.begin()),
+                               object.transform, object.color});
+
+            chunk.min = {std::min(chunk.min.x, object.min.x),
+                         std::min(chunk.min.y, object.min.y),
+                         std::min(chunk.min.z, object.min.z)};
+            chunk.max = {std::max(chunk.max.x, object.max.x),
+                         std::max(chunk.max.y, object.max.y),
+                         std::max(chunk.max.z, object.max.z)};
+        }
+
+        data.clear();
+        StreamingFileChunkHeader counts = {(uint32_t)meshes.size(),
+                                           (uint32_t)objects.size()};
+        Streaming_Append(&data, &counts, sizeof(counts));
+        for (const Mesh *mesh : meshes) {
+            uint32_t sizes[2] = {mesh->numVertices, mesh->vertexSize};
+            Streaming_Append(&data, sizes, sizeof(sizes));
+            Streaming_Append(&data, mesh->vertices.data(),
+                             mesh->vertices.size() * sizeof(float));
+        }
+        Streaming_Append(&data, objects.data(),
+                         objects.size() * sizeof(StreamingFileObject));
+
+        chunk.offset = offset;
+        chunk.size = data.size();
+        index.push_back(chunk);
+        offset += data.size();
+        ok = ok && fwrite(data.data(), 1, data.size(), file) == data.size();
+    }
+
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(index.data(), sizeof(StreamingFileChunk), index.size(),
+                file) == index.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        fprintf(stderr, "could not write %s\n", path);
+    }
+    return ok;
+}
+
+static bool Streaming_ReadAt(int fd, void *data, size_t size,
+                             uint64_t offset) {
+    uint8_t *p = (uint8_t *)data;
+    while (size > 0) {
+        ssize_t n = pread(fd, p, size, (off_t)offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// Reads a chunk and builds its scene, on a loader thread. Null when the
+// data is unreadable
+static StreamingChunkData *StreamingWorld_LoadChunk(int fd,
+                                                    const StreamingChunk *c) {
+    std::vector<uint8_t> blob(c->size);
+    if (!Streaming_ReadAt(fd, blob.data(), blob.size(), c->offset)) {
+        return nullptr;
+    }
+
+    size_t at = 0;
+    auto read = [&](void *out, size_t size) {
+        if (blob.size() - at < size) {
+            return false;
+        }
+        memcpy(out, &blob[at], size);
+        at += size;
+        return true;
+    };
+
+    StreamingFileChunkHeader counts;
+    if (!read(&counts, sizeof(counts))) {
+        return nullptr;
+    }
+
+    // Every mesh takes at least its two sizes, so a count beyond that is
+    // corrupt rather than something to allocate for
+    if (counts.numMeshes > (blob.size() - at) / (2 * sizeof(uint32_t))) {
+        return nullptr;
+    }
+
+    StreamingChunkData *data = new StreamingChunkData();
+    data->meshes.reserve(counts.numMeshes);
+    for (uint32_t m = 0; m < counts.numMeshes; m++) {
+        uint32_t sizes[2];
+        if (!read(sizes, sizeof(sizes)) || sizes[1] == 0 ||
+            (blob.size() - at) / sizeof(float) / sizes[1] < sizes[0]) {
+            delete data;
+            return nullptr;
+        }
+        data->meshes.push_back(Mesh_Create((const float *)&blob[at],
+                                           sizes[0], sizes[1]));
+        at += (size_t)sizes[0] * sizes[1] * sizeof(float);
+    }
+
+    data->scene = Scene_Create();
+    for (uint32_t o = 0; o < counts.numObjects; o++) {
+        StreamingFileObject object;
+        if (!read(&object, sizeof(object)) ||
+            object.mesh >= data->meshes.size()) {
+            delete data;
+            return nullptr;
+        }
+        Scene_AddObject(&data->scene, &data->meshes[object.mesh],
+                        object.transform, object.color);
+    }
+    Scene_Build(&data->scene);
+    return data;
+}
+
+static void StreamingWorld_LoaderLoop(StreamingWorld *world) {
+#ifdef __linux__
+    // Lowest priority: when the cores are busy, loads wait for the render
+    // thread instead of preempting it in the middle of a frame
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), 19);
+#endif
+
+    std::unique_lock<std::mutex> lock(world->mutex);
+
+    for (;;) {
+        world->workAvailable.wait(lock, [&] {
+            return world->quit || !world->requests.empty() ||
+                   !world->retired.empty();
+        });
+        if (world->quit) {
+            return;
+        }
+
+        if (!world->retired.empty()) {
+            StreamingChunkData *data = world->retired.back();
+            world->retired.pop_back();
+            lock.unlock();
+            delete data;
+            lock.lock();
+            continue;
+        }
+
+        uint32_t c = world->requests.front();
+        world->requests.erase(world->requests.begin());
+        // Offset and size never change, the render thread updates the rest
+        // of the chunk without the lock
+        StreamingChunk chunk = {};
+        chunk.offset = world->chunks[c].offset;
+        chunk.size = world->chunks[c].size;
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        StreamingChunkData *data = StreamingWorld_LoadChunk(world->fd, &chunk);
+        float ms = std::chrono::duration<float, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+        lock.lock();
+        world->completed.push_back({c, data});
+        world->stats.lastLoadMs = ms;
+        world->stats.maxLoadMs = std::max(world->stats.maxLoadMs, ms);
+    }
+}
+
+bool StreamingWorld_Open(StreamingWorld *world, const char *path,
+                         size_t budgetBytes, float loadRadius,
+                         int numLoaders) {
+    world->fd = open(path, O_RDONLY);
+    if (world->fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    // Counts and sizes from the file are checked against its size before
+    // anything is allocated for them
+    struct stat st;
+    uint64_t fileSize = fstat(world->fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+    StreamingFileHeader header;
+    std::vector<StreamingFileChunk> index;
+    bool ok = fileSize >= sizeof(header) &&
+              Streaming_ReadAt(world->fd, &header, sizeof(header), 0) &&
+              header.magic == STREAMING_FILE_MAGIC &&
+              header.version == STREAMING_FILE_VERSION &&
+              header.numChunks <= (fileSize - sizeof(header)) /
+                                      sizeof(StreamingFileChunk);
+    if (ok) {
+        index.resize(header.numChunks);
+        ok = Streaming_ReadAt(world->fd, index.data(),
+                              index.size() * sizeof(StreamingFileChunk),
+                              sizeof(header));
+    }
+    if (!ok) {
+        fprintf(stderr, "%s is not a streaming world\n", path);
+        close(world->fd);
+        world->fd = -1;
+        return false;
+    }
+
+    world->chunkSize = header.chunkSize;
+    world->chunks.clear();
+    for (const StreamingFileChunk &c : index) {
+        // Chunks past the end of the file fail without being read
+        bool inFile = c.offset <= fileSize && c.size <= fileSize - c.offset;
+        world->chunks.push_back({
+            .x = c.x,
+            .z = c.z,
+            .min = c.min,
+            .max = c.max,
+            .offset = c.offset,
+            .size = c.size,
+            .state = inFile ? STREAMING_CHUNK_UNLOADED : STREAMING_CHUNK_FAILED,
+        });
+    }
+    world->budgetBytes = budgetBytes;
+    world->loadRadius = loadRadius;
+    world->frame = 0;
+    world->quit = false;
+    world->stats = {
+        .chunks = (int)world->chunks.size(),
+        .budgetBytes = budgetBytes,
+    };
+
+    for (int i = 0; i < numLoaders; i++) {
+        world->loaders.emplace_back(StreamingWorld_LoaderLoop, world);
+    }
+    return true;
+}
+
+void StreamingWorld_Close(StreamingWorld *world) {
+    if (world == nullptr || world->fd < 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(world->mutex);
+        world->quit = true;
+    }
+    world->workAvailable.notify_all();
+    for (std::thread &loader : world->loaders) {
+        loader.join();
+    }
+    world->loaders.clear();
+
+    for (StreamingChunk &chunk : world->chunks) {
+        delete chunk.data;
+    }
+    for (auto &done : world->completed) {
+        delete done.second;
+    }
+    for (StreamingChunkData *data : world->retired) {
+        delete data;
+    }
+    world->chunks.clear();
+    world->requests.clear();
+    world->completed.clear();
+    world->retired.clear();
+
+    close(world->fd);
+    world->fd = -1;
+}
+
+// Distance from position to the chunk's bounds, 0 inside
+static float StreamingChunk_Distance(const StreamingChunk *chunk,
+                                     Vec3 position) {
+    float dx = std::max({chunk->min.x - position.x, 0.0f,
+                         position.x - chunk->max.x});
+    float dy = std::max({chunk->min.y - position.y, 0.0f,
+                         position.y - chunk->max.y});
+    float dz = std::max({chunk->min.z - position.z, 0.0f,
+                         position.z - chunk->max.z});
+    return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// Stores a loaded chunk, or marks it failed
+static void StreamingWorld_Complete(StreamingWorld *world, uint32_t c,
+                                    StreamingChunkData *data) {
+    StreamingChunk &chunk = world->chunks[c];
+    chunk.data = data;
+    chunk.state = data != nullptr ? STREAMING_CHUNK_RESIDENT
+                                  : STREAMING_CHUNK_FAILED;
+    world->stats.pending--;
+    if (data != nullptr) {
+        world->stats.resident++;
+        world->stats.residentBytes += chunk.size;
+        world->stats.loads++;
+    } else {
+        world->stats.committedBytes -= chunk.size;
+        fprintf(stderr, "streaming chunk %d,%d is unreadable\n", chunk.x,
+                chunk.z);
+    }
+}
+
+// Frees room for bytes by evicting resident chunks not visible last frame
+// and farther than maxDistance, least recently visible first. False if
+// that isn't enough; nothing is evicted then
+static bool StreamingWorld_MakeRoom(StreamingWorld *world, uint64_t bytes,
+                                    float maxDistance) {
+    size_t needed = world->stats.committedBytes + bytes;
+    if (needed <= world->budgetBytes) {
+        return true;
+    }
+
+    std::vector<uint32_t> victims;
+    size_t freed = 0;
+    for (uint32_t c = 0; c < world->chunks.size(); c++) {
+        const StreamingChunk &chunk = world->chunks[c];
+        if (chunk.state == STREAMING_CHUNK_RESIDENT &&
+            chunk.lastVisibleFrame + 1 < world->frame &&
+            chunk.distance > maxDistance) {
+            victims.push_back(c);
+            freed += chunk.size;
+        }
+    }
+    if (needed > world->budgetBytes + freed) {
+        return false;
+    }
+
+    std::sort(victims.begin(), victims.end(), [&](uint32_t a, uint32_t b) {
+        const StreamingChunk &ca = world->chunks[a];
+        const StreamingChunk &cb = world->chunks[b];
+        return ca.lastVisibleFrame != cb.lastVisibleFrame
+                   ? ca.lastVisibleFrame < cb.lastVisibleFrame
+                   : ca.distance > cb.distance;
+    });
+
+    // Freed by the loaders, or here without any
+    std::vector<StreamingChunkData *> retired;
+    for (uint32_t c : victims) {
+        if (world->stats.committedBytes + bytes <= world->budgetBytes) {
+            break;
+        }
+        StreamingChunk &chunk = world->chunks[c];
+        retired.push_back(chunk.data);
+        chunk.data = nullptr;
+        chunk.state = STREAMING_CHUNK_UNLOADED;
+        world->stats.resident--;
+        world->stats.residentBytes -= chunk.size;
+        world->stats.committedBytes -= chunk.size;
+        world->stats.evictions++;
+    }
+
+    if (world->loaders.empty()) {
+        for (StreamingChunkData *data : retired) {
+            delete data;
+        }
+    } else {
+        {
+            std::lock_guard<std::mutex> lock(world->mutex);
+            world->retired.insert(world->retired.end(), retired.begin(),
+                                  retired.end());
+        }
+        world->workAvailable.notify_one();
+    }
+    return true;
+}
+
+void StreamingWorld_Update(StreamingWorld *world, Vec3 position) {
+    if (world == nullptr || world->fd < 0) {
+        return;
+    }
+    world->frame++;
+
+    std::vector<std::pair<uint32_t, StreamingChunkData *>> completed;
+    {
+        std::lock_guard<std::mutex> lock(world->mutex);
+        completed.swap(world->completed);
+
+        // Requests not started yet are redone below in the new order
+        for (uint32_t c : world->requests) {
+            world->chunks[c].state = STREAMING_CHUNK_UNLOADED;
+            world->stats.pending--;
+            world->stats.committedBytes -= world->chunks[c].size;
+        }
+        world->requests.clear();
+    }
+    for (auto &done : completed) {
+        StreamingWorld_Complete(world, done.first, done.second);
+    }
+
+    world->wanted.clear();
+    for (uint32_t c = 0; c < world->chunks.size(); c++) {
+        StreamingChunk &chunk = world->chunks[c];
+        chunk.distance = StreamingChunk_Distance(&chunk, position);
+        if (chunk.state == STREAMING_CHUNK_UNLOADED &&
+            chunk.distance <= world->loadRadius) {
+            world->wanted.push_back(c);
+        }
+    }
+    std::sort(world->wanted.begin(), world->wanted.end(),
+              [&](uint32_t a, uint32_t b) {
+                  return world->chunks[a].distance < world->chunks[b].distance;
+              });
+
+    world->stats.deferred = 0;
+    std::vector<uint32_t> requests;
+    for (uint32_t c : world->wanted) {
+        StreamingChunk &chunk = world->chunks[c];
+        if (!StreamingWorld_MakeRoom(world, chunk.size, chunk.distance)) {
+            world->stats.deferred++;
+            continue;
+        }
+
+        world->stats.committedBytes += chunk.size;
+        world->stats.pending++;
+        if (world->loaders.empty()) {
+            auto start = std::chrono::steady_clock::now();
+            StreamingChunkData *data =
+                StreamingWorld_LoadChunk(world->fd, &chunk);
+            float ms = std::chrono::duration<float, std::milli>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+            world->stats.lastLoadMs = ms;
+            world->stats.maxLoadMs = std::max(world->stats.maxLoadMs, ms);
+            StreamingWorld_Complete(world, c, data);
+        } else {
+            chunk.state = STREAMING_CHUNK_PENDING;
+            requests.push_back(c);
+        }
+    }
+
+    if (!requests.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(world->mutex);
+            world->requests.swap(requests);
+        }
+        world->workAvailable.notify_all();
+    }
+}
+
+void StreamingWorld_Draw(Renderer *r, StreamingWorld *world) {
+    if (r == nullptr || r->frame == nullptr || world == nullptr) {
+        return;
+    }
+
+    StreamingWorld_Update(world, r->camera.position);
+
+    Frustum frustum = Frustum_FromMatrix(Renderer_ViewProjection(r));
+    world->stats.drawnChunks = 0;
+    world->stats.placeholders = 0;
+    for (StreamingChunk &chunk : world->chunks) {
+        if (!Frustum_TestAABB(&frustum, chunk.min, chunk.max)) {
+            continue;
+        }
+        chunk.lastVisibleFrame = world->frame;
+
+        if (chunk.state == STREAMING_CHUNK_RESIDENT) {
+            Scene_Draw(r, &chunk.data->scene);
+            world->stats.drawnChunks++;
+        } else if (chunk.state == STREAMING_CHUNK_PENDING ||
+                   chunk.distance <= world->loadRadius) {
+            // The unit cube scaled to the chunk's bounds
+            Vec3 center = Vec3_ScalarMult(Vec3_Add(chunk.min, chunk.max), 0.5f);
+            Vec3 size = Vec3_Subtract(chunk.max, chunk.min);
+            Renderer_DrawCube(r, center, Vec3{0.0f, 0.0f, 0.0f}, size,
+                              STREAMING_PLACEHOLDER_COLOR);
+            world->stats.placeholders++;
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef STREAMING_H_
+#define STREAMING_H_
+
+#include "math.h"
+#include "mesh.h"
+#include "scene.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Renderer;
+
+// Streaming worlds: a large scene is partitioned into square chunks on the
+// XZ plane and stored in one file with an index of the chunks' bounds.
+// At runtime only the chunks near the camera are resident. They are read
+// and built into a Scene by loader threads, the least recently visible
+// ones are evicted to stay within a memory budget, and chunks still
+// loading are drawn as placeholder boxes. The render thread never waits
+// for I/O: it only swaps in finished chunks and hands evicted ones back to
+// the loaders to free, and the loaders run at the lowest priority so they
+// don't take its core. The file is native-endian; meshes are stored per
+// chunk, without lods or textures.
+
+const uint32_t STREAMING_FILE_VERSION = 1;
+const int STREAMING_DEFAULT_LOADERS = 2;
+const ColorRGBA STREAMING_PLACEHOLDER_COLOR = {0.35f, 0.35f, 0.38f, 1.0f};
+
+enum StreamingChunkState {
+    STREAMING_CHUNK_UNLOADED,
+    // Queued or being read by a loader
+    STREAMING_CHUNK_PENDING,
+    STREAMING_CHUNK_RESIDENT,
+    // Unreadable, never requested again
+    STREAMING_CHUNK_FAILED,
+};
+
+// Meshes and objects of a resident chunk (streaming.cpp)
+struct StreamingChunkData;
+
+struct StreamingChunk {
+    // Grid cell and world space bounds of the chunk's objects
+    int x, z;
+    Vec3 min, max;
+    // Bytes in the file, also what the chunk counts against the budget
+    uint64_t offset, size;
+    StreamingChunkState state;
+    StreamingChunkData *data;
+    // Frame number the chunk was last in the frustum
+    uint64_t lastVisibleFrame;
+    float distance;
+};
+
+struct StreamingStats {
+    int chunks;
+    int resident;
+    int pending;
+    size_t residentBytes;
+    // Resident plus pending, what the budget limits
+    size_t committedBytes;
+    size_t budgetBytes;
+    // Totals since the world was opened
+    int loads;
+    int evictions;
+    // Chunks within the load radius left out because the budget is full
+    int deferred;
+    // Of the last StreamingWorld_Draw
+    int drawnChunks;
+    int placeholders;
+    // Time to read and build a chunk, last and worst
+    float lastLoadMs;
+    float maxLoadMs;
+};
+
+struct StreamingWorld {
+    int fd;
+    float chunkSize;
+    std::vector<StreamingChunk> chunks;
+    size_t budgetBytes;
+    float loadRadius;
+    uint64_t frame;
+    // Render thread scratch: chunks to request, nearest first
+    std::vector<uint32_t> wanted;
+
+    // Loaders, and everything they share with the render thread
+    std::vector<std::thread> loaders;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    // Chunks to read, nearest first
+    std::vector<uint32_t> requests;
+    std::vector<std::pair<uint32_t, StreamingChunkData *>> completed;
+    // Evicted chunks for the loaders to free
+    std::vector<StreamingChunkData *> retired;
+    bool quit;
+
+    StreamingStats stats;
+};
+
+// Partitions the objects of scene into chunks of chunkSize x chunkSize world
+// units by the center of their bounds and writes them to path
+bool StreamingWorld_Write(const char *path, const Scene *scene,
+                          float chunkSize);
+
+// Opens a file written by StreamingWorld_Write. Chunks within loadRadius of
+// the camera are kept resident as long as budgetBytes allows. With 0
+// loaders chunks are loaded synchronously in StreamingWorld_Update, which
+// shows the frame time spikes streaming avoids
+bool StreamingWorld_Open(StreamingWorld *world, const char *path,
+                         size_t budgetBytes, float loadRadius,
+                         int numLoaders = STREAMING_DEFAULT_LOADERS);
+void StreamingWorld_Close(StreamingWorld *world);
+
+// Takes in the chunks loaded since the last call, requests the ones within
+// the load radius of position nearest first, and evicts the least recently
+// visible ones the budget needs room from
+void StreamingWorld_Update(StreamingWorld *world, Vec3 position);
+// Updates around the renderer's camera, then draws the resident chunks in
+// its frustum with Scene_Draw and a placeholder box for those still loading
+void StreamingWorld_Draw(Renderer *r, StreamingWorld *world);
+
+#endif
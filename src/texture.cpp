@@ -0,0 +1,94 @@
+#include "texture.h"
+#include <algorithm>
+#include <cmath>
+
+static int Log2(int v) {
+    int l = 0;
+    while ((1 << (l + 1)) <= v) {
+        l++;
+    }
+    return l;
+}
+
+static uint32_t AverageTexels(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+        uint32_t sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) +
+                       ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+        result |= ((sum + 2) / 4) << shift;
+    }
+    return result;
+}
+
+Texture Texture_Create(const uint32_t *pixels, int w, int h,
+                       TextureFilter filter) {
+    Texture t = {.width = w, .height = h, .filter = filter};
+
+    for (int level = 0; level < TEXTURE_MAX_LEVELS; level++) {
+        int lw = std::max(w >> level, 1);
+        int lh = std::max(h >> level, 1);
+
+        TextureLevel *l = &t.levels[level];
+        l->width = lw;
+        l->height = lh;
+        l->blockShift = Log2(std::min(lw, lh));
+        l->texels = new uint32_t[lw * lh];
+
+        for (int y = 0; y < lh; y++) {
+            for (int x = 0; x < lw; x++) {
+                uint32_t texel;
+                if (level == 0) {
+                    texel = pixels[y * w + x];
+                } else {
+                    // 2x2 box filter of the previous level
+                    const TextureLevel *p = &t.levels[level - 1];
+                    int x0 = std::min(x * 2, p->width - 1);
+                    int y0 = std::min(y * 2, p->height - 1);
+                    int x1 = std::min(x * 2 + 1, p->width - 1);
+                    int y1 = std::min(y * 2 + 1, p->height - 1);
+                    texel = AverageTexels(Texture_FetchTexel(p, x0, y0),
+                                          Texture_FetchTexel(p, x1, y0),
+                                          Texture_FetchTexel(p, x0, y1),
+                                          Texture_FetchTexel(p, x1, y1));
+                }
+                l->texels[TextureLevel_Index(l, x, y)] = texel;
+            }
+        }
+
+        t.numLevels = level + 1;
+        if (lw == 1 && lh == 1) {
+            break;
+        }
+    }
+
+    return t;
+}
+
+Texture Texture_CreateChecker(int size, int cells, uint32_t colorA,
+                              uint32_t colorB, TextureFilter filter) {
+    uint32_t *pixels = new uint32_t[size * size];
+    int cellSize = std::max(size / cells, 1);
+
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            bool odd = ((x / cellSize) + (y / cellSize)) & 1;
+            pixels[y * size + x] = odd ? colorB : colorA;
+        }
+    }
+
+    Texture t = Texture_Create(pixels, size, size, filter);
+    delete[] pixels;
+
+    return t;
+}
+
+void Texture_Destroy(Texture *t) {
+    if (t == nullptr) {
+        return;
+    }
+
+    for (int i = 0; i < t->numLevels; i++) {
+        delete[] t->levels[i].texels;
+    }
+    t->numLevels = 0;
+}
@@ -0,0 +1,147 @@
+#ifndef TEXTURE_H_
+#define TEXTURE_H_
+
+#include "math.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+const int TEXTURE_MAX_LEVELS = 16;
+
+enum TextureFilter {
+    TEXTURE_NEAREST,   // nearest texel of the nearest mip level
+    TEXTURE_BILINEAR,  // bilinear within the nearest mip level
+    TEXTURE_TRILINEAR, // bilinear in the two closest levels, blended
+};
+
+// One mip level. Texels are stored in Morton (Z-order) within square blocks
+// of min(width, height) texels, so the 2x2 footprint of a bilinear fetch is
+// almost always within one or two cache lines.
+struct TextureLevel {
+    int width, height;
+    // log2 of the block size, and the Morton mask of a block
+    int blockShift;
+    uint32_t *texels;
+};
+
+struct Texture {
+    int width, height;
+    int numLevels;
+    TextureLevel levels[TEXTURE_MAX_LEVELS];
+    TextureFilter filter;
+};
+
+// Builds the full mip chain from row-major 0xAARRGGBB pixels. Width and
+// height must be powers of two. Coordinates wrap (repeat).
+Texture Texture_Create(const uint32_t *pixels, int w, int h,
+                       TextureFilter filter = TEXTURE_TRILINEAR);
+Texture Texture_CreateChecker(int size, int cells, uint32_t colorA,
+                              uint32_t colorB,
+                              TextureFilter filter = TEXTURE_TRILINEAR);
+void Texture_Destroy(Texture *t);
+
+// The sampler below is inline so that each of the renderer's instruction
+// set variants (see RendererIsa) compiles its own copy rather than calling
+// the generic build out of line
+
+// Spreads the low 16 bits of v so there is a zero bit between each of them
+inline uint32_t MortonPart1By1(uint32_t v) {
+    v &= 0x0000FFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+inline uint32_t TextureLevel_Index(const TextureLevel *level, int x, int y) {
+    uint32_t blockMask = (1u << level->blockShift) - 1;
+    uint32_t morton = MortonPart1By1(x & blockMask) |
+                      (MortonPart1By1(y & blockMask) << 1);
+    // At most one of the two block coordinates is non-zero
+    uint32_t block = (x >> level->blockShift) + (y >> level->blockShift);
+
+    return (block << (level->blockShift * 2)) + morton;
+}
+
+inline uint32_t Texture_FetchTexel(const TextureLevel *level, int x, int y) {
+    // Power-of-two sizes, so repeat is a mask
+    x &= level->width - 1;
+    y &= level->height - 1;
+    return level->texels[TextureLevel_Index(level, x, y)];
+}
+
+inline ColorRGBA TexelToColor(uint32_t texel) {
+    const float s = 1.0f / 255.0f;
+    return {((texel >> 16) & 0xFF) * s, ((texel >> 8) & 0xFF) * s,
+            (texel & 0xFF) * s, ((texel >> 24) & 0xFF) * s};
+}
+
+inline ColorRGBA Texture_SampleNearest(const TextureLevel *level, Vec2 uv) {
+    int x = (int)floorf(uv.x * level->width);
+    int y = (int)floorf(uv.y * level->height);
+    return TexelToColor(Texture_FetchTexel(level, x, y));
+}
+
+inline ColorRGBA Texture_SampleBilinear(const TextureLevel *level, Vec2 uv) {
+    float u = uv.x * level->width - 0.5f;
+    float v = uv.y * level->height - 0.5f;
+    float fx = floorf(u);
+    float fy = floorf(v);
+    float tx = u - fx;
+    float ty = v - fy;
+    int x = (int)fx;
+    int y = (int)fy;
+
+    ColorRGBA c00 = TexelToColor(Texture_FetchTexel(level, x, y));
+    ColorRGBA c10 = TexelToColor(Texture_FetchTexel(level, x + 1, y));
+    ColorRGBA c01 = TexelToColor(Texture_FetchTexel(level, x, y + 1));
+    ColorRGBA c11 = TexelToColor(Texture_FetchTexel(level, x + 1, y + 1));
+
+    ColorRGBA top = LerpRGB(c00, c10, tx);
+    ColorRGBA bottom = LerpRGB(c01, c11, tx);
+    ColorRGBA result = LerpRGB(top, bottom, ty);
+    result.a = LerpFloat(LerpFloat(c00.a, c10.a, tx),
+                         LerpFloat(c01.a, c11.a, tx), ty);
+
+    return result;
+}
+
+// Level of detail for a pixel quad from the UV differences between
+// horizontally and vertically adjacent pixels
+inline float Texture_ComputeLod(const Texture *t, Vec2 dUVdx, Vec2 dUVdy) {
+    float dx = (dUVdx.x * t->width) * (dUVdx.x * t->width) +
+               (dUVdx.y * t->height) * (dUVdx.y * t->height);
+    float dy = (dUVdy.x * t->width) * (dUVdy.x * t->width) +
+               (dUVdy.y * t->height) * (dUVdy.y * t->height);
+
+    // log2(sqrt(x)) == 0.5 * log2(x)
+    return 0.5f * log2f(std::max(std::max(dx, dy), 1e-12f));
+}
+
+inline ColorRGBA Texture_Sample(const Texture *t, Vec2 uv, float lod) {
+    float maxLod = (float)(t->numLevels - 1);
+    lod = std::clamp(lod, 0.0f, maxLod);
+
+    switch (t->filter) {
+    case TEXTURE_NEAREST:
+        return Texture_SampleNearest(&t->levels[(int)(lod + 0.5f)], uv);
+    case TEXTURE_BILINEAR:
+        return Texture_SampleBilinear(&t->levels[(int)(lod + 0.5f)], uv);
+    case TEXTURE_TRILINEAR:
+    default: {
+        int level = (int)lod;
+        float frac = lod - level;
+        ColorRGBA c0 = Texture_SampleBilinear(&t->levels[level], uv);
+        if (frac == 0.0f || level + 1 >= t->numLevels) {
+            return c0;
+        }
+        ColorRGBA c1 = Texture_SampleBilinear(&t->levels[level + 1], uv);
+        ColorRGBA result = LerpRGB(c0, c1, frac);
+        result.a = LerpFloat(c0.a, c1.a, frac);
+        return result;
+    }
+    }
+}
+
+#endif
@@ -0,0 +1,319 @@
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct ThreadPoolJob {
+    ThreadPoolTask task;
+    int count;
+    // Items claimed so far
+    std::atomic<int> next;
+    std::atomic<int> done;
+    // Workers currently inside the job (guarded by the pool mutex). The
+    // submitter keeps the job alive until this drops to zero
+    int users;
+    // Affine jobs claim items per band, from the pool's cursors
+    bool affine;
+    std::atomic<int> stolen;
+};
+
+struct ThreadPool {
+    std::vector<std::thread> threads;
+    std::vector<ThreadPoolJob *> jobs;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable jobFinished;
+    bool quit;
+    // Items of each band an affine job has claimed, one per thread
+    std::unique_ptr<std::atomic<int>[]> bandCursors;
+    std::vector<int> workerNodes;
+};
+
+// Claims and runs items of job until none are left. participant is the
+// worker index, or the number of workers for the submitting thread
+static void ThreadPool_RunJob(ThreadPool *pool, ThreadPoolJob *job,
+                              int participant) {
+    int finished = 0;
+
+    if (!job->affine) {
+        for (;;) {
+            int i = job->next.fetch_add(1);
+            if (i >= job->count) {
+                break;
+            }
+
+            job->task.run(job->task.fn, i);
+            finished++;
+        }
+
+        job->done.fetch_add(finished);
+        return;
+    }
+
+    // Own band first, then the leftovers of the following ones
+    int bands = (int)pool->threads.size() + 1;
+    int stolen = 0;
+    for (int b = 0; b < bands && job->next.load() < job->count; b++) {
+        int band = (participant + b) % bands;
+        int start = (int)((int64_t)band * job->count / bands);
+        int end = (int)((int64_t)(band + 1) * job->count / bands);
+
+        for (;;) {
+            int i = start + pool->bandCursors[band].fetch_add(1);
+            if (i >= end) {
+                break;
+            }
+
+            job->next.fetch_add(1);
+            job->task.run(job->task.fn, i);
+            finished++;
+            stolen += b > 0;
+        }
+    }
+
+    job->stolen.fetch_add(stolen);
+    job->done.fetch_add(finished);
+}
+
+static ThreadPoolJob *ThreadPool_FindJob(ThreadPool *pool) {
+    for (ThreadPoolJob *job : pool->jobs) {
+        if (job->next.load() < job->count) {
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+static void ThreadPool_WorkerLoop(ThreadPool *pool, int index) {
+    std::unique_lock<std::mutex> lock(pool->mutex);
+
+    for (;;) {
+        ThreadPoolJob *job = nullptr;
+        pool->workAvailable.wait(lock, [&] {
+            job = ThreadPool_FindJob(pool);
+            return pool->quit || job != nullptr;
+        });
+
+        if (pool->quit) {
+            return;
+        }
+
+        job->users++;
+        lock.unlock();
+        ThreadPool_RunJob(pool, job, index);
+        lock.lock();
+        job->users--;
+
+        if (job->users == 0 && job->done.load() == job->count) {
+            pool->jobFinished.notify_all();
+        }
+    }
+}
+
+ThreadPool *ThreadPool_Create(int numWorkers) {
+    ThreadPool *pool = new ThreadPool();
+    pool->bandCursors.reset(new std::atomic<int>[numWorkers + 1]);
+    pool->workerNodes.assign(numWorkers, -1);
+
+    for (int i = 0; i < numWorkers; i++) {
+        pool->threads.emplace_back(ThreadPool_WorkerLoop, pool, i);
+    }
+
+    return pool;
+}
+
+void ThreadPool_Destroy(ThreadPool *pool) {
+    if (pool == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->workAvailable.notify_all();
+
+    for (auto &th : pool->threads) {
+        th.join();
+    }
+
+    delete pool;
+}
+
+int ThreadPool_Concurrency(ThreadPool *pool) {
+    return (int)pool->threads.size() + 1;
+}
+
+#ifdef __linux__
+// Node of each CPU from sysfs, all on node 0 without it
+static std::vector<int> ThreadPool_CpuNodes() {
+    std::vector<int> nodes(CPU_SETSIZE, 0);
+    for (int node = 0; node < CPU_SETSIZE; node++) {
+        char path[64];
+        snprintf(path, sizeof(path),
+                 "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *file = fopen(path, "r");
+        if (file == nullptr) {
+            // Node numbers can have holes, stop after a long gap
+            if (node > 64) {
+                break;
+            }
+            continue;
+        }
+
+        // e.g. "0-15,32-47"
+        int first, last;
+        while (fscanf(file, "%d", &first) == 1) {
+            last = first;
+            int c = fgetc(file);
+            if (c == '-' && fscanf(file, "%d", &last) == 1) {
+                c = fgetc(file);
+            }
+            for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+                nodes[cpu] = node;
+            }
+            if (c != ',') {
+                break;
+            }
+        }
+        fclose(file);
+    }
+    return nodes;
+}
+#endif
+
+int ThreadPool_PinWorkers(ThreadPool *pool) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return 0;
+    }
+
+    // Allowed CPUs as (node, cpu), by node
+    std::vector<int> cpuNodes = ThreadPool_CpuNodes();
+    std::vector<std::pair<int, int>> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) {
+            cpus.push_back({cpuNodes[cpu], cpu});
+        }
+    }
+    if (cpus.empty()) {
+        return 0;
+    }
+    std::stable_sort(cpus.begin(), cpus.end());
+
+    for (size_t i = 0; i < pool->threads.size(); i++) {
+        const std::pair<int, int> &cpu = cpus[i % cpus.size()];
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu.second, &set);
+        if (pthread_setaffinity_np(pool->threads[i].native_handle(),
+                                   sizeof(set), &set) == 0) {
+            pool->workerNodes[i] = cpu.first;
+        }
+    }
+
+    int nodes = 1;
+    for (size_t i = 1; i < cpus.size(); i++) {
+        nodes += cpus[i].first != cpus[i - 1].first;
+    }
+    return nodes;
+#else
+    // Thread affinity is only a hint elsewhere (e.g. macOS)
+    return 0;
+#endif
+}
+
+int ThreadPool_WorkerNode(ThreadPool *pool, int i) {
+    if (i < 0 || i >= (int)pool->workerNodes.size()) {
+        return -1;
+    }
+    return pool->workerNodes[i];
+}
+
+// Publishes job, helps with it and waits until every item is done
+static void ThreadPool_Submit(ThreadPool *pool, ThreadPoolJob *job) {
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->jobs.push_back(job);
+    }
+    pool->workAvailable.notify_all();
+
+    ThreadPool_RunJob(pool, job, (int)pool->threads.size());
+
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->jobFinished.wait(lock, [&] {
+        return job->done.load() == job->count && job->users == 0;
+    });
+
+    for (size_t i = 0; i < pool->jobs.size(); i++) {
+        if (pool->jobs[i] == job) {
+            pool->jobs.erase(pool->jobs.begin() + i);
+            break;
+        }
+    }
+}
+
+void ThreadPool_Run(ThreadPool *pool, int count, ThreadPoolTask task) {
+    if (count <= 0) {
+        return;
+    }
+
+    // Not worth waking anybody up
+    if (count == 1 || pool->threads.empty()) {
+        for (int i = 0; i < count; i++) {
+            task.run(task.fn, i);
+        }
+        return;
+    }
+
+    ThreadPoolJob job;
+    job.task = task;
+    job.count = count;
+    job.next = 0;
+    job.done = 0;
+    job.users = 0;
+    job.affine = false;
+    job.stolen = 0;
+    ThreadPool_Submit(pool, &job);
+}
+
+int ThreadPool_RunAffine(ThreadPool *pool, int count, ThreadPoolTask task) {
+    if (count <= 0) {
+        return 0;
+    }
+
+    // Everything runs on the caller, which owns the only band
+    if (pool->threads.empty()) {
+        for (int i = 0; i < count; i++) {
+            task.run(task.fn, i);
+        }
+        return 0;
+    }
+
+    for (size_t b = 0; b <= pool->threads.size(); b++) {
+        pool->bandCursors[b] = 0;
+    }
+
+    ThreadPoolJob job;
+    job.task = task;
+    job.count = count;
+    job.next = 0;
+    job.done = 0;
+    job.users = 0;
+    job.affine = true;
+    job.stolen = 0;
+    ThreadPool_Submit(pool, &job);
+    return job.stolen.load();
+}
@@ -0,0 +1,55 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+// Persistent worker threads shared by the render stages. Several threads may
+// submit work at the same time (e.g. geometry on the main thread while the
+// raster thread fans out tiles); idle workers pick up whichever job still has
+// unclaimed items.
+struct ThreadPool;
+
+// Creates numWorkers background threads. The thread calling
+// ThreadPool_ParallelFor always helps with its own job, so 0 is valid and
+// runs everything on the caller.
+ThreadPool *ThreadPool_Create(int numWorkers);
+void ThreadPool_Destroy(ThreadPool *pool);
+// Background workers plus the calling thread
+int ThreadPool_Concurrency(ThreadPool *pool);
+
+// Non-owning reference to a loop body, so submitting work never allocates
+struct ThreadPoolTask {
+    void (*run)(const void *fn, int i);
+    const void *fn;
+};
+
+// Pins the workers to the CPUs the process may run on, ordered by NUMA node
+// so that workers next to each other share a node. Returns the number of
+// nodes found (1 on single-socket machines), 0 where threads can't be
+// pinned
+int ThreadPool_PinWorkers(ThreadPool *pool);
+// NUMA node of worker i once pinned, -1 when unknown
+int ThreadPool_WorkerNode(ThreadPool *pool, int i);
+
+// Runs task for every i in [0, count) and returns once all calls finished
+void ThreadPool_Run(ThreadPool *pool, int count, ThreadPoolTask task);
+
+// ThreadPool_Run with a stable item to thread mapping: [0, count) is split
+// into one contiguous band per thread, workers in order and the caller
+// last, and each thread runs its own band before helping with what is left
+// of the others. Returns how many items ran outside their thread's band.
+// Only one affine job may run on a pool at a time
+int ThreadPool_RunAffine(ThreadPool *pool, int count, ThreadPoolTask task);
+
+// ThreadPool_Run for any callable fn(int), usually a lambda
+template <typename F>
+void ThreadPool_ParallelFor(ThreadPool *pool, int count, const F &fn) {
+    ThreadPool_Run(pool, count,
+                   {[](const void *f, int i) { (*(const F *)f)(i); }, &fn});
+}
+
+template <typename F>
+int ThreadPool_ParallelForAffine(ThreadPool *pool, int count, const F &fn) {
+    return ThreadPool_RunAffine(
+        pool, count, {[](const void *f, int i) { (*(const F *)f)(i); }, &fn});
+}
+
+#endif
@@ -0,0 +1,86 @@
+// Sample consumer of frames exported with Renderer_EnableFrameExport. Maps
+// the ring, reads every frame in place and prints once per second the
+// frames/sec it sustains, the latency from Renderer_EndFrame to the frame
+// being read, and frames it skipped or found overwritten.
+//
+//   make consumer
+//   ./bin/Bench export & ./bin/FrameConsumer [name] [seconds]
+
+#include "framering.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+int main(int argc, char **argv) {
+    const char *name = argc > 1 ? argv[1] : "/rasterizer";
+    double seconds = argc > 2 ? atof(argv[2]) : 10.0;
+
+    // The producer may not be up yet
+    FrameRingReader reader;
+    uint64_t end = FrameRing_NowNs() + (uint64_t)(seconds * 1e9);
+    while (!FrameRingReader_Open(&reader, name)) {
+        if (FrameRing_NowNs() >= end) {
+            fprintf(stderr, "no frame ring named %s\n", name);
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    printf("%s: %u slots of up to %ux%u\n", name, reader.header->numSlots,
+           reader.header->maxWidth, reader.header->maxHeight);
+
+    uint64_t reportNs = FrameRing_NowNs() + 1000000000ull;
+    uint64_t lastFrame = 0;
+    int frames = 0, skipped = 0, torn = 0, idle = 0;
+    double latencyMs = 0.0, maxLatencyMs = 0.0;
+    uint32_t checksum = 0;
+
+    while (FrameRing_NowNs() < end) {
+        FrameView view;
+        if (FrameRingReader_Wait(&reader, 100, &view)) {
+            idle = 0;
+
+            // Stands in for encoding or compositing the frame
+            for (uint32_t y = 0; y < view.height; y++) {
+                const uint32_t *row = view.pixels + y * view.stride;
+                for (uint32_t x = 0; x < view.width; x++) {
+                    checksum += row[x];
+                }
+            }
+
+            if (FrameRingReader_Valid(&reader, &view)) {
+                double ms = (FrameRing_NowNs() - view.submitNs) / 1e6;
+                if (lastFrame > 0) {
+                    skipped += (int)(view.frameNumber - lastFrame) - 1;
+                }
+                lastFrame = view.frameNumber;
+                frames++;
+                latencyMs += ms;
+                maxLatencyMs = std::max(maxLatencyMs, ms);
+            } else {
+                torn++;
+            }
+        } else if (++idle == 20) {
+            printf("producer idle for 2 s, stopping\n");
+            break;
+        }
+
+        uint64_t now = FrameRing_NowNs();
+        if (now >= reportNs) {
+            printf("%6.1f fps  latency avg %6.2f ms max %6.2f ms  "
+                   "skipped %d  torn %d\n",
+                   frames * 1e9 / (now - reportNs + 1000000000ull),
+                   latencyMs / std::max(frames, 1), maxLatencyMs, skipped,
+                   torn);
+            reportNs = now + 1000000000ull;
+            frames = skipped = torn = 0;
+            latencyMs = maxLatencyMs = 0.0;
+        }
+    }
+
+    // Keeps the pixel reads from being optimized out
+    printf("checksum %08x\n", checksum);
+    FrameRingReader_Close(&reader);
+    return 0;
+}